@@ -48,6 +48,70 @@ BEGIN_C_DECLS
 
 /*********************** DATA STRUCTURES ***************************/
 
+/** Bits of hawopencl_device_caps.extension_bits for frequently checked extensions */
+#define HAWOPENCL_EXT_KHR_FP64                      (1ULL << 0)
+#define HAWOPENCL_EXT_KHR_FP16                      (1ULL << 1)
+#define HAWOPENCL_EXT_KHR_GL_SHARING                (1ULL << 2)
+#define HAWOPENCL_EXT_KHR_GL_EVENT                  (1ULL << 3)
+#define HAWOPENCL_EXT_APPLE_GL_SHARING              (1ULL << 4)
+#define HAWOPENCL_EXT_KHR_GLOBAL_INT32_BASE_ATOMICS (1ULL << 5)
+#define HAWOPENCL_EXT_KHR_LOCAL_INT32_BASE_ATOMICS  (1ULL << 6)
+#define HAWOPENCL_EXT_KHR_INT64_BASE_ATOMICS        (1ULL << 7)
+#define HAWOPENCL_EXT_KHR_BYTE_ADDRESSABLE_STORE    (1ULL << 8)
+#define HAWOPENCL_EXT_KHR_3D_IMAGE_WRITES           (1ULL << 9)
+#define HAWOPENCL_EXT_KHR_IL_PROGRAM                (1ULL << 10)
+#define HAWOPENCL_EXT_KHR_SUBGROUPS                 (1ULL << 11)
+#define HAWOPENCL_EXT_KHR_SPIR                      (1ULL << 12)
+
+/** Indices of hawopencl_device_caps.preferred_vector_width and native_vector_width */
+typedef enum {
+    HAWOPENCL_VECTOR_CHAR = 0,
+    HAWOPENCL_VECTOR_SHORT,
+    HAWOPENCL_VECTOR_INT,
+    HAWOPENCL_VECTOR_LONG,
+    HAWOPENCL_VECTOR_FLOAT,
+    HAWOPENCL_VECTOR_DOUBLE,
+    HAWOPENCL_VECTOR_HALF,
+    HAWOPENCL_VECTOR_TYPES
+} hawopencl_vector_type;
+
+/** The capabilities of a device, queried once, see opencl_device_caps() */
+typedef struct {
+    char name[256];             /** CL_DEVICE_NAME */
+    char vendor[256];           /** CL_DEVICE_VENDOR */
+    char device_version[128];   /** CL_DEVICE_VERSION */
+    char driver_version[128];   /** CL_DRIVER_VERSION */
+    char platform_name[256];    /** CL_PLATFORM_NAME of the device's platform */
+    char platform_version[128]; /** CL_PLATFORM_VERSION of the device's platform */
+    char * extensions;          /** CL_DEVICE_EXTENSIONS, the complete list, owned by the library */
+    cl_ulong extension_bits;    /** The HAWOPENCL_EXT_* bits of the extensions supported */
+    cl_platform_id platform_id; /** The platform the device belongs to */
+    cl_device_type type;        /** CL_DEVICE_TYPE */
+    cl_uint vendor_id;          /** CL_DEVICE_VENDOR_ID */
+    cl_uint max_compute_units;  /** CL_DEVICE_MAX_COMPUTE_UNITS */
+    cl_uint max_clock_frequency; /** CL_DEVICE_MAX_CLOCK_FREQUENCY in MHz */
+    cl_uint max_work_item_dimensions; /** CL_DEVICE_MAX_WORK_ITEM_DIMENSIONS */
+    size_t max_work_item_sizes[3]; /** CL_DEVICE_MAX_WORK_ITEM_SIZES of the first three dimensions */
+    size_t max_work_group_size; /** CL_DEVICE_MAX_WORK_GROUP_SIZE */
+    cl_ulong global_mem_size;   /** CL_DEVICE_GLOBAL_MEM_SIZE in bytes */
+    cl_ulong global_mem_cache_size; /** CL_DEVICE_GLOBAL_MEM_CACHE_SIZE in bytes */
+    cl_uint global_mem_cacheline_size; /** CL_DEVICE_GLOBAL_MEM_CACHELINE_SIZE in bytes */
+    cl_ulong local_mem_size;    /** CL_DEVICE_LOCAL_MEM_SIZE in bytes */
+    cl_device_local_mem_type local_mem_type; /** CL_DEVICE_LOCAL_MEM_TYPE, CL_LOCAL or CL_GLOBAL */
+    cl_ulong max_mem_alloc_size; /** CL_DEVICE_MAX_MEM_ALLOC_SIZE in bytes */
+    cl_ulong max_constant_buffer_size; /** CL_DEVICE_MAX_CONSTANT_BUFFER_SIZE in bytes */
+    cl_uint mem_base_addr_align; /** CL_DEVICE_MEM_BASE_ADDR_ALIGN in bits */
+    cl_uint address_bits;       /** CL_DEVICE_ADDRESS_BITS */
+    cl_uint preferred_vector_width[HAWOPENCL_VECTOR_TYPES]; /** CL_DEVICE_PREFERRED_VECTOR_WIDTH_* */
+    cl_uint native_vector_width[HAWOPENCL_VECTOR_TYPES]; /** CL_DEVICE_NATIVE_VECTOR_WIDTH_* */
+    cl_bool little_endian;      /** CL_DEVICE_ENDIAN_LITTLE */
+    cl_bool image_support;      /** CL_DEVICE_IMAGE_SUPPORT */
+    cl_bool compiler_available; /** CL_DEVICE_COMPILER_AVAILABLE */
+    cl_command_queue_properties queue_properties; /** CL_DEVICE_QUEUE_PROPERTIES supported by host queues */
+    cl_ulong svm_capabilities;  /** CL_DEVICE_SVM_CAPABILITIES, 0 before OpenCL 2.0 */
+    double score;               /** Estimated performance used by opencl_select_device(), higher is faster */
+} hawopencl_device_caps;
+
 typedef struct {
     cl_device_id device_id;
     cl_device_type device_type; /** The device type returned by clGetDeviceInfo(CL_DEVICE_TYPE) */
@@ -57,8 +121,127 @@ typedef struct {
     bool has_cl_khr_gl_sharing;
     bool has_cl_khr_gl_event;
     bool has_cl_compiler;
+    cl_platform_id platform_id; /** The platform the device belongs to */
+    const hawopencl_device_caps * caps; /** All capabilities, e.g. vendor and score, owned by the library */
 } hawopencl_device;
 
+/** Priority of a command queue, requires the extension cl_khr_priority_hints */
+typedef enum {
+    HAWOPENCL_QUEUE_PRIORITY_DEFAULT = 0,
+    HAWOPENCL_QUEUE_PRIORITY_HIGH,
+    HAWOPENCL_QUEUE_PRIORITY_MEDIUM,
+    HAWOPENCL_QUEUE_PRIORITY_LOW
+} hawopencl_queue_priority;
+
+/** The properties of command queues, see opencl_queue_config_init() */
+typedef struct {
+    cl_command_queue_properties properties; /** E.g. CL_QUEUE_PROFILING_ENABLE, CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE */
+    cl_uint size;               /** CL_QUEUE_SIZE in bytes for CL_QUEUE_ON_DEVICE queues (OpenCL 2.x), 0 for default */
+    hawopencl_queue_priority priority; /** The priority, ignored without cl_khr_priority_hints */
+} hawopencl_queue_config;
+
+/**
+ * A context shared by several devices of one platform with their command queues.
+ * All functions taking the runtime may be called from several threads at once;
+ * the OpenCL objects follow the OpenCL rules, i.e. a cl_kernel must not be
+ * used by several threads concurrently.
+ * Only the programs of opencl_runtime_kernel() belong to the runtime; the
+ * binary cache, kernel variants, libraries and watched kernels are shared by
+ * all runtimes of the process.
+ */
+typedef struct {
+    cl_platform_id platform_id; /** The platform of all devices */
+    cl_context context;         /** The context containing all devices */
+    cl_uint num_devices;        /** The number of devices */
+    cl_device_id * device_ids;  /** The devices */
+    cl_uint queues_per_device;  /** The number of command queues of every device */
+    cl_command_queue * command_queues; /** The queues of device d start at d * queues_per_device */
+    cl_device_id parent_device_id; /** The device partitioned into the devices, NULL without partitioning */
+    int * numa_nodes;           /** The NUMA node of every device, -1 if unknown */
+    struct hawopencl_runtime_state * state; /** The programs built for the runtime and their lock */
+} hawopencl_runtime;
+
+/** How opencl_init_partitioned() splits a device into sub-devices */
+typedef enum {
+    HAWOPENCL_PARTITION_NUMA,   /** One sub-device per NUMA node */
+    HAWOPENCL_PARTITION_EQUALLY, /** Sub-devices of the same number of compute units */
+    HAWOPENCL_PARTITION_BY_COUNTS /** Sub-devices of the given numbers of compute units */
+} hawopencl_partition_mode;
+
+/** The size classes and budget of a buffer pool, see opencl_buffer_pool_config_init() */
+typedef struct {
+    cl_mem_flags flags;         /** The flags of all buffers, e.g. CL_MEM_READ_WRITE */
+    size_t min_size;            /** The smallest size class, a power of two */
+    size_t max_size;            /** The largest size class, a power of two; larger buffers are not pooled */
+    cl_uint classes_per_doubling; /** Size classes from one power of two to the next: 1 for powers of two, 2, 4, ... */
+    size_t budget;              /** The maximum bytes of the buffers held, in use or free; 0 for no limit */
+} hawopencl_buffer_pool_config;
+
+typedef struct {
+    unsigned long hits;         /** Allocations served by a released buffer */
+    unsigned long misses;       /** Allocations, which had to call clCreateBuffer() */
+    unsigned long unpooled;     /** Allocations larger than max_size */
+    unsigned long trims;        /** Free buffers released to stay within the budget */
+    unsigned long long bytes_in_use; /** The bytes of the pooled buffers currently allocated */
+    unsigned long long bytes_free;   /** The bytes of the released buffers kept for reuse */
+} hawopencl_buffer_pool_stats;
+
+/** Device buffers of one context recycled by size class, see opencl_buffer_pool_create() */
+typedef struct hawopencl_buffer_pool hawopencl_buffer_pool;
+
+/** Host memory a buffer works on in place, see opencl_host_buffer_create() */
+typedef struct {
+    cl_mem buffer;              /** The CL_MEM_USE_HOST_PTR buffer wrapping host */
+    void * host;                /** The host memory, aligned and padded to alignment */
+    size_t size;                /** The size of the buffer in bytes */
+    size_t alignment;           /** CL_DEVICE_MEM_BASE_ADDR_ALIGN in bytes, at least the cacheline size */
+    bool zero_copy;             /** Whether the last map returned host, i.e. mapping copies nothing */
+} hawopencl_host_buffer;
+
+/**
+ * One buffer, from which sub-buffers are allocated for many small objects,
+ * uploaded by one transfer and freed together, see opencl_arena_create().
+ */
+typedef struct {
+    cl_mem buffer;              /** The buffer the sub-buffers are created in */
+    char * host;                /** The host copy of the buffer, transferred by opencl_arena_upload() */
+    size_t size;                /** The size of the buffer in bytes */
+    size_t used;                /** The bytes allocated since the last opencl_arena_reset() */
+    size_t alignment;           /** CL_DEVICE_MEM_BASE_ADDR_ALIGN in bytes, the alignment of all sub-buffers */
+    cl_uint num_sub_buffers;    /** The sub-buffers allocated since the last opencl_arena_reset() */
+    cl_uint max_sub_buffers;    /** The size of the array sub_buffers */
+    cl_mem * sub_buffers;       /** The sub-buffers, released by opencl_arena_reset() */
+} hawopencl_arena;
+
+/** The sharing of shared virtual memory between host and device */
+typedef enum {
+    HAWOPENCL_SVM_COARSE_GRAIN = 0, /** Shared at map and unmap, CL_DEVICE_SVM_COARSE_GRAIN_BUFFER */
+    HAWOPENCL_SVM_FINE_GRAIN        /** Shared at synchronization points without mapping, CL_DEVICE_SVM_FINE_GRAIN_BUFFER */
+} hawopencl_svm_granularity;
+
+/**
+ * A region of shared virtual memory, in which pointer-rich data structures
+ * are allocated by opencl_svm_alloc(); its pointers are valid on the host
+ * and in kernels alike, see opencl_svm_create().
+ */
+typedef struct {
+    cl_context context;         /** The context the region was allocated in */
+    void * ptr;                 /** The start of the region */
+    size_t size;                /** The size of the region in bytes */
+    size_t used;                /** The bytes allocated by opencl_svm_alloc() */
+    hawopencl_svm_granularity granularity; /** The granularity of the region */
+} hawopencl_svm;
+
+/** Pinned host memory for asynchronous transfers, see opencl_staging_ring_create() */
+typedef struct hawopencl_staging_ring hawopencl_staging_ring;
+
+typedef enum {
+    HAWOPENCL_SELECT_FASTEST = 0,   /** The highest score */
+    HAWOPENCL_SELECT_MEMORY,        /** The most global memory */
+    HAWOPENCL_SELECT_NAME,          /** The fastest device with a name matching the pattern */
+    HAWOPENCL_SELECT_VENDOR         /** The fastest device with a vendor matching the pattern */
+} hawopencl_select_policy;
+
 typedef struct {
     cl_kernel_arg_address_qualifier address_qualifier;
     cl_kernel_arg_access_qualifier access_qualifier;
@@ -87,10 +270,80 @@ typedef struct {
     cl_ulong private_mem_size;
 
     // Information provided by clGetKernelArgInfo()
-    // Array of size kernel_num_args (as above)
+    // Array of size kernel_num_args (as above); names and types are NULL,
+    // unless the program was built with -cl-kernel-arg-info
+    // (e.g. hawopencl_build_options.kernel_arg_info or the debug profile).
     hawopencl_kernelarg * args;
 } hawopencl_kernel;
 
+typedef enum {
+    HAWOPENCL_BUILD_PROFILE_DEBUG = 0,  /** No optimization, with kernel argument info */
+    HAWOPENCL_BUILD_PROFILE_RELEASE,    /** The compiler's default optimizations */
+    HAWOPENCL_BUILD_PROFILE_FAST_MATH,  /** -cl-fast-relaxed-math -cl-mad-enable */
+    HAWOPENCL_BUILD_PROFILE_STRICT      /** Correctly rounded single precision divide and sqrt */
+} hawopencl_build_profile;
+
+typedef struct {
+    hawopencl_build_profile profile; /** The optimization profile */
+    bool kernel_arg_info;       /** Add -cl-kernel-arg-info, for argument names and types in opencl_kernel_info() */
+    char * defines;             /** The -D macro definitions added by opencl_build_options_define() */
+    char * extra;               /** Further options added by opencl_build_options_add() */
+    char * options;             /** The options string assembled by opencl_build_options_string() */
+} hawopencl_build_options;
+
+typedef struct {
+    cl_program program;         /** The program all kernels were created from */
+    cl_uint num_kernels;        /** The number of kernels in the program */
+    cl_kernel * kernels;        /** Array of size num_kernels */
+    char ** kernel_names;       /** Array of size num_kernels, the kernels' function names */
+    cl_uint table_size;         /** Size of the hash table (a power of two) */
+    cl_int * table;             /** Hash table of indices into kernels, -1 if empty */
+} hawopencl_program;
+
+typedef struct {
+    unsigned long hits;         /** Programs created from a cached binary */
+    unsigned long misses;       /** Programs which had to be built from source */
+    unsigned long stores;       /** Binaries written to the cache */
+    unsigned long evictions;    /** Entries removed to stay below the size cap */
+    unsigned long invalid;      /** Corrupt or stale entries removed */
+    unsigned long long bytes;   /** Size of the cache directory after the last store */
+} hawopencl_kernel_cache_stats;
+
+/** Library of device functions compiled once and linked into programs, see opencl_library_build() */
+typedef struct hawopencl_library hawopencl_library;
+
+typedef struct {
+    const char * name;          /** The macro's name */
+    const char * value;         /** The macro's value, or NULL to define it without value */
+} hawopencl_define;
+
+/** Kernel file compiled into the executable, see hawopencl_embed_kernels() */
+typedef struct {
+    const char * name;          /** The name the file is loaded and included by, e.g. "vector_add.cl" */
+    const char * source;        /** The file's contents, NUL-terminated */
+    size_t length;              /** The length of the contents without the NUL */
+} hawopencl_embedded_kernel;
+
+/** Kernel source loaded by opencl_kernel_map() as segments of the mapped files */
+typedef struct {
+    cl_uint count;              /** The number of segments */
+    const char ** strings;      /** The segments, NOT NUL-terminated */
+    size_t * lengths;           /** The length of each segment */
+    struct hawopencl_source_files * files; /** The mapped files, released by opencl_kernel_unmap() */
+} hawopencl_source;
+
+/** Table of kernel variants built by opencl_kernel_variant() */
+typedef struct hawopencl_variant_cache hawopencl_variant_cache;
+
+/** Archive of kernels compiled ahead of time, see opencl_archive_open() */
+typedef struct hawopencl_archive hawopencl_archive;
+
+/** Handle of a program being built by opencl_program_build_async() */
+typedef struct hawopencl_build_job hawopencl_build_job;
+
+/** Kernel file rebuilt upon changes, see opencl_kernel_watch() */
+typedef struct hawopencl_watch hawopencl_watch;
+
 typedef struct {
     char ** event_names;
     cl_event * events;
@@ -130,9 +383,9 @@ int opencl_print_device(cl_device_id cl_device);
 int opencl_print_info(void);
 
 /**
- * Get all the available device IDs.
+ * Get all the available device IDs of all platforms.
  * This may be used in conjunction with opencl_print_device() or with
- * opencl_init() to select a preferred device.
+ * opencl_select_device() and opencl_init() to select a preferred device.
  * 
  * @param[in] on_device_type Either CL_DEVICE_TYPE_CPU / GPU / ACCELERATOR,
  *                           a combination of the previous, or
@@ -141,22 +394,65 @@ int opencl_print_info(void);
  * @param[out] devices       The array of matching devices.
  * 
  * @return CL_SUCCESS in case of no error
- * @warning The User is responsible for freeing the devices array!
+ * @warning The User is responsible for freeing the devices array, e.g. using opencl_free_devices()!
  */
 int opencl_get_devices(const cl_device_type on_device_type, 
         cl_uint * num_devices,
         hawopencl_device ** devices) __HAW_OPENCL_ATTR_NONNULL__(2,3);
 
+/**
+ * Select a device of the list returned by opencl_get_devices() by policy.
+ * The score is derived from the compute units, the clock frequency, the
+ * local memory type and the global memory size.
+ *
+ * @param[in] num_devices    The number of devices in the array
+ * @param[in] devices        The devices returned by opencl_get_devices()
+ * @param[in] policy         The policy to select by
+ * @param[in] pattern        For HAWOPENCL_SELECT_NAME and _VENDOR the case-insensitive
+ *                           extended regular expression to match, e.g. "NVIDIA|AMD"
+ * @param[out] index         The index of the selected device in devices
+ *
+ * @return CL_SUCCESS in case of no error, CL_DEVICE_NOT_FOUND if no device matches
+ */
+int opencl_select_device(cl_uint num_devices,
+        const hawopencl_device * devices,
+        hawopencl_select_policy policy,
+        const char * pattern,
+        cl_uint * index) __HAW_OPENCL_ATTR_NONNULL__(5);
+
+/**
+ * Free the devices returned by opencl_get_devices() including their strings.
+ *
+ * @return CL_SUCCESS in case of no error
+ */
+int opencl_free_devices(cl_uint num_devices,
+        hawopencl_device * devices);
+
+/**
+ * Get the capabilities of the device. They are queried once per process and
+ * shared by all library functions; with the kernel cache enabled (see
+ * opencl_kernel_cache_config()) they are stored in the cache directory, so
+ * later processes only query the few properties identifying the device and
+ * its driver version.
+ *
+ * @param[in] device_id      The device
+ *
+ * @return the capabilities, valid until the end of the process, also for
+ *         released sub-devices of opencl_init_partitioned()
+ */
+const hawopencl_device_caps * opencl_device_caps(const cl_device_id device_id);
+
 
 /**
- * Initialize OpenCL, searching for the first of the requested target
+ * Initialize OpenCL, searching all platforms for the requested target
  *
  * @param[in] on_device_type Either CL_DEVICE_TYPE_CPU / GPU / ACCELERATOR,
  *                           a combination of the previous, or
  *                           CL_DEVICE_TYPE_CUSTOM
- * @param[in] preferred_device_id By default, the 1. matching device of given
- *                           type is selected, aka passing 0. This may be used
- *                           to select another device than the first device.
+ * @param[in] preferred_device_id By default, the fastest matching device of given
+ *                           type of all platforms is selected, aka passing 0.
+ *                           This may be used to select another device, e.g.
+ *                           by opencl_select_device().
  * @param[out] device_id     The device id opened
  * @param[out] context       The context opened with the device
  * @param[out] command_queue The command queue to which further commands are send.
@@ -173,62 +469,1376 @@ int opencl_init(const cl_device_type on_device_type,
         cl_command_queue * command_queue) __HAW_OPENCL_ATTR_NONNULL__(3,4,5);
 
 /**
- * Print the provided error-status into the print-buffer of length len.
+ * Initialize OpenCL like opencl_init(), creating the command queue with the
+ * given properties.
  *
- * @param[in]    status       The error status returned by any OpenCL function
- * @param[in]    len          The length of the print_buffer
- * @param[inout] print_buffer This buffer of length len is overwritten with the
- *                            clear-text description of the error (NUL-terminated) 
- *  
- * @return the error-status as passed in;
- *         CL_SUCCESS in case of no error
+ * @param[in] on_device_type As for opencl_init()
+ * @param[in] preferred_device_id As for opencl_init()
+ * @param[in] config         The properties of the queue; NULL for the defaults
+ *                           of opencl_queue_config_init()
+ * @param[out] device_id     The device id opened
+ * @param[out] context       The context opened with the device
+ * @param[out] command_queue The command queue to which further commands are send.
+ *
+ * @return CL_SUCCESS in case of no error
+ * @warning User has to release context and command_queue upon exit
  */
-int opencl_printf_error(cl_int status, unsigned int len, char * print_buffer) __HAW_OPENCL_ATTR_NONNULL__(3);
+int opencl_init_with_queue_config(const cl_device_type on_device_type,
+        cl_device_id preferred_device_id,
+        const hawopencl_queue_config * config,
+        cl_device_id * device_id,
+        cl_context * context,
+        cl_command_queue * command_queue) __HAW_OPENCL_ATTR_NONNULL__(4,5,6);
 
 /**
- * Macro to exit in case of error status (!= CL_SUCCESS) with provided message.
+ * Initialize the queue properties to the defaults used by opencl_init():
+ * an in-order queue with profiling enabled. Profiling may add overhead
+ * to every command; an out-of-order queue lets independent commands overlap,
+ * dependencies then have to be expressed by events.
  *
- * @param[in]   status        The status variable which is checked against CL_SUCCESS
- * @param[in]   msg           The error message to print in case of error
+ * @param[out] config        The properties to initialize
+ *
+ * @return CL_SUCCESS in case of no error
  */
-#define opencl_check_error(status,msg) do { \
-            if (CL_SUCCESS != status) { \
-                char buf[256]; \
-                opencl_printf_error(status, sizeof(buf)-1, buf); \
-                fprintf(stderr, "ERROR (%s:%d): %s. %s\n", \
-                        __FILE__, __LINE__, (msg), buf); \
-                exit(-1); \
-            } \
-        } while(0)
+int opencl_queue_config_init(hawopencl_queue_config * config) __HAW_OPENCL_ATTR_NONNULL__(1);
 
 /**
- * Load the file named kernel_file_name as String.
+ * Create a command queue with the given properties. Properties the device
+ * does not support, such as out-of-order execution, are dropped with a notice.
+ * On OpenCL 2.x platforms clCreateCommandQueueWithProperties() is used,
+ * which is required for the queue size and priority.
  *
- * @return Kernel as String in case of success
- *         NULL otherwise
+ * @param[in] device_id      The device
+ * @param[in] context        The context containing the device
+ * @param[in] config         The properties of the queue; NULL for the defaults
+ * @param[out] command_queue The command queue
+ *
+ * @return CL_SUCCESS in case of no error
  */
-char * opencl_kernel_load(const char * kernel_file_name) __HAW_OPENCL_ATTR_NONNULL__(1) __HAW_OPENCL_ATTR_WARN_UNUSED_RESULT__;
+int opencl_command_queue_create(const cl_device_id device_id,
+        const cl_context context,
+        const hawopencl_queue_config * config,
+        cl_command_queue * command_queue) __HAW_OPENCL_ATTR_NONNULL__(4);
 
+/**
+ * Initialize OpenCL with one context for several devices of the same
+ * platform, and create queues_per_device command queues for every device,
+ * e.g. to run independent batches on all devices in parallel.
+ *
+ * @param[in] on_device_type    The device type as for opencl_init()
+ * @param[in] num_devices       The number of devices in device_ids; without device_ids
+ *                              the maximum number of devices to use, 0 for all
+ * @param[in] device_ids        The devices to use, e.g. from opencl_get_devices();
+ *                              NULL selects the devices of the platform with the
+ *                              fastest device of on_device_type
+ * @param[in] queues_per_device The number of command queues for every device
+ * @param[in] config            The properties of the queues; NULL for the defaults
+ *                              of opencl_queue_config_init()
+ * @param[out] runtime          The context, the devices and their queues
+ *
+ * @return CL_SUCCESS in case of no error, CL_INVALID_DEVICE if the devices belong
+ *         to several platforms or are not of on_device_type
+ * @note OpenGL sharing is not supported for several devices; use opencl_init().
+ * @warning User has to release the runtime using opencl_runtime_release()
+ */
+int opencl_init_multi(const cl_device_type on_device_type,
+        cl_uint num_devices,
+        const cl_device_id * device_ids,
+        cl_uint queues_per_device,
+        const hawopencl_queue_config * config,
+        hawopencl_runtime ** runtime) __HAW_OPENCL_ATTR_NONNULL__(6);
 
 /**
- * Builds a kernel of name from the specified kernel string
- * for a specific device.
- * 
- * @remark PLEASE NOTE: This needs to be called after OpenGL Initialization
+ * Initialize OpenCL by partitioning a device, usually a CPU spanning several
+ * sockets, into sub-devices with clCreateSubDevices(), which share one context;
+ * every sub-device gets one command queue. Keeping the work-groups of a
+ * sub-device and its memory on one NUMA node avoids traffic across the
+ * interconnect; allocate host memory by opencl_runtime_host_alloc().
+ * Requires OpenCL 1.2.
  *
- * @param kernel_source[in]  The kernels source code
- * @param kernel_name[in]    The kernel name within the source
- * @param device_id[in]      The previously initialized device
- * @param context[in]        The previously initialized device's context
- * @param kernel[out]        The generated kernel for this device
+ * @param[in] device_id      The device to partition
+ * @param[in] mode           How to partition the device
+ * @param[in] num_counts     HAWOPENCL_PARTITION_EQUALLY: the compute units per sub-device,
+ *                           HAWOPENCL_PARTITION_BY_COUNTS: the number of counts
+ * @param[in] counts         HAWOPENCL_PARTITION_BY_COUNTS: the compute units of every sub-device
+ * @param[in] config         The properties of the queues; NULL for the defaults
+ * @param[out] runtime       The context, the sub-devices and their queues
  *
- * @return CL_SUCCESS in case of success
+ * @return CL_SUCCESS in case of no error, the error of clCreateSubDevices(), e.g.
+ *         CL_DEVICE_PARTITION_FAILED if the device cannot be partitioned this way,
+ *         or CL_INVALID_OPERATION without OpenCL 1.2
+ * @warning User has to release the runtime using opencl_runtime_release()
  */
-int opencl_kernel_build(const char * kernel_source,
+int opencl_init_partitioned(const cl_device_id device_id,
+        hawopencl_partition_mode mode,
+        cl_uint num_counts,
+        const cl_uint * counts,
+        const hawopencl_queue_config * config,
+        hawopencl_runtime ** runtime) __HAW_OPENCL_ATTR_NONNULL__(6);
+
+/**
+ * Get a kernel for a device of the runtime. The program is built once per
+ * source, options and device (or loaded from the binary cache), and shared
+ * by all threads; concurrent requests for the same program wait for its
+ * build instead of building it again, others build in parallel.
+ *
+ * @param[in] runtime        The runtime
+ * @param[in] kernel_source  The kernels source code
+ * @param[in] kernel_name    The kernel name within the source
+ * @param[in] device         The index of the device within the runtime
+ * @param[in] options        The build options, only read, so they may be shared by threads; NULL selects the release profile
+ * @param[out] kernel        A new kernel, to be used by one thread at a time and released by the caller
+ *
+ * @return CL_SUCCESS in case of no error, CL_INVALID_DEVICE if device is out of
+ *         range, CL_INVALID_KERNEL_NAME if there's no such kernel
+ */
+int opencl_runtime_kernel(hawopencl_runtime * runtime,
+        const char * kernel_source,
         const char * kernel_name,
-        const cl_device_id device_id,
+        cl_uint device,
+        hawopencl_build_options * options,
+        cl_kernel * kernel) __HAW_OPENCL_ATTR_NONNULL__(1,2,3,6);
+
+/**
+ * Allocate page-aligned host memory on the NUMA node of a device of the
+ * runtime, e.g. to be used with CL_MEM_USE_HOST_PTR. The pages are placed
+ * by touching them first from a thread bound to the node's CPUs; if the
+ * node is unknown, the memory is allocated as usual.
+ *
+ * @param[in] runtime        The runtime
+ * @param[in] device         The index of the device within the runtime
+ * @param[in] size           The size in bytes
+ *
+ * @return the memory, to be freed by opencl_runtime_host_free(), NULL on failure
+ */
+void * opencl_runtime_host_alloc(const hawopencl_runtime * runtime,
+        cl_uint device,
+        size_t size) __HAW_OPENCL_ATTR_NONNULL__(1) __HAW_OPENCL_ATTR_WARN_UNUSED_RESULT__;
+
+/**
+ * Free memory allocated by opencl_runtime_host_alloc().
+ *
+ * @param[in] ptr            The memory
+ * @param[in] size           The size passed to opencl_runtime_host_alloc()
+ */
+void opencl_runtime_host_free(void * ptr, size_t size);
+
+/**
+ * Get a command queue of a runtime created by opencl_init_multi().
+ *
+ * @param[in] runtime        The runtime
+ * @param[in] device         The index of the device within the runtime
+ * @param[in] queue          The index of the queue of this device
+ *
+ * @return the command queue, NULL if device or queue are out of range
+ */
+cl_command_queue opencl_runtime_queue(const hawopencl_runtime * runtime,
+        cl_uint device,
+        cl_uint queue) __HAW_OPENCL_ATTR_NONNULL__(1);
+
+/**
+ * Release the programs, command queues and the context of the runtime,
+ * and the sub-devices of opencl_init_partitioned().
+ *
+ * @param[in] runtime        The runtime created by opencl_init_multi()
+ *
+ * @return CL_SUCCESS in case of no error
+ */
+int opencl_runtime_release(hawopencl_runtime * runtime) __HAW_OPENCL_ATTR_NONNULL__(1);
+
+/**
+ * Initialize the configuration of a buffer pool to the defaults:
+ * CL_MEM_READ_WRITE buffers in power-of-two size classes from 256 bytes
+ * to 256 MiB without a budget.
+ *
+ * @param[out] config        The configuration to initialize
+ *
+ * @return CL_SUCCESS in case of no error
+ */
+int opencl_buffer_pool_config_init(hawopencl_buffer_pool_config * config) __HAW_OPENCL_ATTR_NONNULL__(1);
+
+/**
+ * Create a pool of device buffers, which rounds the requested size up to
+ * its size class and serves it from a buffer released before, instead of
+ * creating and releasing a buffer for every request.
+ * More classes per doubling waste less memory, but find fewer buffers to reuse.
+ * All functions taking the pool may be called from several threads at once.
+ *
+ * @param[in] context        The context to create the buffers in
+ * @param[in] config         The configuration; NULL for the defaults of opencl_buffer_pool_config_init()
+ * @param[out] pool          The buffer pool
+ *
+ * @return CL_SUCCESS in case of no error, CL_INVALID_VALUE for an invalid configuration
+ * @warning User has to release the pool using opencl_buffer_pool_release()
+ */
+int opencl_buffer_pool_create(const cl_context context,
+        const hawopencl_buffer_pool_config * config,
+        hawopencl_buffer_pool ** pool) __HAW_OPENCL_ATTR_NONNULL__(3);
+
+/**
+ * Allocate a buffer of at least size bytes from the pool.
+ *
+ * @param[in] pool           The buffer pool
+ * @param[in] size           The size in bytes; the buffer may be larger
+ * @param[out] buffer        The buffer, to be returned by opencl_buffer_pool_free()
+ *
+ * @return CL_SUCCESS in case of no error, CL_INVALID_BUFFER_SIZE for size 0,
+ *         or the error of clCreateBuffer(), e.g. CL_MEM_OBJECT_ALLOCATION_FAILURE
+ */
+int opencl_buffer_pool_alloc(hawopencl_buffer_pool * pool,
+        size_t size,
+        cl_mem * buffer) __HAW_OPENCL_ATTR_NONNULL__(1,3);
+
+/**
+ * Return a buffer to the pool for reuse; it is released instead, if keeping
+ * it would exceed the budget. The commands using the buffer need not have
+ * finished, as OpenCL keeps the buffer until then; however a later user
+ * of the buffer has to order its commands after them, e.g. by an in-order queue.
+ *
+ * @param[in] pool           The buffer pool
+ * @param[in] buffer         The buffer allocated by opencl_buffer_pool_alloc()
+ *
+ * @return CL_SUCCESS in case of no error, CL_INVALID_MEM_OBJECT if the buffer
+ *         was not allocated from this pool
+ */
+int opencl_buffer_pool_free(hawopencl_buffer_pool * pool,
+        cl_mem buffer) __HAW_OPENCL_ATTR_NONNULL__(1);
+
+/**
+ * Release free buffers of the pool, the largest first, until at most
+ * bytes are kept for reuse.
+ *
+ * @param[in] pool           The buffer pool
+ * @param[in] bytes          The bytes of free buffers to keep; 0 releases all of them
+ *
+ * @return CL_SUCCESS in case of no error
+ */
+int opencl_buffer_pool_trim(hawopencl_buffer_pool * pool,
+        size_t bytes) __HAW_OPENCL_ATTR_NONNULL__(1);
+
+/**
+ * Get the statistics of the pool; the hit rate is hits / (hits + misses).
+ *
+ * @param[in] pool           The buffer pool
+ * @param[out] stats         The statistics since the pool's creation
+ *
+ * @return CL_SUCCESS in case of no error
+ */
+int opencl_buffer_pool_stats(hawopencl_buffer_pool * pool,
+        hawopencl_buffer_pool_stats * stats) __HAW_OPENCL_ATTR_NONNULL__(1,2);
+
+/**
+ * Release the pool and its free buffers. Buffers still allocated from the
+ * pool remain valid and have to be released with clReleaseMemObject().
+ *
+ * @param[in] pool           The buffer pool
+ *
+ * @return CL_SUCCESS in case of no error
+ */
+int opencl_buffer_pool_release(hawopencl_buffer_pool * pool) __HAW_OPENCL_ATTR_NONNULL__(1);
+
+/**
+ * Allocate host memory aligned and padded to the device's
+ * CL_DEVICE_MEM_BASE_ADDR_ALIGN and wrap it by a CL_MEM_USE_HOST_PTR buffer.
+ * CPU and integrated devices then work on the host memory in place: neither
+ * kernels nor opencl_host_buffer_map() copy the data, while the host memory
+ * of an unaligned buffer may be copied by the driver. Access the memory only
+ * between opencl_host_buffer_map() and opencl_host_buffer_unmap(), as
+ * discrete devices still copy.
+ *
+ * @param[in] device_id      The device to align the memory for
+ * @param[in] context        The context to create the buffer in
+ * @param[in] flags          The access flags, e.g. CL_MEM_READ_ONLY; CL_MEM_USE_HOST_PTR is added
+ * @param[in] size           The size in bytes
+ * @param[out] buffer        The buffer and its host memory
+ *
+ * @return CL_SUCCESS in case of no error, CL_INVALID_VALUE for flags allocating or
+ *         copying host memory, CL_INVALID_BUFFER_SIZE for size 0
+ * @warning User has to release the buffer using opencl_host_buffer_release()
+ */
+int opencl_host_buffer_create(const cl_device_id device_id,
         const cl_context context,
-        cl_kernel * kernel) __HAW_OPENCL_ATTR_NONNULL__(1,2,5);
+        cl_mem_flags flags,
+        size_t size,
+        hawopencl_host_buffer * buffer) __HAW_OPENCL_ATTR_NONNULL__(5);
+
+/**
+ * Map the whole buffer for access by the host, blocking until the device's
+ * commands using it have completed; for zero-copy buffers this copies nothing.
+ *
+ * @param[in] command_queue  The queue to map the buffer with
+ * @param[in] buffer         The buffer created by opencl_host_buffer_create()
+ * @param[in] flags          CL_MAP_READ, CL_MAP_WRITE or both
+ *
+ * @return the mapped memory, usually buffer->host
+ */
+void * opencl_host_buffer_map(const cl_command_queue command_queue,
+        hawopencl_host_buffer * buffer,
+        cl_map_flags flags) __HAW_OPENCL_ATTR_NONNULL__(2);
+
+/**
+ * Unmap the memory mapped by opencl_host_buffer_map() before the device
+ * uses the buffer again.
+ *
+ * @param[in] command_queue  The queue to unmap the buffer with
+ * @param[in] buffer         The buffer created by opencl_host_buffer_create()
+ * @param[in] ptr            The memory returned by opencl_host_buffer_map()
+ *
+ * @return CL_SUCCESS in case of no error
+ */
+int opencl_host_buffer_unmap(const cl_command_queue command_queue,
+        hawopencl_host_buffer * buffer,
+        void * ptr) __HAW_OPENCL_ATTR_NONNULL__(2,3);
+
+/**
+ * Release the buffer; its host memory is freed, once no enqueued command uses it anymore.
+ *
+ * @param[in] buffer         The buffer created by opencl_host_buffer_create()
+ *
+ * @return CL_SUCCESS in case of no error
+ */
+int opencl_host_buffer_release(hawopencl_host_buffer * buffer) __HAW_OPENCL_ATTR_NONNULL__(1);
+
+/**
+ * Create an arena of size bytes for many small objects, e.g. per item of a
+ * frame: opencl_arena_alloc() hands out sub-buffers by advancing an offset,
+ * without allocating device memory, the host fills their data in the arena's
+ * host copy, opencl_arena_upload() transfers all of them at once and
+ * opencl_arena_reset() frees them together for the next frame.
+ * Requires OpenCL 1.1.
+ *
+ * @param[in] device_id      The device to align the sub-buffers for
+ * @param[in] context        The context to create the buffer in
+ * @param[in] flags          The flags of the buffer, e.g. CL_MEM_READ_WRITE; no host pointer flags
+ * @param[in] size           The size of the arena in bytes
+ * @param[out] arena         The arena
+ *
+ * @return CL_SUCCESS in case of no error, CL_INVALID_VALUE for host pointer flags,
+ *         CL_INVALID_BUFFER_SIZE for size 0, CL_INVALID_OPERATION before OpenCL 1.1
+ * @warning User has to release the arena using opencl_arena_release()
+ */
+int opencl_arena_create(const cl_device_id device_id,
+        const cl_context context,
+        cl_mem_flags flags,
+        size_t size,
+        hawopencl_arena * arena) __HAW_OPENCL_ATTR_NONNULL__(5);
+
+/**
+ * Allocate a sub-buffer of the arena, aligned to CL_DEVICE_MEM_BASE_ADDR_ALIGN.
+ *
+ * @param[in] arena          The arena
+ * @param[in] size           The size in bytes
+ * @param[out] sub_buffer    The sub-buffer, owned by the arena until opencl_arena_reset()
+ * @param[out] host          The sub-buffer's memory in the arena's host copy; may be NULL
+ *
+ * @return CL_SUCCESS in case of no error, CL_INVALID_BUFFER_SIZE for size 0,
+ *         CL_MEM_OBJECT_ALLOCATION_FAILURE if the arena is exhausted
+ */
+int opencl_arena_alloc(hawopencl_arena * arena,
+        size_t size,
+        cl_mem * sub_buffer,
+        void ** host) __HAW_OPENCL_ATTR_NONNULL__(1,3);
+
+/**
+ * Write the allocated part of the host copy to the buffer by one transfer.
+ * Until a non-blocking upload has completed, the host copy must not be changed.
+ *
+ * @param[in] command_queue  The queue to enqueue the write to
+ * @param[in] arena          The arena
+ * @param[in] blocking       CL_TRUE to wait for the completion of the write
+ * @param[out] event         The event of the write, may be NULL; without any
+ *                           allocation the event of a marker
+ *
+ * @return CL_SUCCESS in case of no error, or the error of clEnqueueWriteBuffer()
+ */
+int opencl_arena_upload(const cl_command_queue command_queue,
+        hawopencl_arena * arena,
+        cl_bool blocking,
+        cl_event * event) __HAW_OPENCL_ATTR_NONNULL__(2);
+
+/**
+ * Read the allocated part of the buffer into the host copy by one transfer,
+ * e.g. the results of the kernels using the sub-buffers.
+ *
+ * @param[in] command_queue  The queue to enqueue the read to
+ * @param[in] arena          The arena
+ * @param[in] blocking       CL_TRUE to wait for the completion of the read
+ * @param[out] event         The event of the read, may be NULL; without any
+ *                           allocation the event of a marker
+ *
+ * @return CL_SUCCESS in case of no error, or the error of clEnqueueReadBuffer()
+ */
+int opencl_arena_download(const cl_command_queue command_queue,
+        hawopencl_arena * arena,
+        cl_bool blocking,
+        cl_event * event) __HAW_OPENCL_ATTR_NONNULL__(2);
+
+/**
+ * Release all sub-buffers and start allocating at the beginning again;
+ * commands still using the sub-buffers keep them until completion, however
+ * the next allocations reuse their memory.
+ *
+ * @param[in] arena          The arena
+ *
+ * @return CL_SUCCESS in case of no error
+ */
+int opencl_arena_reset(hawopencl_arena * arena) __HAW_OPENCL_ATTR_NONNULL__(1);
+
+/**
+ * Release the sub-buffers, the buffer and the host copy of the arena;
+ * its uploads and downloads have to be completed.
+ *
+ * @param[in] arena          The arena
+ *
+ * @return CL_SUCCESS in case of no error
+ */
+int opencl_arena_release(hawopencl_arena * arena) __HAW_OPENCL_ATTR_NONNULL__(1);
+
+/**
+ * Check whether the device supports shared virtual memory of the granularity.
+ *
+ * @param[in] device_id      The device
+ * @param[in] granularity    The granularity
+ *
+ * @return true if the library was configured with HAWOPENCL_CL_VERSION of
+ *         at least 200 and the device supports the granularity
+ */
+bool opencl_device_supports_svm(const cl_device_id device_id,
+        hawopencl_svm_granularity granularity);
+
+/**
+ * Allocate a region of shared virtual memory by clSVMAlloc(). Data structures
+ * linked by pointers, e.g. trees or graphs, are built in the region on the
+ * host by opencl_svm_alloc() and passed to kernels as they are, instead of
+ * being serialized into flat buffers with indices instead of pointers.
+ * Coarse-grained regions have to be mapped by opencl_svm_map() for access
+ * by the host; fine-grained regions are accessed without mapping, yet the
+ * host and kernels have to synchronize, e.g. by clFinish().
+ * Requires HAWOPENCL_CL_VERSION of at least 200.
+ *
+ * @param[in] device_id      The device to check the granularity for
+ * @param[in] context        The context to allocate in
+ * @param[in] flags          The access flags, e.g. CL_MEM_READ_WRITE
+ * @param[in] granularity    The granularity
+ * @param[in] size           The size of the region in bytes
+ * @param[out] svm           The region
+ *
+ * @return CL_SUCCESS in case of no error, CL_INVALID_OPERATION if the library
+ *         or the device does not support the granularity,
+ *         CL_MEM_OBJECT_ALLOCATION_FAILURE if clSVMAlloc() fails
+ * @warning User has to release the region using opencl_svm_release()
+ */
+int opencl_svm_create(const cl_device_id device_id,
+        const cl_context context,
+        cl_mem_flags flags,
+        hawopencl_svm_granularity granularity,
+        size_t size,
+        hawopencl_svm * svm) __HAW_OPENCL_ATTR_NONNULL__(6);
+
+/**
+ * Allocate memory within the region, e.g. a node of a tree. The memory is
+ * not freed individually, but with the whole region.
+ * Coarse-grained regions have to be mapped for writing.
+ *
+ * @param[in] svm            The region
+ * @param[in] size           The size in bytes
+ * @param[in] alignment      The alignment in bytes, a power of two; 0 for 128, the size of a long16
+ *
+ * @return the memory, NULL if the region is exhausted
+ */
+void * opencl_svm_alloc(hawopencl_svm * svm,
+        size_t size,
+        size_t alignment) __HAW_OPENCL_ATTR_NONNULL__(1);
+
+/**
+ * Map the whole region for access by the host, blocking until the commands
+ * using it have completed; fine-grained regions need no mapping.
+ *
+ * @param[in] command_queue  The queue to map the region with
+ * @param[in] svm            The region
+ * @param[in] flags          CL_MAP_READ, CL_MAP_WRITE or both
+ *
+ * @return CL_SUCCESS in case of no error
+ */
+int opencl_svm_map(const cl_command_queue command_queue,
+        hawopencl_svm * svm,
+        cl_map_flags flags) __HAW_OPENCL_ATTR_NONNULL__(2);
+
+/**
+ * Unmap the region mapped by opencl_svm_map() before kernels use it again.
+ *
+ * @param[in] command_queue  The queue to unmap the region with
+ * @param[in] svm            The region
+ *
+ * @return CL_SUCCESS in case of no error
+ */
+int opencl_svm_unmap(const cl_command_queue command_queue,
+        hawopencl_svm * svm) __HAW_OPENCL_ATTR_NONNULL__(2);
+
+/**
+ * Pass a pointer into the region as kernel argument by clSetKernelArgSVMPointer().
+ * For the kernel to follow pointers stored in the region, the region has to
+ * be made known by opencl_svm_set_kernel_regions().
+ *
+ * @param[in] kernel         The kernel
+ * @param[in] index          The argument's index
+ * @param[in] svm            The region
+ * @param[in] ptr            The pointer into the region, e.g. the root of a tree
+ *
+ * @return CL_SUCCESS in case of no error, CL_INVALID_ARG_VALUE if ptr is not
+ *         within the region, or the error of clSetKernelArgSVMPointer()
+ */
+int opencl_svm_set_kernel_arg(cl_kernel kernel,
+        cl_uint index,
+        const hawopencl_svm * svm,
+        const void * ptr) __HAW_OPENCL_ATTR_NONNULL__(3);
+
+/**
+ * Make all regions known to the kernel by CL_KERNEL_EXEC_INFO_SVM_PTRS, so
+ * that it may follow the pointers into them stored in its memory, e.g. of a
+ * tree passed as input and a region for the output.
+ * Each call replaces the regions of a previous call for the same kernel.
+ *
+ * @param[in] kernel         The kernel
+ * @param[in] num_regions    The number of regions
+ * @param[in] regions        The regions, used by the kernel's arguments
+ *
+ * @return CL_SUCCESS in case of no error, or the error of clSetKernelExecInfo()
+ */
+int opencl_svm_set_kernel_regions(cl_kernel kernel,
+        cl_uint num_regions,
+        const hawopencl_svm * const * regions) __HAW_OPENCL_ATTR_NONNULL__(3);
+
+/**
+ * Free the region by clSVMFree(); all commands using it have to be completed.
+ *
+ * @param[in] svm            The region
+ *
+ * @return CL_SUCCESS in case of no error
+ */
+int opencl_svm_release(hawopencl_svm * svm) __HAW_OPENCL_ATTR_NONNULL__(1);
+
+/**
+ * Create a ring of staging slots in one CL_MEM_ALLOC_HOST_PTR buffer, which
+ * is mapped once; the driver transfers from and to such pinned memory by DMA
+ * without copying through its own bounce buffers, so the transfers of
+ * opencl_staging_ring_write() and opencl_staging_ring_read() do not block
+ * the host and overlap, e.g. writes on one queue and reads on another.
+ * All functions taking the ring may be called from several threads at once.
+ *
+ * @param[in] context        The context to create the buffer in
+ * @param[in] command_queue  The queue to map and unmap the buffer
+ * @param[in] slot_size      The size of every slot in bytes
+ * @param[in] num_slots      The number of slots, i.e. of transfers in flight
+ * @param[out] ring          The staging ring
+ *
+ * @return CL_SUCCESS in case of no error, CL_INVALID_VALUE for no slots or slot_size 0
+ * @warning User has to release the ring using opencl_staging_ring_release()
+ */
+int opencl_staging_ring_create(const cl_context context,
+        const cl_command_queue command_queue,
+        size_t slot_size,
+        cl_uint num_slots,
+        hawopencl_staging_ring ** ring) __HAW_OPENCL_ATTR_NONNULL__(5);
+
+/**
+ * Acquire the next slot of the ring; if its previous transfer has not
+ * completed yet, wait for it.
+ *
+ * @param[in] ring           The staging ring
+ * @param[out] slot          The slot, to be passed to opencl_staging_ring_write(),
+ *                           opencl_staging_ring_read() or opencl_staging_ring_release_slot()
+ * @param[out] ptr           The slot's pinned host memory of slot_size bytes
+ *
+ * @return CL_SUCCESS in case of no error, CL_OUT_OF_RESOURCES if all slots are acquired
+ */
+int opencl_staging_ring_acquire(hawopencl_staging_ring * ring,
+        cl_uint * slot,
+        void ** ptr) __HAW_OPENCL_ATTR_NONNULL__(1,2,3);
+
+/**
+ * Enqueue a non-blocking write of the first size bytes of an acquired slot
+ * into the buffer; the slot is returned to the ring and reused once the
+ * write has completed.
+ *
+ * @param[in] ring           The staging ring
+ * @param[in] slot           The slot acquired by opencl_staging_ring_acquire()
+ * @param[in] command_queue  The queue to enqueue the write to
+ * @param[in] buffer         The buffer to write
+ * @param[in] offset         The offset in the buffer in bytes
+ * @param[in] size           The number of bytes, at most slot_size
+ * @param[in] num_events     The number of events in wait_list
+ * @param[in] wait_list      The events to wait for before the write, may be NULL
+ * @param[out] event         The event of the write, may be NULL
+ *
+ * @return CL_SUCCESS in case of no error, CL_INVALID_VALUE if the slot is not
+ *         acquired or size exceeds slot_size, or the error of clEnqueueWriteBuffer()
+ */
+int opencl_staging_ring_write(hawopencl_staging_ring * ring,
+        cl_uint slot,
+        const cl_command_queue command_queue,
+        cl_mem buffer,
+        size_t offset,
+        size_t size,
+        cl_uint num_events,
+        const cl_event * wait_list,
+        cl_event * event) __HAW_OPENCL_ATTR_NONNULL__(1);
+
+/**
+ * Enqueue a non-blocking read of size bytes of the buffer into an acquired
+ * slot. The data is available in the slot's memory once the event has
+ * completed; the slot remains acquired until opencl_staging_ring_release_slot().
+ *
+ * @param[in] ring           The staging ring
+ * @param[in] slot           The slot acquired by opencl_staging_ring_acquire()
+ * @param[in] command_queue  The queue to enqueue the read to
+ * @param[in] buffer         The buffer to read
+ * @param[in] offset         The offset in the buffer in bytes
+ * @param[in] size           The number of bytes, at most slot_size
+ * @param[in] num_events     The number of events in wait_list
+ * @param[in] wait_list      The events to wait for before the read, may be NULL
+ * @param[out] event         The event of the read, may be NULL
+ *
+ * @return CL_SUCCESS in case of no error, CL_INVALID_VALUE if the slot is not
+ *         acquired or size exceeds slot_size, or the error of clEnqueueReadBuffer()
+ */
+int opencl_staging_ring_read(hawopencl_staging_ring * ring,
+        cl_uint slot,
+        const cl_command_queue command_queue,
+        cl_mem buffer,
+        size_t offset,
+        size_t size,
+        cl_uint num_events,
+        const cl_event * wait_list,
+        cl_event * event) __HAW_OPENCL_ATTR_NONNULL__(1);
+
+/**
+ * Return an acquired slot to the ring without writing it, e.g. after
+ * consuming the data of opencl_staging_ring_read().
+ *
+ * @param[in] ring           The staging ring
+ * @param[in] slot           The slot acquired by opencl_staging_ring_acquire()
+ *
+ * @return CL_SUCCESS in case of no error, CL_INVALID_VALUE if the slot is not acquired
+ */
+int opencl_staging_ring_release_slot(hawopencl_staging_ring * ring,
+        cl_uint slot) __HAW_OPENCL_ATTR_NONNULL__(1);
+
+/**
+ * Wait for all transfers of the ring, unmap and release its buffer.
+ *
+ * @param[in] ring           The staging ring
+ *
+ * @return CL_SUCCESS in case of no error
+ */
+int opencl_staging_ring_release(hawopencl_staging_ring * ring) __HAW_OPENCL_ATTR_NONNULL__(1);
+
+/**
+ * Print the provided error-status into the print-buffer of length len.
+ *
+ * @param[in]    status       The error status returned by any OpenCL function
+ * @param[in]    len          The length of the print_buffer
+ * @param[inout] print_buffer This buffer of length len is overwritten with the
+ *                            clear-text description of the error (NUL-terminated) 
+ *  
+ * @return the error-status as passed in;
+ *         CL_SUCCESS in case of no error
+ */
+int opencl_printf_error(cl_int status, unsigned int len, char * print_buffer) __HAW_OPENCL_ATTR_NONNULL__(3);
+
+/**
+ * Macro to exit in case of error status (!= CL_SUCCESS) with provided message.
+ *
+ * @param[in]   status        The status variable which is checked against CL_SUCCESS
+ * @param[in]   msg           The error message to print in case of error
+ */
+#define opencl_check_error(status,msg) do { \
+            if (CL_SUCCESS != status) { \
+                char buf[256]; \
+                opencl_printf_error(status, sizeof(buf)-1, buf); \
+                fprintf(stderr, "ERROR (%s:%d): %s. %s\n", \
+                        __FILE__, __LINE__, (msg), buf); \
+                exit(-1); \
+            } \
+        } while(0)
+
+/**
+ * Load the file named kernel_file_name as String.
+ * Any #include "..." is expanded recursively with #line directives mapping
+ * back to the original files; files with #pragma once or an include guard
+ * are included only once. Included files are searched next to the including
+ * file and in the paths below, and are cached until their mtime changes,
+ * as noticed after opencl_kernel_path_refresh().
+ * Files registered with opencl_kernel_register_embedded() are served first;
+ * only other files are searched in the source directory and the OPENCL_KERNEL_PATH.
+ * These directories are indexed once.
+ *
+ * @return Kernel as String in case of success
+ *         NULL otherwise
+ */
+char * opencl_kernel_load(const char * kernel_file_name) __HAW_OPENCL_ATTR_NONNULL__(1) __HAW_OPENCL_ATTR_WARN_UNUSED_RESULT__;
+
+/**
+ * Load the file named kernel_file_name as String without replacing any
+ * #include "...", e.g. for sources passed to opencl_program_build_linked().
+ *
+ * @return Kernel as String in case of success, to be freed by the caller
+ */
+char * opencl_kernel_load_source(const char * kernel_file_name) __HAW_OPENCL_ATTR_NONNULL__(1) __HAW_OPENCL_ATTR_WARN_UNUSED_RESULT__;
+
+/**
+ * Map the file named kernel_file_name and its #include "..." files like
+ * opencl_kernel_load(), however without copying: the source is passed as
+ * segments pointing into the mapped file and the cached includes, to be built with
+ * opencl_kernel_build_sources(source.count, source.strings, source.lengths, ...).
+ *
+ * @param kernel_file_name[in]  The file name, searched like opencl_kernel_load()
+ * @param source[out]           The segments
+ *
+ * @return CL_SUCCESS in case of success
+ * @warning User has to release the source using opencl_kernel_unmap()
+ */
+int opencl_kernel_map(const char * kernel_file_name,
+        hawopencl_source * source) __HAW_OPENCL_ATTR_NONNULL__(1,2);
+
+/**
+ * Release the files mapped by opencl_kernel_map().
+ *
+ * @param source[in]         The source to release
+ */
+void opencl_kernel_unmap(hawopencl_source * source) __HAW_OPENCL_ATTR_NONNULL__(1);
+
+/**
+ * Register kernel files compiled into the executable, to be served by
+ * opencl_kernel_load() without any file access.
+ * The source generated by hawopencl_embed_kernels() calls this on startup.
+ *
+ * @param num_kernels[in]    The number of entries in kernels
+ * @param kernels[in]        The files, sorted by name; must remain valid
+ *
+ * @return CL_SUCCESS in case of success
+ */
+int opencl_kernel_register_embedded(size_t num_kernels,
+        const hawopencl_embedded_kernel kernels[]) __HAW_OPENCL_ATTR_NONNULL__(2);
+
+/**
+ * Drop the index of the kernel search paths, e.g. after editing kernel files
+ * in place. Files added or removed are noticed without this, as a failing
+ * lookup rescans the directories changed; changes to a file's contents are
+ * only noticed after the refresh, as the status of found files is kept.
+ */
+void opencl_kernel_path_refresh(void);
+
+/**
+ * Load the intermediate language file named il_file_name, e.g. SPIR-V
+ * compiled by hawopencl_add_spirv(), searching the paths like opencl_kernel_load().
+ *
+ * @param[in]  il_file_name  The file name, e.g. "vector_add.spv"
+ * @param[out] length        The length of the IL in bytes
+ *
+ * @return the IL in case of success, to be freed by the caller
+ */
+void * opencl_kernel_load_il(const char * il_file_name, size_t * length) __HAW_OPENCL_ATTR_NONNULL__(1,2) __HAW_OPENCL_ATTR_WARN_UNUSED_RESULT__;
+
+
+/**
+ * Builds a kernel of name from the specified kernel string
+ * for a specific device, using the release profile of the build options.
+ * 
+ * @remark PLEASE NOTE: This needs to be called after OpenGL Initialization
+ *
+ * @param kernel_source[in]  The kernels source code
+ * @param kernel_name[in]    The kernel name within the source
+ * @param device_id[in]      The previously initialized device
+ * @param context[in]        The previously initialized device's context
+ * @param kernel[out]        The generated kernel for this device
+ *
+ * @return CL_SUCCESS in case of success
+ */
+int opencl_kernel_build(const char * kernel_source,
+        const char * kernel_name,
+        const cl_device_id device_id,
+        const cl_context context,
+        cl_kernel * kernel) __HAW_OPENCL_ATTR_NONNULL__(1,2,5);
+
+/**
+ * Builds a kernel like opencl_kernel_build_with_options() from a source
+ * passed in count segments, e.g. as loaded by opencl_kernel_map(); the
+ * segments are handed to clCreateProgramWithSource() without concatenating.
+ *
+ * @param count[in]          The number of segments
+ * @param strings[in]        The segments
+ * @param lengths[in]        The segments' lengths; NULL or 0 for NUL-terminated segments
+ * @param kernel_name[in]    The kernel name within the source
+ * @param options[in]        The build options; NULL selects the release profile
+ * @param device_id[in]      The previously initialized device
+ * @param context[in]        The previously initialized device's context
+ * @param kernel[out]        The generated kernel for this device
+ *
+ * @return CL_SUCCESS in case of success
+ */
+int opencl_kernel_build_sources(cl_uint count,
+        const char ** strings,
+        const size_t * lengths,
+        const char * kernel_name,
+        hawopencl_build_options * options,
+        const cl_device_id device_id,
+        const cl_context context,
+        cl_kernel * kernel) __HAW_OPENCL_ATTR_NONNULL__(2,4,8);
+
+/**
+ * Initialize build options with the specified profile.
+ *
+ * @param[out] options   The build options
+ * @param[in]  profile   The optimization profile
+ *
+ * @return CL_SUCCESS in case of success
+ * @warning User has to release the options using opencl_build_options_free()
+ */
+int opencl_build_options_init(hawopencl_build_options * options,
+        hawopencl_build_profile profile) __HAW_OPENCL_ATTR_NONNULL__(1);
+
+/**
+ * Add a macro definition -Dname=value (or -Dname, if value is NULL).
+ *
+ * @return CL_SUCCESS in case of success
+ */
+int opencl_build_options_define(hawopencl_build_options * options,
+        const char * name,
+        const char * value) __HAW_OPENCL_ATTR_NONNULL__(1,2);
+
+/**
+ * Add any further option to be passed to the compiler.
+ *
+ * @return CL_SUCCESS in case of success
+ */
+int opencl_build_options_add(hawopencl_build_options * options,
+        const char * option) __HAW_OPENCL_ATTR_NONNULL__(1,2);
+
+/**
+ * Assemble the options string passed to clBuildProgram().
+ * The env.-var. OPENCL_BUILD_PROFILE (one of debug, release, fast-math, strict)
+ * overrides the profile and options in env.-var. OPENCL_BUILD_OPTIONS are appended.
+ *
+ * @param[inout] options The build options
+ *
+ * @return The options string, owned by options
+ */
+const char * opencl_build_options_string(hawopencl_build_options * options) __HAW_OPENCL_ATTR_NONNULL__(1);
+
+/**
+ * Release the strings allocated in the build options.
+ *
+ * @return CL_SUCCESS in case of success
+ */
+int opencl_build_options_free(hawopencl_build_options * options) __HAW_OPENCL_ATTR_NONNULL__(1);
+
+/**
+ * Get the name of a profile, e.g. "fast-math".
+ *
+ * @return the name or NULL for an unknown profile
+ */
+const char * opencl_build_profile_name(hawopencl_build_profile profile);
+
+/**
+ * Parse the name of a profile, e.g. "fast-math".
+ *
+ * @return CL_SUCCESS in case of success, CL_INVALID_VALUE for an unknown name
+ */
+int opencl_build_profile_parse(const char * name,
+        hawopencl_build_profile * profile) __HAW_OPENCL_ATTR_NONNULL__(1,2);
+
+/**
+ * Builds a kernel like opencl_kernel_build(), using the specified build options.
+ *
+ * @param kernel_source[in]  The kernels source code
+ * @param kernel_name[in]    The kernel name within the source
+ * @param options[in]        The build options; NULL selects the release profile
+ * @param device_id[in]      The previously initialized device
+ * @param context[in]        The previously initialized device's context
+ * @param kernel[out]        The generated kernel for this device
+ *
+ * @return CL_SUCCESS in case of success
+ */
+int opencl_kernel_build_with_options(const char * kernel_source,
+        const char * kernel_name,
+        hawopencl_build_options * options,
+        const cl_device_id device_id,
+        const cl_context context,
+        cl_kernel * kernel) __HAW_OPENCL_ATTR_NONNULL__(1,2,6);
+
+/**
+ * Check whether the device accepts SPIR-V by CL_DEVICE_IL_VERSION.
+ *
+ * @param device_id[in]      The device
+ *
+ * @return true if the library was configured with HAWOPENCL_CL_VERSION of
+ *         at least 210 and the device supports SPIR-V
+ */
+bool opencl_device_supports_il(const cl_device_id device_id);
+
+/**
+ * Builds a kernel of name from the specified SPIR-V intermediate language
+ * using clCreateProgramWithIL(), avoiding the compiler front-end at startup.
+ * Requires HAWOPENCL_CL_VERSION of at least 210 and device support;
+ * otherwise CL_INVALID_OPERATION is returned and the caller may fall back
+ * to opencl_kernel_build() with the source.
+ *
+ * @param il[in]             The SPIR-V module
+ * @param length[in]         The length of the module in bytes
+ * @param kernel_name[in]    The kernel name within the module
+ * @param options[in]        The build options; NULL selects the release profile
+ * @param device_id[in]      The previously initialized device
+ * @param context[in]        The previously initialized device's context
+ * @param kernel[out]        The generated kernel for this device
+ *
+ * @return CL_SUCCESS in case of success, CL_INVALID_OPERATION if IL is not supported
+ */
+int opencl_kernel_build_il(const void * il,
+        size_t length,
+        const char * kernel_name,
+        hawopencl_build_options * options,
+        const cl_device_id device_id,
+        const cl_context context,
+        cl_kernel * kernel) __HAW_OPENCL_ATTR_NONNULL__(1,3,7);
+
+/**
+ * Builds a program from the specified SPIR-V intermediate language,
+ * creating all kernels contained in it, like opencl_program_build().
+ *
+ * @param il[in]             The SPIR-V module
+ * @param length[in]         The length of the module in bytes
+ * @param options[in]        The build options; NULL selects the release profile
+ * @param device_id[in]      The previously initialized device
+ * @param context[in]        The previously initialized device's context
+ * @param program[out]       The program with all its kernels
+ *
+ * @return CL_SUCCESS in case of success, CL_INVALID_OPERATION if IL is not supported
+ * @warning User has to release the program using opencl_program_release()
+ */
+int opencl_program_build_il(const void * il,
+        size_t length,
+        hawopencl_build_options * options,
+        const cl_device_id device_id,
+        const cl_context context,
+        hawopencl_program ** program) __HAW_OPENCL_ATTR_NONNULL__(1,6);
+
+/**
+ * Builds a program from the specified source once for a specific device,
+ * creating all kernels contained in it.
+ *
+ * @remark PLEASE NOTE: This needs to be called after OpenGL Initialization
+ *
+ * @param program_source[in] The program's source code
+ * @param device_id[in]      The previously initialized device
+ * @param context[in]        The previously initialized device's context
+ * @param program[out]       The program with all its kernels
+ *
+ * @return CL_SUCCESS in case of success
+ * @warning User has to release the program using opencl_program_release()
+ */
+int opencl_program_build(const char * program_source,
+        const cl_device_id device_id,
+        const cl_context context,
+        hawopencl_program ** program) __HAW_OPENCL_ATTR_NONNULL__(1,4);
+
+/**
+ * Builds a program like opencl_program_build(), using the specified build options.
+ *
+ * @param program_source[in] The program's source code
+ * @param options[in]        The build options; NULL selects the release profile
+ * @param device_id[in]      The previously initialized device
+ * @param context[in]        The previously initialized device's context
+ * @param program[out]       The program with all its kernels
+ *
+ * @return CL_SUCCESS in case of success
+ */
+int opencl_program_build_with_options(const char * program_source,
+        hawopencl_build_options * options,
+        const cl_device_id device_id,
+        const cl_context context,
+        hawopencl_program ** program) __HAW_OPENCL_ATTR_NONNULL__(1,5);
+
+/**
+ * Starts building a program in the background and returns immediately,
+ * so that several programs may be compiled concurrently.
+ * The builds run on a pool of $OPENCL_BUILD_THREADS (by default the
+ * number of CPUs, at most 8) threads.
+ *
+ * @param program_source[in] The program's source code, copied by the call
+ * @param options[in]        The build options; NULL selects the release profile
+ * @param device_id[in]      The previously initialized device
+ * @param context[in]        The previously initialized device's context
+ * @param job[out]           The handle to pass to opencl_program_build_wait()
+ *
+ * @return CL_SUCCESS in case of success
+ */
+int opencl_program_build_async(const char * program_source,
+        hawopencl_build_options * options,
+        const cl_device_id device_id,
+        const cl_context context,
+        hawopencl_build_job ** job) __HAW_OPENCL_ATTR_NONNULL__(1,5);
+
+/**
+ * Check without blocking whether the build of the job has finished.
+ *
+ * @param job[in]            The handle returned by opencl_program_build_async()
+ *
+ * @return true if opencl_program_build_wait() will not block
+ */
+bool opencl_program_build_ready(hawopencl_build_job * job) __HAW_OPENCL_ATTR_NONNULL__(1);
+
+/**
+ * Wait for the build of the job to finish and create all kernels of the
+ * program; the job is released. Like opencl_program_build() a failed
+ * build prints the build log and exits.
+ *
+ * @param job[in]            The handle returned by opencl_program_build_async()
+ * @param program[out]       The program with all its kernels
+ *
+ * @return CL_SUCCESS in case of success
+ * @warning User has to release the program using opencl_program_release()
+ */
+int opencl_program_build_wait(hawopencl_build_job * job,
+        hawopencl_program ** program) __HAW_OPENCL_ATTR_NONNULL__(1,2);
+
+/**
+ * Build the kernel file like opencl_kernel_map() and opencl_program_build(),
+ * and watch the file and all the files it includes for changes (using inotify).
+ * Upon a change, the program is rebuilt in the background; its kernels are
+ * swapped in by the next opencl_watch_kernel(). A failing rebuild, also due
+ * to a missing file or include, prints the error and keeps the previous
+ * program; only the first build must succeed.
+ *
+ * @param kernel_file_name[in] The file name, searched like opencl_kernel_load()
+ * @param options[in]        The build options; NULL selects the release profile
+ * @param device_id[in]      The previously initialized device
+ * @param context[in]        The previously initialized device's context
+ * @param watch[out]         The handle to get kernels from
+ *
+ * @return CL_SUCCESS in case of success
+ * @warning User has to release the watch using opencl_watch_release()
+ */
+int opencl_kernel_watch(const char * kernel_file_name,
+        hawopencl_build_options * options,
+        const cl_device_id device_id,
+        const cl_context context,
+        hawopencl_watch ** watch) __HAW_OPENCL_ATTR_NONNULL__(1,5);
+
+/**
+ * Get the kernel of the most recent successful build, to be called before
+ * every launch. Kernels are owned by the watch and remain valid until the
+ * second reload after this call; after a reload, the arguments have to be set again.
+ *
+ * @param watch[in]          The handle returned by opencl_kernel_watch()
+ * @param kernel_name[in]    The kernel name within the source
+ * @param kernel[out]        The kernel
+ * @param reloaded[out]      Set to true, if the kernel was rebuilt since the last call; may be NULL
+ *
+ * @return CL_SUCCESS in case of success, CL_INVALID_KERNEL_NAME if there's no such kernel
+ */
+int opencl_watch_kernel(hawopencl_watch * watch,
+        const char * kernel_name,
+        cl_kernel * kernel,
+        bool * reloaded) __HAW_OPENCL_ATTR_NONNULL__(1,2,3);
+
+/**
+ * Stop watching and release the programs and their kernels.
+ *
+ * @param watch[in]          The handle returned by opencl_kernel_watch()
+ *
+ * @return CL_SUCCESS in case of success
+ */
+int opencl_watch_release(hawopencl_watch * watch) __HAW_OPENCL_ATTR_NONNULL__(1);
+
+/**
+ * Compiles utility functions once into a library, which is linked into
+ * programs built with opencl_program_build_linked(). Kernel sources include
+ * the library's declarations by #include "header_name"; the header is passed
+ * to the compiler rather than pasted into every source.
+ * Libraries are shared in memory for the same sources, options, device and
+ * context, and the compiled library is stored in the binary cache.
+ *
+ * @param header_name[in]    The name the header is included by
+ * @param header_source[in]  The header with the library's declarations
+ * @param library_source[in] The library's source code, may include the header
+ * @param options[in]        The build options; NULL selects the release profile
+ * @param device_id[in]      The previously initialized device
+ * @param context[in]        The previously initialized device's context
+ * @param library[out]       The compiled library
+ *
+ * @return CL_SUCCESS in case of success
+ * @warning User has to release the library using opencl_library_release()
+ */
+int opencl_library_build(const char * header_name,
+        const char * header_source,
+        const char * library_source,
+        hawopencl_build_options * options,
+        const cl_device_id device_id,
+        const cl_context context,
+        hawopencl_library ** library) __HAW_OPENCL_ATTR_NONNULL__(1,2,3,7);
+
+/**
+ * Loads the header and the library's source using the OPENCL_KERNEL_PATH
+ * like opencl_kernel_load() and compiles them using opencl_library_build().
+ *
+ * @param header_file_name[in]  The header, also the name it is included by
+ * @param library_file_name[in] The library's source file
+ * @param options[in]        The build options; NULL selects the release profile
+ * @param device_id[in]      The previously initialized device
+ * @param context[in]        The previously initialized device's context
+ * @param library[out]       The compiled library
+ *
+ * @return CL_SUCCESS in case of success
+ */
+int opencl_library_load(const char * header_file_name,
+        const char * library_file_name,
+        hawopencl_build_options * options,
+        const cl_device_id device_id,
+        const cl_context context,
+        hawopencl_library ** library) __HAW_OPENCL_ATTR_NONNULL__(1,2,6);
+
+/**
+ * Release a library; the last release frees it.
+ *
+ * @param library[in]        The library built with opencl_library_build()
+ *
+ * @return CL_SUCCESS in case of success
+ */
+int opencl_library_release(hawopencl_library * library) __HAW_OPENCL_ATTR_NONNULL__(1);
+
+/**
+ * Builds a program by compiling the source with the headers of the
+ * libraries and linking it with the compiled libraries, creating all kernels.
+ * The linked program is stored in the binary cache.
+ *
+ * @param program_source[in] The program's source code
+ * @param num_libraries[in]  The number of libraries
+ * @param libraries[in]      The libraries built with opencl_library_build()
+ * @param options[in]        The build options; NULL selects the release profile
+ * @param device_id[in]      The previously initialized device
+ * @param context[in]        The previously initialized device's context
+ * @param program[out]       The program with all its kernels
+ *
+ * @return CL_SUCCESS in case of success
+ * @warning User has to release the program using opencl_program_release()
+ */
+int opencl_program_build_linked(const char * program_source,
+        cl_uint num_libraries,
+        hawopencl_library * libraries[],
+        hawopencl_build_options * options,
+        const cl_device_id device_id,
+        const cl_context context,
+        hawopencl_program ** program) __HAW_OPENCL_ATTR_NONNULL__(1,7);
+
+/**
+ * Create a table of variants of one source, which are specialized by
+ * compile-time constants, e.g. tile sizes, vector widths or element types.
+ *
+ * @param kernel_source[in]  The kernels source code, copied by the call
+ * @param options[in]        The build options shared by all variants; NULL selects the release profile
+ * @param device_id[in]      The previously initialized device
+ * @param context[in]        The previously initialized device's context
+ * @param cache[out]         The table of variants
+ *
+ * @return CL_SUCCESS in case of success
+ * @warning User has to release the table using opencl_variant_cache_release()
+ */
+int opencl_variant_cache_create(const char * kernel_source,
+        hawopencl_build_options * options,
+        const cl_device_id device_id,
+        const cl_context context,
+        hawopencl_variant_cache ** cache) __HAW_OPENCL_ATTR_NONNULL__(1,5);
+
+/**
+ * Get the program of the variant built with the specified -DNAME=VALUE
+ * definitions; it is built on first use and looked up in the table afterwards.
+ * The order of definitions does not matter.
+ *
+ * @param cache[in]          The table of variants
+ * @param num_defines[in]    The number of definitions
+ * @param defines[in]        The definitions
+ * @param program[out]       The program, owned by the cache
+ *
+ * @return CL_SUCCESS in case of success
+ */
+int opencl_kernel_variant_program(hawopencl_variant_cache * cache,
+        cl_uint num_defines,
+        const hawopencl_define defines[],
+        hawopencl_program ** program) __HAW_OPENCL_ATTR_NONNULL__(1,4);
+
+/**
+ * Get the kernel of the variant built with the specified -DNAME=VALUE
+ * definitions, see opencl_kernel_variant_program().
+ *
+ * @param cache[in]          The table of variants
+ * @param num_defines[in]    The number of definitions
+ * @param defines[in]        The definitions
+ * @param kernel_name[in]    The kernel name within the source
+ * @param kernel[out]        The kernel, owned by the cache
+ *
+ * @return CL_SUCCESS in case of success
+ */
+int opencl_kernel_variant(hawopencl_variant_cache * cache,
+        cl_uint num_defines,
+        const hawopencl_define defines[],
+        const char * kernel_name,
+        cl_kernel * kernel) __HAW_OPENCL_ATTR_NONNULL__(1,4,5);
+
+/**
+ * Get the kernel of the variant with the element type T defined as type,
+ * e.g. "float", "int" or "double", from a type-generic source.
+ *
+ * @param cache[in]          The table of variants
+ * @param type[in]           The type T is defined as
+ * @param kernel_name[in]    The kernel name within the source
+ * @param kernel[out]        The kernel, owned by the cache
+ *
+ * @return CL_SUCCESS in case of success
+ */
+int opencl_kernel_variant_typed(hawopencl_variant_cache * cache,
+        const char * type,
+        const char * kernel_name,
+        cl_kernel * kernel) __HAW_OPENCL_ATTR_NONNULL__(1,2,3,4);
+
+/**
+ * Get the number of variants built so far.
+ *
+ * @param cache[in]          The table of variants
+ *
+ * @return the number of variants
+ */
+cl_uint opencl_variant_cache_size(hawopencl_variant_cache * cache) __HAW_OPENCL_ATTR_NONNULL__(1);
+
+/**
+ * Release the table and all variants' programs and kernels.
+ *
+ * @param cache[in]          The table of variants
+ *
+ * @return CL_SUCCESS in case of success
+ */
+int opencl_variant_cache_release(hawopencl_variant_cache * cache) __HAW_OPENCL_ATTR_NONNULL__(1);
+
+/**
+ * Write an archive of programs, containing each program's source and build
+ * options and its binary compiled for each of the devices, e.g. all devices
+ * found by opencl_get_devices(). Devices failing to build a program only
+ * get the source, which is built at runtime.
+ *
+ * @param archive_file_name[in] The archive to write
+ * @param num_programs[in]   The number of programs
+ * @param names[in]          The names to look up the programs by
+ * @param sources[in]        The programs' fully expanded source, e.g. by opencl_kernel_load()
+ * @param options[in]        The programs' build options; may be NULL
+ * @param num_devices[in]    The number of devices
+ * @param devices[in]        The devices to compile for
+ *
+ * @return CL_SUCCESS in case of success
+ */
+int opencl_archive_write(const char * archive_file_name,
+        cl_uint num_programs,
+        const char * names[],
+        const char * sources[],
+        const char * options[],
+        cl_uint num_devices,
+        const cl_device_id devices[]) __HAW_OPENCL_ATTR_NONNULL__(1,3,4,7);
+
+/**
+ * Open an archive written by opencl_archive_write() or opencl_kernel_compile
+ * by mapping it into memory.
+ *
+ * @param archive_file_name[in] The archive to open
+ * @param archive[out]       The opened archive
+ *
+ * @return CL_SUCCESS in case of success, CL_INVALID_VALUE if the file cannot
+ *         be read, or CL_INVALID_BINARY if the archive is corrupt or of another version
+ * @warning User has to close the archive using opencl_archive_close()
+ */
+int opencl_archive_open(const char * archive_file_name,
+        hawopencl_archive ** archive) __HAW_OPENCL_ATTR_NONNULL__(1,2);
+
+/**
+ * Get the name of a program in the archive.
+ *
+ * @param archive[in]        The opened archive
+ * @param index[in]          The index of the program
+ *
+ * @return the name, or NULL if index is beyond the number of programs
+ */
+const char * opencl_archive_program_name(const hawopencl_archive * archive,
+        cl_uint index) __HAW_OPENCL_ATTR_NONNULL__(1);
+
+/**
+ * Builds the named program of the archive from the binary matching the
+ * device, its driver version and platform without invoking the compiler;
+ * if there is none, the program is built from the archived source.
+ *
+ * @param archive[in]        The opened archive
+ * @param name[in]           The program's name
+ * @param device_id[in]      The previously initialized device
+ * @param context[in]        The previously initialized device's context
+ * @param program[out]       The program with all its kernels
+ *
+ * @return CL_SUCCESS in case of success, CL_INVALID_PROGRAM if there's no such program
+ * @warning User has to release the program using opencl_program_release()
+ */
+int opencl_archive_program(const hawopencl_archive * archive,
+        const char * name,
+        const cl_device_id device_id,
+        const cl_context context,
+        hawopencl_program ** program) __HAW_OPENCL_ATTR_NONNULL__(1,2,5);
+
+/**
+ * Close the archive; programs built from it stay valid.
+ *
+ * @param archive[in]        The opened archive
+ *
+ * @return CL_SUCCESS in case of success
+ */
+int opencl_archive_close(hawopencl_archive * archive) __HAW_OPENCL_ATTR_NONNULL__(1);
+
+/**
+ * Look up a kernel of the program by its function name.
+ *
+ * @param program[in]        The program built with opencl_program_build()
+ * @param kernel_name[in]    The kernel name within the source
+ *
+ * @return the kernel (owned by program) or NULL if there's no such kernel
+ */
+cl_kernel opencl_program_kernel(const hawopencl_program * program,
+        const char * kernel_name) __HAW_OPENCL_ATTR_NONNULL__(1,2);
+
+/**
+ * Release the program and all its kernels.
+ *
+ * @param program[in]        The program built with opencl_program_build()
+ *
+ * @return CL_SUCCESS in case of success
+ */
+int opencl_program_release(hawopencl_program * program) __HAW_OPENCL_ATTR_NONNULL__(1);
+
+/**
+ * Configure the on-disk cache of program binaries used by opencl_kernel_build().
+ * By default, the cache is stored in $OPENCL_KERNEL_CACHE_DIR, or
+ * $XDG_CACHE_HOME/HAWOpenCL, or $HOME/.cache/HAWOpenCL with a size of
+ * $OPENCL_KERNEL_CACHE_SIZE (suffixes K, M and G are allowed), or 64MB.
+ * Setting OPENCL_KERNEL_CACHE_DIR to the empty string disables the cache.
+ *
+ * @param[in] cache_dir  The directory to store binaries in; NULL disables the cache
+ * @param[in] max_size   The size cap in bytes; least recently used entries are evicted
+ *
+ * @return CL_SUCCESS in case of success
+ */
+int opencl_kernel_cache_config(const char * cache_dir, size_t max_size);
+
+/**
+ * Get the hit and miss counts of the program binary cache.
+ *
+ * @param[out] stats     The statistics since process start
+ *
+ * @return CL_SUCCESS in case of success
+ */
+int opencl_kernel_cache_stats(hawopencl_kernel_cache_stats * stats) __HAW_OPENCL_ATTR_NONNULL__(1);
 
 /**
  * Gets the kernel information for a specific device.
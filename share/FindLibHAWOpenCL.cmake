@@ -13,6 +13,10 @@
 #   LibHAWOpenCL_INCLUDE_DIRS - include search path
 #   LibHAWOpenCL_LIBRARIES    - libraries to link
 #   LibHAWOpenCL_VERSION      - libHAWOpenCL 3-component version number
+#
+# The functions of HAWOpenCLKernels.cmake are provided: hawopencl_add_spirv()
+# to compile kernels offline into SPIR-V, and hawopencl_embed_kernels() to
+# compile kernel sources into the executable.
 
 #=============================================================================
 # Copyright 2010 Kitware, Inc.
@@ -65,6 +69,9 @@ set(LibHAWOpenCL_FOUND ${LIBHAWOPENCL_FOUND})
 unset(LIBHAWOPENCL_FOUND)
 
 if(LibHAWOpenCL_FOUND)
+  # The static library builds programs asynchronously using pthreads
+  find_package(Threads)
   set(LibHAWOpenCL_INCLUDE_DIRS ${LibHAWOpenCL_INCLUDE_DIR})
-  set(LibHAWOpenCL_LIBRARIES    ${LibHAWOpenCL_LIBRARY})
+  set(LibHAWOpenCL_LIBRARIES    ${LibHAWOpenCL_LIBRARY} ${CMAKE_THREAD_LIBS_INIT})
+  include(${CMAKE_CURRENT_LIST_DIR}/HAWOpenCLKernels.cmake OPTIONAL)
 endif()
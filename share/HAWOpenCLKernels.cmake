@@ -0,0 +1,205 @@
+#.rst:
+# HAWOpenCLKernels
+# ----------------
+#
+# Compile OpenCL C kernels offline into SPIR-V, to be loaded with
+# opencl_kernel_load_il() and built with opencl_kernel_build_il(),
+# or embed their sources into the executable.
+#
+# ::
+#
+#   hawopencl_add_spirv(<target>
+#                       SOURCES <file.cl>...
+#                       [OPTIONS <clang-option>...]
+#                       [OUTPUT_DIRECTORY <dir>]
+#                       [INSTALL_DESTINATION <dir>])
+#
+# Adds the custom target <target> (built by ALL), compiling every source
+# <name>.cl into <name>.spv in OUTPUT_DIRECTORY (default: the current
+# binary directory). OPTIONS are passed to clang, e.g. -DTILE=16.
+# Headers are searched in the source's directory.
+#
+# Requires clang with the spir64 target and llvm-spirv; if these are not
+# found, HAWOPENCL_SPIRV_FOUND is false and the target is empty, so that
+# applications fall back to building from source.
+#
+#   HAWOPENCL_SPIRV_FOUND     - true if SPIR-V kernels can be compiled
+#   HAWOPENCL_CLANG           - the clang executable
+#   HAWOPENCL_LLVM_SPIRV      - the llvm-spirv executable
+#
+# ::
+#
+#   hawopencl_embed_kernels(<target>
+#                           SOURCES <file.cl>...
+#                           [INCLUDE_DIRECTORIES <dir>...]
+#                           [BASE_DIRECTORY <dir>])
+#
+# Generates a C source with the contents of every source and every file it
+# includes by #include "...", and adds it to the existing <target>.
+# On startup, the files are registered with opencl_kernel_register_embedded(),
+# so that opencl_kernel_load() serves them without any file access.
+# Sources are named by their path relative to BASE_DIRECTORY (default: the
+# current source directory), includes by the name they are included with;
+# these are searched in the including file's directory and INCLUDE_DIRECTORIES.
+# With compilers not supporting constructors, or if <target> is a static
+# library, call hawopencl_embedded_<target>_register() before loading kernels.
+
+#=============================================================================
+# Copyright 2018-2022 Rainer Keller, HS Esslingen
+#
+# Distributed under the OSI-approved BSD License (the "License");
+# see accompanying file Copyright.txt for details.
+#=============================================================================
+
+# Script mode: generate the C source of hawopencl_embed_kernels()
+if(CMAKE_SCRIPT_MODE_FILE AND HAWOPENCL_EMBED_LIST)
+  include(${HAWOPENCL_EMBED_LIST})
+  string(MAKE_C_IDENTIFIER "${HAWOPENCL_EMBED_TARGET}" identifier)
+  set(sorted_names ${HAWOPENCL_EMBED_NAMES})
+  # opencl_kernel_register_embedded() expects the table sorted by name
+  list(SORT sorted_names)
+
+  set(arrays "")
+  set(table "")
+  set(index 0)
+  foreach(name ${sorted_names})
+    list(FIND HAWOPENCL_EMBED_NAMES "${name}" position)
+    list(GET HAWOPENCL_EMBED_FILES ${position} file)
+    file(READ ${file} hex HEX)
+    string(LENGTH "${hex}" length)
+    math(EXPR length "${length} / 2")
+    string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1," hex "${hex}")
+    # Break the lines like the file's
+    string(REPLACE "0x0a," "0x0a,\n    " hex "${hex}")
+    string(REPLACE "\\" "\\\\" c_name "${name}")
+    string(REPLACE "\"" "\\\"" c_name "${c_name}")
+    string(APPEND arrays "/* ${name} */\nstatic const char kernel_${index}[] = {\n    ${hex}0x00\n};\n\n")
+    string(APPEND table "    {\"${c_name}\", kernel_${index}, ${length}},\n")
+    math(EXPR index "${index} + 1")
+  endforeach()
+
+  file(WRITE ${HAWOPENCL_EMBED_OUTPUT}
+"/* Generated by hawopencl_embed_kernels(${HAWOPENCL_EMBED_TARGET}) -- do not edit */
+#include \"HAWOpenCL.h\"
+
+${arrays}static const hawopencl_embedded_kernel kernels[] = {
+${table}};
+
+#if defined(__GNUC__)
+void hawopencl_embedded_${identifier}_register(void) __attribute__((constructor));
+#endif
+void hawopencl_embedded_${identifier}_register(void) {
+    opencl_kernel_register_embedded(sizeof(kernels) / sizeof(kernels[0]), kernels);
+}
+")
+  return()
+endif()
+
+set(HAWOPENCL_KERNELS_CMAKE ${CMAKE_CURRENT_LIST_FILE})
+
+find_program(HAWOPENCL_CLANG NAMES clang clang-15 clang-14 clang-13 clang-12)
+find_program(HAWOPENCL_LLVM_SPIRV NAMES llvm-spirv llvm-spirv-15 llvm-spirv-14 llvm-spirv-13 llvm-spirv-12)
+mark_as_advanced(HAWOPENCL_CLANG HAWOPENCL_LLVM_SPIRV)
+
+if(HAWOPENCL_CLANG AND HAWOPENCL_LLVM_SPIRV)
+  set(HAWOPENCL_SPIRV_FOUND TRUE)
+else()
+  set(HAWOPENCL_SPIRV_FOUND FALSE)
+endif()
+
+function(hawopencl_add_spirv target)
+  cmake_parse_arguments(ARG "" "OUTPUT_DIRECTORY;INSTALL_DESTINATION" "SOURCES;OPTIONS" ${ARGN})
+  if(NOT ARG_OUTPUT_DIRECTORY)
+    set(ARG_OUTPUT_DIRECTORY ${CMAKE_CURRENT_BINARY_DIR})
+  endif()
+
+  if(NOT HAWOPENCL_SPIRV_FOUND)
+    message(STATUS "clang or llvm-spirv not found; not compiling SPIR-V kernels of ${target}")
+    add_custom_target(${target})
+    return()
+  endif()
+
+  set(outputs)
+  foreach(source ${ARG_SOURCES})
+    get_filename_component(source ${source} ABSOLUTE)
+    get_filename_component(name ${source} NAME_WE)
+    get_filename_component(dir ${source} DIRECTORY)
+    set(bc  ${CMAKE_CURRENT_BINARY_DIR}/${name}.bc)
+    set(spv ${ARG_OUTPUT_DIRECTORY}/${name}.spv)
+    add_custom_command(OUTPUT ${spv}
+      COMMAND ${HAWOPENCL_CLANG} -c -target spir64 -cl-std=CL1.2 -O2 -emit-llvm
+              -Xclang -finclude-default-header -I${dir} ${ARG_OPTIONS} -o ${bc} ${source}
+      COMMAND ${HAWOPENCL_LLVM_SPIRV} ${bc} -o ${spv}
+      DEPENDS ${source}
+      IMPLICIT_DEPENDS C ${source}
+      COMMENT "Compiling OpenCL kernel ${name}.cl to SPIR-V"
+      VERBATIM)
+    list(APPEND outputs ${spv})
+  endforeach()
+
+  add_custom_target(${target} ALL DEPENDS ${outputs})
+  if(ARG_INSTALL_DESTINATION)
+    install(FILES ${outputs} DESTINATION ${ARG_INSTALL_DESTINATION})
+  endif()
+endfunction()
+
+function(hawopencl_embed_kernels target)
+  cmake_parse_arguments(ARG "" "BASE_DIRECTORY" "SOURCES;INCLUDE_DIRECTORIES" ${ARGN})
+  if(NOT ARG_BASE_DIRECTORY)
+    set(ARG_BASE_DIRECTORY ${CMAKE_CURRENT_SOURCE_DIR})
+  endif()
+
+  # Resolve the sources and, transitively, their includes
+  set(names)
+  set(files)
+  set(pending)
+  foreach(source ${ARG_SOURCES})
+    get_filename_component(source ${source} ABSOLUTE)
+    file(RELATIVE_PATH name ${ARG_BASE_DIRECTORY} ${source})
+    list(APPEND names ${name})
+    list(APPEND files ${source})
+    list(APPEND pending ${source})
+  endforeach()
+  while(pending)
+    list(POP_FRONT pending file)
+    get_filename_component(dir ${file} DIRECTORY)
+    file(STRINGS ${file} lines REGEX "^[ \t]*#[ \t]*include[ \t]*\"[^\"]+\"")
+    foreach(line ${lines})
+      string(REGEX REPLACE "^[ \t]*#[ \t]*include[ \t]*\"([^\"]+)\".*$" "\\1" include "${line}")
+      if(include IN_LIST names)
+        continue()
+      endif()
+      set(found)
+      foreach(include_dir ${dir} ${ARG_INCLUDE_DIRECTORIES})
+        get_filename_component(include_dir ${include_dir} ABSOLUTE)
+        if(EXISTS ${include_dir}/${include})
+          set(found ${include_dir}/${include})
+          break()
+        endif()
+      endforeach()
+      if(NOT found)
+        message(WARNING "hawopencl_embed_kernels(${target}): include file ${include} of ${file} not found; it will be searched at runtime")
+        continue()
+      endif()
+      list(APPEND names ${include})
+      list(APPEND files ${found})
+      list(APPEND pending ${found})
+    endforeach()
+  endwhile()
+  # Changed includes require a new scan
+  set_property(DIRECTORY APPEND PROPERTY CMAKE_CONFIGURE_DEPENDS ${files})
+
+  set(list ${CMAKE_CURRENT_BINARY_DIR}/${target}_kernels.cmake)
+  set(output ${CMAKE_CURRENT_BINARY_DIR}/${target}_kernels.c)
+  file(WRITE ${list}
+    "set(HAWOPENCL_EMBED_TARGET \"${target}\")\n"
+    "set(HAWOPENCL_EMBED_NAMES \"${names}\")\n"
+    "set(HAWOPENCL_EMBED_FILES \"${files}\")\n")
+  add_custom_command(OUTPUT ${output}
+    COMMAND ${CMAKE_COMMAND} -DHAWOPENCL_EMBED_LIST=${list} -DHAWOPENCL_EMBED_OUTPUT=${output}
+            -P ${HAWOPENCL_KERNELS_CMAKE}
+    DEPENDS ${files} ${list} ${HAWOPENCL_KERNELS_CMAKE}
+    COMMENT "Embedding OpenCL kernels of ${target}"
+    VERBATIM)
+  target_sources(${target} PRIVATE ${output})
+endfunction()
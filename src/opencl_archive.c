@@ -0,0 +1,364 @@
+//
+//  opencl_archive.c : Part of libHAWOpenCL
+//
+//  Archive of kernel sources, their build options and the binaries
+//  compiled ahead of time for several devices (see opencl_kernel_compile).
+//  At startup the archive is mapped into memory and the binary matching the
+//  device is used without invoking the compiler; otherwise the source is built.
+//
+//  Copyright (c) 2018-2022 Rainer Keller, HS Esslingen. All rights reserved.
+//
+#include "HAWOpenCL_config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <stdint.h>
+#ifdef HAVE_STDLIB_H
+#  include <stdlib.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#  include <unistd.h>
+#endif
+#ifdef HAVE_SYS_TYPES_H
+#  include <sys/types.h>
+#endif
+#ifdef HAVE_SYS_STAT_H
+#  include <sys/stat.h>
+#endif
+#ifdef HAVE_SYS_MMAN_H
+#  include <sys/mman.h>
+#endif
+#include <fcntl.h>
+
+#if defined(__APPLE__) && defined(__MACH__)
+#  include <OpenCL/opencl.h>
+#else
+#  include <CL/cl.h>
+#endif
+
+#include "HAWOpenCL.h"
+#include "opencl_internal.h"
+
+#define ARCHIVE_MAGIC           "HAWCLARC"
+#define ARCHIVE_FORMAT_VERSION  1
+#define ARCHIVE_ALIGN(x)        (((x) + 7) & ~((uint64_t) 7))
+
+/*
+ * The archive consists of the header, the table of programs, the table of
+ * binaries and the data referenced by offsets from the start of the file.
+ * Strings are NUL-terminated, binaries are 8-byte aligned.
+ */
+typedef struct {
+    char magic[8];
+    uint32_t format_version;
+    uint32_t num_programs;
+    uint32_t num_binaries;
+    uint32_t reserved;
+    uint64_t file_size;
+} archive_header;
+
+typedef struct {
+    uint64_t name_offset;
+    uint64_t source_offset;
+    uint64_t source_size;
+    uint64_t options_offset;
+} archive_program;
+
+typedef struct {
+    uint32_t program_index;
+    uint32_t reserved;
+    uint64_t key;               // opencl_kernel_cache_key() of source, options and device
+    uint64_t offset;
+    uint64_t size;
+} archive_binary;
+
+struct hawopencl_archive {
+    unsigned char * data;
+    size_t size;
+    bool mapped;
+    const archive_header * header;
+    const archive_program * programs;
+    const archive_binary * binaries;
+};
+
+/*
+ * Local functions
+ */
+static uint64_t opencl_archive_append(unsigned char ** data, uint64_t * size, const void * buf, size_t len);
+static bool opencl_archive_string_valid(const hawopencl_archive * archive, uint64_t offset);
+static bool opencl_archive_range_valid(const hawopencl_archive * archive, uint64_t offset, uint64_t size);
+
+// Append len bytes to the growing data (8-byte aligned); returns the offset
+static uint64_t opencl_archive_append(unsigned char ** data, uint64_t * size, const void * buf, size_t len) {
+    const uint64_t offset = ARCHIVE_ALIGN(*size);
+
+    *data = (unsigned char *) realloc(*data, offset + len);
+    if (NULL == *data)
+        FATAL_ERROR("realloc", ENOMEM);
+    memset(*data + *size, 0, offset - *size);
+    memcpy(*data + offset, buf, len);
+    *size = offset + len;
+    return offset;
+}
+
+// Check that a string starts and is NUL-terminated within the archive
+static bool opencl_archive_string_valid(const hawopencl_archive * archive, uint64_t offset) {
+    return offset < archive->size &&
+        NULL != memchr(archive->data + offset, '\0', archive->size - offset);
+}
+
+// Check that size bytes at offset are within the archive, without overflowing
+static bool opencl_archive_range_valid(const hawopencl_archive * archive, uint64_t offset, uint64_t size) {
+    return offset <= archive->size && size <= archive->size - offset;
+}
+
+int opencl_archive_write(const char * archive_file_name,
+        cl_uint num_programs,
+        const char * names[],
+        const char * sources[],
+        const char * options[],
+        cl_uint num_devices,
+        const cl_device_id devices[]) {
+    archive_header header;
+    archive_program * programs;
+    archive_binary * binaries;
+    cl_context * contexts;
+    unsigned char * data = NULL;
+    uint64_t size;
+    uint64_t tables_size;
+    cl_uint num_binaries = 0;
+    cl_uint i;
+    cl_uint d;
+    FILE * file;
+
+    programs = (archive_program *) calloc(num_programs + 1, sizeof(archive_program));
+    binaries = (archive_binary *) calloc(num_programs * num_devices + 1, sizeof(archive_binary));
+    contexts = (cl_context *) calloc(num_devices + 1, sizeof(cl_context));
+    if (NULL == programs || NULL == binaries || NULL == contexts)
+        FATAL_ERROR("calloc", ENOMEM);
+    for (d = 0; d < num_devices; d++) {
+        int err;
+        contexts[d] = clCreateContext(NULL, 1, &devices[d], NULL, NULL, &err);
+        if (NULL == contexts[d] || CL_SUCCESS != err)
+            FATAL_ERROR("clCreateContext", err);
+    }
+
+    // The data follows the tables; the number of binaries is not yet known, reserve the maximum
+    tables_size = sizeof(header) + num_programs * sizeof(archive_program) +
+        num_programs * num_devices * sizeof(archive_binary);
+    size = tables_size;
+    data = (unsigned char *) calloc(1, size);
+    if (NULL == data)
+        FATAL_ERROR("calloc", ENOMEM);
+
+    for (i = 0; i < num_programs; i++) {
+        const char * opts = (NULL == options || NULL == options[i]) ? "" : options[i];
+
+        programs[i].name_offset = opencl_archive_append(&data, &size, names[i], strlen(names[i]) + 1);
+        programs[i].source_size = strlen(sources[i]);
+        programs[i].source_offset = opencl_archive_append(&data, &size, sources[i], programs[i].source_size + 1);
+        programs[i].options_offset = opencl_archive_append(&data, &size, opts, strlen(opts) + 1);
+
+        for (d = 0; d < num_devices; d++) {
+            cl_program program;
+            unsigned char * binary;
+            size_t binary_size;
+            int err;
+
+            program = clCreateProgramWithSource(contexts[d], 1, &sources[i], NULL, &err);
+            if (NULL == program || CL_SUCCESS != err)
+                FATAL_ERROR("clCreateProgramWithSource", err);
+
+            // A device failing to compile the program falls back to the source at runtime
+            err = clBuildProgram(program, 1, &devices[d], opts, NULL, NULL);
+            if (CL_SUCCESS != err) {
+                opencl_kernel_build_log_print(program, devices[d], names[i]);
+                fprintf(stderr, "WARNING: Not storing a binary of %s for device %u\n", names[i], d);
+            } else if (NULL != (binary = opencl_program_binary(program, devices[d], &binary_size))) {
+                binaries[num_binaries].program_index = i;
+                binaries[num_binaries].key = opencl_kernel_cache_key(sources[i], opts, devices[d]);
+                binaries[num_binaries].offset = opencl_archive_append(&data, &size, binary, binary_size);
+                binaries[num_binaries].size = binary_size;
+                num_binaries++;
+                free(binary);
+            }
+            OPENCL_CHECK(clReleaseProgram, (program));
+        }
+    }
+    for (d = 0; d < num_devices; d++)
+        OPENCL_CHECK(clReleaseContext, (contexts[d]));
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, ARCHIVE_MAGIC, sizeof(header.magic));
+    header.format_version = ARCHIVE_FORMAT_VERSION;
+    header.num_programs = num_programs;
+    header.num_binaries = num_binaries;
+    header.file_size = size;
+    memcpy(data, &header, sizeof(header));
+    memcpy(data + sizeof(header), programs, num_programs * sizeof(archive_program));
+    memcpy(data + sizeof(header) + num_programs * sizeof(archive_program),
+            binaries, num_binaries * sizeof(archive_binary));
+
+    file = fopen(archive_file_name, "wb");
+    if (NULL == file) {
+        fprintf(stderr, "ERROR: Cannot open archive %s for writing\n", archive_file_name);
+        FATAL_ERROR("fopen", errno);
+    }
+    if (1 != fwrite(data, size, 1, file) || 0 != fclose(file))
+        FATAL_ERROR("fwrite", errno);
+
+    free(data);
+    free(programs);
+    free(binaries);
+    free(contexts);
+    return CL_SUCCESS;
+}
+
+int opencl_archive_open(const char * archive_file_name,
+        hawopencl_archive ** archive) {
+    hawopencl_archive * a;
+    struct stat stat_buf;
+    uint64_t tables_size;
+    uint32_t i;
+    int fd;
+
+    fd = open(archive_file_name, O_RDONLY);
+    if (-1 == fd)
+        return CL_INVALID_VALUE;
+    if (0 != fstat(fd, &stat_buf) || (size_t) stat_buf.st_size < sizeof(archive_header)) {
+        close(fd);
+        return CL_INVALID_VALUE;
+    }
+
+    a = (hawopencl_archive *) calloc(1, sizeof(hawopencl_archive));
+    if (NULL == a)
+        FATAL_ERROR("calloc", ENOMEM);
+    a->size = stat_buf.st_size;
+#if defined(HAVE_SYS_MMAN_H)
+    // Binaries are passed to the driver straight from the mapped pages
+    a->data = mmap(NULL, a->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    a->mapped = (MAP_FAILED != a->data);
+#endif
+    if (!a->mapped) {
+        a->data = (unsigned char *) malloc(a->size);
+        if (NULL == a->data)
+            FATAL_ERROR("malloc", ENOMEM);
+        if ((ssize_t) a->size != read(fd, a->data, a->size)) {
+            close(fd);
+            free(a->data);
+            free(a);
+            return CL_INVALID_VALUE;
+        }
+    }
+    close(fd);
+
+    a->header = (const archive_header *) a->data;
+    a->programs = (const archive_program *) (a->data + sizeof(archive_header));
+    a->binaries = (const archive_binary *) (a->programs + a->header->num_programs);
+    tables_size = sizeof(archive_header) +
+        (uint64_t) a->header->num_programs * sizeof(archive_program) +
+        (uint64_t) a->header->num_binaries * sizeof(archive_binary);
+    if (0 != memcmp(a->header->magic, ARCHIVE_MAGIC, sizeof(a->header->magic)) ||
+        ARCHIVE_FORMAT_VERSION != a->header->format_version ||
+        a->size != a->header->file_size ||
+        tables_size > a->size)
+        goto invalid;
+    // The offsets of a truncated or corrupt archive must not point beyond the mapping
+    for (i = 0; i < a->header->num_programs; i++)
+        if (!opencl_archive_string_valid(a, a->programs[i].name_offset) ||
+            !opencl_archive_string_valid(a, a->programs[i].options_offset) ||
+            !opencl_archive_range_valid(a, a->programs[i].source_offset, a->programs[i].source_size) ||
+            a->programs[i].source_size == a->size - a->programs[i].source_offset ||
+            '\0' != a->data[a->programs[i].source_offset + a->programs[i].source_size])
+            goto invalid;
+    for (i = 0; i < a->header->num_binaries; i++)
+        if (a->binaries[i].program_index >= a->header->num_programs ||
+            !opencl_archive_range_valid(a, a->binaries[i].offset, a->binaries[i].size))
+            goto invalid;
+
+    *archive = a;
+    return CL_SUCCESS;
+
+invalid:
+    fprintf(stderr, "ERROR: %s is not a valid kernel archive of version %d\n",
+            archive_file_name, ARCHIVE_FORMAT_VERSION);
+    opencl_archive_close(a);
+    return CL_INVALID_BINARY;
+}
+
+const char * opencl_archive_program_name(const hawopencl_archive * archive,
+        cl_uint index) {
+    if (index >= archive->header->num_programs)
+        return NULL;
+    return (const char *) archive->data + archive->programs[index].name_offset;
+}
+
+int opencl_archive_program(const hawopencl_archive * archive,
+        const char * name,
+        const cl_device_id device_id,
+        const cl_context context,
+        hawopencl_program ** program) {
+    hawopencl_program * p;
+    const char * source = NULL;
+    const char * options = NULL;
+    uint64_t key;
+    uint32_t index;
+    uint32_t i;
+
+    for (index = 0; index < archive->header->num_programs; index++)
+        if (0 == strcmp(name, (const char *) archive->data + archive->programs[index].name_offset)) {
+            source = (const char *) archive->data + archive->programs[index].source_offset;
+            options = (const char *) archive->data + archive->programs[index].options_offset;
+            break;
+        }
+    if (NULL == source)
+        return CL_INVALID_PROGRAM;
+
+    p = (hawopencl_program *) calloc(1, sizeof(hawopencl_program));
+    if (NULL == p)
+        FATAL_ERROR("calloc", ENOMEM);
+
+    // Pick the binary compiled for this very device, driver and platform
+    key = opencl_kernel_cache_key(source, options, device_id);
+    for (i = 0; i < archive->header->num_binaries && NULL == p->program; i++) {
+        const archive_binary * b = &archive->binaries[i];
+        const unsigned char * binary = archive->data + b->offset;
+        const size_t size = b->size;
+        cl_int binary_status;
+        int err;
+
+        if (b->program_index != index || b->key != key)
+            continue;
+        p->program = clCreateProgramWithBinary(context, 1, &device_id, &size,
+                &binary, &binary_status, &err);
+        if (NULL != p->program && CL_SUCCESS == err && CL_SUCCESS == binary_status)
+            err = clBuildProgram(p->program, 1, &device_id, options, NULL, NULL);
+        if (NULL == p->program || CL_SUCCESS != err || CL_SUCCESS != binary_status) {
+            fprintf(stderr, "INFO: Binary of %s in kernel archive rejected; building from source\n", name);
+            if (NULL != p->program)
+                clReleaseProgram(p->program);
+            p->program = NULL;
+        }
+    }
+
+    // Fall back to the source on unknown hardware
+    if (NULL == p->program)
+        p->program = opencl_kernel_build_program(source, options, name, device_id, context);
+    opencl_program_kernels_create(p);
+
+    *program = p;
+    return CL_SUCCESS;
+}
+
+int opencl_archive_close(hawopencl_archive * archive) {
+#if defined(HAVE_SYS_MMAN_H)
+    if (archive->mapped)
+        munmap(archive->data, archive->size);
+    else
+#endif
+        free(archive->data);
+    free(archive);
+    return CL_SUCCESS;
+}
@@ -0,0 +1,152 @@
+//
+//  opencl_arena.c : Part of libHAWOpenCL
+//
+//  Arena of sub-buffers of one buffer for many small objects, allocated
+//  by advancing an offset, uploaded at once and freed together.
+//
+//  Copyright (c) 2018-2022 Rainer Keller, HS Esslingen. All rights reserved.
+//
+#include "HAWOpenCL_config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+
+#if defined(__APPLE__) && defined(__MACH__)
+#include <OpenCL/opencl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include "HAWOpenCL.h"
+#include "opencl_internal.h"
+
+/*
+ * Local functions
+ */
+static int opencl_arena_marker(const cl_command_queue command_queue, cl_event * event);
+
+// Without any data to transfer, return an event completing with the previously enqueued commands
+static int opencl_arena_marker(const cl_command_queue command_queue, cl_event * event) {
+    if (NULL == event)
+        return CL_SUCCESS;
+#if defined(CL_VERSION_1_2)
+    return clEnqueueMarkerWithWaitList(command_queue, 0, NULL, event);
+#else
+    return clEnqueueMarker(command_queue, event);
+#endif
+}
+
+int opencl_arena_create(const cl_device_id device_id,
+        const cl_context context,
+        cl_mem_flags flags,
+        size_t size,
+        hawopencl_arena * arena) {
+#if defined(CL_VERSION_1_1)
+    int err;
+
+    if (0 != (flags & (CL_MEM_USE_HOST_PTR | CL_MEM_ALLOC_HOST_PTR | CL_MEM_COPY_HOST_PTR)))
+        return CL_INVALID_VALUE;
+    if (0 == size)
+        return CL_INVALID_BUFFER_SIZE;
+
+    memset(arena, 0, sizeof(hawopencl_arena));
+    // The origin of a sub-buffer has to be a multiple of the alignment
+    arena->alignment = opencl_device_caps(device_id)->mem_base_addr_align / 8;
+    if (arena->alignment < sizeof(void *))
+        arena->alignment = sizeof(void *);
+    arena->size = size;
+    err = posix_memalign((void **) &arena->host, arena->alignment, size);
+    if (0 != err)
+        FATAL_ERROR("posix_memalign", err);
+    arena->buffer = clCreateBuffer(context, flags, size, NULL, &err);
+    if (NULL == arena->buffer || CL_SUCCESS != err)
+        FATAL_ERROR("clCreateBuffer", err);
+    return CL_SUCCESS;
+#else
+    (void) device_id; (void) context; (void) flags; (void) size; (void) arena;
+    return CL_INVALID_OPERATION;
+#endif
+}
+
+int opencl_arena_alloc(hawopencl_arena * arena,
+        size_t size,
+        cl_mem * sub_buffer,
+        void ** host) {
+#if defined(CL_VERSION_1_1)
+    cl_buffer_region region;
+    int err;
+
+    if (0 == size)
+        return CL_INVALID_BUFFER_SIZE;
+    region.origin = (arena->used + arena->alignment - 1) / arena->alignment * arena->alignment;
+    region.size = size;
+    if (region.origin + size > arena->size)
+        return CL_MEM_OBJECT_ALLOCATION_FAILURE;
+
+    if (arena->num_sub_buffers == arena->max_sub_buffers) {
+        cl_mem * tmp;
+        arena->max_sub_buffers = (0 == arena->max_sub_buffers) ? 64 : 2 * arena->max_sub_buffers;
+        tmp = realloc(arena->sub_buffers, arena->max_sub_buffers * sizeof(cl_mem));
+        if (NULL == tmp)
+            FATAL_ERROR("realloc", ENOMEM);
+        arena->sub_buffers = tmp;
+    }
+    // The sub-buffer inherits the flags of the arena's buffer
+    *sub_buffer = clCreateSubBuffer(arena->buffer, 0, CL_BUFFER_CREATE_TYPE_REGION, &region, &err);
+    if (NULL == *sub_buffer || CL_SUCCESS != err)
+        FATAL_ERROR("clCreateSubBuffer", err);
+    arena->sub_buffers[arena->num_sub_buffers++] = *sub_buffer;
+    arena->used = region.origin + size;
+    if (NULL != host)
+        *host = arena->host + region.origin;
+    return CL_SUCCESS;
+#else
+    (void) arena; (void) size; (void) sub_buffer; (void) host;
+    return CL_INVALID_OPERATION;
+#endif
+}
+
+int opencl_arena_upload(const cl_command_queue command_queue,
+        hawopencl_arena * arena,
+        cl_bool blocking,
+        cl_event * event) {
+    if (0 == arena->used)
+        return opencl_arena_marker(command_queue, event);
+    return clEnqueueWriteBuffer(command_queue, arena->buffer, blocking, 0, arena->used, arena->host,
+            0, NULL, event);
+}
+
+int opencl_arena_download(const cl_command_queue command_queue,
+        hawopencl_arena * arena,
+        cl_bool blocking,
+        cl_event * event) {
+    if (0 == arena->used)
+        return opencl_arena_marker(command_queue, event);
+    return clEnqueueReadBuffer(command_queue, arena->buffer, blocking, 0, arena->used, arena->host,
+            0, NULL, event);
+}
+
+int opencl_arena_reset(hawopencl_arena * arena) {
+    cl_uint i;
+
+    for (i = 0; i < arena->num_sub_buffers; i++)
+        OPENCL_CHECK(clReleaseMemObject, (arena->sub_buffers[i]));
+    arena->num_sub_buffers = 0;
+    arena->used = 0;
+    return CL_SUCCESS;
+}
+
+int opencl_arena_release(hawopencl_arena * arena) {
+    opencl_arena_reset(arena);
+    if (NULL != arena->buffer)
+        OPENCL_CHECK(clReleaseMemObject, (arena->buffer));
+    free(arena->sub_buffers);
+    free(arena->host);
+    memset(arena, 0, sizeof(hawopencl_arena));
+    return CL_SUCCESS;
+}
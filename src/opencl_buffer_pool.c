@@ -0,0 +1,289 @@
+//
+//  opencl_buffer_pool.c : Part of libHAWOpenCL
+//
+//  Device buffers of one context, recycled by size class instead of being
+//  created and released for every use.
+//
+//  Copyright (c) 2018-2022 Rainer Keller, HS Esslingen. All rights reserved.
+//
+#include "HAWOpenCL_config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+#if defined(__APPLE__) && defined(__MACH__)
+#include <OpenCL/opencl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include "HAWOpenCL.h"
+#include "opencl_internal.h"
+
+#define POOL_MIN_SIZE   256
+#define POOL_MAX_SIZE   (256 * 1024 * 1024)
+
+// The free buffers of one size class
+typedef struct {
+    size_t size;                    // The size of all buffers of this class
+    cl_uint num_in_use;             // The buffers allocated and not yet freed
+    cl_uint num_free;
+    cl_uint max_free;               // The size of the array free
+    cl_mem * free;                  // Stack of free buffers, the most recently freed on top
+} opencl_buffer_class;
+
+struct hawopencl_buffer_pool {
+    cl_context context;
+    hawopencl_buffer_pool_config config;
+    cl_uint num_classes;
+    opencl_buffer_class * classes;
+    hawopencl_buffer_pool_stats stats;
+#if defined(HAVE_PTHREAD_H)
+    pthread_mutex_t mutex;
+#endif
+};
+
+#if defined(HAVE_PTHREAD_H)
+#  define POOL_LOCK(p)    pthread_mutex_lock(&(p)->mutex)
+#  define POOL_UNLOCK(p)  pthread_mutex_unlock(&(p)->mutex)
+#else
+#  define POOL_LOCK(p)
+#  define POOL_UNLOCK(p)
+#endif
+
+#define IS_POWER_OF_TWO(x)  (0 != (x) && 0 == ((x) & ((x) - 1)))
+
+/*
+ * Local functions
+ */
+static cl_uint opencl_buffer_pool_class(const hawopencl_buffer_pool * pool, size_t size);
+static void opencl_buffer_pool_trim_locked(hawopencl_buffer_pool * pool, size_t bytes);
+
+// Get the index of the smallest size class holding size bytes, which are at most max_size
+static cl_uint opencl_buffer_pool_class(const hawopencl_buffer_pool * pool, size_t size) {
+    const cl_uint k = pool->config.classes_per_doubling;
+    size_t base = pool->config.min_size;
+    size_t step;
+    cl_uint index = 0;
+
+    if (size <= base)
+        return 0;
+    // Find the power of two with base < size <= 2 * base
+    while (2 * base < size) {
+        base *= 2;
+        index += k;
+    }
+    step = base / k;
+    return index + (cl_uint) ((size - base + step - 1) / step);
+}
+
+// Release free buffers, the largest first, until at most bytes are kept; called with the lock held
+static void opencl_buffer_pool_trim_locked(hawopencl_buffer_pool * pool, size_t bytes) {
+    cl_uint i = pool->num_classes;
+
+    while (pool->stats.bytes_free > bytes && i > 0) {
+        opencl_buffer_class * c = &pool->classes[i - 1];
+        if (0 == c->num_free) {
+            i--;
+            continue;
+        }
+        c->num_free--;
+        OPENCL_CHECK(clReleaseMemObject, (c->free[c->num_free]));
+        pool->stats.bytes_free -= c->size;
+        pool->stats.trims++;
+    }
+}
+
+int opencl_buffer_pool_config_init(hawopencl_buffer_pool_config * config) {
+    config->flags = CL_MEM_READ_WRITE;
+    config->min_size = POOL_MIN_SIZE;
+    config->max_size = POOL_MAX_SIZE;
+    config->classes_per_doubling = 1;
+    config->budget = 0;
+    return CL_SUCCESS;
+}
+
+int opencl_buffer_pool_create(const cl_context context,
+        const hawopencl_buffer_pool_config * config,
+        hawopencl_buffer_pool ** pool) {
+    hawopencl_buffer_pool * p;
+    size_t base;
+    cl_uint i;
+
+    p = calloc(1, sizeof(hawopencl_buffer_pool));
+    if (NULL == p)
+        FATAL_ERROR("calloc", ENOMEM);
+    if (NULL == config)
+        opencl_buffer_pool_config_init(&p->config);
+    else
+        p->config = *config;
+    // The classes between two powers of two have to be of integral size
+    if (!IS_POWER_OF_TWO(p->config.min_size) || !IS_POWER_OF_TWO(p->config.max_size) ||
+        p->config.min_size > p->config.max_size ||
+        !IS_POWER_OF_TWO(p->config.classes_per_doubling) ||
+        p->config.classes_per_doubling > p->config.min_size ||
+        0 != (p->config.flags & (CL_MEM_USE_HOST_PTR | CL_MEM_COPY_HOST_PTR))) {
+        free(p);
+        return CL_INVALID_VALUE;
+    }
+
+    p->num_classes = opencl_buffer_pool_class(p, p->config.max_size) + 1;
+    p->classes = calloc(p->num_classes, sizeof(opencl_buffer_class));
+    if (NULL == p->classes)
+        FATAL_ERROR("calloc", ENOMEM);
+    p->classes[0].size = p->config.min_size;
+    for (i = 1, base = p->config.min_size; i < p->num_classes; i++) {
+        const cl_uint j = (i - 1) % p->config.classes_per_doubling + 1;
+        p->classes[i].size = base + j * (base / p->config.classes_per_doubling);
+        if (j == p->config.classes_per_doubling)
+            base *= 2;
+    }
+
+    OPENCL_CHECK(clRetainContext, (context));
+    p->context = context;
+#if defined(HAVE_PTHREAD_H)
+    pthread_mutex_init(&p->mutex, NULL);
+#endif
+    *pool = p;
+    return CL_SUCCESS;
+}
+
+int opencl_buffer_pool_alloc(hawopencl_buffer_pool * pool,
+        size_t size,
+        cl_mem * buffer) {
+    opencl_buffer_class * c;
+    cl_int err;
+
+    if (0 == size)
+        return CL_INVALID_BUFFER_SIZE;
+    if (size > pool->config.max_size) {
+        POOL_LOCK(pool);
+        pool->stats.unpooled++;
+        POOL_UNLOCK(pool);
+        *buffer = clCreateBuffer(pool->context, pool->config.flags, size, NULL, &err);
+        return err;
+    }
+
+    c = &pool->classes[opencl_buffer_pool_class(pool, size)];
+    POOL_LOCK(pool);
+    if (c->num_free > 0) {
+        c->num_free--;
+        *buffer = c->free[c->num_free];
+        c->num_in_use++;
+        pool->stats.bytes_free -= c->size;
+        pool->stats.bytes_in_use += c->size;
+        pool->stats.hits++;
+        POOL_UNLOCK(pool);
+        return CL_SUCCESS;
+    }
+    // Make room for the new buffer by releasing free ones of other classes
+    if (0 != pool->config.budget) {
+        const unsigned long long held = pool->stats.bytes_in_use + c->size;
+        opencl_buffer_pool_trim_locked(pool, held < pool->config.budget ? pool->config.budget - held : 0);
+    }
+    pool->stats.misses++;
+    POOL_UNLOCK(pool);
+
+    *buffer = clCreateBuffer(pool->context, pool->config.flags, c->size, NULL, &err);
+    // The device may be out of memory due to the free buffers; release them and retry
+    if (CL_MEM_OBJECT_ALLOCATION_FAILURE == err || CL_OUT_OF_RESOURCES == err) {
+        POOL_LOCK(pool);
+        opencl_buffer_pool_trim_locked(pool, 0);
+        POOL_UNLOCK(pool);
+        *buffer = clCreateBuffer(pool->context, pool->config.flags, c->size, NULL, &err);
+    }
+    if (CL_SUCCESS != err)
+        return err;
+
+    POOL_LOCK(pool);
+    c->num_in_use++;
+    pool->stats.bytes_in_use += c->size;
+    POOL_UNLOCK(pool);
+    return CL_SUCCESS;
+}
+
+int opencl_buffer_pool_free(hawopencl_buffer_pool * pool,
+        cl_mem buffer) {
+    opencl_buffer_class * c;
+    cl_context context;
+    size_t size;
+    cl_uint i;
+
+    if (NULL == buffer ||
+        CL_SUCCESS != clGetMemObjectInfo(buffer, CL_MEM_CONTEXT, sizeof(context), &context, NULL) ||
+        CL_SUCCESS != clGetMemObjectInfo(buffer, CL_MEM_SIZE, sizeof(size), &size, NULL) ||
+        context != pool->context)
+        return CL_INVALID_MEM_OBJECT;
+    if (size > pool->config.max_size) {
+        OPENCL_CHECK(clReleaseMemObject, (buffer));
+        return CL_SUCCESS;
+    }
+
+    i = opencl_buffer_pool_class(pool, size);
+    c = &pool->classes[i];
+    POOL_LOCK(pool);
+    if (c->size != size || 0 == c->num_in_use) {
+        POOL_UNLOCK(pool);
+        return CL_INVALID_MEM_OBJECT;
+    }
+    c->num_in_use--;
+    pool->stats.bytes_in_use -= size;
+    if (0 != pool->config.budget &&
+        pool->stats.bytes_in_use + pool->stats.bytes_free + size > pool->config.budget) {
+        pool->stats.trims++;
+        POOL_UNLOCK(pool);
+        OPENCL_CHECK(clReleaseMemObject, (buffer));
+        return CL_SUCCESS;
+    }
+    if (c->num_free == c->max_free) {
+        cl_mem * tmp;
+        c->max_free = (0 == c->max_free) ? 8 : 2 * c->max_free;
+        tmp = realloc(c->free, c->max_free * sizeof(cl_mem));
+        if (NULL == tmp)
+            FATAL_ERROR("realloc", ENOMEM);
+        c->free = tmp;
+    }
+    c->free[c->num_free++] = buffer;
+    pool->stats.bytes_free += size;
+    POOL_UNLOCK(pool);
+    return CL_SUCCESS;
+}
+
+int opencl_buffer_pool_trim(hawopencl_buffer_pool * pool,
+        size_t bytes) {
+    POOL_LOCK(pool);
+    opencl_buffer_pool_trim_locked(pool, bytes);
+    POOL_UNLOCK(pool);
+    return CL_SUCCESS;
+}
+
+int opencl_buffer_pool_stats(hawopencl_buffer_pool * pool,
+        hawopencl_buffer_pool_stats * stats) {
+    POOL_LOCK(pool);
+    *stats = pool->stats;
+    POOL_UNLOCK(pool);
+    return CL_SUCCESS;
+}
+
+int opencl_buffer_pool_release(hawopencl_buffer_pool * pool) {
+    cl_uint i;
+
+    opencl_buffer_pool_trim_locked(pool, 0);
+    for (i = 0; i < pool->num_classes; i++)
+        free(pool->classes[i].free);
+    free(pool->classes);
+    OPENCL_CHECK(clReleaseContext, (pool->context));
+#if defined(HAVE_PTHREAD_H)
+    pthread_mutex_destroy(&pool->mutex);
+#endif
+    free(pool);
+    return CL_SUCCESS;
+}
@@ -0,0 +1,157 @@
+//
+//  opencl_build_options.c : Part of libHAWOpenCL
+//
+//  Assemble the options passed to clBuildProgram() from a named profile,
+//  macro definitions and user-provided options.
+//
+//  Copyright (c) 2018-2022 Rainer Keller, HS Esslingen. All rights reserved.
+//
+#include "HAWOpenCL_config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+
+#if defined(__APPLE__) && defined(__MACH__)
+#include <OpenCL/opencl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include "HAWOpenCL.h"
+#include "opencl_internal.h"
+
+struct build_profile {
+    hawopencl_build_profile profile;
+    const char * name;
+    const char * options;
+};
+
+static const struct build_profile build_profiles[] = {
+    {HAWOPENCL_BUILD_PROFILE_DEBUG,     "debug",     "-cl-opt-disable -cl-kernel-arg-info"},
+    {HAWOPENCL_BUILD_PROFILE_RELEASE,   "release",   ""},
+    {HAWOPENCL_BUILD_PROFILE_FAST_MATH, "fast-math", "-cl-fast-relaxed-math -cl-mad-enable"},
+    {HAWOPENCL_BUILD_PROFILE_STRICT,    "strict",    "-cl-fp32-correctly-rounded-divide-sqrt"},
+};
+#define NUM_BUILD_PROFILES (sizeof(build_profiles) / sizeof(build_profiles[0]))
+
+// Append str to the dynamically allocated *buffer, separated by a space
+static void opencl_build_options_append(char ** buffer, const char * str) {
+    const size_t len = (NULL == *buffer) ? 0 : strlen(*buffer);
+
+    if ('\0' == str[0])
+        return;
+    *buffer = (char *) realloc(*buffer, len + 1 + strlen(str) + 1);
+    if (NULL == *buffer)
+        FATAL_ERROR("realloc", ENOMEM);
+    if (0 == len)
+        strcpy(*buffer, str);
+    else
+        sprintf(*buffer + len, " %s", str);
+}
+
+const char * opencl_build_profile_name(hawopencl_build_profile profile) {
+    unsigned int i;
+    for (i = 0; i < NUM_BUILD_PROFILES; i++)
+        if (build_profiles[i].profile == profile)
+            return build_profiles[i].name;
+    return NULL;
+}
+
+int opencl_build_profile_parse(const char * name, hawopencl_build_profile * profile) {
+    unsigned int i;
+    for (i = 0; i < NUM_BUILD_PROFILES; i++)
+        if (0 == strcmp(build_profiles[i].name, name)) {
+            *profile = build_profiles[i].profile;
+            return CL_SUCCESS;
+        }
+    return CL_INVALID_VALUE;
+}
+
+int opencl_build_options_init(hawopencl_build_options * options,
+        hawopencl_build_profile profile) {
+    memset(options, 0, sizeof(hawopencl_build_options));
+    options->profile = profile;
+    return CL_SUCCESS;
+}
+
+int opencl_build_options_define(hawopencl_build_options * options,
+        const char * name,
+        const char * value) {
+    char * define;
+
+    if (NULL == value) {
+        define = malloc(2 + strlen(name) + 1);
+        if (NULL == define)
+            FATAL_ERROR("malloc", ENOMEM);
+        sprintf(define, "-D%s", name);
+    } else {
+        define = malloc(2 + strlen(name) + 1 + strlen(value) + 1);
+        if (NULL == define)
+            FATAL_ERROR("malloc", ENOMEM);
+        sprintf(define, "-D%s=%s", name, value);
+    }
+    opencl_build_options_append(&options->defines, define);
+    free(define);
+    return CL_SUCCESS;
+}
+
+int opencl_build_options_add(hawopencl_build_options * options,
+        const char * option) {
+    opencl_build_options_append(&options->extra, option);
+    return CL_SUCCESS;
+}
+
+char * opencl_build_options_assemble(const hawopencl_build_options * options) {
+    hawopencl_build_profile profile = options->profile;
+    char * str;
+    const char * env;
+    unsigned int i;
+
+    // The environment overrides the profile selected by the application
+    env = getenv("OPENCL_BUILD_PROFILE");
+    if (NULL != env && CL_SUCCESS != opencl_build_profile_parse(env, &profile))
+        fprintf(stderr, "WARNING: Unknown OPENCL_BUILD_PROFILE=%s; using profile %s\n",
+                env, opencl_build_profile_name(profile));
+
+    str = strdup("");
+    if (NULL == str)
+        FATAL_ERROR("strdup", ENOMEM);
+
+    for (i = 0; i < NUM_BUILD_PROFILES; i++)
+        if (build_profiles[i].profile == profile)
+            opencl_build_options_append(&str, build_profiles[i].options);
+    if (options->kernel_arg_info && HAWOPENCL_BUILD_PROFILE_DEBUG != profile)
+        opencl_build_options_append(&str, "-cl-kernel-arg-info");
+    if (NULL != options->defines)
+        opencl_build_options_append(&str, options->defines);
+    if (NULL != options->extra)
+        opencl_build_options_append(&str, options->extra);
+
+    // Options in the environment are appended last, so they take precedence
+    env = getenv("OPENCL_BUILD_OPTIONS");
+    if (NULL != env)
+        opencl_build_options_append(&str, env);
+
+    return str;
+}
+
+const char * opencl_build_options_string(hawopencl_build_options * options) {
+    free(options->options);
+    options->options = opencl_build_options_assemble(options);
+    return options->options;
+}
+
+int opencl_build_options_free(hawopencl_build_options * options) {
+    free(options->defines);
+    free(options->extra);
+    free(options->options);
+    options->defines = NULL;
+    options->extra = NULL;
+    options->options = NULL;
+    return CL_SUCCESS;
+}
@@ -0,0 +1,135 @@
+//
+//  opencl_command_queue.c : Part of libHAWOpenCL
+//
+//  Creation of command queues with configurable properties.
+//
+//  Copyright (c) 2018-2022 Rainer Keller, HS Esslingen. All rights reserved.
+//
+#include "HAWOpenCL_config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+
+#if defined(__APPLE__) && defined(__MACH__)
+#include <OpenCL/opencl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include "HAWOpenCL.h"
+#include "opencl_internal.h"
+
+// From cl_ext.h of cl_khr_priority_hints, which not every installation provides
+#if !defined(CL_QUEUE_PRIORITY_KHR)
+#  define CL_QUEUE_PRIORITY_KHR       0x1096
+#  define CL_QUEUE_PRIORITY_HIGH_KHR  (1 << 0)
+#  define CL_QUEUE_PRIORITY_MED_KHR   (1 << 1)
+#  define CL_QUEUE_PRIORITY_LOW_KHR   (1 << 2)
+#endif
+
+/*
+ * Local functions
+ */
+static bool opencl_platform_has_extension(const cl_platform_id platform_id, const char * name);
+
+static bool opencl_platform_has_extension(const cl_platform_id platform_id, const char * name) {
+    char * platform_extensions;
+    size_t len;
+    bool ret;
+    int err;
+
+    err = clGetPlatformInfo(platform_id, CL_PLATFORM_EXTENSIONS, 0, NULL, &len);
+    if (CL_SUCCESS != err)
+        FATAL_ERROR("clGetPlatformInfo", err);
+    platform_extensions = (char*) malloc(len + 1);
+    if (NULL == platform_extensions)
+        FATAL_ERROR("malloc", ENOMEM);
+    err = clGetPlatformInfo(platform_id, CL_PLATFORM_EXTENSIONS, len, platform_extensions, NULL);
+    if (CL_SUCCESS != err)
+        FATAL_ERROR("clGetPlatformInfo", err);
+    // Don't trust anyone, let's set the last character to NUL character.
+    platform_extensions[len] = '\0';
+    ret = checkDeviceExtension(platform_extensions, name);
+    free(platform_extensions);
+    return ret;
+}
+
+int opencl_queue_config_init(hawopencl_queue_config * config) {
+    config->properties = CL_QUEUE_PROFILING_ENABLE;
+    config->size = 0;
+    config->priority = HAWOPENCL_QUEUE_PRIORITY_DEFAULT;
+    return CL_SUCCESS;
+}
+
+int opencl_command_queue_create(const cl_device_id device_id,
+        const cl_context context,
+        const hawopencl_queue_config * config,
+        cl_command_queue * command_queue) {
+    const hawopencl_device_caps * caps = opencl_device_caps(device_id);
+    hawopencl_queue_config c;
+    bool with_properties = false;
+    int err;
+
+    if (NULL == config)
+        opencl_queue_config_init(&c);
+    else
+        c = *config;
+
+    if ((c.properties & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE) &&
+        !(caps->queue_properties & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE)) {
+        fprintf(stderr, "INFO: Device %s does not support out-of-order queues, using an in-order queue\n",
+                caps->name);
+        c.properties &= ~(cl_command_queue_properties) CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE;
+    }
+    if (HAWOPENCL_QUEUE_PRIORITY_DEFAULT != c.priority &&
+        !opencl_platform_has_extension(caps->platform_id, "cl_khr_priority_hints")) {
+        fprintf(stderr, "INFO: Platform %s does not support cl_khr_priority_hints, ignoring the queue priority\n",
+                caps->platform_name);
+        c.priority = HAWOPENCL_QUEUE_PRIORITY_DEFAULT;
+    }
+
+#if defined(CL_VERSION_2_0)
+    // The size only applies to device-side queues, others are rejected with it
+    if (0 != c.size && !(c.properties & CL_QUEUE_ON_DEVICE)) {
+        fprintf(stderr, "INFO: Queue size requires CL_QUEUE_ON_DEVICE, ignoring it\n");
+        c.size = 0;
+    }
+
+    // OpenCL 2.x platforms or cl_khr_create_command_queue offer properties beyond the bitfield
+    with_properties = 0 != strncmp(caps->platform_version, "OpenCL 1.", strlen("OpenCL 1.")) ||
+        opencl_platform_has_extension(caps->platform_id, "cl_khr_create_command_queue");
+    if (with_properties) {
+        cl_queue_properties qp[7];
+        int i = 0;
+
+        qp[i++] = CL_QUEUE_PROPERTIES;
+        qp[i++] = c.properties;
+        if (0 != c.size) {
+            qp[i++] = CL_QUEUE_SIZE;
+            qp[i++] = c.size;
+        }
+        if (HAWOPENCL_QUEUE_PRIORITY_DEFAULT != c.priority) {
+            qp[i++] = CL_QUEUE_PRIORITY_KHR;
+            qp[i++] = (HAWOPENCL_QUEUE_PRIORITY_HIGH == c.priority) ? CL_QUEUE_PRIORITY_HIGH_KHR :
+                      (HAWOPENCL_QUEUE_PRIORITY_MEDIUM == c.priority) ? CL_QUEUE_PRIORITY_MED_KHR :
+                                                                         CL_QUEUE_PRIORITY_LOW_KHR;
+        }
+        qp[i] = 0;
+        *command_queue = clCreateCommandQueueWithProperties(context, device_id, qp, &err);
+    } else
+#endif
+    {
+        if (0 != c.size || HAWOPENCL_QUEUE_PRIORITY_DEFAULT != c.priority)
+            fprintf(stderr, "INFO: Queue size and priority require OpenCL 2.x, ignoring them\n");
+        // Let's call the (deprecated) function, if we're on OpenCL < 2.0
+        *command_queue = clCreateCommandQueue(context, device_id, c.properties, &err);
+    }
+    if (NULL == *command_queue || CL_SUCCESS != err)
+        FATAL_ERROR(with_properties ? "clCreateCommandQueueWithProperties" : "clCreateCommandQueue", err);
+    return CL_SUCCESS;
+}
@@ -0,0 +1,450 @@
+//
+//  opencl_device_caps.c : Part of libHAWOpenCL
+//
+//  Snapshot of the device capabilities, queried once per process and device,
+//  and persisted in the cache directory keyed by the device's driver version.
+//
+//  Copyright (c) 2018-2022 Rainer Keller, HS Esslingen. All rights reserved.
+//
+#include "HAWOpenCL_config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <stdint.h>
+#ifdef HAVE_STDLIB_H
+#  include <stdlib.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#  include <unistd.h>
+#endif
+#ifdef HAVE_PTHREAD_H
+#  include <pthread.h>
+#endif
+
+#if defined(__APPLE__) && defined(__MACH__)
+#  include <OpenCL/opencl.h>
+#else
+#  include <CL/cl.h>
+#endif
+
+#include "HAWOpenCL.h"
+#include "opencl_internal.h"
+
+#define CAPS_MAGIC           "HAWCLDEV"
+#define CAPS_FORMAT_VERSION  4
+#define CAPS_FILE_NAME       "devices.clcaps"
+
+// The header of the cache file, followed by num_records of opencl_device_caps_record
+typedef struct {
+    char magic[8];
+    uint32_t format_version;
+    uint32_t caps_size;             // sizeof(hawopencl_device_caps), changes with the layout
+    uint32_t num_records;
+    uint32_t reserved;
+    uint64_t checksum;              // Of all records
+} opencl_device_caps_header;
+
+typedef struct {
+    uint64_t key;                   // Identifies device, driver and platform
+    hawopencl_device_caps caps;
+} opencl_device_caps_record;
+
+// The capabilities of the devices queried in this process
+typedef struct opencl_device_caps_entry {
+    cl_device_id device_id;
+    hawopencl_device_caps caps;
+    struct opencl_device_caps_entry * next;
+} opencl_device_caps_entry;
+
+static opencl_device_caps_entry * caps_entries = NULL;
+static opencl_device_caps_entry * caps_released = NULL;    // Of released sub-devices, still referenced
+static bool caps_file_read = false;
+static opencl_device_caps_record * caps_records = NULL;
+static uint32_t caps_records_num = 0;
+
+#if defined(HAVE_PTHREAD_H)
+static pthread_mutex_t caps_mutex = PTHREAD_MUTEX_INITIALIZER;
+#  define CAPS_LOCK()    pthread_mutex_lock(&caps_mutex)
+#  define CAPS_UNLOCK()  pthread_mutex_unlock(&caps_mutex)
+#else
+#  define CAPS_LOCK()
+#  define CAPS_UNLOCK()
+#endif
+
+// The extensions represented in hawopencl_device_caps.extension_bits
+static const struct {
+    const char * name;
+    cl_ulong bit;
+} caps_extensions[] = {
+    {"cl_khr_fp64",                      HAWOPENCL_EXT_KHR_FP64},
+    {"cl_khr_fp16",                      HAWOPENCL_EXT_KHR_FP16},
+    {"cl_khr_gl_sharing",                HAWOPENCL_EXT_KHR_GL_SHARING},
+    {"cl_khr_gl_event",                  HAWOPENCL_EXT_KHR_GL_EVENT},
+    {"cl_APPLE_gl_sharing",              HAWOPENCL_EXT_APPLE_GL_SHARING},
+    {"cl_khr_global_int32_base_atomics", HAWOPENCL_EXT_KHR_GLOBAL_INT32_BASE_ATOMICS},
+    {"cl_khr_local_int32_base_atomics",  HAWOPENCL_EXT_KHR_LOCAL_INT32_BASE_ATOMICS},
+    {"cl_khr_int64_base_atomics",        HAWOPENCL_EXT_KHR_INT64_BASE_ATOMICS},
+    {"cl_khr_byte_addressable_store",    HAWOPENCL_EXT_KHR_BYTE_ADDRESSABLE_STORE},
+    {"cl_khr_3d_image_writes",           HAWOPENCL_EXT_KHR_3D_IMAGE_WRITES},
+    {"cl_khr_il_program",                HAWOPENCL_EXT_KHR_IL_PROGRAM},
+    {"cl_khr_subgroups",                 HAWOPENCL_EXT_KHR_SUBGROUPS},
+    {"cl_khr_spir",                      HAWOPENCL_EXT_KHR_SPIR},
+};
+
+// Query a fixed-size property of the device
+#define DEVICE_INFO(device_id, param, val) do {                                \
+        int __err = clGetDeviceInfo((device_id), (param), sizeof(val), &(val), NULL); \
+        if (CL_SUCCESS != __err)                                               \
+            FATAL_ERROR("clGetDeviceInfo", __err);                             \
+    } while(0)
+
+/*
+ * Local functions
+ */
+static char * opencl_device_caps_string_alloc(cl_device_id device_id, cl_platform_id platform_id,
+        cl_uint param);
+static void opencl_device_caps_string(cl_device_id device_id, cl_platform_id platform_id,
+        cl_uint param, char * val, size_t size);
+static uint64_t opencl_device_caps_key(const hawopencl_device_caps * caps);
+static void opencl_device_caps_query(cl_device_id device_id, hawopencl_device_caps * caps);
+static void opencl_device_caps_read(void);
+static void opencl_device_caps_write(void);
+static opencl_device_caps_entry * opencl_device_caps_lookup(const cl_device_id device_id);
+
+// Query a string property of the device (or of the platform, if platform_id is given)
+// into a newly allocated string
+static char * opencl_device_caps_string_alloc(cl_device_id device_id, cl_platform_id platform_id,
+        cl_uint param) {
+    size_t len = 0;
+    char * tmp;
+    int err;
+
+    if (NULL != platform_id)
+        err = clGetPlatformInfo(platform_id, param, 0, NULL, &len);
+    else
+        err = clGetDeviceInfo(device_id, param, 0, NULL, &len);
+    if (CL_SUCCESS != err)
+        FATAL_ERROR((NULL != platform_id) ? "clGetPlatformInfo" : "clGetDeviceInfo", err);
+    tmp = malloc(len + 1);
+    if (NULL == tmp)
+        FATAL_ERROR("malloc", ENOMEM);
+    if (NULL != platform_id)
+        err = clGetPlatformInfo(platform_id, param, len, tmp, NULL);
+    else
+        err = clGetDeviceInfo(device_id, param, len, tmp, NULL);
+    if (CL_SUCCESS != err)
+        FATAL_ERROR((NULL != platform_id) ? "clGetPlatformInfo" : "clGetDeviceInfo", err);
+    tmp[len] = '\0';
+    return tmp;
+}
+
+// Query a string property of the device (or of the platform, if platform_id is given)
+// into val; a longer string is cut at the last space which fits
+static void opencl_device_caps_string(cl_device_id device_id, cl_platform_id platform_id,
+        cl_uint param, char * val, size_t size) {
+    char * tmp = opencl_device_caps_string_alloc(device_id, platform_id, param);
+
+    if (strlen(tmp) >= size) {
+        char * space;
+        tmp[size - 1] = '\0';
+        space = strrchr(tmp, ' ');
+        if (NULL != space)
+            *space = '\0';
+    }
+    strcpy(val, tmp);
+    free(tmp);
+}
+
+// The key of the cache file: the properties which change with a driver update
+static uint64_t opencl_device_caps_key(const hawopencl_device_caps * caps) {
+    uint64_t hash = OPENCL_HASH_FNV1A_INIT;
+    hash = opencl_hash_fnv1a(hash, caps->name, strlen(caps->name) + 1);
+    hash = opencl_hash_fnv1a(hash, caps->device_version, strlen(caps->device_version) + 1);
+    hash = opencl_hash_fnv1a(hash, caps->driver_version, strlen(caps->driver_version) + 1);
+    hash = opencl_hash_fnv1a(hash, caps->platform_name, strlen(caps->platform_name) + 1);
+    hash = opencl_hash_fnv1a(hash, caps->platform_version, strlen(caps->platform_version) + 1);
+    hash = opencl_hash_fnv1a(hash, &caps->max_compute_units, sizeof(caps->max_compute_units));
+    return hash;
+}
+
+// Query all the remaining properties
+static void opencl_device_caps_query(cl_device_id device_id, hawopencl_device_caps * caps) {
+    size_t sizes[16] = {0};
+    size_t i;
+    int err;
+
+    opencl_device_caps_string(device_id, NULL, CL_DEVICE_VENDOR, caps->vendor, sizeof(caps->vendor));
+    DEVICE_INFO(device_id, CL_DEVICE_TYPE, caps->type);
+    DEVICE_INFO(device_id, CL_DEVICE_VENDOR_ID, caps->vendor_id);
+    DEVICE_INFO(device_id, CL_DEVICE_MAX_CLOCK_FREQUENCY, caps->max_clock_frequency);
+    DEVICE_INFO(device_id, CL_DEVICE_MAX_WORK_ITEM_DIMENSIONS, caps->max_work_item_dimensions);
+    err = clGetDeviceInfo(device_id, CL_DEVICE_MAX_WORK_ITEM_SIZES, sizeof(sizes), sizes, NULL);
+    if (CL_SUCCESS != err)
+        FATAL_ERROR("clGetDeviceInfo", err);
+    memcpy(caps->max_work_item_sizes, sizes, sizeof(caps->max_work_item_sizes));
+    DEVICE_INFO(device_id, CL_DEVICE_MAX_WORK_GROUP_SIZE, caps->max_work_group_size);
+    DEVICE_INFO(device_id, CL_DEVICE_GLOBAL_MEM_SIZE, caps->global_mem_size);
+    DEVICE_INFO(device_id, CL_DEVICE_GLOBAL_MEM_CACHE_SIZE, caps->global_mem_cache_size);
+    DEVICE_INFO(device_id, CL_DEVICE_GLOBAL_MEM_CACHELINE_SIZE, caps->global_mem_cacheline_size);
+    DEVICE_INFO(device_id, CL_DEVICE_LOCAL_MEM_SIZE, caps->local_mem_size);
+    DEVICE_INFO(device_id, CL_DEVICE_LOCAL_MEM_TYPE, caps->local_mem_type);
+    DEVICE_INFO(device_id, CL_DEVICE_MAX_MEM_ALLOC_SIZE, caps->max_mem_alloc_size);
+    DEVICE_INFO(device_id, CL_DEVICE_MAX_CONSTANT_BUFFER_SIZE, caps->max_constant_buffer_size);
+    DEVICE_INFO(device_id, CL_DEVICE_MEM_BASE_ADDR_ALIGN, caps->mem_base_addr_align);
+    DEVICE_INFO(device_id, CL_DEVICE_ADDRESS_BITS, caps->address_bits);
+    DEVICE_INFO(device_id, CL_DEVICE_ENDIAN_LITTLE, caps->little_endian);
+    DEVICE_INFO(device_id, CL_DEVICE_IMAGE_SUPPORT, caps->image_support);
+    DEVICE_INFO(device_id, CL_DEVICE_COMPILER_AVAILABLE, caps->compiler_available);
+    DEVICE_INFO(device_id, CL_DEVICE_QUEUE_PROPERTIES, caps->queue_properties);
+#if defined(CL_VERSION_2_0)
+    {
+        // Devices before OpenCL 2.0 do not know the property
+        cl_device_svm_capabilities svm = 0;
+        if (CL_SUCCESS == clGetDeviceInfo(device_id, CL_DEVICE_SVM_CAPABILITIES, sizeof(svm), &svm, NULL))
+            caps->svm_capabilities = svm;
+    }
+#endif
+
+    DEVICE_INFO(device_id, CL_DEVICE_PREFERRED_VECTOR_WIDTH_CHAR, caps->preferred_vector_width[HAWOPENCL_VECTOR_CHAR]);
+    DEVICE_INFO(device_id, CL_DEVICE_PREFERRED_VECTOR_WIDTH_SHORT, caps->preferred_vector_width[HAWOPENCL_VECTOR_SHORT]);
+    DEVICE_INFO(device_id, CL_DEVICE_PREFERRED_VECTOR_WIDTH_INT, caps->preferred_vector_width[HAWOPENCL_VECTOR_INT]);
+    DEVICE_INFO(device_id, CL_DEVICE_PREFERRED_VECTOR_WIDTH_LONG, caps->preferred_vector_width[HAWOPENCL_VECTOR_LONG]);
+    DEVICE_INFO(device_id, CL_DEVICE_PREFERRED_VECTOR_WIDTH_FLOAT, caps->preferred_vector_width[HAWOPENCL_VECTOR_FLOAT]);
+    DEVICE_INFO(device_id, CL_DEVICE_PREFERRED_VECTOR_WIDTH_DOUBLE, caps->preferred_vector_width[HAWOPENCL_VECTOR_DOUBLE]);
+#if defined(CL_VERSION_1_1)
+    DEVICE_INFO(device_id, CL_DEVICE_PREFERRED_VECTOR_WIDTH_HALF, caps->preferred_vector_width[HAWOPENCL_VECTOR_HALF]);
+    DEVICE_INFO(device_id, CL_DEVICE_NATIVE_VECTOR_WIDTH_CHAR, caps->native_vector_width[HAWOPENCL_VECTOR_CHAR]);
+    DEVICE_INFO(device_id, CL_DEVICE_NATIVE_VECTOR_WIDTH_SHORT, caps->native_vector_width[HAWOPENCL_VECTOR_SHORT]);
+    DEVICE_INFO(device_id, CL_DEVICE_NATIVE_VECTOR_WIDTH_INT, caps->native_vector_width[HAWOPENCL_VECTOR_INT]);
+    DEVICE_INFO(device_id, CL_DEVICE_NATIVE_VECTOR_WIDTH_LONG, caps->native_vector_width[HAWOPENCL_VECTOR_LONG]);
+    DEVICE_INFO(device_id, CL_DEVICE_NATIVE_VECTOR_WIDTH_FLOAT, caps->native_vector_width[HAWOPENCL_VECTOR_FLOAT]);
+    DEVICE_INFO(device_id, CL_DEVICE_NATIVE_VECTOR_WIDTH_DOUBLE, caps->native_vector_width[HAWOPENCL_VECTOR_DOUBLE]);
+    DEVICE_INFO(device_id, CL_DEVICE_NATIVE_VECTOR_WIDTH_HALF, caps->native_vector_width[HAWOPENCL_VECTOR_HALF]);
+#endif
+
+    for (i = 0; i < sizeof(caps_extensions) / sizeof(caps_extensions[0]); i++)
+        if (checkDeviceExtension(caps->extensions, caps_extensions[i].name))
+            caps->extension_bits |= caps_extensions[i].bit;
+
+    /*
+     * The peak rate scales with compute units times clock; local memory
+     * emulated in global memory (CL_GLOBAL) makes work-group cooperation slow.
+     * The global memory in GiB only decides between otherwise equal devices.
+     */
+    caps->score = (double) caps->max_compute_units * caps->max_clock_frequency;
+    if (CL_LOCAL != caps->local_mem_type)
+        caps->score *= 0.5;
+    caps->score += (double) (caps->global_mem_size >> 30);
+}
+
+// Read the records of the cache file; called with the lock held
+static void opencl_device_caps_read(void) {
+    opencl_device_caps_header header;
+    opencl_device_caps_record * records;
+    char * path;
+    FILE * file;
+
+    caps_file_read = true;
+    path = opencl_kernel_cache_file(CAPS_FILE_NAME);
+    if (NULL == path)
+        return;
+    file = fopen(path, "rb");
+    free(path);
+    if (NULL == file)
+        return;
+    if (1 != fread(&header, sizeof(header), 1, file) ||
+        0 != memcmp(header.magic, CAPS_MAGIC, sizeof(header.magic)) ||
+        CAPS_FORMAT_VERSION != header.format_version ||
+        sizeof(hawopencl_device_caps) != header.caps_size ||
+        0 == header.num_records) {
+        fclose(file);
+        return;
+    }
+    records = malloc(header.num_records * sizeof(opencl_device_caps_record));
+    if (NULL == records)
+        FATAL_ERROR("malloc", ENOMEM);
+    if (header.num_records != fread(records, sizeof(opencl_device_caps_record), header.num_records, file) ||
+        header.checksum != opencl_hash_fnv1a(OPENCL_HASH_FNV1A_INIT, records,
+                header.num_records * sizeof(opencl_device_caps_record))) {
+        // A stale or corrupt file is simply overwritten by the next write
+        free(records);
+        fclose(file);
+        return;
+    }
+    fclose(file);
+    caps_records = records;
+    caps_records_num = header.num_records;
+}
+
+// Write all records into the cache file; called with the lock held
+static void opencl_device_caps_write(void) {
+    opencl_device_caps_header header;
+    char * path;
+    char * tmp_path;
+    FILE * file;
+    int ret = 0;
+
+    path = opencl_kernel_cache_file(CAPS_FILE_NAME);
+    if (NULL == path)
+        return;
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CAPS_MAGIC, sizeof(header.magic));
+    header.format_version = CAPS_FORMAT_VERSION;
+    header.caps_size = sizeof(hawopencl_device_caps);
+    header.num_records = caps_records_num;
+    header.checksum = opencl_hash_fnv1a(OPENCL_HASH_FNV1A_INIT, caps_records,
+            caps_records_num * sizeof(opencl_device_caps_record));
+
+    // Write into a temporary file and rename, so readers never see partial files
+    tmp_path = malloc(strlen(path) + 32);
+    if (NULL == tmp_path)
+        FATAL_ERROR("malloc", ENOMEM);
+    sprintf(tmp_path, "%s.%ld.tmp", path, (long) getpid());
+    file = fopen(tmp_path, "wb");
+    if (NULL != file) {
+        if (1 != fwrite(&header, sizeof(header), 1, file) ||
+            caps_records_num != fwrite(caps_records, sizeof(opencl_device_caps_record), caps_records_num, file))
+            ret = -1;
+        if (0 != fclose(file))
+            ret = -1;
+        if (0 == ret && 0 != rename(tmp_path, path))
+            ret = -1;
+        if (0 != ret)
+            unlink(tmp_path);
+    }
+    free(tmp_path);
+    free(path);
+}
+
+// Look up the capabilities queried in this process; called with the lock held
+static opencl_device_caps_entry * opencl_device_caps_lookup(const cl_device_id device_id) {
+    opencl_device_caps_entry * entry;
+
+    for (entry = caps_entries; NULL != entry; entry = entry->next)
+        if (entry->device_id == device_id)
+            break;
+    return entry;
+}
+
+/*
+ * The lock is not held while querying the driver, so that the devices of
+ * several platforms may be queried in parallel (see opencl_platforms.c);
+ * if two threads query the same device, the first entry wins.
+ */
+const hawopencl_device_caps * opencl_device_caps(const cl_device_id device_id) {
+    opencl_device_caps_entry * entry;
+    opencl_device_caps_entry * found;
+    bool cached = false;
+    uint64_t key;
+    uint32_t i;
+
+    CAPS_LOCK();
+    entry = opencl_device_caps_lookup(device_id);
+    CAPS_UNLOCK();
+    if (NULL != entry)
+        return &entry->caps;
+
+    entry = calloc(1, sizeof(opencl_device_caps_entry));
+    if (NULL == entry)
+        FATAL_ERROR("calloc", ENOMEM);
+    entry->device_id = device_id;
+
+    // Only the properties identifying device and driver are queried every time;
+    // sub-devices differ from their parent device in the number of compute units
+    DEVICE_INFO(device_id, CL_DEVICE_PLATFORM, entry->caps.platform_id);
+    DEVICE_INFO(device_id, CL_DEVICE_MAX_COMPUTE_UNITS, entry->caps.max_compute_units);
+    opencl_device_caps_string(device_id, NULL, CL_DEVICE_NAME, entry->caps.name, sizeof(entry->caps.name));
+    opencl_device_caps_string(device_id, NULL, CL_DEVICE_VERSION,
+            entry->caps.device_version, sizeof(entry->caps.device_version));
+    opencl_device_caps_string(device_id, NULL, CL_DRIVER_VERSION,
+            entry->caps.driver_version, sizeof(entry->caps.driver_version));
+    opencl_device_caps_string(NULL, entry->caps.platform_id, CL_PLATFORM_NAME,
+            entry->caps.platform_name, sizeof(entry->caps.platform_name));
+    opencl_device_caps_string(NULL, entry->caps.platform_id, CL_PLATFORM_VERSION,
+            entry->caps.platform_version, sizeof(entry->caps.platform_version));
+    // The list of extensions may be of any length, so it is not part of the cache file
+    entry->caps.extensions = opencl_device_caps_string_alloc(device_id, NULL, CL_DEVICE_EXTENSIONS);
+    key = opencl_device_caps_key(&entry->caps);
+
+    CAPS_LOCK();
+    if (!caps_file_read)
+        opencl_device_caps_read();
+    for (i = 0; i < caps_records_num; i++)
+        if (caps_records[i].key == key) {
+            const cl_platform_id platform_id = entry->caps.platform_id;
+            char * extensions = entry->caps.extensions;
+            entry->caps = caps_records[i].caps;
+            entry->caps.platform_id = platform_id;
+            entry->caps.extensions = extensions;
+            cached = true;
+            break;
+        }
+    CAPS_UNLOCK();
+    if (!cached)
+        opencl_device_caps_query(device_id, &entry->caps);
+
+    CAPS_LOCK();
+    found = opencl_device_caps_lookup(device_id);
+    if (NULL != found) {
+        CAPS_UNLOCK();
+        free(entry->caps.extensions);
+        free(entry);
+        return &found->caps;
+    }
+    if (!cached) {
+        opencl_device_caps_record * records;
+
+        records = realloc(caps_records, (caps_records_num + 1) * sizeof(opencl_device_caps_record));
+        if (NULL == records)
+            FATAL_ERROR("realloc", ENOMEM);
+        caps_records = records;
+        memset(&caps_records[caps_records_num], 0, sizeof(opencl_device_caps_record));
+        caps_records[caps_records_num].key = key;
+        caps_records[caps_records_num].caps = entry->caps;
+        // The platform and the extensions are only valid within this process
+        caps_records[caps_records_num].caps.platform_id = NULL;
+        caps_records[caps_records_num].caps.extensions = NULL;
+        caps_records_num++;
+        opencl_device_caps_write();
+    }
+    entry->next = caps_entries;
+    caps_entries = entry;
+    CAPS_UNLOCK();
+    return &entry->caps;
+}
+
+bool opencl_device_caps_platform_types(const char * platform_name, cl_device_type * types) {
+    bool known = false;
+    uint32_t i;
+
+    *types = 0;
+    CAPS_LOCK();
+    if (!caps_file_read)
+        opencl_device_caps_read();
+    for (i = 0; i < caps_records_num; i++)
+        if (0 == strcmp(caps_records[i].caps.platform_name, platform_name)) {
+            *types |= caps_records[i].caps.type;
+            known = true;
+        }
+    CAPS_UNLOCK();
+    return known;
+}
+
+void opencl_device_caps_release(const cl_device_id device_id) {
+    opencl_device_caps_entry ** prev;
+
+    CAPS_LOCK();
+    for (prev = &caps_entries; NULL != *prev; prev = &(*prev)->next)
+        if ((*prev)->device_id == device_id) {
+            opencl_device_caps_entry * entry = *prev;
+            // Callers may hold the pointer to the capabilities, e.g. in hawopencl_device
+            *prev = entry->next;
+            entry->next = caps_released;
+            caps_released = entry;
+            break;
+        }
+    CAPS_UNLOCK();
+}
@@ -12,6 +12,11 @@
 #ifdef HAVE_STDLIB_H
 #include <stdlib.h>
 #endif
+#ifdef HAVE_REGEX_H
+#include <regex.h>
+#else
+#include <ctype.h>
+#endif
 
 #if defined(__APPLE__) && defined(__MACH__)
 #include <OpenCL/opencl.h>
@@ -29,7 +34,17 @@
 #endif
 
 #include "HAWOpenCL.h"
-
+#include "opencl_internal.h"
+
+/*
+ * Local functions
+ */
+static void opencl_get_device(cl_device_id id, cl_platform_id platform_id, hawopencl_device * device);
+static void opencl_get_platform_devices(opencl_platform * platform, const cl_device_type on_device_type,
+        cl_uint * num_all, hawopencl_device ** all);
+#if !defined(HAVE_REGEX_H)
+static bool opencl_match_nocase(const char * s, const char * pattern);
+#endif
 
 int checkDeviceExtension(const char * extensions, const char * extensionName) {
     int ret = 0;
@@ -46,108 +61,94 @@ int checkDeviceExtension(const char * extensions, const char * extensionName) {
     return ret;
 }
 
+// Fill the device from the capabilities queried once per device
+static void opencl_get_device(cl_device_id id, cl_platform_id platform_id, hawopencl_device * device) {
+    const hawopencl_device_caps * caps = opencl_device_caps(id);
+
+    device->device_id = id;
+    device->platform_id = platform_id;
+    device->gl_preferred_device = false;
+    device->device_type = caps->type;
+    device->device_name = strdup(caps->name);
+    device->extensions = strdup(caps->extensions);
+    if (NULL == device->device_name || NULL == device->extensions)
+        FATAL_ERROR("strdup", ENOMEM);
+
+    device->has_cl_khr_gl_sharing = 0 != (caps->extension_bits & (HAWOPENCL_EXT_KHR_GL_SHARING
+#if defined(__APPLE__) && defined(__MACH__)
+         | HAWOPENCL_EXT_APPLE_GL_SHARING
+#endif
+         ));
+    device->has_cl_khr_gl_event = 0 != (caps->extension_bits & HAWOPENCL_EXT_KHR_GL_EVENT);
+    device->has_cl_compiler = caps->compiler_available;
+    device->caps = caps;
+}
+
+#if !defined(HAVE_REGEX_H)
+// Without regular expressions, check whether pattern is a substring of s, ignoring case
+static bool opencl_match_nocase(const char * s, const char * pattern) {
+    for (; '\0' != *s; s++) {
+        size_t i;
+        for (i = 0; '\0' != pattern[i] &&
+             tolower((unsigned char) s[i]) == tolower((unsigned char) pattern[i]); i++)
+            ;
+        if ('\0' == pattern[i])
+            return true;
+    }
+    return '\0' == *pattern;
+}
+#endif
+
+// Append the matching devices of the discovered platform to the list
+static void opencl_get_platform_devices(opencl_platform * platform, const cl_device_type on_device_type,
+        cl_uint * num_all, hawopencl_device ** all) {
+    cl_uint j;
+
+    for (j = 0; j < platform->num_devices; j++) {
+        const cl_device_id id = platform->devices[j];
+        const cl_device_type type = opencl_device_caps(id)->type;
+        // CL_DEVICE_TYPE_DEFAULT is the first device of the platform
+        if (0 == (type & on_device_type) &&
+            !((on_device_type & CL_DEVICE_TYPE_DEFAULT) && 0 == j))
+            continue;
+        *all = (hawopencl_device*)realloc(*all, (*num_all + 1) * sizeof(hawopencl_device));
+        if (*all == NULL)
+            FATAL_ERROR("realloc", ENOMEM);
+        opencl_get_device(id, platform->platform_id, &(*all)[*num_all]);
+        (*num_all)++;
+    }
+}
+
 int opencl_get_devices(const cl_device_type on_device_type,
         cl_uint * num_devices, hawopencl_device ** devices) {
     assert (num_devices != NULL);
     unsigned int i;
-    unsigned int j;
-    cl_int err;
-    cl_platform_id * cl_platform;
-    cl_device_id * cl_devices;
+    opencl_platform * platforms;
     cl_uint num_platform;
-
-    // Get all the Platforms first!
-    err = clGetPlatformIDs(0, NULL, &num_platform);
-    if (CL_SUCCESS != err)
-        FATAL_ERROR("clGetPlatformIDs", err);
-    if (num_platform == 0)
-        FATAL_ERROR("No OpenCL Platform detected.", ENODEV);
-    if (num_platform > 1)
-        fprintf(stderr, "ATTENTION: opencl_get_devices() detected %d OpenCL Platforms. Will select 1st matching\n", num_platform);
-
-    cl_platform = (cl_platform_id*) malloc(sizeof(cl_platform_id) * num_platform);
-    if (NULL == cl_platform)
-        FATAL_ERROR("malloc", ENOMEM);
-    err = clGetPlatformIDs(num_platform, cl_platform, &num_platform);
-    if (CL_SUCCESS != err)
-        FATAL_ERROR("clGetPlatformIDs", err);
+    cl_uint num_all = 0;
+    hawopencl_device * all = NULL;
+
+    /*
+     * The platforms are discovered in parallel once per process; wait only for
+     * those, which may have devices of the requested type, so that e.g. a
+     * request for the CPU need not wait for the initialization of a GPU driver.
+     */
+    num_platform = opencl_platforms(&platforms);
+    // Collect the matching devices of all platforms into one list
     for (i = 0; i < num_platform; i++) {
-        cl_uint num;
-        err = clGetDeviceIDs(cl_platform[i], on_device_type, 0, NULL, &num);
-        // Only error out, if there's an error and it's not CL_DEVICE_NOT_FOUND
-        if (CL_SUCCESS != err && CL_DEVICE_NOT_FOUND != err)
-            FATAL_ERROR("clGetDeviceIDs", err);
-        // Continue the loop of platforms, if there are no matching devices
-        if (CL_DEVICE_NOT_FOUND == err || num <= 0) {
-            // printf ("CONTINUE Platform i:%d does not offer on_device_type:%d err:%d num:%u\n",
-            //        i, on_device_type, err, num));
+        if (!opencl_platform_may_have(&platforms[i], on_device_type))
             continue;
-        }
-        *num_devices = num;
-        *devices = (hawopencl_device*)malloc(num * sizeof(hawopencl_device));
-        if (*devices == NULL)
-            FATAL_ERROR("malloc", ENOMEM);
-        cl_devices = (cl_device_id*)malloc(num * sizeof(cl_device_id));
-        if (cl_devices == NULL)
-            FATAL_ERROR("malloc", ENOMEM);
-        err = clGetDeviceIDs(cl_platform[i], on_device_type, num, cl_devices, NULL);
-        if (CL_SUCCESS != err)
-            FATAL_ERROR("clGetDeviceIDs", err);
-        for (j = 0; j < num; j++) {
-            size_t len;
-            char * extensions;
-            cl_device_id id = cl_devices[j];
-            cl_device_type type;
-            cl_bool value;
-
-            err = clGetDeviceInfo(id, CL_DEVICE_NAME, 0, NULL, &len);
-            if (CL_SUCCESS != err)
-                FATAL_ERROR("clGetDeviceInfo", err);
-
-            err = clGetDeviceInfo(id, CL_DEVICE_TYPE, sizeof(cl_device_type), &type, NULL);
-            if (CL_SUCCESS != err)
-                FATAL_ERROR("clGetDeviceInfo", err);
-
-            (*devices)[j].device_id = id;
-            (*devices)[j].device_type = type;
-            (*devices)[j].device_name = (char*)malloc(len * sizeof(char));
-
-            err = clGetDeviceInfo(id, CL_DEVICE_NAME,
-                    len, (*devices)[j].device_name, NULL);
-            if (CL_SUCCESS != err)
-                FATAL_ERROR("clGetDeviceInfo", err);
-
-            err = clGetDeviceInfo(id, CL_DEVICE_EXTENSIONS, 0, NULL, &len);
-            if (CL_SUCCESS != err)
-                FATAL_ERROR("clGetDeviceInfo", err);
-            extensions = malloc(sizeof(char) * len);
-            if (NULL == extensions)
-                FATAL_ERROR("malloc", ENOMEM);
-            err = clGetDeviceInfo(id, CL_DEVICE_EXTENSIONS, len, extensions, NULL);
-            if (CL_SUCCESS != err)
-                FATAL_ERROR("clGetDeviceInfo", err);
-
-            if (checkDeviceExtension(extensions, "cl_khr_gl_sharing")
-#if defined(__APPLE__) && defined(__MACH__)
-                 || checkDeviceExtension(extensions, "cl_APPLE_gl_sharing")
-#endif
-                 ) {
-                (*devices)[j].has_cl_khr_gl_sharing = true;
-            } else {
-                (*devices)[j].has_cl_khr_gl_sharing = false;
-            }
-            (*devices)[j].has_cl_khr_gl_event = checkDeviceExtension(extensions, "cl_khr_gl_event");
-            err = clGetDeviceInfo(id, CL_DEVICE_COMPILER_AVAILABLE, sizeof(cl_bool), &value, NULL);
-            if (CL_SUCCESS != err)
-                FATAL_ERROR("clGetDeviceInfo", err);
-            (*devices)[j].has_cl_compiler = value;
-            (*devices)[j].extensions = extensions;
-        }
-        free (cl_devices);
-        // SUCCESS, WE FOUND AT LEAST ONE DEVICE FOR THIS PLATFORM
-        break;
+        opencl_platform_wait(&platforms[i]);
+        opencl_get_platform_devices(&platforms[i], on_device_type, &num_all, &all);
     }
-    if (i == num_platform) {
+    // The types known from previous runs may be outdated, e.g. after a driver update;
+    // the platforms waited for above offer no matching device, so scanning them again adds none
+    if (0 == num_all)
+        for (i = 0; i < num_platform; i++) {
+            opencl_platform_wait(&platforms[i]);
+            opencl_get_platform_devices(&platforms[i], on_device_type, &num_all, &all);
+        }
+    if (0 == num_all) {
         char * tmp;
         char cl_device_type_name[512];
         // The device type may be either CUSTOM or a combination...
@@ -168,6 +169,82 @@ int opencl_get_devices(const cl_device_type on_device_type,
                 cl_device_type_name);
         exit (-1);
     }
-    free (cl_platform);
+    *num_devices = num_all;
+    *devices = all;
+    return CL_SUCCESS;
+}
+
+int opencl_select_device(cl_uint num_devices,
+        const hawopencl_device * devices,
+        hawopencl_select_policy policy,
+        const char * pattern,
+        cl_uint * index) {
+    bool found = false;
+    cl_uint best = 0;
+    cl_uint i;
+#if defined(HAVE_REGEX_H)
+    regex_t regex;
+#endif
+
+    if (HAWOPENCL_SELECT_NAME == policy || HAWOPENCL_SELECT_VENDOR == policy) {
+        if (NULL == pattern)
+            return CL_INVALID_VALUE;
+#if defined(HAVE_REGEX_H)
+        if (0 != regcomp(&regex, pattern, REG_EXTENDED | REG_ICASE | REG_NOSUB)) {
+            fprintf(stderr, "ERROR in %s(): Invalid regular expression %s\n", __func__, pattern);
+            return CL_INVALID_VALUE;
+        }
+#endif
+    }
+
+    for (i = 0; i < num_devices; i++) {
+        const hawopencl_device * d = &devices[i];
+        switch (policy) {
+            case HAWOPENCL_SELECT_NAME:
+            case HAWOPENCL_SELECT_VENDOR: {
+                const char * s = (HAWOPENCL_SELECT_NAME == policy) ? d->device_name : d->caps->vendor;
+#if defined(HAVE_REGEX_H)
+                if (0 != regexec(&regex, s, 0, NULL, 0))
+                    continue;
+#else
+                if (!opencl_match_nocase(s, pattern))
+                    continue;
+#endif
+            }
+            // Among the matching devices select the fastest
+            /* fall through */
+            case HAWOPENCL_SELECT_FASTEST:
+                if (!found || d->caps->score > devices[best].caps->score)
+                    best = i;
+                break;
+            case HAWOPENCL_SELECT_MEMORY:
+                if (!found || d->caps->global_mem_size > devices[best].caps->global_mem_size ||
+                    (d->caps->global_mem_size == devices[best].caps->global_mem_size &&
+                     d->caps->score > devices[best].caps->score))
+                    best = i;
+                break;
+            default:
+                return CL_INVALID_VALUE;
+        }
+        found = true;
+    }
+#if defined(HAVE_REGEX_H)
+    if (HAWOPENCL_SELECT_NAME == policy || HAWOPENCL_SELECT_VENDOR == policy)
+        regfree(&regex);
+#endif
+    if (!found)
+        return CL_DEVICE_NOT_FOUND;
+    *index = best;
+    return CL_SUCCESS;
+}
+
+int opencl_free_devices(cl_uint num_devices, hawopencl_device * devices) {
+    cl_uint i;
+
+    for (i = 0; i < num_devices; i++) {
+        free(devices[i].device_name);
+        free(devices[i].extensions);
+    }
+    free(devices);
     return CL_SUCCESS;
 }
@@ -0,0 +1,32 @@
+//
+//  opencl_hash.c : Part of libHAWOpenCL
+//
+//  The hash function shared by the caches and lookup tables of the library.
+//
+//  Copyright (c) 2018-2022 Rainer Keller, HS Esslingen. All rights reserved.
+//
+#include "HAWOpenCL_config.h"
+
+#include <stdio.h>
+#include <stdint.h>
+
+#if defined(__APPLE__) && defined(__MACH__)
+#include <OpenCL/opencl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include "HAWOpenCL.h"
+#include "opencl_internal.h"
+
+#define FNV_PRIME  UINT64_C(0x100000001b3)
+
+uint64_t opencl_hash_fnv1a(uint64_t hash, const void * data, size_t len) {
+    const unsigned char * p = (const unsigned char *) data;
+    size_t i;
+    for (i = 0; i < len; i++) {
+        hash ^= p[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
@@ -0,0 +1,98 @@
+//
+//  opencl_host_buffer.c : Part of libHAWOpenCL
+//
+//  Buffers using aligned host memory in place, so that CPU and integrated
+//  devices neither copy the data to the device nor back upon mapping.
+//
+//  Copyright (c) 2018-2022 Rainer Keller, HS Esslingen. All rights reserved.
+//
+#include "HAWOpenCL_config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+
+#if defined(__APPLE__) && defined(__MACH__)
+#include <OpenCL/opencl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include "HAWOpenCL.h"
+#include "opencl_internal.h"
+
+/*
+ * Local functions
+ */
+static void CL_CALLBACK opencl_host_buffer_free(cl_mem buffer, void * host);
+
+// Called by the driver, once the buffer is destroyed, i.e. no command uses the host memory anymore
+static void CL_CALLBACK opencl_host_buffer_free(cl_mem buffer __HAW_OPENCL_ATTR_UNUSED__, void * host) {
+    free(host);
+}
+
+int opencl_host_buffer_create(const cl_device_id device_id,
+        const cl_context context,
+        cl_mem_flags flags,
+        size_t size,
+        hawopencl_host_buffer * buffer) {
+    const hawopencl_device_caps * caps = opencl_device_caps(device_id);
+    size_t alignment = caps->mem_base_addr_align / 8;
+    size_t padded;
+    int err;
+
+    if (0 != (flags & (CL_MEM_USE_HOST_PTR | CL_MEM_ALLOC_HOST_PTR | CL_MEM_COPY_HOST_PTR)))
+        return CL_INVALID_VALUE;
+    if (0 == size)
+        return CL_INVALID_BUFFER_SIZE;
+
+    // Whole cachelines avoid false sharing with other data on the host
+    if (alignment < caps->global_mem_cacheline_size)
+        alignment = caps->global_mem_cacheline_size;
+    if (alignment < sizeof(void *))
+        alignment = sizeof(void *);
+    padded = (size + alignment - 1) / alignment * alignment;
+
+    memset(buffer, 0, sizeof(hawopencl_host_buffer));
+    err = posix_memalign(&buffer->host, alignment, padded);
+    if (0 != err)
+        FATAL_ERROR("posix_memalign", err);
+    buffer->size = size;
+    buffer->alignment = alignment;
+    buffer->buffer = clCreateBuffer(context, flags | CL_MEM_USE_HOST_PTR, size, buffer->host, &err);
+    if (NULL == buffer->buffer || CL_SUCCESS != err)
+        FATAL_ERROR("clCreateBuffer", err);
+    OPENCL_CHECK(clSetMemObjectDestructorCallback, (buffer->buffer, opencl_host_buffer_free, buffer->host));
+    return CL_SUCCESS;
+}
+
+void * opencl_host_buffer_map(const cl_command_queue command_queue,
+        hawopencl_host_buffer * buffer,
+        cl_map_flags flags) {
+    void * ptr;
+    int err;
+
+    ptr = clEnqueueMapBuffer(command_queue, buffer->buffer, CL_TRUE, flags,
+            0, buffer->size, 0, NULL, NULL, &err);
+    if (NULL == ptr || CL_SUCCESS != err)
+        FATAL_ERROR("clEnqueueMapBuffer", err);
+    buffer->zero_copy = (ptr == buffer->host);
+    return ptr;
+}
+
+int opencl_host_buffer_unmap(const cl_command_queue command_queue,
+        hawopencl_host_buffer * buffer,
+        void * ptr) {
+    return clEnqueueUnmapMemObject(command_queue, buffer->buffer, ptr, 0, NULL, NULL);
+}
+
+int opencl_host_buffer_release(hawopencl_host_buffer * buffer) {
+    // The host memory is freed by the destructor callback after the commands using it
+    OPENCL_CHECK(clReleaseMemObject, (buffer->buffer));
+    memset(buffer, 0, sizeof(hawopencl_host_buffer));
+    return CL_SUCCESS;
+}
@@ -32,174 +32,66 @@
 #endif
 
 #include "HAWOpenCL.h"
+#include "opencl_internal.h"
 
 int opencl_init(const cl_device_type on_device_type,
         cl_device_id preferred_device_id,
         cl_device_id * device_id,
         cl_context * context,
         cl_command_queue * command_queue) {
-    unsigned int platform;
+    return opencl_init_with_queue_config(on_device_type, preferred_device_id, NULL,
+            device_id, context, command_queue);
+}
+
+int opencl_init_with_queue_config(const cl_device_type on_device_type,
+        cl_device_id preferred_device_id,
+        const hawopencl_queue_config * config,
+        cl_device_id * device_id,
+        cl_context * context,
+        cl_command_queue * command_queue) {
     int err;
-    cl_uint num_platform;
-    cl_uint num_device;
-    cl_platform_id * cl_platform;
+    cl_platform_id platform_id;
     cl_context_properties cl_properties[7] = {0,};
 
-    // Get all the Platforms first!
-    err = clGetPlatformIDs(0, NULL, &num_platform);
-    if (CL_SUCCESS != err)
-        FATAL_ERROR("clGetPlatformIDs", err);
-
-    if (num_platform == 0)
-        FATAL_ERROR("No OpenCL Platform detected.", ENODEV);
-    if (num_platform > 1)
-        fprintf(stderr, "ATTENTION: opencl_init() detected %d OpenCL Platforms. Will select 1st matching\n", num_platform);
-
-    cl_platform = (cl_platform_id*) malloc(sizeof (cl_platform_id) * num_platform);
-    if (NULL == cl_platform)
-        FATAL_ERROR("malloc", ENOMEM);
-
-    cl_uint actual_platform;
-    err = clGetPlatformIDs(num_platform, cl_platform, &actual_platform);
-    if (CL_SUCCESS != err)
-        FATAL_ERROR("clGetPlatformIDs", err);
-    assert (actual_platform == num_platform);
-
-    static char * cl_platform_name = NULL;
-    static size_t cl_platform_name_len = 0;
-
-    for (platform = 0; platform < num_platform; platform++) {
-        // First get the numbers of devices for this specific type on this platform
-        err = clGetDeviceIDs(cl_platform[platform], on_device_type, 0, NULL, &num_device);
-        // Only error out, if there's an error and it's not CL_DEVICE_NOT_FOUND
-        if (CL_SUCCESS != err && CL_DEVICE_NOT_FOUND != err)
-            FATAL_ERROR("clGetDeviceIDs", err);
-        // First print do some error printing (if any)
-        if (CL_DEVICE_NOT_FOUND == err) {
-            size_t len;
-            char * tmp;
-            char cl_device_type_name[512];
-            
-            err = clGetPlatformInfo(cl_platform[platform], CL_PLATFORM_NAME,
-                    0, NULL, &len);
-            if (CL_SUCCESS != err)
-                FATAL_ERROR("clGetPlatformInfo", err);
-            if (NULL == cl_platform_name) {
-                cl_platform_name = malloc(len);
-                if (NULL == cl_platform_name)
-                    FATAL_ERROR("malloc", ENOMEM);
-                cl_platform_name_len = len;
-            } else if (len > cl_platform_name_len) {
-                cl_platform_name = realloc(cl_platform_name, len);
-                if (NULL == cl_platform_name)
-                    FATAL_ERROR("realloc", ENOMEM);
-                cl_platform_name_len = len;
-            }
-            err = clGetPlatformInfo(cl_platform[platform], CL_PLATFORM_NAME,
-                    len, cl_platform_name, &len);
-            if (CL_SUCCESS != err)
-                FATAL_ERROR("clGetPlatformInfo", err);
-
-            // The device type may be either CUSTOM or a combination...
-            if (on_device_type & CL_DEVICE_TYPE_CUSTOM)
-                sprintf(cl_device_type_name, "CL_DEVICE_TYPE_CUSTOM");
-            else {
-                tmp = cl_device_type_name;
-                if (on_device_type & CL_DEVICE_TYPE_CPU)
-                    tmp += sprintf(tmp, "CL_DEVICE_TYPE_CPU ");
-                if (on_device_type & CL_DEVICE_TYPE_GPU)
-                    tmp += sprintf(tmp, "CL_DEVICE_TYPE_GPU ");
-                if (on_device_type & CL_DEVICE_TYPE_ACCELERATOR)
-                    tmp += sprintf(tmp, "CL_DEVICE_TYPE_ACCELERATOR ");
-                if (on_device_type & CL_DEVICE_TYPE_DEFAULT)
-                    tmp += sprintf(tmp, "CL_DEVICE_TYPE_DEFAULT ");
-            }
-
-            fprintf(stderr, "INFO: Platform %s does not offer device of type %s\n",
-                    cl_platform_name, cl_device_type_name);
-            continue;
-        }
-        // Warn the user, there's more than one fitting device
-        if (num_device > 1) {
-#if defined (HAWOPENCL_WANT_OPENGL)
-            const unsigned char * renderer = (unsigned char*) "(none)";
-#if defined(__APPLE__) && defined(__MACH__)
-            if (NULL != CGLGetCurrentContext())
-                renderer = glGetString(GL_RENDERER);
-#elif defined(__linux__)
-            if (NULL != glXGetCurrentContext())
-                renderer = glGetString(GL_RENDERER);
-#elif defined(_WIN32) || defined(_WIN64)
-            if (NULL != wglGetCurrentContext())
-                renderer = glGetString(GL_RENDERER);
-#endif
-#endif /* HAWOPENCL_WANT_OPENGL */
+    // Without a preferred device, select the fastest matching device of all platforms
+    if (preferred_device_id == 0) {
+        cl_uint num_devices;
+        hawopencl_device * devices;
+        cl_uint index;
 
-            // The warning is more elaborate if we want OpenGL and have more devices.
+        opencl_get_devices(on_device_type, &num_devices, &devices);
+        opencl_select_device(num_devices, devices, HAWOPENCL_SELECT_FASTEST, NULL, &index);
+        if (num_devices > 1)
             fprintf(stderr, "ATTENTION: opencl_init() detected %d OpenCL devices. "
 #if defined (HAWOPENCL_WANT_OPENGL)
-                    "Will try to select OpenCL device matching OpenGL %s.\n"
+                    "Will try to select OpenCL device matching OpenGL, otherwise the fastest: %s.\n"
 #else
-                    "Will try to select %s OpenCL device.\n"
+                    "Will select the fastest: %s.\n"
 #endif
-                    , num_device
-#if defined (HAWOPENCL_WANT_OPENGL)
-                    , renderer
-#else
-                    , ((preferred_device_id == 0) ? "1." : "preferred")
-#endif                                  
-                    );
+                    , num_devices, devices[index].device_name);
+        preferred_device_id = devices[index].device_id;
+        platform_id = devices[index].platform_id;
+        opencl_free_devices(num_devices, devices);
+    } else {
+        const hawopencl_device_caps * caps = opencl_device_caps(preferred_device_id);
+
+        if (0 == (caps->type & on_device_type)) {
+            fprintf(stderr, "ERROR in %s(): The preferred device:%lu is no OpenCL device of the requested type.\n",
+                    __func__, (long unsigned int)preferred_device_id);
+            FATAL_ERROR("opencl_init", ENODEV);
         }
-        if (num_device >= 1)
-            break;
-    }
-    // Free the cl_platform_name again, if it was allocated
-    if (NULL != cl_platform_name) {
-        free (cl_platform_name);
-        cl_platform_name = NULL;
-        cl_platform_name_len = 0;
+        platform_id = caps->platform_id;
     }
-    // By NOW, we should have at least one fitting device within this platform
-    if (platform == num_platform) {
-        fprintf(stderr, "ERROR in %s(): Have checked all %d OpenCL platforms, but no matching devices found.\n",
-                __func__, num_platform);
-        FATAL_ERROR("opencl_init", ENODEV);
-    }
-    assert(num_device >= 1);
 
     // Now run the code to initialize the OS-dependent OpenCL<->OpenGL interaction
 #if !defined(HAWOPENCL_WANT_OPENGL)
-    // If no device ID is preferred, select the first one, otherwise check for the available
-    if (preferred_device_id == 0) {
-        err = clGetDeviceIDs(cl_platform[platform], on_device_type, 1, device_id, NULL);
-        if (CL_SUCCESS != err)
-            FATAL_ERROR("clGetDeviceIDs", err);
-    } else {
-        int i;
-	cl_device_id * all_device_ids = malloc(sizeof(cl_device_id) * num_device);
-        if (NULL == all_device_ids)
-            FATAL_ERROR("malloc", ENOMEM);
-        err = clGetDeviceIDs(cl_platform[platform], on_device_type, num_device, all_device_ids, NULL);
-        if (CL_SUCCESS != err)
-            FATAL_ERROR("clGetDeviceIDs", err);
-        for (i = 0; i < num_device; i++) {
-            if (preferred_device_id == all_device_ids[i])
-                break;
-        }
-        if (i == num_device) {
-            fprintf(stderr, "ERROR in %s(): Have checked all %d OpenCL devices, but none matched the preferred device:%lu.\n",
-                    __func__, num_device, (long unsigned int)preferred_device_id);
-            FATAL_ERROR("opencl_init", ENODEV);
-        }
-        free (all_device_ids);
-        *device_id = preferred_device_id;
-    }
+    *device_id = preferred_device_id;
     // Create a context with this one device; for apple enable logging to stdout.
 #if defined(__APPLE__) && defined(__MACH__)
     *context = clCreateContext(NULL, 1, device_id, clLogMessagesToStdoutAPPLE, NULL, &err);
 #else
     cl_properties[0]=CL_CONTEXT_PLATFORM;
-    cl_properties[1]=(long int) cl_platform[platform];
+    cl_properties[1]=(long int) platform_id;
     cl_properties[2]=0;
     *context = clCreateContext(cl_properties, 1, device_id, NULL, NULL, &err);
 #endif
@@ -242,9 +134,7 @@ int opencl_init(const cl_device_type on_device_type,
         if (CL_SUCCESS != err)
             FATAL_ERROR("clGetGLContextInfoAPPLE", err);
     } else {
-        err = clGetDeviceIDs(cl_platform[platform], on_device_type, 1, device_id, NULL);
-        if (CL_SUCCESS != err)
-            FATAL_ERROR("clGetDeviceIDs", err);
+        *device_id = preferred_device_id;
         *context = clCreateContext(NULL, 1, device_id, clLogMessagesToStdoutAPPLE, NULL, &err);
         if (NULL == *context || CL_SUCCESS != err)
             FATAL_ERROR("clCreateContext", err);
@@ -260,12 +150,12 @@ int opencl_init(const cl_device_type on_device_type,
         cl_properties[2] = CL_GLX_DISPLAY_KHR;
         cl_properties[3] = (cl_context_properties) glXGetCurrentDisplay();
         cl_properties[4] = CL_CONTEXT_PLATFORM;
-        cl_properties[5] = (cl_context_properties) cl_platform[platform];
+        cl_properties[5] = (cl_context_properties) platform_id;
         cl_properties[6] = 0;
 
         /* For Linux we are dependent on the Khronos extension to get the OpenGL context info */
 #if defined (CL_VERSION_1_2)
-        clGetGLContextInfoKHR_fn func = (clGetGLContextInfoKHR_fn) clGetExtensionFunctionAddressForPlatform(cl_platform[platform], "clGetGLContextInfoKHR");
+        clGetGLContextInfoKHR_fn func = (clGetGLContextInfoKHR_fn) clGetExtensionFunctionAddressForPlatform(platform_id, "clGetGLContextInfoKHR");
 #else
         clGetGLContextInfoKHR_fn func = (clGetGLContextInfoKHR_fn) clGetExtensionFunctionAddress("clGetGLContextInfoKHR");
 #endif /* CL_VERSION_1_2 */
@@ -276,15 +166,9 @@ int opencl_init(const cl_device_type on_device_type,
 
         func(cl_properties, CL_CURRENT_DEVICE_FOR_GL_CONTEXT_KHR, sizeof (cl_device_id), device_id, NULL);
     }
-    if (preferred_device_id == 0) {
-        err = clGetDeviceIDs(cl_platform[platform], on_device_type, 1, &preferred_device_id, NULL);
-        if (CL_SUCCESS != err)
-            FATAL_ERROR("clGetDeviceIDs", err);
-    }
-
     // Create a context with this one device
     cl_properties[0]=CL_CONTEXT_PLATFORM;
-    cl_properties[1]=(long int) cl_platform[platform];
+    cl_properties[1]=(long int) platform_id;
     cl_properties[2]=0;
 
     *context = clCreateContext(cl_properties, 1, &preferred_device_id, NULL, NULL, &err);
@@ -299,10 +183,10 @@ int opencl_init(const cl_device_type on_device_type,
     cl_properties[2] = CL_WGL_HDC_KHR;
     cl_properties[3] = (cl_context_properties) wglGetCurrentDC();
     cl_properties[4] = CL_CONTEXT_PLATFORM;
-    cl_properties[5] = (cl_context_properties) cl_platform;
+    cl_properties[5] = (cl_context_properties) platform_id;
     cl_properties[6] = 0;
 #if defined (CL_VERSION_1_2)
-    clGetGLContextInfoKHR_fn func = clGetExtensionFunctionAddressForPlatform(cl_platform, "clGetGLContextInfoKHR");
+    clGetGLContextInfoKHR_fn func = clGetExtensionFunctionAddressForPlatform(platform_id, "clGetGLContextInfoKHR");
 #else
     clGetGLContextInfoKHR_fn func = clGetExtensionFunctionAddress("clGetGLContextInfoKHR");
 #endif /* CL_VERSION_1_2 */
@@ -317,41 +201,8 @@ int opencl_init(const cl_device_type on_device_type,
 
 #endif /* HAWOPENCL_WANT_OPENGL */
 
-    // Create a command queue to issue commands to this device;
-    // Might want to check, if CL_QUEUE_PROFILING_ENABLE is reducing performance...
-    // This property is mandatory, anyhow!
-    cl_command_queue_properties properties = CL_QUEUE_PROFILING_ENABLE;
-#if defined(CL_VERSION_2_0)
-    char * platform_extensions;
-    size_t len;
-    err = clGetPlatformInfo(cl_platform[platform], CL_PLATFORM_EXTENSIONS,
-                            0, NULL, &len);
-    if (CL_SUCCESS != err)
-        FATAL_ERROR("clGetPlatformInfo", err);
-    platform_extensions = (char*) malloc(len);
-    if (NULL == platform_extensions)
-        FATAL_ERROR("malloc", ENOMEM);    
-    err = clGetPlatformInfo(cl_platform[platform], CL_PLATFORM_EXTENSIONS,
-                            len, platform_extensions, NULL);
-    if (CL_SUCCESS != err)
-        FATAL_ERROR("clGetPlatformInfo", err);
-    // Don't trust anyone, let's set the last character to NUL character.
-    platform_extensions[len-1] = '\0';
-
-    // Let's call the (deprecated) function, if we're on OpenCL < 2.0
-    if (NULL == strstr(platform_extensions, "cl_khr_create_command_queue")) {
-        *command_queue = clCreateCommandQueue(*context, *device_id, properties, &err);
-    } else {
-        cl_queue_properties  qp[] = {CL_QUEUE_PROPERTIES, properties, 0};
-        *command_queue = clCreateCommandQueueWithProperties(*context, *device_id, qp, &err);
-    }
-#else
-    *command_queue = clCreateCommandQueue(*context, *device_id, properties, &err);
-#endif
-    if (!*command_queue || err != CL_SUCCESS)
-        FATAL_ERROR("clCreateCommandQueue*", err);
-
-    free(cl_platform);
+    // Create a command queue to issue commands to this device
+    opencl_command_queue_create(*device_id, *context, config, command_queue);
 
     return CL_SUCCESS;
 }
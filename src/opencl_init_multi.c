@@ -0,0 +1,153 @@
+//
+//  opencl_init_multi.c : Part of libHAWOpenCL
+//
+//  One context shared by several devices, each with several command queues.
+//
+//  Copyright (c) 2018-2022 Rainer Keller, HS Esslingen. All rights reserved.
+//
+#include "HAWOpenCL_config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+
+#if defined(__APPLE__) && defined(__MACH__)
+#include <OpenCL/opencl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include "HAWOpenCL.h"
+#include "opencl_internal.h"
+
+/*
+ * Local functions
+ */
+static cl_uint opencl_init_multi_select(const cl_device_type on_device_type,
+        cl_uint num_devices, cl_device_id ** device_ids);
+
+// Select the devices on the platform of the fastest device of on_device_type
+static cl_uint opencl_init_multi_select(const cl_device_type on_device_type,
+        cl_uint num_devices, cl_device_id ** device_ids) {
+    hawopencl_device * devices;
+    cl_uint num_all;
+    cl_uint fastest;
+    cl_uint num = 0;
+    cl_uint i;
+
+    opencl_get_devices(on_device_type, &num_all, &devices);
+    opencl_select_device(num_all, devices, HAWOPENCL_SELECT_FASTEST, NULL, &fastest);
+    *device_ids = malloc(num_all * sizeof(cl_device_id));
+    if (NULL == *device_ids)
+        FATAL_ERROR("malloc", ENOMEM);
+    for (i = 0; i < num_all && (0 == num_devices || num < num_devices); i++)
+        if (devices[i].platform_id == devices[fastest].platform_id)
+            (*device_ids)[num++] = devices[i].device_id;
+    opencl_free_devices(num_all, devices);
+    return num;
+}
+
+int opencl_init_multi(const cl_device_type on_device_type,
+        cl_uint num_devices,
+        const cl_device_id * device_ids,
+        cl_uint queues_per_device,
+        const hawopencl_queue_config * config,
+        hawopencl_runtime ** runtime) {
+    cl_context_properties cl_properties[3];
+    hawopencl_runtime * r;
+    cl_uint d;
+    cl_uint q;
+    int err;
+
+    if (0 == queues_per_device || (NULL != device_ids && 0 == num_devices))
+        return CL_INVALID_VALUE;
+
+    r = calloc(1, sizeof(hawopencl_runtime));
+    if (NULL == r)
+        FATAL_ERROR("calloc", ENOMEM);
+    if (NULL == device_ids) {
+        r->num_devices = opencl_init_multi_select(on_device_type, num_devices, &r->device_ids);
+    } else {
+        r->num_devices = num_devices;
+        r->device_ids = malloc(num_devices * sizeof(cl_device_id));
+        if (NULL == r->device_ids)
+            FATAL_ERROR("malloc", ENOMEM);
+        memcpy(r->device_ids, device_ids, num_devices * sizeof(cl_device_id));
+    }
+
+    // A context may only contain devices of one platform
+    r->platform_id = opencl_device_caps(r->device_ids[0])->platform_id;
+    for (d = 0; d < r->num_devices; d++) {
+        const hawopencl_device_caps * caps = opencl_device_caps(r->device_ids[d]);
+        if (caps->platform_id != r->platform_id || 0 == (caps->type & on_device_type)) {
+            fprintf(stderr, "ERROR in %s(): The device %s is not of the requested type or of another platform than %s.\n",
+                    __func__, caps->name, opencl_device_caps(r->device_ids[0])->platform_name);
+            free(r->device_ids);
+            free(r);
+            return CL_INVALID_DEVICE;
+        }
+    }
+
+#if defined(__APPLE__) && defined(__MACH__)
+    r->context = clCreateContext(NULL, r->num_devices, r->device_ids, clLogMessagesToStdoutAPPLE, NULL, &err);
+#else
+    cl_properties[0] = CL_CONTEXT_PLATFORM;
+    cl_properties[1] = (cl_context_properties) r->platform_id;
+    cl_properties[2] = 0;
+    r->context = clCreateContext(cl_properties, r->num_devices, r->device_ids, NULL, NULL, &err);
+#endif
+    if (NULL == r->context || CL_SUCCESS != err)
+        FATAL_ERROR("clCreateContext", err);
+
+    r->numa_nodes = malloc(r->num_devices * sizeof(int));
+    if (NULL == r->numa_nodes)
+        FATAL_ERROR("malloc", ENOMEM);
+    for (d = 0; d < r->num_devices; d++)
+        r->numa_nodes[d] = -1;
+
+    r->queues_per_device = queues_per_device;
+    r->command_queues = malloc(r->num_devices * queues_per_device * sizeof(cl_command_queue));
+    if (NULL == r->command_queues)
+        FATAL_ERROR("malloc", ENOMEM);
+    for (d = 0; d < r->num_devices; d++)
+        for (q = 0; q < queues_per_device; q++)
+            opencl_command_queue_create(r->device_ids[d], r->context, config,
+                    &r->command_queues[d * queues_per_device + q]);
+
+    r->state = opencl_runtime_state_create();
+    *runtime = r;
+    return CL_SUCCESS;
+}
+
+cl_command_queue opencl_runtime_queue(const hawopencl_runtime * runtime,
+        cl_uint device,
+        cl_uint queue) {
+    if (device >= runtime->num_devices || queue >= runtime->queues_per_device)
+        return NULL;
+    return runtime->command_queues[device * runtime->queues_per_device + queue];
+}
+
+int opencl_runtime_release(hawopencl_runtime * runtime) {
+    cl_uint i;
+
+    opencl_runtime_state_free(runtime->state);
+    for (i = 0; i < runtime->num_devices * runtime->queues_per_device; i++)
+        OPENCL_CHECK(clReleaseCommandQueue, (runtime->command_queues[i]));
+    OPENCL_CHECK(clReleaseContext, (runtime->context));
+#if defined(CL_VERSION_1_2)
+    if (NULL != runtime->parent_device_id)
+        for (i = 0; i < runtime->num_devices; i++) {
+            opencl_device_caps_release(runtime->device_ids[i]);
+            OPENCL_CHECK(clReleaseDevice, (runtime->device_ids[i]));
+        }
+#endif
+    free(runtime->command_queues);
+    free(runtime->numa_nodes);
+    free(runtime->device_ids);
+    free(runtime);
+    return CL_SUCCESS;
+}
@@ -0,0 +1,241 @@
+//
+//  opencl_init_partitioned.c : Part of libHAWOpenCL
+//
+//  Partitioning of a device into sub-devices, e.g. one per NUMA node,
+//  and allocation of host memory on the sub-device's node.
+//
+//  Copyright (c) 2018-2022 Rainer Keller, HS Esslingen. All rights reserved.
+//
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+// For sched_setaffinity()
+#  define _GNU_SOURCE
+#endif
+#include "HAWOpenCL_config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+#ifdef HAVE_SCHED_H
+#include <sched.h>
+#endif
+
+#if defined(__APPLE__) && defined(__MACH__)
+#include <OpenCL/opencl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include "HAWOpenCL.h"
+#include "opencl_internal.h"
+
+#define NODE_DIR   "/sys/devices/system/node"
+#define MAX_NODES  1024
+
+#if defined(__linux__) && defined(HAVE_PTHREAD_H) && defined(HAVE_SCHED_H) && defined(CPU_SET)
+#  define HAWOPENCL_HAVE_NUMA_PLACEMENT 1
+#endif
+
+#if defined(HAWOPENCL_HAVE_NUMA_PLACEMENT)
+// The memory to touch by a thread running on the CPUs of a node
+typedef struct {
+    char * ptr;
+    size_t size;
+    int node;
+} opencl_first_touch;
+#endif
+
+/*
+ * Local functions
+ */
+static int opencl_parse_list(const char * path, int * values, int max_values);
+#if defined(HAWOPENCL_HAVE_NUMA_PLACEMENT)
+static void * opencl_first_touch_thread(void * arg);
+#endif
+
+// Parse a list like "0-3,8,10-11" as used in sysfs into values; returns the number of values
+static int opencl_parse_list(const char * path, int * values, int max_values) {
+    char buffer[4096];
+    char * p = buffer;
+    FILE * file;
+    int num = 0;
+
+    file = fopen(path, "r");
+    if (NULL == file)
+        return 0;
+    if (NULL == fgets(buffer, sizeof(buffer), file)) {
+        fclose(file);
+        return 0;
+    }
+    fclose(file);
+    while ('\0' != *p && '\n' != *p) {
+        char * end;
+        long first = strtol(p, &end, 10);
+        long last = first;
+        if (end == p)
+            break;
+        p = end;
+        if ('-' == *p) {
+            last = strtol(p + 1, &end, 10);
+            p = end;
+        }
+        for (; first <= last && num < max_values; first++)
+            values[num++] = (int) first;
+        if (',' == *p)
+            p++;
+    }
+    return num;
+}
+
+#if defined(HAWOPENCL_HAVE_NUMA_PLACEMENT)
+// Bind to the CPUs of the node and touch every page, so that the kernel places it there
+static void * opencl_first_touch_thread(void * arg) {
+    opencl_first_touch * touch = (opencl_first_touch *) arg;
+    char path[64];
+    int cpus[CPU_SETSIZE];
+    cpu_set_t set;
+    int num;
+    int i;
+
+    snprintf(path, sizeof(path), NODE_DIR "/node%d/cpulist", touch->node);
+    num = opencl_parse_list(path, cpus, CPU_SETSIZE);
+    CPU_ZERO(&set);
+    for (i = 0; i < num; i++)
+        CPU_SET(cpus[i], &set);
+    if (0 == num || 0 != sched_setaffinity(0, sizeof(set), &set))
+        fprintf(stderr, "INFO: Cannot bind to the CPUs of NUMA node %d, memory may be placed elsewhere\n",
+                touch->node);
+    memset(touch->ptr, 0, touch->size);
+    return NULL;
+}
+#endif
+
+int opencl_init_partitioned(const cl_device_id device_id,
+        hawopencl_partition_mode mode,
+        cl_uint num_counts,
+        const cl_uint * counts,
+        const hawopencl_queue_config * config,
+        hawopencl_runtime ** runtime) {
+#if defined(CL_VERSION_1_2)
+    cl_device_partition_property * properties;
+    cl_device_id * sub_devices;
+    cl_uint num_sub_devices;
+    cl_uint i;
+    int err;
+
+    properties = malloc((num_counts + 3) * sizeof(cl_device_partition_property));
+    if (NULL == properties)
+        FATAL_ERROR("malloc", ENOMEM);
+    switch (mode) {
+        case HAWOPENCL_PARTITION_NUMA:
+            properties[0] = CL_DEVICE_PARTITION_BY_AFFINITY_DOMAIN;
+            properties[1] = CL_DEVICE_AFFINITY_DOMAIN_NUMA;
+            properties[2] = 0;
+            break;
+        case HAWOPENCL_PARTITION_EQUALLY:
+            properties[0] = CL_DEVICE_PARTITION_EQUALLY;
+            properties[1] = num_counts;
+            properties[2] = 0;
+            break;
+        case HAWOPENCL_PARTITION_BY_COUNTS:
+            if (0 == num_counts || NULL == counts) {
+                free(properties);
+                return CL_INVALID_VALUE;
+            }
+            properties[0] = CL_DEVICE_PARTITION_BY_COUNTS;
+            for (i = 0; i < num_counts; i++)
+                properties[1 + i] = counts[i];
+            properties[1 + num_counts] = CL_DEVICE_PARTITION_BY_COUNTS_LIST_END;
+            properties[2 + num_counts] = 0;
+            break;
+        default:
+            free(properties);
+            return CL_INVALID_VALUE;
+    }
+
+    // The device may not support this partitioning; let the caller fall back to the whole device
+    err = clCreateSubDevices(device_id, properties, 0, NULL, &num_sub_devices);
+    if (CL_SUCCESS != err) {
+        free(properties);
+        return err;
+    }
+    sub_devices = malloc(num_sub_devices * sizeof(cl_device_id));
+    if (NULL == sub_devices)
+        FATAL_ERROR("malloc", ENOMEM);
+    err = clCreateSubDevices(device_id, properties, num_sub_devices, sub_devices, NULL);
+    if (CL_SUCCESS != err)
+        FATAL_ERROR("clCreateSubDevices", err);
+    free(properties);
+
+    err = opencl_init_multi(CL_DEVICE_TYPE_ALL, num_sub_devices, sub_devices, 1, config, runtime);
+    if (CL_SUCCESS != err)
+        FATAL_ERROR("opencl_init_multi", err);
+    (*runtime)->parent_device_id = device_id;
+    free(sub_devices);
+
+    /*
+     * Partitioning by the NUMA affinity domain returns the sub-devices in
+     * the order of the nodes; if their numbers differ, e.g. with a limited
+     * cpuset, the nodes remain unknown.
+     */
+    if (HAWOPENCL_PARTITION_NUMA == mode) {
+        int nodes[MAX_NODES];
+        int num_nodes = opencl_parse_list(NODE_DIR "/online", nodes, MAX_NODES);
+        if ((cl_uint) num_nodes == num_sub_devices)
+            for (i = 0; i < num_sub_devices; i++)
+                (*runtime)->numa_nodes[i] = nodes[i];
+    }
+    return CL_SUCCESS;
+#else
+    (void) device_id; (void) mode; (void) num_counts; (void) counts; (void) config; (void) runtime;
+    return CL_INVALID_OPERATION;
+#endif
+}
+
+void * opencl_runtime_host_alloc(const hawopencl_runtime * runtime,
+        cl_uint device,
+        size_t size) {
+    void * ptr;
+
+    if (device >= runtime->num_devices || 0 == size)
+        return NULL;
+#if defined(HAVE_SYS_MMAN_H)
+    ptr = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (MAP_FAILED == ptr)
+        return NULL;
+#else
+    ptr = malloc(size);
+    if (NULL == ptr)
+        return NULL;
+#endif
+
+#if defined(HAWOPENCL_HAVE_NUMA_PLACEMENT)
+    if (-1 != runtime->numa_nodes[device]) {
+        opencl_first_touch touch = {(char *) ptr, size, runtime->numa_nodes[device]};
+        pthread_t thread;
+        if (0 == pthread_create(&thread, NULL, opencl_first_touch_thread, &touch))
+            pthread_join(thread, NULL);
+    }
+#endif
+    return ptr;
+}
+
+void opencl_runtime_host_free(void * ptr, size_t size) {
+    if (NULL == ptr)
+        return;
+#if defined(HAVE_SYS_MMAN_H)
+    munmap(ptr, size);
+#else
+    (void) size;
+    free(ptr);
+#endif
+}
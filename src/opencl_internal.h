@@ -0,0 +1,395 @@
+//
+//  opencl_internal.h : Part of libHAWOpenCL
+//
+//  Functions shared between the library's translation units;
+//  this header is not installed and not part of the public API.
+//
+//  Copyright (c) 2018-2022 Rainer Keller, HS Esslingen. All rights reserved.
+//
+#ifndef HAWOPENCL_INTERNAL_H
+#define HAWOPENCL_INTERNAL_H
+
+#include "HAWOpenCL_config.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#ifdef HAVE_SYS_STAT_H
+#include <sys/stat.h>
+#endif
+#ifdef HAVE_STDBOOL_H
+#include <stdbool.h>
+#endif
+
+#if defined(__APPLE__) && defined(__MACH__)
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include "HAWOpenCL.h"
+
+BEGIN_C_DECLS
+
+/*********************** opencl_device_caps.c ***************************/
+
+/**
+ * Forget the capabilities of a released sub-device, whose id may be reused;
+ * pointers to them stay valid, as returned by opencl_device_caps().
+ *
+ * @param[in] device_id      The device
+ */
+void opencl_device_caps_release(const cl_device_id device_id);
+
+/**
+ * Get the device types, that the platform offered in previous runs.
+ *
+ * @param[in] platform_name  The name of the platform
+ * @param[out] types         The union of the types of the platform's devices
+ * @return true, if devices of this platform are known from the cache file
+ */
+bool opencl_device_caps_platform_types(const char * platform_name, cl_device_type * types);
+
+/*********************** opencl_platforms.c ***************************/
+
+/** A platform and its devices, discovered once per process */
+typedef struct {
+    cl_platform_id platform_id;
+    char name[256];                 /** CL_PLATFORM_NAME */
+    cl_uint num_devices;            /** Valid once discovered */
+    cl_device_id * devices;         /** All devices of the platform, valid once discovered */
+    bool discovered;                /** Set by the discovering thread, see opencl_platform_wait() */
+} opencl_platform;
+
+/**
+ * Get the platforms; on the first call start discovering their devices in
+ * parallel, which continues in the background.
+ *
+ * @param[out] all           The platforms, owned by the library
+ * @return The number of platforms
+ */
+cl_uint opencl_platforms(opencl_platform ** all);
+
+/**
+ * Wait until the devices of the platform have been discovered.
+ *
+ * @param[in] platform       The platform
+ */
+void opencl_platform_wait(opencl_platform * platform);
+
+/**
+ * Check, whether the platform may offer devices of the type, without
+ * waiting for its discovery, if previous runs know it does not.
+ * As the types of previous runs may be outdated, this is only a hint for
+ * the order of waiting; before reporting no device, all platforms are waited for.
+ *
+ * @param[in] platform       The platform
+ * @param[in] on_device_type The requested device type(s)
+ * @return false, if the platform is known not to have any device of this type
+ */
+bool opencl_platform_may_have(opencl_platform * platform, const cl_device_type on_device_type);
+
+/*********************** opencl_build_options.c ***************************/
+
+/**
+ * Assemble the options string like opencl_build_options_string(), without
+ * keeping it in options, e.g. for options shared by several threads.
+ *
+ * @param[in] options        The build options
+ *
+ * @return the newly allocated options string, to be freed by the caller
+ */
+char * opencl_build_options_assemble(const hawopencl_build_options * options) __HAW_OPENCL_ATTR_NONNULL__(1);
+
+/*********************** opencl_runtime.c ***************************/
+
+/**
+ * Create the state of a runtime, initially without programs.
+ *
+ * @return the state, to be freed with opencl_runtime_state_free()
+ */
+struct hawopencl_runtime_state * opencl_runtime_state_create(void);
+
+/**
+ * Release the programs of the state and free it.
+ *
+ * @param[in] state          The state
+ */
+void opencl_runtime_state_free(struct hawopencl_runtime_state * state) __HAW_OPENCL_ATTR_NONNULL__(1);
+
+/*********************** opencl_kernel_build.c ***************************/
+
+/**
+ * Create and build a program from source for a device, using the binary
+ * cache if enabled. In case of a build failure, the build log is printed
+ * and the process exits.
+ *
+ * @param[in] kernel_source  The kernels source code
+ * @param[in] options        The build options (may be NULL)
+ * @param[in] build_name     The name to report in case of build failure
+ * @param[in] device_id      The previously initialized device
+ * @param[in] context        The previously initialized device's context
+ *
+ * @return the built program, to be released by the caller
+ */
+cl_program opencl_kernel_build_program(const char * kernel_source,
+        const char * options,
+        const char * build_name,
+        const cl_device_id device_id,
+        const cl_context context) __HAW_OPENCL_ATTR_NONNULL__(1,3);
+
+/**
+ * Create and build a program like opencl_kernel_build_program() from count
+ * segments, which are passed to clCreateProgramWithSource() unchanged.
+ *
+ * @param[in] count      The number of segments
+ * @param[in] strings    The segments
+ * @param[in] lengths    The segments' lengths; NULL or 0 for NUL-terminated segments
+ */
+cl_program opencl_kernel_build_program_sources(cl_uint count,
+        const char ** strings,
+        const size_t * lengths,
+        const char * options,
+        const char * build_name,
+        const cl_device_id device_id,
+        const cl_context context) __HAW_OPENCL_ATTR_NONNULL__(2,5);
+
+/**
+ * Print the build options and the build log of a failed build to stdout.
+ */
+void opencl_kernel_build_log_print(const cl_program program,
+        const cl_device_id device_id,
+        const char * build_name) __HAW_OPENCL_ATTR_NONNULL__(3);
+
+/*********************** opencl_kernel_load.c ***************************/
+
+// The files a hawopencl_source points into, released by opencl_kernel_unmap()
+struct hawopencl_source_files {
+    const char * data;              /** The kernel file, NULL if not owned by the source */
+    size_t length;
+    bool mapped;                    /** Whether to munmap() or free() the kernel file */
+    cl_uint max_segments;           /** The allocated length of strings and lengths */
+    char ** lines;                  /** The #line directives */
+    size_t num_lines;
+    struct opencl_kernel_included * included; /** The files included */
+    size_t num_included;
+    bool fatal;                     /** Whether a missing include ends the process */
+    bool failed;                    /** An include was missing, the segments are incomplete */
+};
+
+/**
+ * Search the files compiled into the executable.
+ *
+ * @return the file, or NULL if not embedded
+ */
+const hawopencl_embedded_kernel * opencl_kernel_embedded_find(const char * file_name) __HAW_OPENCL_ATTR_NONNULL__(1);
+
+/**
+ * Read len bytes of the file into buffer.
+ *
+ * @return the number of bytes read
+ */
+size_t opencl_kernel_read_file(FILE * file, char * buffer, size_t len) __HAW_OPENCL_ATTR_NONNULL__(1,2);
+
+/**
+ * Map the kernel file like opencl_kernel_map(), however a missing file or
+ * include is printed and returned, instead of ending the process.
+ *
+ * @return CL_SUCCESS, or CL_INVALID_VALUE if a file is missing; then source is released
+ */
+int opencl_kernel_map_try(const char * kernel_file_name,
+        hawopencl_source * source) __HAW_OPENCL_ATTR_NONNULL__(1,2);
+
+/*********************** opencl_kernel_path.c ***************************/
+
+/**
+ * Search the regular file file_name in first_dir, then in the kernel search
+ * paths: the source directory and the paths of OPENCL_KERNEL_PATH.
+ * The directories are listed once into a process-wide index; only if the
+ * file is not found, the directories are checked for changes.
+ *
+ * @param[in]  first_dir  The directory to search first, may be NULL
+ * @param[out] stat_buf   The file's status, as of its first lookup; mtime and
+ *                        size may be stale, take them from fstat() once opened
+ *
+ * @return the path, to be freed by the caller, or NULL if not found
+ */
+char * opencl_kernel_find_file(const char * first_dir,
+        const char * file_name,
+        struct stat * stat_buf) __HAW_OPENCL_ATTR_NONNULL__(2,3);
+
+/*********************** opencl_kernel_preprocess.c ***************************/
+
+/**
+ * Expand the #include "..." of the kernel file in buffer recursively into
+ * the segments of source, pointing into buffer, the included files and the
+ * #line directives mapping back to the original files.
+ * Included files are read once and shared between all sources, until changed.
+ *
+ * @param[in]  kernel_file_name  The name of the file, used in #line directives
+ * @param[in]  buffer            The file's contents, which must remain valid
+ * @param[in]  fatal             Whether a missing include ends the process
+ * @param[out] source            The segments, to be released by opencl_kernel_preprocess_release()
+ *                               also in case of an error
+ * @return CL_SUCCESS, or CL_INVALID_VALUE if an include is missing and fatal is false
+ */
+int opencl_kernel_preprocess(const char * kernel_file_name,
+        const char * buffer,
+        size_t buffer_len,
+        bool fatal,
+        hawopencl_source * source) __HAW_OPENCL_ATTR_NONNULL__(1,2,5);
+
+/**
+ * Get the path of the i-th file included into source, i below source->files->num_included.
+ *
+ * @return the path, or NULL for a file compiled into the executable
+ */
+const char * opencl_kernel_preprocess_dependency(const hawopencl_source * source,
+        size_t i) __HAW_OPENCL_ATTR_NONNULL__(1);
+
+/**
+ * Release the segments, directives and included files of source.
+ */
+void opencl_kernel_preprocess_release(hawopencl_source * source) __HAW_OPENCL_ATTR_NONNULL__(1);
+
+/*********************** opencl_program_build.c ***************************/
+
+/**
+ * Create all kernels of the already built program->program and fill the
+ * kernel table for opencl_program_kernel().
+ *
+ * @return CL_SUCCESS in case of success
+ */
+int opencl_program_kernels_create(hawopencl_program * program) __HAW_OPENCL_ATTR_NONNULL__(1);
+
+/*********************** opencl_hash.c ***************************/
+
+/** The initial value of opencl_hash_fnv1a() */
+#define OPENCL_HASH_FNV1A_INIT  UINT64_C(0xcbf29ce484222325)
+
+/**
+ * Continue the 64-bit FNV-1a hash with len bytes of data; cheap and good
+ * enough to key the caches and index tables, not to guard against attacks.
+ *
+ * @param[in] hash       OPENCL_HASH_FNV1A_INIT, or the hash of the preceding data
+ * @param[in] data       The data
+ * @param[in] len        The number of bytes
+ *
+ * @return the hash
+ */
+uint64_t opencl_hash_fnv1a(uint64_t hash, const void * data, size_t len);
+
+/*********************** opencl_kernel_cache.c ***************************/
+
+/**
+ * Compute the key of a program binary in the cache.
+ * The key covers the source, the build options and the device's name,
+ * driver version and platform, so that a driver update invalidates entries.
+ *
+ * @param[in] source     The fully expanded kernel source
+ * @param[in] options    The build options (may be NULL)
+ * @param[in] device_id  The device the program is built for
+ *
+ * @return the 64-bit key
+ */
+uint64_t opencl_kernel_cache_key(const char * source,
+        const char * options,
+        const cl_device_id device_id) __HAW_OPENCL_ATTR_NONNULL__(1);
+
+/**
+ * Compute the key like opencl_kernel_cache_key() for the source passed as
+ * count segments; equals the key of the concatenated source.
+ *
+ * @param[in] lengths    The segments' lengths; NULL or 0 for NUL-terminated segments
+ */
+uint64_t opencl_kernel_cache_key_sources(cl_uint count,
+        const char ** strings,
+        const size_t * lengths,
+        const char * options,
+        const cl_device_id device_id) __HAW_OPENCL_ATTR_NONNULL__(2);
+
+/**
+ * Read the binary stored under key from the cache directory.
+ *
+ * @param[in]  key       The key as returned by opencl_kernel_cache_key()
+ * @param[out] binary    The binary, to be freed by the caller
+ * @param[out] size      The size of the binary in bytes
+ *
+ * @return 0 on a hit, -1 on a miss or if the entry was corrupt (and removed)
+ */
+int opencl_kernel_cache_read(uint64_t key,
+        unsigned char ** binary,
+        size_t * size) __HAW_OPENCL_ATTR_NONNULL__(2,3);
+
+/**
+ * Store a binary under key in the cache directory, evicting the
+ * least recently used entries if the size cap is exceeded.
+ *
+ * @return 0 in case of success
+ */
+int opencl_kernel_cache_write(uint64_t key,
+        const unsigned char * binary,
+        size_t size) __HAW_OPENCL_ATTR_NONNULL__(2);
+
+/**
+ * Create a program for device_id from the binary cached under key, without
+ * building it; used for compiled objects and libraries passed to clLinkProgram().
+ *
+ * @return the program on a hit, NULL on a miss or a stale entry
+ */
+cl_program opencl_kernel_cache_binary(const cl_context context,
+        const cl_device_id device_id,
+        uint64_t key);
+
+/**
+ * Create and build a program for device_id from the binary cached under key.
+ *
+ * @return the built program on a hit, NULL on a miss or a stale entry
+ */
+cl_program opencl_kernel_cache_program(const cl_context context,
+        const cl_device_id device_id,
+        uint64_t key,
+        const char * options);
+
+/**
+ * Store the binary of a successfully built program for device_id under key.
+ *
+ * @return 0 in case of success
+ */
+int opencl_kernel_cache_store(uint64_t key,
+        const cl_program program,
+        const cl_device_id device_id);
+
+/**
+ * Get the binary of a built program for device_id.
+ *
+ * @param[out] size      The size of the binary in bytes
+ *
+ * @return the binary, to be freed by the caller, or NULL if not available
+ */
+unsigned char * opencl_program_binary(const cl_program program,
+        const cl_device_id device_id,
+        size_t * size) __HAW_OPENCL_ATTR_NONNULL__(3);
+
+/**
+ * Returns true, if the binary cache is enabled.
+ */
+bool opencl_kernel_cache_enabled(void);
+
+/**
+ * Get the path of a further file named name in the cache directory,
+ * which is created if necessary.
+ *
+ * @return the path, to be freed by the caller, or NULL if the cache is disabled
+ */
+char * opencl_kernel_cache_file(const char * name) __HAW_OPENCL_ATTR_NONNULL__(1);
+
+/**
+ * Check, whether extensionName is contained in the space-separated list extensions.
+ *
+ * @return 1 if found, 0 otherwise
+ */
+int checkDeviceExtension(const char * extensions, const char * extensionName) __HAW_OPENCL_ATTR_NONNULL__(1,2);
+
+END_C_DECLS
+
+#endif /* HAWOPENCL_INTERNAL_H */
@@ -22,6 +22,7 @@
 #endif
 
 #include "HAWOpenCL.h"
+#include "opencl_internal.h"
 
 #define BUILD_LOG(cl_program, device_id, build_param, log, len) do {           \
         size_t __len = 0;                                                      \
@@ -39,47 +40,100 @@
                               len, log, NULL);                                 \
     } while(0)
 
-int opencl_kernel_build(const char * kernel_source,
-        const char * kernel_name,
+void opencl_kernel_build_log_print(const cl_program program,
         const cl_device_id device_id,
-        const cl_context context,
-        cl_kernel * kernel) {
-    int err;
-    cl_program cl_program;
-    char * pwd_env = NULL;
-    char * compile_option = NULL;
-    int compile_option_len;
+        const char * build_name) {
+    char * build_log = NULL;
+    size_t len = 0;
+
+    printf("--------------------------------------\n");
+    printf("Building of Kernel '%s' failed:\n", build_name);
+
+    BUILD_LOG(program, device_id, CL_PROGRAM_BUILD_OPTIONS, build_log, len);
+    printf("Build Options (len:%zd):\n%s\n", len, build_log);
+
+    BUILD_LOG(program, device_id, CL_PROGRAM_BUILD_LOG, build_log, len);
+    printf("Build Info Log (len:%zd):\n%s\n", len, build_log);
+    printf("--------------------------------------\n");
+
+    free(build_log);
+}
 
-    compile_option_len = strlen("-cl-kernel-arg-info -cl-opt-disable");
-    compile_option = strdup("-cl-kernel-arg-info -cl-opt-disable");
-    if (NULL == compile_option)
-        FATAL_ERROR("strdup", ENOMEM);
+cl_program opencl_kernel_build_program(const char * kernel_source,
+        const char * options,
+        const char * build_name,
+        const cl_device_id device_id,
+        const cl_context context) {
+    return opencl_kernel_build_program_sources(1, &kernel_source, NULL, options,
+            build_name, device_id, context);
+}
+
+cl_program opencl_kernel_build_program_sources(cl_uint count,
+        const char ** strings,
+        const size_t * lengths,
+        const char * options,
+        const char * build_name,
+        const cl_device_id device_id,
+        const cl_context context) {
+    int err;
+    cl_program cl_program = NULL;
+    uint64_t key = 0;
+
+    // First try the binary cache, only upon a miss build from source.
+    if (opencl_kernel_cache_enabled()) {
+        key = opencl_kernel_cache_key_sources(count, strings, lengths, options, device_id);
+        cl_program = opencl_kernel_cache_program(context, device_id, key, options);
+        if (NULL != cl_program)
+            return cl_program;
+    }
 
-    cl_program = clCreateProgramWithSource(context, 1, (const char**) &kernel_source, NULL, &err);
+    cl_program = clCreateProgramWithSource(context, count, strings, lengths, &err);
     if (!cl_program || err != CL_SUCCESS)
         FATAL_ERROR("clCreateProgramWithSource", err);
 
     // Build Program -- only in case of error report the build-log.
-    err = clBuildProgram(cl_program, 0, NULL, compile_option, NULL, NULL);
+    err = clBuildProgram(cl_program, 1, &device_id, options, NULL, NULL);
     if (CL_SUCCESS != err) {
-        char * build_log = NULL;
-        size_t len = 0;
+        opencl_kernel_build_log_print(cl_program, device_id, build_name);
+        FATAL_ERROR("clBuildProgram", err);
+    }
 
-        printf("--------------------------------------\n");
-        printf("Building of Kernel '%s' failed:\n", kernel_name);
+    if (opencl_kernel_cache_enabled())
+        opencl_kernel_cache_store(key, cl_program, device_id);
 
-        BUILD_LOG(cl_program, device_id, CL_PROGRAM_BUILD_OPTIONS, build_log, len);
-        printf("Build Options (len:%zd):\n%s\n", len, build_log);
+    return cl_program;
+}
 
-        BUILD_LOG(cl_program, device_id, CL_PROGRAM_BUILD_LOG, build_log, len);
-        printf("Build Info Log (len:%zd):\n%s\n", len, build_log);
-        printf("--------------------------------------\n");
+int opencl_kernel_build_with_options(const char * kernel_source,
+        const char * kernel_name,
+        hawopencl_build_options * options,
+        const cl_device_id device_id,
+        const cl_context context,
+        cl_kernel * kernel) {
+    return opencl_kernel_build_sources(1, &kernel_source, NULL, kernel_name, options,
+            device_id, context, kernel);
+}
 
-        free(build_log);
-        free(compile_option);
+int opencl_kernel_build_sources(cl_uint count,
+        const char ** strings,
+        const size_t * lengths,
+        const char * kernel_name,
+        hawopencl_build_options * options,
+        const cl_device_id device_id,
+        const cl_context context,
+        cl_kernel * kernel) {
+    int err;
+    cl_program cl_program;
+    hawopencl_build_options default_options;
 
-        FATAL_ERROR("clBuildProgram", err);
+    if (NULL == options) {
+        opencl_build_options_init(&default_options, HAWOPENCL_BUILD_PROFILE_RELEASE);
+        options = &default_options;
     }
+    cl_program = opencl_kernel_build_program_sources(count, strings, lengths,
+            opencl_build_options_string(options), kernel_name, device_id, context);
+    if (options == &default_options)
+        opencl_build_options_free(&default_options);
 
     // Create the kernel
     *kernel = clCreateKernel(cl_program, kernel_name, &err);
@@ -95,6 +149,14 @@ int opencl_kernel_build(const char * kernel_source,
     err = clReleaseProgram(cl_program);
     if (CL_SUCCESS != err)
         FATAL_ERROR("clReleaseProgram", err);
-    free(compile_option);
     return CL_SUCCESS;
 }
+
+int opencl_kernel_build(const char * kernel_source,
+        const char * kernel_name,
+        const cl_device_id device_id,
+        const cl_context context,
+        cl_kernel * kernel) {
+    return opencl_kernel_build_with_options(kernel_source, kernel_name, NULL,
+            device_id, context, kernel);
+}
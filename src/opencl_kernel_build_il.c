@@ -0,0 +1,157 @@
+//
+//  opencl_kernel_build_il.c : Part of libHAWOpenCL
+//
+//  Build programs from an intermediate language, i.e. SPIR-V compiled
+//  offline, so that the compiler front-end does not run at startup.
+//  Requires OpenCL-2.1, i.e. configuring with HAWOPENCL_CL_VERSION=210.
+//
+//  Copyright (c) 2018-2022 Rainer Keller, HS Esslingen. All rights reserved.
+//
+#include "HAWOpenCL_config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <stdint.h>
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+
+#if defined(__APPLE__) && defined(__MACH__)
+#include <OpenCL/opencl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include "HAWOpenCL.h"
+#include "opencl_internal.h"
+
+#if defined(CL_VERSION_2_1) && HAWOPENCL_CL_VERSION >= 210
+#  define HAWOPENCL_HAVE_IL 1
+#endif
+
+#if defined(HAWOPENCL_HAVE_IL)
+/*
+ * Local functions
+ */
+static cl_program opencl_program_build_il_program(const void * il, size_t length,
+        hawopencl_build_options * options, const char * build_name,
+        const cl_device_id device_id, const cl_context context);
+
+// Create and build the program, using the binary cache if enabled
+static cl_program opencl_program_build_il_program(const void * il, size_t length,
+        hawopencl_build_options * options, const char * build_name,
+        const cl_device_id device_id, const cl_context context) {
+    hawopencl_build_options default_options;
+    const char * build_options;
+    cl_program program = NULL;
+    uint64_t key = 0;
+    int err;
+
+    if (NULL == options) {
+        opencl_build_options_init(&default_options, HAWOPENCL_BUILD_PROFILE_RELEASE);
+        options = &default_options;
+    }
+    build_options = opencl_build_options_string(options);
+
+    // The IL is binary; key the cache by the IL's hash and length instead
+    if (opencl_kernel_cache_enabled()) {
+        const uint64_t hash = opencl_hash_fnv1a(OPENCL_HASH_FNV1A_INIT, il, length);
+        char key_source[64];
+
+        snprintf(key_source, sizeof(key_source), "IL:%016llx:%llu",
+                (unsigned long long) hash, (unsigned long long) length);
+        key = opencl_kernel_cache_key(key_source, build_options, device_id);
+        program = opencl_kernel_cache_program(context, device_id, key, build_options);
+    }
+
+    if (NULL == program) {
+        program = clCreateProgramWithIL(context, il, length, &err);
+        if (NULL == program || CL_SUCCESS != err)
+            FATAL_ERROR("clCreateProgramWithIL", err);
+
+        err = clBuildProgram(program, 1, &device_id, build_options, NULL, NULL);
+        if (CL_SUCCESS != err) {
+            opencl_kernel_build_log_print(program, device_id, build_name);
+            FATAL_ERROR("clBuildProgram", err);
+        }
+        if (opencl_kernel_cache_enabled())
+            opencl_kernel_cache_store(key, program, device_id);
+    }
+
+    if (options == &default_options)
+        opencl_build_options_free(&default_options);
+    return program;
+}
+#endif /* HAWOPENCL_HAVE_IL */
+
+bool opencl_device_supports_il(const cl_device_id device_id __HAW_OPENCL_ATTR_UNUSED__) {
+#if defined(HAWOPENCL_HAVE_IL)
+    char il_version[256];
+    int err;
+
+    // Devices below OpenCL-2.1 do not know the query at all
+    err = clGetDeviceInfo(device_id, CL_DEVICE_IL_VERSION, sizeof(il_version), il_version, NULL);
+    if (CL_SUCCESS != err)
+        return false;
+    il_version[sizeof(il_version) - 1] = '\0';
+    return NULL != strstr(il_version, "SPIR-V");
+#else
+    return false;
+#endif
+}
+
+int opencl_kernel_build_il(const void * il,
+        size_t length,
+        const char * kernel_name,
+        hawopencl_build_options * options,
+        const cl_device_id device_id,
+        const cl_context context,
+        cl_kernel * kernel) {
+#if defined(HAWOPENCL_HAVE_IL)
+    cl_program program;
+    int err;
+
+    if (!opencl_device_supports_il(device_id))
+        return CL_INVALID_OPERATION;
+
+    program = opencl_program_build_il_program(il, length, options, kernel_name, device_id, context);
+    *kernel = clCreateKernel(program, kernel_name, &err);
+    if (NULL == *kernel || CL_SUCCESS != err)
+        FATAL_ERROR("clCreateKernel", err);
+    OPENCL_CHECK(clReleaseProgram, (program));
+    return CL_SUCCESS;
+#else
+    (void) il; (void) length; (void) kernel_name; (void) options;
+    (void) device_id; (void) context; (void) kernel;
+    return CL_INVALID_OPERATION;
+#endif
+}
+
+int opencl_program_build_il(const void * il,
+        size_t length,
+        hawopencl_build_options * options,
+        const cl_device_id device_id,
+        const cl_context context,
+        hawopencl_program ** program) {
+#if defined(HAWOPENCL_HAVE_IL)
+    hawopencl_program * p;
+
+    if (!opencl_device_supports_il(device_id))
+        return CL_INVALID_OPERATION;
+
+    p = (hawopencl_program *) calloc(1, sizeof(hawopencl_program));
+    if (NULL == p)
+        FATAL_ERROR("calloc", ENOMEM);
+    p->program = opencl_program_build_il_program(il, length, options, "(program)", device_id, context);
+    opencl_program_kernels_create(p);
+
+    *program = p;
+    return CL_SUCCESS;
+#else
+    (void) il; (void) length; (void) options;
+    (void) device_id; (void) context; (void) program;
+    return CL_INVALID_OPERATION;
+#endif
+}
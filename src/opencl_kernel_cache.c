@@ -0,0 +1,608 @@
+//
+//  opencl_kernel_cache.c : Part of libHAWOpenCL
+//
+//  Persistent on-disk cache of program binaries, so that kernels built
+//  once do not have to be compiled from source at every process start.
+//
+//  Copyright (c) 2018-2022 Rainer Keller, HS Esslingen. All rights reserved.
+//
+#include "HAWOpenCL_config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <stdint.h>
+#ifdef HAVE_STDLIB_H
+#  include <stdlib.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#  include <unistd.h>
+#endif
+#ifdef HAVE_SYS_TYPES_H
+#  include <sys/types.h>
+#endif
+#ifdef HAVE_SYS_STAT_H
+#  include <sys/stat.h>
+#endif
+#ifdef HAVE_DIRENT_H
+#  include <dirent.h>
+#endif
+#include <time.h>
+#include <utime.h>
+#ifdef HAVE_PTHREAD_H
+#  include <pthread.h>
+#endif
+
+#if defined(__APPLE__) && defined(__MACH__)
+#  include <OpenCL/opencl.h>
+#else
+#  include <CL/cl.h>
+#endif
+
+#include "HAWOpenCL.h"
+#include "opencl_internal.h"
+
+#if defined(HAVE_UNISTD_H) && defined(HAVE_SYS_STAT_H) && defined(HAVE_DIRENT_H)
+#  define HAWOPENCL_HAVE_KERNEL_CACHE 1
+#endif
+
+#define CACHE_MAGIC           "HAWCLBIN"
+#define CACHE_FORMAT_VERSION  1
+#define CACHE_SUFFIX          ".clbin"
+#define CACHE_DEFAULT_SIZE    (64UL * 1024 * 1024)
+
+// The header preceding every binary in the cache file
+typedef struct {
+    char magic[8];
+    uint32_t format_version;
+    uint32_t reserved;
+    uint64_t key;
+    uint64_t binary_size;
+    uint64_t checksum;
+} opencl_kernel_cache_header;
+
+static bool cache_initialized = false;
+static char * cache_dir = NULL;
+static size_t cache_max_size = CACHE_DEFAULT_SIZE;
+static hawopencl_kernel_cache_stats cache_stats;
+
+// Programs may be built concurrently (see opencl_program_build_async())
+#if defined(HAVE_PTHREAD_H)
+static pthread_mutex_t cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+#  define CACHE_LOCK()    pthread_mutex_lock(&cache_mutex)
+#  define CACHE_UNLOCK()  pthread_mutex_unlock(&cache_mutex)
+#else
+#  define CACHE_LOCK()
+#  define CACHE_UNLOCK()
+#endif
+
+/*
+ * Local functions
+ */
+static void opencl_kernel_cache_init(void);
+static void opencl_kernel_cache_invalidate(uint64_t key);
+#if defined(HAWOPENCL_HAVE_KERNEL_CACHE)
+static char * opencl_kernel_cache_path(uint64_t key);
+static int opencl_kernel_cache_mkdir(const char * dir);
+static void opencl_kernel_cache_evict(void);
+#endif
+
+// Parse a size with an optional K, M or G suffix, as passed in OPENCL_KERNEL_CACHE_SIZE
+static size_t opencl_kernel_cache_parse_size(const char * str) {
+    char * end;
+    unsigned long long size = strtoull(str, &end, 10);
+    switch (*end) {
+        case 'g': case 'G': size *= 1024;
+        /* FALLTHROUGH */
+        case 'm': case 'M': size *= 1024;
+        /* FALLTHROUGH */
+        case 'k': case 'K': size *= 1024;
+        /* FALLTHROUGH */
+        default: break;
+    }
+    return (size_t) size;
+}
+
+static void opencl_kernel_cache_init(void) {
+    const char * env;
+
+    CACHE_LOCK();
+    if (cache_initialized) {
+        CACHE_UNLOCK();
+        return;
+    }
+    cache_initialized = true;
+    memset(&cache_stats, 0, sizeof(cache_stats));
+
+    env = getenv("OPENCL_KERNEL_CACHE_SIZE");
+    if (NULL != env)
+        cache_max_size = opencl_kernel_cache_parse_size(env);
+
+    // Setting OPENCL_KERNEL_CACHE_DIR to the empty string disables the cache
+    env = getenv("OPENCL_KERNEL_CACHE_DIR");
+    if (NULL != env) {
+        cache_dir = ('\0' == env[0]) ? NULL : strdup(env);
+    } else if (NULL != (env = getenv("XDG_CACHE_HOME")) && '\0' != env[0]) {
+        cache_dir = malloc(strlen(env) + strlen("/HAWOpenCL") + 1);
+        if (NULL != cache_dir)
+            sprintf(cache_dir, "%s/HAWOpenCL", env);
+    } else if (NULL != (env = getenv("HOME")) && '\0' != env[0]) {
+        cache_dir = malloc(strlen(env) + strlen("/.cache/HAWOpenCL") + 1);
+        if (NULL != cache_dir)
+            sprintf(cache_dir, "%s/.cache/HAWOpenCL", env);
+    }
+    CACHE_UNLOCK();
+}
+
+bool opencl_kernel_cache_enabled(void) {
+#if defined(HAWOPENCL_HAVE_KERNEL_CACHE)
+    bool enabled;
+    opencl_kernel_cache_init();
+    CACHE_LOCK();
+    enabled = NULL != cache_dir && 0 < cache_max_size;
+    CACHE_UNLOCK();
+    return enabled;
+#else
+    return false;
+#endif
+}
+
+int opencl_kernel_cache_config(const char * dir, size_t max_size) {
+    opencl_kernel_cache_init();
+    CACHE_LOCK();
+    free(cache_dir);
+    cache_dir = NULL;
+    if (NULL != dir) {
+        cache_dir = strdup(dir);
+        if (NULL == cache_dir)
+            FATAL_ERROR("strdup", ENOMEM);
+    }
+    cache_max_size = max_size;
+    CACHE_UNLOCK();
+    return CL_SUCCESS;
+}
+
+int opencl_kernel_cache_stats(hawopencl_kernel_cache_stats * stats) {
+    opencl_kernel_cache_init();
+    CACHE_LOCK();
+    *stats = cache_stats;
+    CACHE_UNLOCK();
+    return CL_SUCCESS;
+}
+
+// Hash a string-valued device or platform property into the key, including its NUL
+#define HASH_STRING(str, hash) \
+        (hash) = opencl_hash_fnv1a((hash), (str), strlen(str) + 1)
+
+uint64_t opencl_kernel_cache_key(const char * source,
+        const char * options,
+        const cl_device_id device_id) {
+    return opencl_kernel_cache_key_sources(1, &source, NULL, options, device_id);
+}
+
+uint64_t opencl_kernel_cache_key_sources(cl_uint count,
+        const char ** strings,
+        const size_t * lengths,
+        const char * options,
+        const cl_device_id device_id) {
+    uint64_t hash = OPENCL_HASH_FNV1A_INIT;
+    const uint32_t format_version = CACHE_FORMAT_VERSION;
+    const hawopencl_device_caps * caps = opencl_device_caps(device_id);
+    cl_uint i;
+
+    hash = opencl_hash_fnv1a(hash, &format_version, sizeof(format_version));
+    // Hashing the segments equals hashing their concatenation
+    for (i = 0; i < count; i++)
+        hash = opencl_hash_fnv1a(hash, strings[i],
+                (NULL != lengths && 0 != lengths[i]) ? lengths[i] : strlen(strings[i]));
+    hash = opencl_hash_fnv1a(hash, "", 1);
+    if (NULL != options)
+        hash = opencl_hash_fnv1a(hash, options, strlen(options));
+    hash = opencl_hash_fnv1a(hash, "", 1);
+
+    HASH_STRING(caps->name, hash);
+    HASH_STRING(caps->device_version, hash);
+    HASH_STRING(caps->driver_version, hash);
+    HASH_STRING(caps->platform_name, hash);
+    HASH_STRING(caps->platform_version, hash);
+
+    return hash;
+}
+
+#if defined(HAWOPENCL_HAVE_KERNEL_CACHE)
+
+static char * opencl_kernel_cache_path(uint64_t key) {
+    const size_t len = strlen(cache_dir) + 1 + 16 + strlen(CACHE_SUFFIX) + 1;
+    char * path = malloc(len);
+    if (NULL == path)
+        FATAL_ERROR("malloc", ENOMEM);
+    snprintf(path, len, "%s/%016llx" CACHE_SUFFIX, cache_dir, (unsigned long long) key);
+    return path;
+}
+
+// Create the directory including all its parents, like mkdir -p
+static int opencl_kernel_cache_mkdir(const char * dir) {
+    char * tmp = strdup(dir);
+    char * p;
+    int ret = 0;
+
+    if (NULL == tmp)
+        FATAL_ERROR("strdup", ENOMEM);
+    for (p = tmp + 1; ; p++) {
+        if ('/' == *p || '\0' == *p) {
+            const char c = *p;
+            *p = '\0';
+            if (0 != mkdir(tmp, 0755) && EEXIST != errno) {
+                ret = -1;
+                break;
+            }
+            *p = c;
+            if ('\0' == c)
+                break;
+        }
+    }
+    free(tmp);
+    return ret;
+}
+
+// Remove the least recently used (oldest mtime) entries until below cache_max_size
+static void opencl_kernel_cache_evict(void) {
+    typedef struct {
+        char * name;
+        time_t mtime;
+        off_t size;
+    } entry_t;
+    DIR * dir;
+    struct dirent * dirent;
+    entry_t * entries = NULL;
+    size_t num = 0;
+    size_t max = 0;
+    unsigned long long total = 0;
+    const size_t suffix_len = strlen(CACHE_SUFFIX);
+
+    dir = opendir(cache_dir);
+    if (NULL == dir)
+        return;
+    while (NULL != (dirent = readdir(dir))) {
+        const size_t name_len = strlen(dirent->d_name);
+        struct stat stat_buf;
+        char path[4096];
+
+        if (name_len <= suffix_len ||
+            0 != strcmp(dirent->d_name + name_len - suffix_len, CACHE_SUFFIX))
+            continue;
+        snprintf(path, sizeof(path), "%s/%s", cache_dir, dirent->d_name);
+        if (0 != stat(path, &stat_buf))
+            continue;
+        if (num == max) {
+            max = (0 == max) ? 64 : 2 * max;
+            entries = realloc(entries, max * sizeof(entry_t));
+            if (NULL == entries)
+                FATAL_ERROR("realloc", ENOMEM);
+        }
+        entries[num].name = strdup(dirent->d_name);
+        if (NULL == entries[num].name)
+            FATAL_ERROR("strdup", ENOMEM);
+        entries[num].mtime = stat_buf.st_mtime;
+        entries[num].size = stat_buf.st_size;
+        total += stat_buf.st_size;
+        num++;
+    }
+    closedir(dir);
+
+    while (total > cache_max_size && 0 < num) {
+        size_t i;
+        size_t oldest = 0;
+        char path[4096];
+        for (i = 1; i < num; i++)
+            if (entries[i].mtime < entries[oldest].mtime)
+                oldest = i;
+        snprintf(path, sizeof(path), "%s/%s", cache_dir, entries[oldest].name);
+        if (0 == unlink(path)) {
+            total -= entries[oldest].size;
+            cache_stats.evictions++;
+        }
+        free(entries[oldest].name);
+        entries[oldest] = entries[--num];
+    }
+    cache_stats.bytes = total;
+
+    while (0 < num)
+        free(entries[--num].name);
+    free(entries);
+}
+
+int opencl_kernel_cache_read(uint64_t key, unsigned char ** binary, size_t * size) {
+    opencl_kernel_cache_header header;
+    char * path;
+    FILE * file;
+    unsigned char * buffer;
+
+    if (!opencl_kernel_cache_enabled())
+        return -1;
+
+    CACHE_LOCK();
+    if (NULL == cache_dir) {
+        CACHE_UNLOCK();
+        return -1;
+    }
+    path = opencl_kernel_cache_path(key);
+    file = fopen(path, "rb");
+    if (NULL == file) {
+        cache_stats.misses++;
+        CACHE_UNLOCK();
+        free(path);
+        return -1;
+    }
+    if (1 != fread(&header, sizeof(header), 1, file) ||
+        0 != memcmp(header.magic, CACHE_MAGIC, sizeof(header.magic)) ||
+        CACHE_FORMAT_VERSION != header.format_version ||
+        key != header.key ||
+        0 == header.binary_size)
+        goto corrupt;
+
+    buffer = malloc(header.binary_size);
+    if (NULL == buffer)
+        FATAL_ERROR("malloc", ENOMEM);
+    if (1 != fread(buffer, header.binary_size, 1, file) ||
+        header.checksum != opencl_hash_fnv1a(OPENCL_HASH_FNV1A_INIT, buffer, header.binary_size)) {
+        free(buffer);
+        goto corrupt;
+    }
+    fclose(file);
+
+    // Mark as recently used for the LRU eviction
+    utime(path, NULL);
+    free(path);
+
+    *binary = buffer;
+    *size = header.binary_size;
+    cache_stats.hits++;
+    CACHE_UNLOCK();
+    return 0;
+
+corrupt:
+    fprintf(stderr, "INFO: Removing corrupt OpenCL kernel cache entry %s\n", path);
+    fclose(file);
+    unlink(path);
+    free(path);
+    cache_stats.invalid++;
+    cache_stats.misses++;
+    CACHE_UNLOCK();
+    return -1;
+}
+
+int opencl_kernel_cache_write(uint64_t key, const unsigned char * binary, size_t size) {
+    opencl_kernel_cache_header header;
+    char * path;
+    char * tmp_path;
+    FILE * file;
+    int ret = 0;
+
+    if (!opencl_kernel_cache_enabled())
+        return -1;
+    CACHE_LOCK();
+    if (NULL == cache_dir || size > cache_max_size) {
+        CACHE_UNLOCK();
+        return -1;
+    }
+    if (0 != opencl_kernel_cache_mkdir(cache_dir)) {
+        fprintf(stderr, "WARNING: Cannot create OpenCL kernel cache directory %s; disabling cache\n",
+                cache_dir);
+        free(cache_dir);
+        cache_dir = NULL;
+        CACHE_UNLOCK();
+        return -1;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CACHE_MAGIC, sizeof(header.magic));
+    header.format_version = CACHE_FORMAT_VERSION;
+    header.key = key;
+    header.binary_size = size;
+    header.checksum = opencl_hash_fnv1a(OPENCL_HASH_FNV1A_INIT, binary, size);
+
+    // Write into a temporary file and rename, so readers never see partial entries
+    path = opencl_kernel_cache_path(key);
+    tmp_path = malloc(strlen(path) + 32);
+    if (NULL == tmp_path)
+        FATAL_ERROR("malloc", ENOMEM);
+    sprintf(tmp_path, "%s.%ld.tmp", path, (long) getpid());
+
+    file = fopen(tmp_path, "wb");
+    if (NULL == file) {
+        ret = -1;
+    } else {
+        if (1 != fwrite(&header, sizeof(header), 1, file) ||
+            1 != fwrite(binary, size, 1, file))
+            ret = -1;
+        if (0 != fclose(file))
+            ret = -1;
+        if (0 == ret && 0 != rename(tmp_path, path))
+            ret = -1;
+        if (0 != ret)
+            unlink(tmp_path);
+    }
+    free(tmp_path);
+    free(path);
+
+    if (0 == ret) {
+        cache_stats.stores++;
+        opencl_kernel_cache_evict();
+    }
+    CACHE_UNLOCK();
+    return ret;
+}
+
+char * opencl_kernel_cache_file(const char * name) {
+    char * path = NULL;
+
+    if (!opencl_kernel_cache_enabled())
+        return NULL;
+    CACHE_LOCK();
+    if (NULL != cache_dir && 0 == opencl_kernel_cache_mkdir(cache_dir)) {
+        path = malloc(strlen(cache_dir) + 1 + strlen(name) + 1);
+        if (NULL == path)
+            FATAL_ERROR("malloc", ENOMEM);
+        sprintf(path, "%s/%s", cache_dir, name);
+    }
+    CACHE_UNLOCK();
+    return path;
+}
+
+// Remove an entry, which was read fine, but is rejected by the driver; count it as miss
+static void opencl_kernel_cache_invalidate(uint64_t key) {
+    char * path;
+
+    CACHE_LOCK();
+    if (NULL == cache_dir) {
+        CACHE_UNLOCK();
+        return;
+    }
+    path = opencl_kernel_cache_path(key);
+    fprintf(stderr, "INFO: Removing stale OpenCL kernel cache entry %s\n", path);
+    unlink(path);
+    free(path);
+    cache_stats.hits--;
+    cache_stats.misses++;
+    cache_stats.invalid++;
+    CACHE_UNLOCK();
+}
+
+#else /* HAWOPENCL_HAVE_KERNEL_CACHE */
+
+int opencl_kernel_cache_read(uint64_t key __HAW_OPENCL_ATTR_UNUSED__,
+        unsigned char ** binary __HAW_OPENCL_ATTR_UNUSED__,
+        size_t * size __HAW_OPENCL_ATTR_UNUSED__) {
+    return -1;
+}
+
+int opencl_kernel_cache_write(uint64_t key __HAW_OPENCL_ATTR_UNUSED__,
+        const unsigned char * binary __HAW_OPENCL_ATTR_UNUSED__,
+        size_t size __HAW_OPENCL_ATTR_UNUSED__) {
+    return -1;
+}
+
+char * opencl_kernel_cache_file(const char * name __HAW_OPENCL_ATTR_UNUSED__) {
+    return NULL;
+}
+
+static void opencl_kernel_cache_invalidate(uint64_t key __HAW_OPENCL_ATTR_UNUSED__) {
+}
+
+#endif /* HAWOPENCL_HAVE_KERNEL_CACHE */
+
+cl_program opencl_kernel_cache_binary(const cl_context context,
+        const cl_device_id device_id,
+        uint64_t key) {
+    unsigned char * binary;
+    size_t size;
+    cl_int binary_status;
+    cl_program program;
+    int err;
+
+    if (0 != opencl_kernel_cache_read(key, &binary, &size))
+        return NULL;
+
+    program = clCreateProgramWithBinary(context, 1, &device_id, &size,
+            (const unsigned char **) &binary, &binary_status, &err);
+    free(binary);
+
+    // A binary the driver rejects is stale (e.g. after a driver update): fall back to source
+    if (NULL == program || CL_SUCCESS != err || CL_SUCCESS != binary_status) {
+        if (NULL != program)
+            clReleaseProgram(program);
+        opencl_kernel_cache_invalidate(key);
+        return NULL;
+    }
+    return program;
+}
+
+cl_program opencl_kernel_cache_program(const cl_context context,
+        const cl_device_id device_id,
+        uint64_t key,
+        const char * options) {
+    cl_program program;
+    int err;
+
+    program = opencl_kernel_cache_binary(context, device_id, key);
+    if (NULL == program)
+        return NULL;
+
+    err = clBuildProgram(program, 1, &device_id, options, NULL, NULL);
+    if (CL_SUCCESS != err) {
+        clReleaseProgram(program);
+        opencl_kernel_cache_invalidate(key);
+        return NULL;
+    }
+    return program;
+}
+
+unsigned char * opencl_program_binary(const cl_program program,
+        const cl_device_id device_id,
+        size_t * size) {
+    cl_uint num_devices;
+    cl_device_id * devices;
+    size_t * sizes;
+    unsigned char ** binaries;
+    unsigned char * binary = NULL;
+    cl_uint idx;
+    int err;
+
+    err = clGetProgramInfo(program, CL_PROGRAM_NUM_DEVICES, sizeof(num_devices), &num_devices, NULL);
+    if (CL_SUCCESS != err)
+        FATAL_ERROR("clGetProgramInfo", err);
+    devices = (cl_device_id *) malloc(num_devices * sizeof(cl_device_id));
+    sizes = (size_t *) malloc(num_devices * sizeof(size_t));
+    binaries = (unsigned char **) calloc(num_devices, sizeof(unsigned char *));
+    if (NULL == devices || NULL == sizes || NULL == binaries)
+        FATAL_ERROR("malloc", ENOMEM);
+
+    err = clGetProgramInfo(program, CL_PROGRAM_DEVICES, num_devices * sizeof(cl_device_id), devices, NULL);
+    if (CL_SUCCESS != err)
+        FATAL_ERROR("clGetProgramInfo", err);
+    for (idx = 0; idx < num_devices; idx++)
+        if (devices[idx] == device_id)
+            break;
+
+    if (idx < num_devices) {
+        err = clGetProgramInfo(program, CL_PROGRAM_BINARY_SIZES, num_devices * sizeof(size_t), sizes, NULL);
+        if (CL_SUCCESS != err)
+            FATAL_ERROR("clGetProgramInfo", err);
+        // Only fetch the binary of our device; the others remain NULL
+        binaries[idx] = (unsigned char *) malloc(sizes[idx] + 1);
+        if (NULL == binaries[idx])
+            FATAL_ERROR("malloc", ENOMEM);
+        err = clGetProgramInfo(program, CL_PROGRAM_BINARIES, num_devices * sizeof(unsigned char *), binaries, NULL);
+        if (CL_SUCCESS == err && 0 < sizes[idx]) {
+            binary = binaries[idx];
+            *size = sizes[idx];
+        } else {
+            free(binaries[idx]);
+        }
+    }
+
+    free(binaries);
+    free(sizes);
+    free(devices);
+    return binary;
+}
+
+int opencl_kernel_cache_store(uint64_t key,
+        const cl_program program,
+        const cl_device_id device_id) {
+    unsigned char * binary;
+    size_t size;
+    int ret;
+
+    if (!opencl_kernel_cache_enabled())
+        return -1;
+
+    binary = opencl_program_binary(program, device_id, &size);
+    if (NULL == binary)
+        return -1;
+    ret = opencl_kernel_cache_write(key, binary, size);
+    free(binary);
+    return ret;
+}
@@ -103,10 +103,7 @@ int opencl_kernel_info(const cl_kernel kernel,
      * custom device.
      * Therefore initialize to something "sane".
      */
-    cl_device_type type;
-    err = clGetDeviceInfo(device_id, CL_DEVICE_TYPE, sizeof(cl_device_type), &type, NULL);
-    if (CL_SUCCESS != err)
-        FATAL_ERROR("clGetDeviceInfo", err);
+    const cl_device_type type = opencl_device_caps(device_id)->type;
     kernel_info->global_work_size[0] = 0;
     kernel_info->global_work_size[1] = 0;
     kernel_info->global_work_size[2] = 0;
@@ -147,9 +144,21 @@ int opencl_kernel_info(const cl_kernel kernel,
 #endif
 
 
-    kernel_info->args = (hawopencl_kernelarg*) malloc(sizeof (hawopencl_kernelarg) * kernel_info->kernel_num_args);
+    kernel_info->args = (hawopencl_kernelarg*) calloc(kernel_info->kernel_num_args + 1, sizeof (hawopencl_kernelarg));
     if (NULL == kernel_info->args)
-        FATAL_ERROR("malloc", ENOMEM);
+        FATAL_ERROR("calloc", ENOMEM);
+
+    /* Argument information is only available, if the program was built with
+     * -cl-kernel-arg-info (see hawopencl_build_options.kernel_arg_info);
+     * otherwise the names and types of the arguments are left NULL.
+     */
+    if (0 < kernel_info->kernel_num_args) {
+        cl_kernel_arg_address_qualifier address_qualifier;
+        err = clGetKernelArgInfo(kernel, 0, CL_KERNEL_ARG_ADDRESS_QUALIFIER,
+                sizeof (address_qualifier), &address_qualifier, NULL);
+        if (CL_KERNEL_ARG_INFO_NOT_AVAILABLE == err)
+            return CL_SUCCESS;
+    }
 
     for (idx = 0; idx < kernel_info->kernel_num_args; idx++) {
         GETARGINFO(kernel, idx, CL_KERNEL_ARG_TYPE_NAME, kernel_info->args[idx].arg_type_name);
@@ -25,6 +25,12 @@
 #ifdef HAVE_SYS_STAT_H
 #  include <sys/stat.h>
 #endif
+#ifdef HAVE_PTHREAD_H
+#  include <pthread.h>
+#endif
+#ifdef HAVE_SYS_MMAN_H
+#  include <sys/mman.h>
+#endif
 
 #if defined(__APPLE__) && defined(__MACH__)
 #  include <OpenCL/opencl.h>
@@ -33,275 +39,82 @@
 #endif
 
 #include "HAWOpenCL.h"
+#include "opencl_internal.h"
 
 #ifndef DEBUG
 #  define DEBUG(x)
 #endif
 
+// Tables of files compiled into the executable by hawopencl_embed_kernels()
+typedef struct {
+    size_t num_kernels;
+    const hawopencl_embedded_kernel * kernels;
+} opencl_kernel_embedded_table;
+
+static opencl_kernel_embedded_table * embedded_tables = NULL;
+static size_t embedded_tables_num = 0;
+
+#if defined(HAVE_PTHREAD_H)
+static pthread_mutex_t embedded_mutex = PTHREAD_MUTEX_INITIALIZER;
+#  define EMBEDDED_LOCK()    pthread_mutex_lock(&embedded_mutex)
+#  define EMBEDDED_UNLOCK()  pthread_mutex_unlock(&embedded_mutex)
+#else
+#  define EMBEDDED_LOCK()
+#  define EMBEDDED_UNLOCK()
+#endif
+
 /*
  * Local functions
  */
-static int opencl_kernel_skip_while(char * buffer, size_t buffer_len, size_t * from, const char * skip_characters);
-static int opencl_kernel_skip_until(char * buffer, size_t buffer_len, size_t * from, const char * skip_characters);
-static int opencl_kernel_build_paths(char ** kernel_paths[]);
-static char * opencl_kernel_replace_include(char * kernel_paths[], const char * kernel_filename, char * buffer, size_t buffer_len);
-static FILE * opencl_kernel_open_file(char * file_paths[],const char * file_name, size_t * file_length);
-static size_t opencl_kernel_read_file(FILE * file, char * buffer, size_t len);
-
-// Skip while buffer contains chars in character set and fail if length is beyond limit
-static int opencl_kernel_skip_while(char * buffer, size_t buffer_len, size_t * from, const char * skip_characters) {
-    assert (NULL != buffer);
-    assert (0 < buffer_len);
-    assert (NULL != from);
-    assert (NULL != skip_characters);
-    size_t i = *from;
-    size_t j;
-    bool skip_character_found = true;
-
-    // go over until the end of Skip-Characters
-    while (i < buffer_len && skip_character_found) {
-        skip_character_found = false;
-        for (j = 0; j < strlen(skip_characters); j++)
-            if (buffer[i] == skip_characters[j])
-                skip_character_found = true;
-        if (skip_character_found)
-            i++;
-    }
-    if (i == buffer_len && !skip_character_found) {
-        fprintf(stderr, "ERROR: Skipping %s searching for skip_characters:%s went over buffer",
-            &buffer[i], skip_characters);
-        FATAL_ERROR("opencl_kernel_skip_while", EINVAL);
-    }
-    *from = i;
-    return skip_character_found;
+static char * opencl_kernel_load_buffer(const char * kernel_file_name, size_t * buffer_len);
+static const char * opencl_kernel_map_file(const char * file_name,
+        struct hawopencl_source_files * files, size_t * length,
+        bool fatal);
+static int opencl_kernel_map_source(const char * kernel_file_name, bool fatal, hawopencl_source * source);
+static FILE * opencl_kernel_open_file(const char * file_name, size_t * file_length);
+static int opencl_kernel_embedded_compare(const void * name, const void * kernel);
+static char * opencl_kernel_embedded_copy(const hawopencl_embedded_kernel * kernel);
+
+static int opencl_kernel_embedded_compare(const void * name, const void * kernel) {
+    return strcmp((const char *) name, ((const hawopencl_embedded_kernel *) kernel)->name);
 }
 
-// Skip until chars in the character set are foun and fail if length is beyond limit
-static int opencl_kernel_skip_until(char * buffer, size_t buffer_len, size_t * from, const char * skip_characters) {
-    assert (NULL != buffer);
-    assert (0 < buffer_len);
-    assert (NULL != from);
-    assert (NULL != skip_characters);
+// Search the registered tables; the tables are sorted by name
+const hawopencl_embedded_kernel * opencl_kernel_embedded_find(const char * file_name) {
+    const hawopencl_embedded_kernel * kernel = NULL;
     size_t i;
-    size_t j;
-    bool skip_character_found = false;
-
-    // go over until the end of Skip-Characters
-    for (i = *from; i < buffer_len; i++) {
-        for (j = 0; j < strlen(skip_characters); j++)
-            if (buffer[i] == skip_characters[j]) {
-                skip_character_found = true;
-                goto out;
-            }
-    }
-out:
-    if (i >= buffer_len && !skip_character_found) {
-        fprintf(stderr, "ERROR: Skipping %s searching for skip_characters:%s went over buffer",
-            &buffer[i], skip_characters);
-        FATAL_ERROR("opencl_kernel_skip_until", EINVAL);
-    }
-    *from = i;
-    return skip_character_found;
-}
 
-static void opencl_kernel_print(char * buffer, size_t len) {
-    printf("buffer:%s\n", buffer);
+    EMBEDDED_LOCK();
+    for (i = 0; i < embedded_tables_num && NULL == kernel; i++)
+        kernel = bsearch(file_name, embedded_tables[i].kernels, embedded_tables[i].num_kernels,
+                         sizeof(hawopencl_embedded_kernel), opencl_kernel_embedded_compare);
+    EMBEDDED_UNLOCK();
+    return kernel;
 }
 
-// Parses buffer, searching for include and checks for any used header files.
-// returns the extended buffer
-static char * opencl_kernel_replace_include(char * kernel_paths[], const char * kernel_filename, char * buffer, size_t buffer_len) {
-    size_t i = 0;
-    #define MAX_INCLUDES 8
-    char * include_filenames[MAX_INCLUDES];
-    char * include_start[MAX_INCLUDES];
-    char * include_end[MAX_INCLUDES];
-    char * include_files[MAX_INCLUDES];
-    size_t include_files_len[MAX_INCLUDES];
-    size_t include_line[MAX_INCLUDES];
-    size_t line_num = 1; // Line numbers start counting with 1!
-
-    size_t includes = 0;
-
-    // We need to check for lines containing the regular expression "[ \t]*#[ \t]*include[ \t] \"FILENAME\""
-    // and copy the filename, as well as the position, whether to enter and replace 
-    for (i = 0; i < buffer_len; i++) {
-        // Check for single-line comments "//", which go until the end of line...
-        if ('/' == buffer[i]) {
-            if (i+1 < buffer_len && '/' == buffer[i+1])         // Single line comments, aka '//'
-                opencl_kernel_skip_until (buffer, buffer_len, &i, "\n");
-            else if (i+1 < buffer_len && '*' == buffer[i+1]) {  // Multi-line comments, aka '/*...*/, counting new-lines
-                // Let's not get fooled by "/*  comments " such as
-                //     /* we do not use #include "file.h" anymore */
-                // Otherwise that would trick us....
-                bool end_comment_found = false;
-                i+=2; // Skip over the /*...
-                while (i < buffer_len && !end_comment_found) {
-                    // Skip until either end of comment (aka */) or there's an EOL
-                    opencl_kernel_skip_until (buffer, buffer_len, &i, "*\n");
-                    if ('\n' == buffer[i]) {
-                        line_num++;
-                        i++;
-                    }
-                    else if (i+1 < buffer_len && '/' == buffer[i+1]) {
-                        end_comment_found = true;
-                        i+=2; // Skip over the */...
-                    } else if ('*' == buffer[i])
-                        i++;  // Skip any '*' which is NOT part of the ending comment
-                }
-            }
-        }
-        if ('\n' == buffer[i])
-            line_num++;
-
-        // We found a preprocessor macro sign
-        if ('#' == buffer[i]) {
-            i++;
-            // Skip over any white-space characters (space and tab), such as in "#  include"
-            opencl_kernel_skip_while (buffer, buffer_len, &i, " \t");
-            // Check whether we now have a "   #[ \t]*include"
-            if (0 == strncmp(&buffer[i], "include", strlen("include"))) {
-                // Yay, we found a filename (but -1, to also replace the '#')
-                include_start[includes] = &buffer[i-1];
-                include_line[includes] = line_num;
-
-                i += strlen("include");
-                // Skip over any white-space characters (space and tab), such as in '#include    "'
-                opencl_kernel_skip_while (buffer, buffer_len, &i, " \t");
-
-                // Check only for local include files #inlude "local.h" not global #include <stdio.h>
-                if ('"' == buffer[i]) {
-                    int len;
-                    i++;                         // Do not include the '"' character
-                    size_t j = i;                   // We start with the filename character array
-                    while (j < buffer_len && '"' != buffer[j]) j++; /* Go over until next closing " */
-                    if (j >= buffer_len)
-                        FATAL_ERROR("opencl_kernel_replace_include: failed to find closing hyphen for file-name", EINVAL);
-
-                    include_end[includes] = &buffer[j]+1;  // we replace until j (aka including the last '"')
-                    len = j - i + 1;                 // but for copying we don't include '"', but (+1) to include the last '\0' aka NUL
-                    include_filenames[includes] = malloc(sizeof(char) * len);
-                    if (NULL == include_filenames[includes])
-                        FATAL_ERROR("malloc", ENOMEM);
-                    strncpy (include_filenames[includes], &buffer[i], len);
-                    include_filenames[includes][len-1] = '\0'; // Be sure to have a NUL-terminated file name
-                    if (++includes == MAX_INCLUDES)
-                        FATAL_ERROR("opencl_kernel_replace_include: too many include files", EINVAL);
-                }
-            }
-        }
-    }
-
-    if (0 == includes) {
-        printf("opencl_kernel_replace_include: No includes good!\n");
-        return buffer;
-    }
-
-    const size_t buffer_olen = buffer_len;
-
-    // Now, that we figured all the include file names, try to search and read those
-    // printf("opencl_kernel_replace_include:       includes:%d\n", includes);
-    const int kernel_filename_len = strlen(kernel_filename);
-    for (i = 0; i < includes; i++) {
-        size_t num_read;
-        // printf("  %d. include:%s\n", i, include_filenames[i]);
-        FILE * file =  opencl_kernel_open_file(kernel_paths, include_filenames[i], &include_files_len[i]);
-        if (NULL == file) {
-            fprintf (stderr, "ERROR in %s(): Cannot find OpenCL include file %s; please set env.-var. OPENCL_KERNEL_PATH to the paths where this .h file may be found\n"
-                             "using colon-notation to separate multiple directories, e.g. use export OPENCL_KERNEL_PATH=$PWD/../src:$PWD/include\n",
-                            __func__, include_filenames[i]);
-            FATAL_ERROR("opencl_kernel_replace_include", ENOENT);
-        }
-
-        include_files[i] = malloc (include_files_len[i]);
-        if (NULL == include_files[i])
-            FATAL_ERROR("malloc", errno);
-        num_read = opencl_kernel_read_file (file, include_files[i], include_files_len[i]);
-        fclose(file);
-        buffer_len += include_files_len[i]; // This disregards the space saved by overriding #include
-        buffer_len += 1 + 1 + 5 + 1 + 1 + kernel_filename_len + 1; // Add space for new CPP-like position informatian: '# LINE-NUMBER(up to 5 digits) "KERNEL_FILE_NAME.c"'
-    }
-
-    char * new_buffer = malloc(buffer_len);
-    if (NULL == new_buffer)
+// Copy the embedded file into a NUL-terminated buffer, to be freed like a file read
+static char * opencl_kernel_embedded_copy(const hawopencl_embedded_kernel * kernel) {
+    char * buffer = malloc(kernel->length + 1);
+    if (NULL == buffer)
         FATAL_ERROR("malloc", ENOMEM);
-    char * p = buffer;
-    char * p_new = new_buffer;
-    char * p_last_start = buffer;
-    for (i = 0; i < includes; i++) {
-        char cpp_buf[1+1+5+1+1+kernel_filename_len+1];
-
-        // Copy from start of last include file (or the beginning of buffer from p to p_new)
-        int len = include_start[i] - p_last_start;
-        strncpy (p_new, p, len);
-        p = include_end[i];
-        p_last_start = include_end[i];
-        p_new += len;
-        strncpy (p_new, include_files[i], include_files_len[i]);
-        p_new += include_files_len[i];
-        len = snprintf(cpp_buf, sizeof(cpp_buf), "# %ld \"%s\"", include_line[i]+1, kernel_filename);
-        strncpy (p_new, cpp_buf, len);
-        p_new += len;
-    }
-    // Copy last part...
-    int len = buffer + buffer_olen - include_end[i-1];
-    strncpy (p_new, p, len);
-    free (buffer);
-
-    // Just for DEBUGGING:
-    // opencl_kernel_print(new_buffer, buffer_len);
+    memcpy(buffer, kernel->source, kernel->length);
+    buffer[kernel->length] = '\0';
+    return buffer;
+}
 
-    return new_buffer;
+static void opencl_kernel_print(char * buffer, size_t len) {
+    printf("buffer:%s\n", buffer);
 }
 
-static FILE * opencl_kernel_open_file(char * file_paths[], const char * file_name, size_t * file_length) {
-    int i;
-    int ret;
+static FILE * opencl_kernel_open_file(const char * file_name, size_t * file_length) {
     FILE * file;
     struct stat file_stat_buf;
-    bool file_found = false;
     char * path;
 
-    int max;
-    // Check for the longest of the file_paths
-    for (i = max = 0; NULL != file_paths[i]; i++) {
-        int len = strlen(file_paths[i]);
-        if (len > max)
-            max = len;
-    }
-    int path_len = max + strlen(file_name) + 2; // +1 for '/', +1 for '\0';
-    path = malloc(path_len * sizeof(char));
+    path = opencl_kernel_find_file(NULL, file_name, &file_stat_buf);
     if (NULL == path)
-        FATAL_ERROR ("malloc", ENOMEM);
-
-    for (i = 0; NULL != file_paths[i]; i++) {
-        DEBUG(printf("opencl_kernel_open_file: Checking for file_name:%s in file_path[%d]:%s\n",
-                file_name, i, file_paths[i]));
-        snprintf(path, path_len, "%s/%s", file_paths[i], file_name);
-        // First check the existence of this file; and some further tests
-        ret = stat (path, &file_stat_buf);
-        if (0 == ret) {
-            printf("opencl_kernel_open_file: Found file_name:%s in file_path[%d]:%s\n",
-                   file_name, i, file_paths[i]);
-
-            file_found = true;
-            break;
-        }
-    }
-    if (!file_found)
         return NULL;
 
-    if (!S_ISREG(file_stat_buf.st_mode)) {
-        fprintf (stderr, "ERROR in %s(): OpenCL file %s is not a regular file.\n",
-                __func__, file_name);
-        FATAL_ERROR("stat", errno);
-    }
-    if (!(file_stat_buf.st_mode & S_IRUSR)) {
-        fprintf (stderr, "ERROR in %s(): OpenCL file %s cannot be opened for reading.\n",
-                __func__, file_name);
-        FATAL_ERROR("stat", errno);
-    }
-    
     // Finally open it
     file = fopen (path, "r");
     if (NULL == file) {
@@ -309,74 +122,18 @@ static FILE * opencl_kernel_open_file(char * file_paths[], const char * file_nam
                 __func__, path);
         FATAL_ERROR("fopen", errno);
     }
+    free(path);
 
-    *file_length = file_stat_buf.st_size;
+    // The index' status may predate an edit of the file; the open file has the actual length
+    if (0 == fstat(fileno(file), &file_stat_buf))
+        *file_length = file_stat_buf.st_size;
+    else
+        FATAL_ERROR("fstat", errno);
 
     return file;
 }
 
-static int opencl_kernel_build_paths(char ** kernel_paths[]) {
-    char ** paths = NULL;
-    int kernel_paths_num = 0;
-    char * kernel_pwd_env = getenv("OPENCL_KERNEL_PATH");
-
-    *kernel_paths = NULL;
-
-    /* First figure out the amount of PATHS in OPENCL_KERNEL_PATH */
-    if (NULL != kernel_pwd_env) {
-        char * pos = kernel_pwd_env-1; // to start with a value != NULL
-        while (NULL != pos) {
-            pos = strchr (pos+1, ':');
-            kernel_paths_num++;
-        }
-    }
-    kernel_paths_num += 3;
-
-    // PLUS one for the last NULL pointer
-    paths = malloc ((kernel_paths_num +1) * sizeof(char*));
-    if (NULL == paths)
-        FATAL_ERROR("malloc", ENOMEM);
-
-    paths[0] = strdup(HAWOPENCL_SOURCE_DIR);
-    paths[1] = strdup(HAWOPENCL_SOURCE_DIR "/src");
-    paths[2] = strdup(HAWOPENCL_SOURCE_DIR "/include");
-    paths[3] = NULL;
-
-    // In case of ENOMEM of any strdup, bail out
-    if (NULL == paths[0] || NULL == paths[1] || NULL == paths[2])
-        FATAL_ERROR("strdup", ENOMEM);
-
-    if (NULL != kernel_pwd_env) {
-        char * pos_start = kernel_pwd_env;
-        char * pos_end = NULL;
-        uint32_t begin;
-        uint32_t num;
-        int i = 3;
-
-        while (NULL != (pos_end = strchr (pos_start, ':'))) {
-            begin = pos_start - kernel_pwd_env;
-            num = pos_end - pos_start;
-            kernel_pwd_env[begin + num] = '\0';
-            paths[i] = strdup (&kernel_pwd_env[begin]);
-            if (NULL == paths[i])
-                FATAL_ERROR("strdup", ENOMEM);
-            pos_start = pos_end+1;
-            i++;
-        }
-        // Copy last path;
-        pos_end = strchr (pos_start, '\0');
-        begin = pos_start - kernel_pwd_env;
-        num = pos_end - pos_start;
-        paths[i] = strdup (&kernel_pwd_env[begin]);
-        if (NULL == paths[i])
-            FATAL_ERROR("strdup", ENOMEM);
-        paths[++i] = NULL;
-    }
-    *kernel_paths = paths;
-    return 0;
-}
-
-static size_t opencl_kernel_read_file(FILE * file, char * buffer, size_t len) {
+size_t opencl_kernel_read_file(FILE * file, char * buffer, size_t len) {
     size_t num_read = 0;
     char * tmp = buffer;
     size_t remain = len;
@@ -394,21 +151,25 @@ static size_t opencl_kernel_read_file(FILE * file, char * buffer, size_t len) {
         tmp += ret;
         remain -= ret;
     }
-    return len;
+    return num_read;
 }
 
-char * opencl_kernel_load(const char * kernel_file_name)
-{
-    char ** kernel_paths;
-    char * kernel_pwd_env;
+// Read the file found in the kernel search paths into a NUL-terminated buffer
+static char * opencl_kernel_load_buffer(const char * kernel_file_name, size_t * buffer_len) {
     char * buffer;
     FILE * file;
     size_t num_read;
     size_t file_length;
+    const hawopencl_embedded_kernel * embedded;
 
-    assert (NULL != kernel_file_name);
-    opencl_kernel_build_paths(&kernel_paths);
-    file = opencl_kernel_open_file(kernel_paths, kernel_file_name, &file_length);
+    // Files compiled into the executable do not need any file access
+    embedded = opencl_kernel_embedded_find(kernel_file_name);
+    if (NULL != embedded) {
+        *buffer_len = embedded->length;
+        return opencl_kernel_embedded_copy(embedded);
+    }
+
+    file = opencl_kernel_open_file(kernel_file_name, &file_length);
     if (NULL == file) {
         fprintf (stderr, "ERROR in %s(): Cannot find OpenCL file %s; please set env.-var. OPENCL_KERNEL_PATH to the paths where the .cl file and any .h file may be found\n"
                          "using colon-notation to separate multiple directories, e.g. use export OPENCL_KERNEL_PATH=$PWD/../src:$PWD/include\n",
@@ -426,5 +187,191 @@ char * opencl_kernel_load(const char * kernel_file_name)
     // Just to make sure, that the last byte is NUL/'\0'
     buffer[num_read] = '\0';
 
-    return opencl_kernel_replace_include(kernel_paths, kernel_file_name, buffer, num_read);
+    *buffer_len = num_read;
+    return buffer;
+}
+
+// Map the kernel file read-only, without mmap() read it; embedded files are used in place.
+// Returns NULL, if the file is missing and the error is not fatal.
+static const char * opencl_kernel_map_file(const char * file_name,
+        struct hawopencl_source_files * files, size_t * length, bool fatal) {
+    const hawopencl_embedded_kernel * embedded;
+    const char * data;
+    bool mapped = false;
+    FILE * file;
+
+    embedded = opencl_kernel_embedded_find(file_name);
+    if (NULL != embedded) {
+        *length = embedded->length;
+        return embedded->source;
+    }
+
+    file = opencl_kernel_open_file(file_name, length);
+    if (NULL == file) {
+        fprintf (stderr, "ERROR in %s(): Cannot find OpenCL file %s; please set env.-var. OPENCL_KERNEL_PATH to the paths where the .cl file and any .h file may be found\n"
+                         "using colon-notation to separate multiple directories, e.g. use export OPENCL_KERNEL_PATH=$PWD/../src:$PWD/include\n",
+                 __func__, file_name);
+        if (fatal)
+            FATAL_ERROR("opencl_kernel_open_file", ENOENT);
+        return NULL;
+    }
+#if defined(HAVE_SYS_MMAN_H)
+    // Empty files cannot be mapped
+    if (0 < *length) {
+        data = mmap(NULL, *length, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+        if (MAP_FAILED == data)
+            FATAL_ERROR("mmap", errno);
+        mapped = true;
+    } else
+#endif
+    {
+        char * buffer = malloc(*length + 1);
+        if (NULL == buffer)
+            FATAL_ERROR("malloc", ENOMEM);
+        *length = opencl_kernel_read_file(file, buffer, *length);
+        data = buffer;
+    }
+    fclose(file);
+
+    files->data = data;
+    files->length = *length;
+    files->mapped = mapped;
+    return data;
+}
+
+char * opencl_kernel_load(const char * kernel_file_name)
+{
+    char * buffer;
+    size_t buffer_len;
+
+    hawopencl_source source;
+    char * new_buffer;
+    char * p_new;
+    cl_uint i;
+
+    assert (NULL != kernel_file_name);
+    buffer = opencl_kernel_load_buffer(kernel_file_name, &buffer_len);
+
+    opencl_kernel_preprocess(kernel_file_name, buffer, buffer_len, true, &source);
+    if (0 == source.files->num_included) {
+        DEBUG(printf("opencl_kernel_load: No includes good!\n"));
+        new_buffer = buffer;
+        buffer = NULL;
+    } else {
+        buffer_len = 0;
+        for (i = 0; i < source.count; i++)
+            buffer_len += source.lengths[i];
+        new_buffer = malloc(buffer_len + 1);
+        if (NULL == new_buffer)
+            FATAL_ERROR("malloc", ENOMEM);
+        p_new = new_buffer;
+        for (i = 0; i < source.count; i++) {
+            memcpy (p_new, source.strings[i], source.lengths[i]);
+            p_new += source.lengths[i];
+        }
+        *p_new = '\0';
+    }
+    opencl_kernel_preprocess_release(&source);
+    free(buffer);
+
+    // Just for DEBUGGING:
+    // opencl_kernel_print(new_buffer, buffer_len);
+
+    return new_buffer;
+}
+
+char * opencl_kernel_load_source(const char * kernel_file_name)
+{
+    char * buffer;
+    size_t buffer_len;
+
+    assert (NULL != kernel_file_name);
+    buffer = opencl_kernel_load_buffer(kernel_file_name, &buffer_len);
+    return buffer;
+}
+
+void * opencl_kernel_load_il(const char * il_file_name, size_t * length)
+{
+    char * buffer;
+
+    assert (NULL != il_file_name);
+    assert (NULL != length);
+    buffer = opencl_kernel_load_buffer(il_file_name, length);
+    return buffer;
+}
+
+int opencl_kernel_register_embedded(size_t num_kernels,
+        const hawopencl_embedded_kernel kernels[])
+{
+    opencl_kernel_embedded_table * tables;
+    size_t i;
+
+    assert (NULL != kernels);
+    for (i = 1; i < num_kernels; i++)
+        if (0 <= strcmp(kernels[i-1].name, kernels[i].name)) {
+            fprintf(stderr, "ERROR in %s(): Embedded kernels are not sorted by name at %s\n",
+                    __func__, kernels[i].name);
+            return CL_INVALID_VALUE;
+        }
+
+    EMBEDDED_LOCK();
+    tables = realloc(embedded_tables, (embedded_tables_num + 1) * sizeof(opencl_kernel_embedded_table));
+    if (NULL == tables)
+        FATAL_ERROR("realloc", ENOMEM);
+    tables[embedded_tables_num].num_kernels = num_kernels;
+    tables[embedded_tables_num].kernels = kernels;
+    embedded_tables = tables;
+    embedded_tables_num++;
+    EMBEDDED_UNLOCK();
+    return CL_SUCCESS;
+}
+
+// Map the kernel file and expand its includes; a missing file is either fatal or returned as error
+static int opencl_kernel_map_source(const char * kernel_file_name, bool fatal, hawopencl_source * source)
+{
+    struct hawopencl_source_files main_file = { 0 };
+    const char * buffer;
+    size_t buffer_len;
+    int err;
+
+    assert (NULL != kernel_file_name);
+    assert (NULL != source);
+    buffer = opencl_kernel_map_file(kernel_file_name, &main_file, &buffer_len, fatal);
+    if (NULL == buffer)
+        return CL_INVALID_VALUE;
+    // The segments point into the mapped file and the cached includes, the text is never copied
+    err = opencl_kernel_preprocess(kernel_file_name, buffer, buffer_len, fatal, source);
+    source->files->data = main_file.data;
+    source->files->length = main_file.length;
+    source->files->mapped = main_file.mapped;
+    if (CL_SUCCESS != err)
+        opencl_kernel_unmap(source);
+    return err;
+}
+
+int opencl_kernel_map(const char * kernel_file_name, hawopencl_source * source)
+{
+    return opencl_kernel_map_source(kernel_file_name, true, source);
+}
+
+int opencl_kernel_map_try(const char * kernel_file_name, hawopencl_source * source)
+{
+    return opencl_kernel_map_source(kernel_file_name, false, source);
+}
+
+void opencl_kernel_unmap(hawopencl_source * source)
+{
+    struct hawopencl_source_files * files;
+
+    assert (NULL != source);
+    files = source->files;
+    if (NULL != files && NULL != files->data) {
+#if defined(HAVE_SYS_MMAN_H)
+        if (files->mapped)
+            munmap((void *) files->data, files->length);
+        else
+#endif
+            free((char *) files->data);
+    }
+    opencl_kernel_preprocess_release(source);
 }
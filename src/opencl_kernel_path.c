@@ -0,0 +1,382 @@
+//
+//  opencl_kernel_path.c : Part of libHAWOpenCL
+//
+//  Process-wide index of the files in the kernel search paths, so that
+//  finding a file needs neither a stat() per directory nor any other syscall.
+//
+//  Copyright (c) 2018-2022 Rainer Keller, HS Esslingen. All rights reserved.
+//
+#include "HAWOpenCL_config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <stdint.h>
+#include <time.h>
+#ifdef HAVE_STDBOOL_H
+#  include <stdbool.h>
+#endif
+#ifdef HAVE_STDLIB_H
+#  include <stdlib.h>
+#endif
+#ifdef HAVE_SYS_TYPES_H
+#  include <sys/types.h>
+#endif
+#ifdef HAVE_SYS_STAT_H
+#  include <sys/stat.h>
+#endif
+#ifdef HAVE_DIRENT_H
+#  include <dirent.h>
+#endif
+#ifdef HAVE_PTHREAD_H
+#  include <pthread.h>
+#endif
+
+#if defined(__APPLE__) && defined(__MACH__)
+#  include <OpenCL/opencl.h>
+#else
+#  include <CL/cl.h>
+#endif
+
+#include "HAWOpenCL.h"
+#include "opencl_internal.h"
+
+#ifndef DEBUG
+#  define DEBUG(x)
+#endif
+
+// A file of an indexed directory; its status is taken upon the first lookup
+typedef struct {
+    char * name;
+    bool stat_valid;
+    struct stat stat_buf;
+} opencl_kernel_path_file;
+
+// The listing of a directory as hash set of the file names
+typedef struct opencl_kernel_path_dir {
+    char * path;
+    bool exists;
+    time_t mtime;
+    time_t listed;                      // When the listing was read
+    size_t table_size;                  // A power of two, at least twice the number of files
+    opencl_kernel_path_file * table;    // Open addressing, unused entries have name NULL
+    struct opencl_kernel_path_dir * next;
+} opencl_kernel_path_dir;
+
+static char * paths_env = NULL;         // The OPENCL_KERNEL_PATH the roots were parsed from
+static bool paths_initialized = false;
+static char ** roots = NULL;            // The NULL-terminated search paths
+static opencl_kernel_path_dir * dirs = NULL;
+
+// Kernels may be loaded concurrently
+#if defined(HAVE_PTHREAD_H)
+static pthread_mutex_t paths_mutex = PTHREAD_MUTEX_INITIALIZER;
+#  define PATHS_LOCK()    pthread_mutex_lock(&paths_mutex)
+#  define PATHS_UNLOCK()  pthread_mutex_unlock(&paths_mutex)
+#else
+#  define PATHS_LOCK()
+#  define PATHS_UNLOCK()
+#endif
+
+/*
+ * Local functions
+ */
+static void opencl_kernel_path_roots(void);
+static void opencl_kernel_path_list(opencl_kernel_path_dir * dir);
+static void opencl_kernel_path_clear(opencl_kernel_path_dir * dir);
+static opencl_kernel_path_dir * opencl_kernel_path_dir_get(const char * path, size_t len);
+static opencl_kernel_path_file * opencl_kernel_path_lookup(const char * dir_path, size_t dir_len,
+        const char * base_name);
+static bool opencl_kernel_path_revalidate(void);
+
+// Parse the search paths: the source directory and OPENCL_KERNEL_PATH, separated by ':'
+static void opencl_kernel_path_roots(void) {
+    const char * env = getenv("OPENCL_KERNEL_PATH");
+    const char * pos;
+    int num = 3;
+    int i;
+
+    paths_initialized = true;
+    if (NULL != roots) {
+        for (i = 0; NULL != roots[i]; i++)
+            free(roots[i]);
+        free(roots);
+    }
+    free(paths_env);
+    paths_env = NULL;
+
+    if (NULL != env) {
+        paths_env = strdup(env);
+        if (NULL == paths_env)
+            FATAL_ERROR("strdup", ENOMEM);
+        for (pos = env; NULL != pos; pos = strchr(pos + 1, ':'))
+            num++;
+    }
+    // PLUS one for the last NULL pointer
+    roots = malloc((num + 1) * sizeof(char *));
+    if (NULL == roots)
+        FATAL_ERROR("malloc", ENOMEM);
+    roots[0] = strdup(HAWOPENCL_SOURCE_DIR);
+    roots[1] = strdup(HAWOPENCL_SOURCE_DIR "/src");
+    roots[2] = strdup(HAWOPENCL_SOURCE_DIR "/include");
+    i = 3;
+    // Copy every path; the environment itself is left untouched
+    for (pos = env; NULL != pos; ) {
+        const char * end = strchr(pos, ':');
+        const size_t len = (NULL != end) ? (size_t) (end - pos) : strlen(pos);
+        roots[i] = malloc(len + 1);
+        if (NULL == roots[i])
+            FATAL_ERROR("malloc", ENOMEM);
+        memcpy(roots[i], pos, len);
+        roots[i][len] = '\0';
+        i++;
+        pos = (NULL != end) ? end + 1 : NULL;
+    }
+    roots[i] = NULL;
+    if (NULL == roots[0] || NULL == roots[1] || NULL == roots[2])
+        FATAL_ERROR("strdup", ENOMEM);
+}
+
+static void opencl_kernel_path_clear(opencl_kernel_path_dir * dir) {
+    size_t i;
+    for (i = 0; i < dir->table_size; i++)
+        free(dir->table[i].name);
+    free(dir->table);
+    dir->table = NULL;
+    dir->table_size = 0;
+}
+
+// (Re-)read the directory's listing into its hash set
+static void opencl_kernel_path_list(opencl_kernel_path_dir * dir) {
+    struct stat stat_buf;
+
+    opencl_kernel_path_clear(dir);
+    dir->exists = (0 == stat(dir->path, &stat_buf) && S_ISDIR(stat_buf.st_mode));
+    if (!dir->exists)
+        return;
+    dir->mtime = stat_buf.st_mtime;
+    dir->listed = time(NULL);
+
+#if defined(HAVE_DIRENT_H)
+    {
+        DIR * d = opendir(dir->path);
+        struct dirent * entry;
+        size_t num = 0;
+
+        if (NULL == d) {
+            dir->exists = false;
+            return;
+        }
+        while (NULL != readdir(d))
+            num++;
+        rewinddir(d);
+        for (dir->table_size = 16; dir->table_size < 2 * num; dir->table_size *= 2)
+            ;
+        dir->table = calloc(dir->table_size, sizeof(opencl_kernel_path_file));
+        if (NULL == dir->table)
+            FATAL_ERROR("calloc", ENOMEM);
+        // Entries created meanwhile are not indexed, if the table would be more than half full
+        while (0 < num-- && NULL != (entry = readdir(d))) {
+            const size_t len = strlen(entry->d_name);
+            size_t i = opencl_hash_fnv1a(OPENCL_HASH_FNV1A_INIT, entry->d_name, len) & (dir->table_size - 1);
+            while (NULL != dir->table[i].name)
+                i = (i + 1) & (dir->table_size - 1);
+            dir->table[i].name = strdup(entry->d_name);
+            if (NULL == dir->table[i].name)
+                FATAL_ERROR("strdup", ENOMEM);
+        }
+        closedir(d);
+    }
+#endif
+}
+
+// Get the index of the directory, listing it upon first use
+static opencl_kernel_path_dir * opencl_kernel_path_dir_get(const char * path, size_t len) {
+    opencl_kernel_path_dir * dir;
+
+    for (dir = dirs; NULL != dir; dir = dir->next)
+        if (len == strlen(dir->path) && 0 == strncmp(dir->path, path, len))
+            return dir;
+
+    dir = calloc(1, sizeof(opencl_kernel_path_dir));
+    if (NULL == dir)
+        FATAL_ERROR("calloc", ENOMEM);
+    dir->path = malloc(len + 1);
+    if (NULL == dir->path)
+        FATAL_ERROR("malloc", ENOMEM);
+    memcpy(dir->path, path, len);
+    dir->path[len] = '\0';
+    opencl_kernel_path_list(dir);
+    dir->next = dirs;
+    dirs = dir;
+    return dir;
+}
+
+// Look up the regular file base_name in the directory; called with the lock held
+static opencl_kernel_path_file * opencl_kernel_path_lookup(const char * dir_path, size_t dir_len,
+        const char * base_name) {
+    opencl_kernel_path_dir * dir = opencl_kernel_path_dir_get(dir_path, dir_len);
+    opencl_kernel_path_file * file = NULL;
+    size_t i;
+
+    if (!dir->exists)
+        return NULL;
+#if defined(HAVE_DIRENT_H)
+    i = opencl_hash_fnv1a(OPENCL_HASH_FNV1A_INIT, base_name, strlen(base_name)) & (dir->table_size - 1);
+    for (; NULL != dir->table[i].name; i = (i + 1) & (dir->table_size - 1))
+        if (0 == strcmp(dir->table[i].name, base_name)) {
+            file = &dir->table[i];
+            break;
+        }
+    if (NULL == file)
+        return NULL;
+#else
+    // Without directory listings, remember the files found so far
+    (void) i;
+    {
+        opencl_kernel_path_file * table;
+        for (i = 0; i < dir->table_size; i++)
+            if (0 == strcmp(dir->table[i].name, base_name))
+                return S_ISREG(dir->table[i].stat_buf.st_mode) ? &dir->table[i] : NULL;
+        table = realloc(dir->table, (dir->table_size + 1) * sizeof(opencl_kernel_path_file));
+        if (NULL == table)
+            FATAL_ERROR("realloc", ENOMEM);
+        dir->table = table;
+        file = &dir->table[dir->table_size++];
+        file->name = strdup(base_name);
+        file->stat_valid = false;
+        if (NULL == file->name)
+            FATAL_ERROR("strdup", ENOMEM);
+    }
+#endif
+
+    if (!file->stat_valid) {
+        char * path = malloc(dir_len + 1 + strlen(base_name) + 1);
+        if (NULL == path)
+            FATAL_ERROR("malloc", ENOMEM);
+        sprintf(path, "%s/%s", dir->path, base_name);
+        if (0 != stat(path, &file->stat_buf))
+            memset(&file->stat_buf, 0, sizeof(struct stat));
+        file->stat_valid = true;
+        free(path);
+    }
+    if (!S_ISREG(file->stat_buf.st_mode))
+        return NULL;
+    if (!(file->stat_buf.st_mode & S_IRUSR)) {
+        fprintf (stderr, "ERROR in %s(): OpenCL file %s/%s cannot be opened for reading.\n",
+                __func__, dir->path, base_name);
+        FATAL_ERROR("stat", EACCES);
+    }
+    return file;
+}
+
+// Re-list the directories changed since they were indexed; called with the lock held.
+// Returns true, if anything changed
+static bool opencl_kernel_path_revalidate(void) {
+    const char * env = getenv("OPENCL_KERNEL_PATH");
+    opencl_kernel_path_dir * dir;
+    struct stat stat_buf;
+    bool changed = false;
+
+    if ((NULL == env) != (NULL == paths_env) ||
+        (NULL != env && 0 != strcmp(env, paths_env))) {
+        opencl_kernel_path_roots();
+        changed = true;
+    }
+    for (dir = dirs; NULL != dir; dir = dir->next) {
+        const bool exists = (0 == stat(dir->path, &stat_buf) && S_ISDIR(stat_buf.st_mode));
+        // Changes within the second of listing do not show in the mtime
+        if (exists != dir->exists ||
+            (exists && (stat_buf.st_mtime != dir->mtime || dir->mtime >= dir->listed))) {
+            opencl_kernel_path_list(dir);
+            changed = true;
+        }
+    }
+    return changed;
+}
+
+char * opencl_kernel_find_file(const char * first_dir,
+        const char * file_name,
+        struct stat * stat_buf) {
+    const opencl_kernel_path_file * file = NULL;
+    const char * base_name = strrchr(file_name, '/');
+    const char * found_dir = NULL;
+    size_t sub_len;
+    size_t found_len = 0;
+    char * path = NULL;
+    bool retry = true;
+    int i;
+
+    assert (NULL != file_name);
+    // A file name like "test/vector_add.cl" is looked up in the subdirectory "test"
+    sub_len = (NULL != base_name) ? (size_t) (base_name - file_name) : 0;
+    base_name = (NULL != base_name) ? base_name + 1 : file_name;
+
+    PATHS_LOCK();
+    if (!paths_initialized)
+        opencl_kernel_path_roots();
+    while (NULL == file) {
+        char * dir_path = NULL;
+
+        if ('/' == file_name[0]) {
+            // Absolute file names are not searched
+            found_dir = file_name;
+            found_len = sub_len;
+            file = opencl_kernel_path_lookup(found_dir, found_len, base_name);
+        }
+        for (i = -1; NULL == file && '/' != file_name[0] && (i < 0 || NULL != roots[i]); i++) {
+            const char * root = (i < 0) ? first_dir : roots[i];
+            size_t root_len;
+            if (NULL == root)
+                continue;
+            root_len = strlen(root);
+            free(dir_path);
+            dir_path = malloc(root_len + 1 + sub_len + 1);
+            if (NULL == dir_path)
+                FATAL_ERROR("malloc", ENOMEM);
+            memcpy(dir_path, root, root_len);
+            found_len = root_len;
+            if (0 < sub_len) {
+                dir_path[found_len++] = '/';
+                memcpy(dir_path + found_len, file_name, sub_len);
+                found_len += sub_len;
+            }
+            dir_path[found_len] = '\0';
+            DEBUG(printf("opencl_kernel_find_file: Checking for file_name:%s in %s\n", base_name, dir_path));
+            file = opencl_kernel_path_lookup(dir_path, found_len, base_name);
+        }
+        if (NULL != file) {
+            path = malloc(found_len + 1 + strlen(base_name) + 1);
+            if (NULL == path)
+                FATAL_ERROR("malloc", ENOMEM);
+            if ('/' == file_name[0])
+                sprintf(path, "%.*s/%s", (int) found_len, found_dir, base_name);
+            else
+                sprintf(path, "%s/%s", dir_path, base_name);
+            *stat_buf = file->stat_buf;
+            printf("opencl_kernel_find_file: Found file_name:%s in %s\n", file_name, path);
+        }
+        free(dir_path);
+        // Only upon a miss, check whether any directory changed meanwhile
+        if (NULL == file && !(retry && opencl_kernel_path_revalidate()))
+            break;
+        retry = false;
+    }
+    PATHS_UNLOCK();
+    return path;
+}
+
+void opencl_kernel_path_refresh(void) {
+    opencl_kernel_path_dir * dir;
+
+    PATHS_LOCK();
+    while (NULL != (dir = dirs)) {
+        dirs = dir->next;
+        opencl_kernel_path_clear(dir);
+        free(dir->path);
+        free(dir);
+    }
+    paths_initialized = false;
+    PATHS_UNLOCK();
+}
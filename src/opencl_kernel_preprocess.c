@@ -0,0 +1,499 @@
+//
+//  opencl_kernel_preprocess.c : Part of libHAWOpenCL
+//
+//  Expansion of #include "..." into the segments of a hawopencl_source,
+//  using a process-wide cache of the included files.
+//
+//  Copyright (c) 2018-2022 Rainer Keller, HS Esslingen. All rights reserved.
+//
+#include "HAWOpenCL_config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <ctype.h>
+#ifdef HAVE_STDBOOL_H
+#  include <stdbool.h>
+#endif
+#ifdef HAVE_STDLIB_H
+#  include <stdlib.h>
+#endif
+#ifdef HAVE_SYS_TYPES_H
+#  include <sys/types.h>
+#endif
+#ifdef HAVE_SYS_STAT_H
+#  include <sys/stat.h>
+#endif
+#ifdef HAVE_PTHREAD_H
+#  include <pthread.h>
+#endif
+
+#if defined(__APPLE__) && defined(__MACH__)
+#  include <OpenCL/opencl.h>
+#else
+#  include <CL/cl.h>
+#endif
+
+#include "HAWOpenCL.h"
+#include "opencl_internal.h"
+
+// Deeper nesting is taken to be a recursive include without guard
+#define MAX_INCLUDE_DEPTH 64
+
+// Length of the directive '#line LINE-NUMBER "FILE_NAME"\n' incl. NUL
+#define LINE_DIRECTIVE_LEN(file_name) (6 + 20 + 2 + strlen(file_name) + 1 + 1 + 1)
+
+// Returned by opencl_kernel_include_resolve() for a missing file, unless fatal
+#define INCLUDE_NOT_FOUND ((size_t) -1)
+
+// A header file read from disk, shared by all sources including it
+typedef struct opencl_kernel_header {
+    char * path;
+    time_t mtime;
+    off_t size;
+    char * data;
+    unsigned int refcount;          // The cache's and every including source's reference
+    struct opencl_kernel_header * next;
+} opencl_kernel_header;
+
+// A file included into a source
+struct opencl_kernel_included {
+    char * id;                      // The resolved path, or the name of an embedded file
+    const char * data;
+    size_t length;
+    opencl_kernel_header * header;  // NULL for embedded files
+    bool once;                      // Has #pragma once or an include guard around all of the file
+};
+
+static opencl_kernel_header * headers = NULL;
+
+// Kernels may be loaded concurrently
+#if defined(HAVE_PTHREAD_H)
+static pthread_mutex_t headers_mutex = PTHREAD_MUTEX_INITIALIZER;
+#  define HEADERS_LOCK()    pthread_mutex_lock(&headers_mutex)
+#  define HEADERS_UNLOCK()  pthread_mutex_unlock(&headers_mutex)
+#else
+#  define HEADERS_LOCK()
+#  define HEADERS_UNLOCK()
+#endif
+
+/*
+ * Local functions
+ */
+static opencl_kernel_header * opencl_kernel_header_get(const char * path, bool fatal);
+static void opencl_kernel_header_release(opencl_kernel_header * header);
+static void opencl_kernel_segment(hawopencl_source * source, const char * string, size_t length);
+static void opencl_kernel_line(hawopencl_source * source, size_t line, const char * file_name, bool newline);
+static size_t opencl_kernel_include_resolve(hawopencl_source * source,
+        const char * includer_path, const char * file_name);
+static bool opencl_kernel_preprocess_file(hawopencl_source * source,
+        const char * file_name, const char * path, const char * buffer, size_t buffer_len, int depth);
+
+// Get the header at path from the cache, (re-)reading it if it is new or changed; called with the lock held.
+// Returns NULL, if the file cannot be opened anymore and the error is not fatal.
+static opencl_kernel_header * opencl_kernel_header_get(const char * path, bool fatal) {
+    opencl_kernel_header * header;
+    opencl_kernel_header ** prev;
+    struct stat stat_buf;
+    FILE * file;
+
+    // The index' status may predate an edit of the file; the open file has the actual one
+    file = fopen(path, "r");
+    if (NULL == file || 0 != fstat(fileno(file), &stat_buf)) {
+        fprintf(stderr, "ERROR in %s(): Cannot open OpenCL include file %s\n", __func__, path);
+        if (fatal)
+            FATAL_ERROR("fopen", errno);
+        if (NULL != file)
+            fclose(file);
+        return NULL;
+    }
+
+    for (prev = &headers; NULL != (header = *prev); prev = &header->next)
+        if (0 == strcmp(header->path, path))
+            break;
+    if (NULL != header && (header->mtime != stat_buf.st_mtime || header->size != stat_buf.st_size)) {
+        // The header changed: sources still including the old one keep it until released
+        *prev = header->next;
+        opencl_kernel_header_release(header);
+        header = NULL;
+    }
+
+    if (NULL == header) {
+        header = calloc(1, sizeof(opencl_kernel_header));
+        if (NULL == header)
+            FATAL_ERROR("calloc", ENOMEM);
+        header->path = strdup(path);
+        header->data = malloc(stat_buf.st_size + 1);
+        if (NULL == header->path || NULL == header->data)
+            FATAL_ERROR("malloc", ENOMEM);
+        header->size = opencl_kernel_read_file(file, header->data, stat_buf.st_size);
+        header->data[header->size] = '\0';
+        header->mtime = stat_buf.st_mtime;
+        header->refcount = 1;
+        header->next = headers;
+        headers = header;
+    }
+    fclose(file);
+    header->refcount++;
+    return header;
+}
+
+// Release one reference of header; called with the lock held
+static void opencl_kernel_header_release(opencl_kernel_header * header) {
+    if (0 < --header->refcount)
+        return;
+    free(header->path);
+    free(header->data);
+    free(header);
+}
+
+// Add the segment to source, leaving out empty ones
+static void opencl_kernel_segment(hawopencl_source * source, const char * string, size_t length) {
+    struct hawopencl_source_files * files = source->files;
+
+    if (0 == length)
+        return;
+    if (source->count == files->max_segments) {
+        files->max_segments = (0 == files->max_segments) ? 16 : 2 * files->max_segments;
+        source->strings = realloc(source->strings, files->max_segments * sizeof(char *));
+        source->lengths = realloc(source->lengths, files->max_segments * sizeof(size_t));
+        if (NULL == source->strings || NULL == source->lengths)
+            FATAL_ERROR("realloc", ENOMEM);
+    }
+    source->strings[source->count] = string;
+    source->lengths[source->count] = length;
+    source->count++;
+}
+
+// Add the directive '#line line "file_name"' as segment
+static void opencl_kernel_line(hawopencl_source * source, size_t line, const char * file_name, bool newline) {
+    struct hawopencl_source_files * files = source->files;
+    const size_t len = LINE_DIRECTIVE_LEN(file_name);
+    char * directive = malloc(len);
+    char ** lines = realloc(files->lines, (files->num_lines + 1) * sizeof(char *));
+
+    if (NULL == directive || NULL == lines)
+        FATAL_ERROR("malloc", ENOMEM);
+    files->lines = lines;
+    files->lines[files->num_lines++] = directive;
+    opencl_kernel_segment(source, directive,
+            snprintf(directive, len, "#line %zu \"%s\"%s", line, file_name, newline ? "\n" : ""));
+}
+
+// Find the file to include: embedded files first, then next to the including file,
+// then in the kernel search paths. Returns the index in the source's included files,
+// or INCLUDE_NOT_FOUND if the file is missing and source->files->fatal is not set.
+static size_t opencl_kernel_include_resolve(hawopencl_source * source,
+        const char * includer_path, const char * file_name) {
+    struct hawopencl_source_files * files = source->files;
+    struct opencl_kernel_included * included;
+    const hawopencl_embedded_kernel * embedded;
+    opencl_kernel_header * header = NULL;
+    struct stat stat_buf;
+    char * path = NULL;
+    const char * id;
+    size_t i;
+
+    embedded = opencl_kernel_embedded_find(file_name);
+    if (NULL != embedded) {
+        id = file_name;
+    } else {
+        const char * slash = (NULL != includer_path) ? strrchr(includer_path, '/') : NULL;
+        char * includer_dir = NULL;
+        if (NULL != slash) {
+            includer_dir = strndup(includer_path, slash - includer_path);
+            if (NULL == includer_dir)
+                FATAL_ERROR("strndup", ENOMEM);
+        }
+        path = opencl_kernel_find_file(includer_dir, file_name, &stat_buf);
+        free(includer_dir);
+        if (NULL == path) {
+            fprintf (stderr, "ERROR in %s(): Cannot find OpenCL include file %s; please set env.-var. OPENCL_KERNEL_PATH to the paths where this .h file may be found\n"
+                             "using colon-notation to separate multiple directories, e.g. use export OPENCL_KERNEL_PATH=$PWD/../src:$PWD/include\n",
+                            __func__, file_name);
+            if (files->fatal)
+                FATAL_ERROR("opencl_kernel_include_resolve", ENOENT);
+            files->failed = true;
+            return INCLUDE_NOT_FOUND;
+        }
+        id = path;
+    }
+
+    for (i = 0; i < files->num_included; i++)
+        if (0 == strcmp(files->included[i].id, id)) {
+            free(path);
+            return i;
+        }
+
+    // Read the header before adding it, it may have been removed since being found
+    if (NULL == embedded) {
+        HEADERS_LOCK();
+        header = opencl_kernel_header_get(path, files->fatal);
+        HEADERS_UNLOCK();
+        if (NULL == header) {
+            free(path);
+            files->failed = true;
+            return INCLUDE_NOT_FOUND;
+        }
+    }
+
+    included = realloc(files->included, (files->num_included + 1) * sizeof(struct opencl_kernel_included));
+    if (NULL == included)
+        FATAL_ERROR("realloc", ENOMEM);
+    files->included = included;
+    included = &files->included[files->num_included];
+    included->once = false;
+    if (NULL != embedded) {
+        included->id = strdup(id);
+        if (NULL == included->id)
+            FATAL_ERROR("strdup", ENOMEM);
+        included->header = NULL;
+        included->data = embedded->source;
+        included->length = embedded->length;
+    } else {
+        included->id = path;
+        included->header = header;
+        included->data = included->header->data;
+        included->length = included->header->size;
+    }
+    return files->num_included++;
+}
+
+// Single pass over buffer, adding the text as segments and expanding
+// #include "..." recursively, outside of comments and literals.
+// #pragma once is removed; conditionals are not evaluated.
+// Returns true, if the file is to be included only once.
+static bool opencl_kernel_preprocess_file(hawopencl_source * source,
+        const char * file_name, const char * path, const char * buffer, size_t buffer_len, int depth) {
+    size_t i = 0;
+    size_t line_num = 1;        // Line numbers start counting with 1!
+    size_t last_end = 0;        // Start of the text not yet added as segment
+    bool line_start = true;     // Only white-space since the beginning of the line
+    bool in_directive = false;
+    bool pragma_once = false;
+    int cond_depth = 0;         // Nesting of #if, #ifdef and #ifndef
+    enum { GUARD_NONE_YET, GUARD_OPEN, GUARD_CLOSED, GUARD_INVALID } guard = GUARD_NONE_YET;
+
+    if (MAX_INCLUDE_DEPTH < depth) {
+        fprintf(stderr, "ERROR in %s(): Includes nested too deeply in %s; recursive include without guard?\n",
+                __func__, file_name);
+        if (source->files->fatal)
+            FATAL_ERROR("opencl_kernel_preprocess_file", EINVAL);
+        source->files->failed = true;
+        return false;
+    }
+
+    while (i < buffer_len) {
+        const char c = buffer[i];
+
+        if ('\n' == c) {
+            line_num++;
+            line_start = true;
+            in_directive = false;
+            i++;
+            continue;
+        }
+        if (' ' == c || '\t' == c || '\r' == c || '\f' == c || '\v' == c) {
+            i++;
+            continue;
+        }
+        if ('\\' == c && i+1 < buffer_len && '\n' == buffer[i+1]) {  // Continued line
+            line_num++;
+            i += 2;
+            continue;
+        }
+        if ('/' == c && i+1 < buffer_len && '/' == buffer[i+1]) {    // Single line comments, aka '//'
+            while (i < buffer_len && '\n' != buffer[i])
+                i++;
+            continue;
+        }
+        if ('/' == c && i+1 < buffer_len && '*' == buffer[i+1]) {    // Multi-line comments, counting new-lines
+            for (i += 2; i < buffer_len && !('*' == buffer[i] && i+1 < buffer_len && '/' == buffer[i+1]); i++)
+                if ('\n' == buffer[i])
+                    line_num++;
+            i = (i + 2 < buffer_len) ? i + 2 : buffer_len;
+            continue;
+        }
+
+        if ('#' == c && line_start) {
+            const size_t start = i;
+            size_t name_start;
+            size_t name_len;
+
+            line_start = false;
+            in_directive = true;
+            for (i++; i < buffer_len && (' ' == buffer[i] || '\t' == buffer[i]); i++)
+                ;
+            for (name_start = i; i < buffer_len && isalpha((unsigned char) buffer[i]); i++)
+                ;
+            name_len = i - name_start;
+#define DIRECTIVE(d)  (strlen(d) == name_len && 0 == strncmp(&buffer[name_start], (d), name_len))
+            // Anything following the #endif of the guard
+            if (GUARD_CLOSED == guard)
+                guard = GUARD_INVALID;
+
+            if (DIRECTIVE("include")) {
+                for (; i < buffer_len && (' ' == buffer[i] || '\t' == buffer[i]); i++)
+                    ;
+                // Check only for local include files #include "local.h" not global #include <stdio.h>
+                if (i < buffer_len && '"' == buffer[i]) {
+                    struct opencl_kernel_included * included;
+                    size_t index;
+                    size_t j;
+                    char * include_name;
+
+                    for (j = ++i; j < buffer_len && '"' != buffer[j] && '\n' != buffer[j]; j++)
+                        ;
+                    if (j >= buffer_len || '"' != buffer[j]) {
+                        if (source->files->fatal)
+                            FATAL_ERROR("opencl_kernel_preprocess_file: failed to find closing quote for file-name", EINVAL);
+                        fprintf(stderr, "ERROR in %s(): Failed to find closing quote for file-name in %s\n",
+                                __func__, file_name);
+                        source->files->failed = true;
+                        return false;
+                    }
+                    include_name = malloc(j - i + 1);
+                    if (NULL == include_name)
+                        FATAL_ERROR("malloc", ENOMEM);
+                    memcpy(include_name, &buffer[i], j - i);
+                    include_name[j - i] = '\0';
+                    i = j + 1;
+
+                    opencl_kernel_segment(source, &buffer[last_end], start - last_end);
+                    last_end = i;
+                    index = opencl_kernel_include_resolve(source, path, include_name);
+                    if (INCLUDE_NOT_FOUND == index) {
+                        free(include_name);
+                        return false;
+                    }
+                    included = &source->files->included[index];
+                    // Files with #pragma once or an include guard are included only once
+                    if (!included->once) {
+                        const char * data = included->data;
+                        const size_t length = included->length;
+                        bool once;
+
+                        opencl_kernel_line(source, 1, include_name, true);
+                        once = opencl_kernel_preprocess_file(source, include_name,
+                                (NULL != included->header) ? included->header->path : NULL,
+                                data, length, depth + 1);
+                        if (source->files->failed) {
+                            free(include_name);
+                            return false;
+                        }
+                        // The array of included files may have been reallocated by nested includes
+                        source->files->included[index].once = once;
+                        if (0 < length && '\n' != data[length - 1])
+                            opencl_kernel_segment(source, "\n", 1);
+                        // Followed by the rest of the line of the #include
+                        opencl_kernel_line(source, line_num + 1, file_name, false);
+                    }
+                    free(include_name);
+                }
+            } else if (DIRECTIVE("pragma")) {
+                for (; i < buffer_len && (' ' == buffer[i] || '\t' == buffer[i]); i++)
+                    ;
+                if (i + 4 <= buffer_len && 0 == strncmp(&buffer[i], "once", 4) &&
+                    (i + 4 == buffer_len || !(isalnum((unsigned char) buffer[i+4]) || '_' == buffer[i+4]))) {
+                    // Remove it, the compiler would warn about #pragma once in the main file
+                    pragma_once = true;
+                    opencl_kernel_segment(source, &buffer[last_end], start - last_end);
+                    i += 4;
+                    last_end = i;
+                }
+                if (GUARD_NONE_YET == guard)
+                    guard = GUARD_INVALID;
+            } else if (DIRECTIVE("if") || DIRECTIVE("ifdef") || DIRECTIVE("ifndef")) {
+                if (GUARD_NONE_YET == guard)
+                    guard = DIRECTIVE("ifndef") ? GUARD_OPEN : GUARD_INVALID;
+                cond_depth++;
+            } else if (DIRECTIVE("else") || DIRECTIVE("elif")) {
+                if (GUARD_OPEN == guard && 1 == cond_depth)
+                    guard = GUARD_INVALID;
+            } else if (DIRECTIVE("endif")) {
+                cond_depth--;
+                if (GUARD_OPEN == guard && 0 == cond_depth)
+                    guard = GUARD_CLOSED;
+            } else if (GUARD_NONE_YET == guard) {
+                guard = GUARD_INVALID;
+            }
+#undef DIRECTIVE
+            continue;
+        }
+
+        // Any other character outside of a directive is code
+        line_start = false;
+        if (!in_directive && GUARD_OPEN != guard)
+            guard = GUARD_INVALID;
+        // Skip over string and character literals, which may contain "/*"
+        if ('"' == c || '\'' == c) {
+            for (i++; i < buffer_len && c != buffer[i] && '\n' != buffer[i]; i++)
+                if ('\\' == buffer[i])
+                    i++;
+        }
+        i++;
+    }
+    if (last_end < buffer_len)
+        opencl_kernel_segment(source, &buffer[last_end], buffer_len - last_end);
+    return pragma_once || GUARD_CLOSED == guard;
+}
+
+int opencl_kernel_preprocess(const char * kernel_file_name,
+        const char * buffer,
+        size_t buffer_len,
+        bool fatal,
+        hawopencl_source * source) {
+    assert (NULL != buffer);
+
+    source->count = 0;
+    source->strings = NULL;
+    source->lengths = NULL;
+    source->files = calloc(1, sizeof(struct hawopencl_source_files));
+    if (NULL == source->files)
+        FATAL_ERROR("calloc", ENOMEM);
+    source->files->fatal = fatal;
+
+    opencl_kernel_preprocess_file(source, kernel_file_name, NULL, buffer, buffer_len, 0);
+    if (source->files->failed)
+        return CL_INVALID_VALUE;
+    if (0 == source->count) {
+        // An empty file; a length of 0 denotes a NUL-terminated string
+        opencl_kernel_segment(source, "", 1);
+        source->lengths[0] = 0;
+    }
+    return CL_SUCCESS;
+}
+
+const char * opencl_kernel_preprocess_dependency(const hawopencl_source * source, size_t i) {
+    assert (i < source->files->num_included);
+    if (NULL == source->files->included[i].header)
+        return NULL;
+    return source->files->included[i].id;
+}
+
+void opencl_kernel_preprocess_release(hawopencl_source * source) {
+    struct hawopencl_source_files * files = source->files;
+    size_t i;
+
+    if (NULL != files) {
+        for (i = 0; i < files->num_lines; i++)
+            free(files->lines[i]);
+        free(files->lines);
+        HEADERS_LOCK();
+        for (i = 0; i < files->num_included; i++) {
+            free(files->included[i].id);
+            if (NULL != files->included[i].header)
+                opencl_kernel_header_release(files->included[i].header);
+        }
+        HEADERS_UNLOCK();
+        free(files->included);
+        free(files);
+    }
+    free(source->strings);
+    free(source->lengths);
+    source->count = 0;
+    source->strings = NULL;
+    source->lengths = NULL;
+    source->files = NULL;
+}
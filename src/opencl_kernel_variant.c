@@ -0,0 +1,300 @@
+//
+//  opencl_kernel_variant.c : Part of libHAWOpenCL
+//
+//  Build variants of one source specialized by -DNAME=VALUE definitions
+//  on first use and keep them in a table keyed by the sorted definitions.
+//
+//  Copyright (c) 2018-2022 Rainer Keller, HS Esslingen. All rights reserved.
+//
+#include "HAWOpenCL_config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <stdint.h>
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+#if defined(__APPLE__) && defined(__MACH__)
+#include <OpenCL/opencl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include "HAWOpenCL.h"
+#include "opencl_internal.h"
+
+typedef struct {
+    uint32_t hash;
+    char * key;                 // The sorted definitions, NULL if empty slot
+    hawopencl_program * program; // NULL while being built
+} variant_entry;
+
+struct hawopencl_variant_cache {
+    char * source;
+    hawopencl_build_profile profile;
+    bool kernel_arg_info;
+    char * defines;
+    char * extra;
+    cl_device_id device_id;
+    cl_context context;
+    cl_uint num_variants;
+    cl_uint table_size;         // A power of two, at most half full
+    variant_entry * table;
+#if defined(HAVE_PTHREAD_H)
+    pthread_mutex_t mutex;
+    pthread_cond_t built;       // Signalled, whenever a variant has been built
+#endif
+};
+
+/*
+ * Local functions
+ */
+static uint32_t opencl_kernel_variant_hash(const char * key);
+static int opencl_kernel_variant_compare(const void * a, const void * b);
+static char * opencl_kernel_variant_key(cl_uint num_defines, const hawopencl_define defines[]);
+static void opencl_kernel_variant_insert(variant_entry * table, cl_uint table_size, const variant_entry * entry);
+static variant_entry * opencl_kernel_variant_find(hawopencl_variant_cache * cache, const variant_entry * entry);
+
+// The hash of the definitions, to index the variant table
+static uint32_t opencl_kernel_variant_hash(const char * key) {
+    return (uint32_t) opencl_hash_fnv1a(OPENCL_HASH_FNV1A_INIT, key, strlen(key));
+}
+
+static int opencl_kernel_variant_compare(const void * a, const void * b) {
+    return strcmp(((const hawopencl_define *) a)->name, ((const hawopencl_define *) b)->name);
+}
+
+// Returns the definitions sorted by name as "-DA=1 -DB=2", so that the order passed does not matter
+static char * opencl_kernel_variant_key(cl_uint num_defines, const hawopencl_define defines[]) {
+    hawopencl_define * sorted;
+    size_t len = 1;
+    char * key;
+    cl_uint i;
+
+    sorted = (hawopencl_define *) malloc((num_defines + 1) * sizeof(hawopencl_define));
+    if (NULL == sorted)
+        FATAL_ERROR("malloc", ENOMEM);
+    if (0 < num_defines) {
+        memcpy(sorted, defines, num_defines * sizeof(hawopencl_define));
+        qsort(sorted, num_defines, sizeof(hawopencl_define), opencl_kernel_variant_compare);
+    }
+
+    for (i = 0; i < num_defines; i++)
+        len += 3 + strlen(sorted[i].name) + 1 + ((NULL == sorted[i].value) ? 0 : strlen(sorted[i].value));
+    key = (char *) malloc(len);
+    if (NULL == key)
+        FATAL_ERROR("malloc", ENOMEM);
+    key[0] = '\0';
+    for (i = 0; i < num_defines; i++) {
+        if (0 < i && 0 == strcmp(sorted[i-1].name, sorted[i].name)) {
+            fprintf(stderr, "ERROR: Macro %s defined twice for kernel variant\n", sorted[i].name);
+            FATAL_ERROR("opencl_kernel_variant", EINVAL);
+        }
+        if (NULL == sorted[i].value)
+            sprintf(key + strlen(key), "%s-D%s", (0 == i) ? "" : " ", sorted[i].name);
+        else
+            sprintf(key + strlen(key), "%s-D%s=%s", (0 == i) ? "" : " ", sorted[i].name, sorted[i].value);
+    }
+    free(sorted);
+    return key;
+}
+
+// Open addressing with linear probing
+static void opencl_kernel_variant_insert(variant_entry * table, cl_uint table_size, const variant_entry * entry) {
+    uint32_t pos = entry->hash & (table_size - 1);
+    while (NULL != table[pos].key)
+        pos = (pos + 1) & (table_size - 1);
+    table[pos] = *entry;
+}
+
+// Look up the variant with the entry's key; called with the lock held
+static variant_entry * opencl_kernel_variant_find(hawopencl_variant_cache * cache, const variant_entry * entry) {
+    uint32_t pos;
+
+    for (pos = entry->hash & (cache->table_size - 1);
+         NULL != cache->table[pos].key;
+         pos = (pos + 1) & (cache->table_size - 1))
+        if (entry->hash == cache->table[pos].hash && 0 == strcmp(entry->key, cache->table[pos].key))
+            return &cache->table[pos];
+    return NULL;
+}
+
+int opencl_variant_cache_create(const char * kernel_source,
+        hawopencl_build_options * options,
+        const cl_device_id device_id,
+        const cl_context context,
+        hawopencl_variant_cache ** cache) {
+    hawopencl_variant_cache * c;
+
+    c = (hawopencl_variant_cache *) calloc(1, sizeof(hawopencl_variant_cache));
+    if (NULL == c)
+        FATAL_ERROR("calloc", ENOMEM);
+    c->source = strdup(kernel_source);
+    if (NULL == c->source)
+        FATAL_ERROR("strdup", ENOMEM);
+    c->profile = HAWOPENCL_BUILD_PROFILE_RELEASE;
+    if (NULL != options) {
+        c->profile = options->profile;
+        c->kernel_arg_info = options->kernel_arg_info;
+        if (NULL != options->defines && NULL == (c->defines = strdup(options->defines)))
+            FATAL_ERROR("strdup", ENOMEM);
+        if (NULL != options->extra && NULL == (c->extra = strdup(options->extra)))
+            FATAL_ERROR("strdup", ENOMEM);
+    }
+    c->device_id = device_id;
+    c->context = context;
+    OPENCL_CHECK(clRetainContext, (context));
+
+    c->table_size = 16;
+    c->table = (variant_entry *) calloc(c->table_size, sizeof(variant_entry));
+    if (NULL == c->table)
+        FATAL_ERROR("calloc", ENOMEM);
+#if defined(HAVE_PTHREAD_H)
+    pthread_mutex_init(&c->mutex, NULL);
+    pthread_cond_init(&c->built, NULL);
+#endif
+
+    *cache = c;
+    return CL_SUCCESS;
+}
+
+int opencl_kernel_variant_program(hawopencl_variant_cache * cache,
+        cl_uint num_defines,
+        const hawopencl_define defines[],
+        hawopencl_program ** program) {
+    hawopencl_build_options options;
+    hawopencl_program * built;
+    variant_entry * found;
+    variant_entry entry;
+    cl_uint i;
+
+    entry.key = opencl_kernel_variant_key(num_defines, defines);
+    entry.hash = opencl_kernel_variant_hash(entry.key);
+
+#if defined(HAVE_PTHREAD_H)
+    pthread_mutex_lock(&cache->mutex);
+    // Another thread is building this variant, wait for it instead of building twice
+    while (NULL != (found = opencl_kernel_variant_find(cache, &entry)) && NULL == found->program)
+        pthread_cond_wait(&cache->built, &cache->mutex);
+#else
+    found = opencl_kernel_variant_find(cache, &entry);
+#endif
+    if (NULL != found) {
+        *program = found->program;
+#if defined(HAVE_PTHREAD_H)
+        pthread_mutex_unlock(&cache->mutex);
+#endif
+        free(entry.key);
+        return CL_SUCCESS;
+    }
+
+    // Keep the table at most half full
+    if (2 * (cache->num_variants + 1) > cache->table_size) {
+        const cl_uint table_size = 2 * cache->table_size;
+        variant_entry * table = (variant_entry *) calloc(table_size, sizeof(variant_entry));
+        if (NULL == table)
+            FATAL_ERROR("calloc", ENOMEM);
+        for (i = 0; i < cache->table_size; i++)
+            if (NULL != cache->table[i].key)
+                opencl_kernel_variant_insert(table, table_size, &cache->table[i]);
+        free(cache->table);
+        cache->table = table;
+        cache->table_size = table_size;
+    }
+    // Enter the variant being built, so that other variants may be used and built meanwhile
+    entry.program = NULL;
+    opencl_kernel_variant_insert(cache->table, cache->table_size, &entry);
+    cache->num_variants++;
+#if defined(HAVE_PTHREAD_H)
+    pthread_mutex_unlock(&cache->mutex);
+#endif
+
+    // Build the variant on first use
+    opencl_build_options_init(&options, cache->profile);
+    options.kernel_arg_info = cache->kernel_arg_info;
+    if (NULL != cache->defines)
+        opencl_build_options_add(&options, cache->defines);
+    if (NULL != cache->extra)
+        opencl_build_options_add(&options, cache->extra);
+    for (i = 0; i < num_defines; i++)
+        opencl_build_options_define(&options, defines[i].name, defines[i].value);
+    opencl_program_build_with_options(cache->source, &options, cache->device_id, cache->context,
+            &built);
+    opencl_build_options_free(&options);
+
+    // The table may have grown meanwhile
+#if defined(HAVE_PTHREAD_H)
+    pthread_mutex_lock(&cache->mutex);
+#endif
+    opencl_kernel_variant_find(cache, &entry)->program = built;
+#if defined(HAVE_PTHREAD_H)
+    pthread_cond_broadcast(&cache->built);
+    pthread_mutex_unlock(&cache->mutex);
+#endif
+
+    *program = built;
+    return CL_SUCCESS;
+}
+
+int opencl_kernel_variant(hawopencl_variant_cache * cache,
+        cl_uint num_defines,
+        const hawopencl_define defines[],
+        const char * kernel_name,
+        cl_kernel * kernel) {
+    hawopencl_program * program;
+
+    opencl_kernel_variant_program(cache, num_defines, defines, &program);
+    *kernel = opencl_program_kernel(program, kernel_name);
+    if (NULL == *kernel) {
+        fprintf(stderr, "ERROR: Kernel %s not found in variant\n", kernel_name);
+        FATAL_ERROR("opencl_kernel_variant", CL_INVALID_KERNEL_NAME);
+    }
+    return CL_SUCCESS;
+}
+
+int opencl_kernel_variant_typed(hawopencl_variant_cache * cache,
+        const char * type,
+        const char * kernel_name,
+        cl_kernel * kernel) {
+    const hawopencl_define define = {"T", type};
+    return opencl_kernel_variant(cache, 1, &define, kernel_name, kernel);
+}
+
+cl_uint opencl_variant_cache_size(hawopencl_variant_cache * cache) {
+    cl_uint num_variants;
+#if defined(HAVE_PTHREAD_H)
+    pthread_mutex_lock(&cache->mutex);
+#endif
+    num_variants = cache->num_variants;
+#if defined(HAVE_PTHREAD_H)
+    pthread_mutex_unlock(&cache->mutex);
+#endif
+    return num_variants;
+}
+
+int opencl_variant_cache_release(hawopencl_variant_cache * cache) {
+    cl_uint i;
+
+    for (i = 0; i < cache->table_size; i++)
+        if (NULL != cache->table[i].key) {
+            free(cache->table[i].key);
+            opencl_program_release(cache->table[i].program);
+        }
+    free(cache->table);
+#if defined(HAVE_PTHREAD_H)
+    pthread_cond_destroy(&cache->built);
+    pthread_mutex_destroy(&cache->mutex);
+#endif
+    OPENCL_CHECK(clReleaseContext, (cache->context));
+    free(cache->source);
+    free(cache->defines);
+    free(cache->extra);
+    free(cache);
+    return CL_SUCCESS;
+}
@@ -0,0 +1,438 @@
+//
+//  opencl_kernel_watch.c : Part of libHAWOpenCL
+//
+//  Hot reload of kernels: the files a program was built from are watched
+//  using inotify; upon a change the program is rebuilt in the background
+//  and its kernels are swapped upon the next opencl_watch_kernel().
+//
+//  Copyright (c) 2018-2022 Rainer Keller, HS Esslingen. All rights reserved.
+//
+#include "HAWOpenCL_config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#ifdef HAVE_STDBOOL_H
+#  include <stdbool.h>
+#endif
+#ifdef HAVE_STDLIB_H
+#  include <stdlib.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#  include <unistd.h>
+#endif
+#ifdef HAVE_PTHREAD_H
+#  include <pthread.h>
+#endif
+#ifdef HAVE_SYS_INOTIFY_H
+#  include <sys/inotify.h>
+#  include <poll.h>
+#endif
+
+#if defined(__APPLE__) && defined(__MACH__)
+#  include <OpenCL/opencl.h>
+#else
+#  include <CL/cl.h>
+#endif
+
+#include "HAWOpenCL.h"
+#include "opencl_internal.h"
+
+#if defined(HAVE_SYS_INOTIFY_H) && defined(HAVE_PTHREAD_H)
+#  define WATCH_INOTIFY 1
+#endif
+
+// Editors write a file in several steps; wait for them to settle before rebuilding
+#define WATCH_SETTLE_MS 50
+
+struct hawopencl_watch {
+    char * kernel_file_name;
+    char * options;
+    cl_device_id device_id;
+    cl_context context;
+    char ** dependencies;               // The paths of the main file and all includes
+    size_t num_dependencies;
+    hawopencl_program * program;        // The program opencl_watch_kernel() returns kernels of
+    hawopencl_program * retired;        // The previous program, kept until the next swap
+    hawopencl_program * pending;        // Rebuilt, to be swapped in
+    bool stale;                         // A dependency changed since the last build
+    bool building;                      // The watcher thread is rebuilding
+    bool released;                      // Released while building, freed by the watcher thread
+    struct hawopencl_watch * next;
+};
+
+#if defined(WATCH_INOTIFY)
+typedef struct {
+    int wd;
+    char * path;
+} opencl_watch_dir;
+
+static int watch_fd = -1;
+static opencl_watch_dir * watch_dirs = NULL;
+static size_t watch_dirs_num = 0;
+static hawopencl_watch * watches = NULL;
+#endif
+
+#if defined(HAVE_PTHREAD_H)
+static pthread_mutex_t watch_mutex = PTHREAD_MUTEX_INITIALIZER;
+#  define WATCH_LOCK()    pthread_mutex_lock(&watch_mutex)
+#  define WATCH_UNLOCK()  pthread_mutex_unlock(&watch_mutex)
+#else
+#  define WATCH_LOCK()
+#  define WATCH_UNLOCK()
+#endif
+
+/*
+ * Local functions
+ */
+static hawopencl_program * opencl_watch_build(hawopencl_watch * watch, char *** dependencies,
+        size_t * num_dependencies);
+static void opencl_watch_dependencies_free(char ** dependencies, size_t num_dependencies);
+static void opencl_watch_free(hawopencl_watch * watch);
+#if defined(WATCH_INOTIFY)
+static void opencl_watch_add(const char * path);
+static void opencl_watch_changed(const char * path);
+static void opencl_watch_rebuild(void);
+static void * opencl_watch_thread(void * arg);
+#endif
+
+// Map and build the kernel file; in case of a missing file or a build failure
+// NULL is returned, so that a typo does not end a long-running process.
+// The dependencies are NULL, if the file could not be mapped.
+static hawopencl_program * opencl_watch_build(hawopencl_watch * watch, char *** dependencies,
+        size_t * num_dependencies) {
+    hawopencl_source source;
+    hawopencl_program * p;
+    cl_program program = NULL;
+    struct stat stat_buf;
+    char ** deps;
+    size_t num = 0;
+    uint64_t key = 0;
+    size_t i;
+    cl_int err;
+
+    *dependencies = NULL;
+    *num_dependencies = 0;
+    if (CL_SUCCESS != opencl_kernel_map_try(watch->kernel_file_name, &source))
+        return NULL;
+
+    deps = malloc((source.files->num_included + 1) * sizeof(char *));
+    if (NULL == deps)
+        FATAL_ERROR("malloc", ENOMEM);
+    // Files compiled into the executable do not change
+    if (NULL == opencl_kernel_embedded_find(watch->kernel_file_name) &&
+        NULL != (deps[num] = opencl_kernel_find_file(NULL, watch->kernel_file_name, &stat_buf)))
+        num++;
+    for (i = 0; i < source.files->num_included; i++) {
+        const char * path = opencl_kernel_preprocess_dependency(&source, i);
+        if (NULL == path)
+            continue;
+        deps[num] = strdup(path);
+        if (NULL == deps[num])
+            FATAL_ERROR("strdup", ENOMEM);
+        num++;
+    }
+    *dependencies = deps;
+    *num_dependencies = num;
+
+    if (opencl_kernel_cache_enabled()) {
+        key = opencl_kernel_cache_key_sources(source.count, source.strings, source.lengths,
+                watch->options, watch->device_id);
+        program = opencl_kernel_cache_program(watch->context, watch->device_id, key, watch->options);
+    }
+    if (NULL == program) {
+        program = clCreateProgramWithSource(watch->context, source.count, source.strings,
+                source.lengths, &err);
+        if (NULL == program || CL_SUCCESS != err)
+            FATAL_ERROR("clCreateProgramWithSource", err);
+        err = clBuildProgram(program, 1, &watch->device_id, watch->options, NULL, NULL);
+        if (CL_SUCCESS != err) {
+            opencl_kernel_build_log_print(program, watch->device_id, watch->kernel_file_name);
+            OPENCL_CHECK(clReleaseProgram, (program));
+            opencl_kernel_unmap(&source);
+            return NULL;
+        }
+        if (opencl_kernel_cache_enabled())
+            opencl_kernel_cache_store(key, program, watch->device_id);
+    }
+    opencl_kernel_unmap(&source);
+
+    p = (hawopencl_program *) calloc(1, sizeof(hawopencl_program));
+    if (NULL == p)
+        FATAL_ERROR("calloc", ENOMEM);
+    p->program = program;
+    opencl_program_kernels_create(p);
+    return p;
+}
+
+static void opencl_watch_dependencies_free(char ** dependencies, size_t num_dependencies) {
+    size_t i;
+    for (i = 0; i < num_dependencies; i++)
+        free(dependencies[i]);
+    free(dependencies);
+}
+
+static void opencl_watch_free(hawopencl_watch * watch) {
+    if (NULL != watch->program)
+        opencl_program_release(watch->program);
+    if (NULL != watch->retired)
+        opencl_program_release(watch->retired);
+    if (NULL != watch->pending)
+        opencl_program_release(watch->pending);
+    opencl_watch_dependencies_free(watch->dependencies, watch->num_dependencies);
+    OPENCL_CHECK(clReleaseContext, (watch->context));
+    free(watch->kernel_file_name);
+    free(watch->options);
+    free(watch);
+}
+
+#if defined(WATCH_INOTIFY)
+// Watch the directory of the file, as editors often replace files by renaming;
+// called with the lock held
+static void opencl_watch_add(const char * path) {
+    const char * slash = strrchr(path, '/');
+    const size_t len = (NULL != slash) ? (size_t) (slash - path) : 0;
+    opencl_watch_dir * dirs;
+    char * dir;
+    int wd;
+    size_t i;
+
+    dir = (0 < len) ? strndup(path, len) : strdup((NULL != slash) ? "/" : ".");
+    if (NULL == dir)
+        FATAL_ERROR("strdup", ENOMEM);
+    for (i = 0; i < watch_dirs_num; i++)
+        if (0 == strcmp(watch_dirs[i].path, dir)) {
+            free(dir);
+            return;
+        }
+    wd = inotify_add_watch(watch_fd, dir, IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (0 > wd) {
+        fprintf(stderr, "WARNING in %s(): Cannot watch %s for changes (%s)\n",
+                __func__, dir, strerror(errno));
+        free(dir);
+        return;
+    }
+    dirs = realloc(watch_dirs, (watch_dirs_num + 1) * sizeof(opencl_watch_dir));
+    if (NULL == dirs)
+        FATAL_ERROR("realloc", ENOMEM);
+    watch_dirs = dirs;
+    watch_dirs[watch_dirs_num].wd = wd;
+    watch_dirs[watch_dirs_num].path = dir;
+    watch_dirs_num++;
+}
+
+// Mark all watches depending on the file as stale; called with the lock held
+static void opencl_watch_changed(const char * path) {
+    hawopencl_watch * watch;
+    size_t i;
+
+    for (watch = watches; NULL != watch; watch = watch->next)
+        for (i = 0; i < watch->num_dependencies; i++)
+            if (0 == strcmp(watch->dependencies[i], path)) {
+                watch->stale = true;
+                break;
+            }
+}
+
+// Rebuild the stale watches one after the other, outside of the lock
+static void opencl_watch_rebuild(void) {
+    // Changed files are only noticed by the kernel search path index after a refresh
+    opencl_kernel_path_refresh();
+    for (;;) {
+        hawopencl_watch * watch;
+        hawopencl_program * program;
+        char ** dependencies;
+        size_t num_dependencies;
+        size_t i;
+
+        WATCH_LOCK();
+        for (watch = watches; NULL != watch && !watch->stale; watch = watch->next)
+            ;
+        if (NULL == watch) {
+            WATCH_UNLOCK();
+            return;
+        }
+        watch->stale = false;
+        watch->building = true;
+        WATCH_UNLOCK();
+
+        printf("opencl_watch: Rebuilding %s\n", watch->kernel_file_name);
+        program = opencl_watch_build(watch, &dependencies, &num_dependencies);
+
+        WATCH_LOCK();
+        watch->building = false;
+        if (watch->released) {
+            WATCH_UNLOCK();
+            if (NULL != program)
+                opencl_program_release(program);
+            opencl_watch_dependencies_free(dependencies, num_dependencies);
+            opencl_watch_free(watch);
+            continue;
+        }
+        // Includes may have been added or removed by the edit; a missing
+        // file keeps the previous dependencies, to notice when it is back
+        if (NULL != dependencies) {
+            opencl_watch_dependencies_free(watch->dependencies, watch->num_dependencies);
+            watch->dependencies = dependencies;
+            watch->num_dependencies = num_dependencies;
+            for (i = 0; i < num_dependencies; i++)
+                opencl_watch_add(dependencies[i]);
+        }
+        if (NULL != program) {
+            if (NULL != watch->pending)
+                opencl_program_release(watch->pending);
+            watch->pending = program;
+        }
+        WATCH_UNLOCK();
+    }
+}
+
+static void * opencl_watch_thread(void * arg __HAW_OPENCL_ATTR_UNUSED__) {
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    struct pollfd pfd = { .fd = watch_fd, .events = POLLIN };
+
+    for (;;) {
+        bool changed = false;
+        int timeout = -1;
+
+        // Block for the first event, then collect events until they settle
+        while (0 < poll(&pfd, 1, timeout)) {
+            ssize_t len = read(watch_fd, buffer, sizeof(buffer));
+            ssize_t pos;
+
+            if (0 >= len)
+                break;
+            WATCH_LOCK();
+            for (pos = 0; pos < len; ) {
+                const struct inotify_event * event = (const struct inotify_event *) &buffer[pos];
+                size_t i;
+
+                for (i = 0; 0 < event->len && i < watch_dirs_num; i++)
+                    if (watch_dirs[i].wd == event->wd) {
+                        char * path = malloc(strlen(watch_dirs[i].path) + 1 + event->len + 1);
+                        if (NULL == path)
+                            FATAL_ERROR("malloc", ENOMEM);
+                        sprintf(path, "%s/%s", watch_dirs[i].path, event->name);
+                        opencl_watch_changed(path);
+                        free(path);
+                        break;
+                    }
+                pos += sizeof(struct inotify_event) + event->len;
+            }
+            WATCH_UNLOCK();
+            changed = true;
+            timeout = WATCH_SETTLE_MS;
+        }
+        if (changed)
+            opencl_watch_rebuild();
+    }
+    return NULL;
+}
+#endif
+
+int opencl_kernel_watch(const char * kernel_file_name,
+        hawopencl_build_options * options,
+        const cl_device_id device_id,
+        const cl_context context,
+        hawopencl_watch ** watch) {
+    hawopencl_watch * w;
+    hawopencl_build_options default_options;
+
+    w = (hawopencl_watch *) calloc(1, sizeof(hawopencl_watch));
+    if (NULL == w)
+        FATAL_ERROR("calloc", ENOMEM);
+
+    if (NULL == options) {
+        opencl_build_options_init(&default_options, HAWOPENCL_BUILD_PROFILE_RELEASE);
+        options = &default_options;
+    }
+    w->kernel_file_name = strdup(kernel_file_name);
+    w->options = strdup(opencl_build_options_string(options));
+    if (NULL == w->kernel_file_name || NULL == w->options)
+        FATAL_ERROR("strdup", ENOMEM);
+    if (options == &default_options)
+        opencl_build_options_free(&default_options);
+    w->device_id = device_id;
+    w->context = context;
+    OPENCL_CHECK(clRetainContext, (context));
+
+    // Unlike a rebuild, the first build has to succeed
+    w->program = opencl_watch_build(w, &w->dependencies, &w->num_dependencies);
+    if (NULL == w->program)
+        FATAL_ERROR("clBuildProgram", CL_BUILD_PROGRAM_FAILURE);
+
+#if defined(WATCH_INOTIFY)
+    {
+        size_t i;
+
+        WATCH_LOCK();
+        if (-1 == watch_fd) {
+            pthread_t thread;
+            int err;
+
+            watch_fd = inotify_init1(IN_CLOEXEC);
+            if (0 > watch_fd)
+                FATAL_ERROR("inotify_init1", errno);
+            err = pthread_create(&thread, NULL, opencl_watch_thread, NULL);
+            if (0 != err)
+                FATAL_ERROR("pthread_create", err);
+            pthread_detach(thread);
+        }
+        for (i = 0; i < w->num_dependencies; i++)
+            opencl_watch_add(w->dependencies[i]);
+        w->next = watches;
+        watches = w;
+        WATCH_UNLOCK();
+    }
+#else
+    printf("opencl_kernel_watch: No inotify available, %s is not reloaded\n", kernel_file_name);
+#endif
+
+    *watch = w;
+    return CL_SUCCESS;
+}
+
+int opencl_watch_kernel(hawopencl_watch * watch,
+        const char * kernel_name,
+        cl_kernel * kernel,
+        bool * reloaded) {
+    bool swapped = false;
+
+    WATCH_LOCK();
+    if (NULL != watch->pending) {
+        if (NULL != watch->retired)
+            opencl_program_release(watch->retired);
+        watch->retired = watch->program;
+        watch->program = watch->pending;
+        watch->pending = NULL;
+        swapped = true;
+    }
+    *kernel = opencl_program_kernel(watch->program, kernel_name);
+    WATCH_UNLOCK();
+
+    if (NULL != reloaded)
+        *reloaded = swapped;
+    return (NULL != *kernel) ? CL_SUCCESS : CL_INVALID_KERNEL_NAME;
+}
+
+int opencl_watch_release(hawopencl_watch * watch) {
+    WATCH_LOCK();
+#if defined(WATCH_INOTIFY)
+    {
+        hawopencl_watch ** prev;
+        for (prev = &watches; *prev != watch; prev = &(*prev)->next)
+            assert (NULL != *prev);
+        *prev = watch->next;
+    }
+#endif
+    if (watch->building) {
+        watch->released = true;
+        watch = NULL;
+    }
+    WATCH_UNLOCK();
+
+    if (NULL != watch)
+        opencl_watch_free(watch);
+    return CL_SUCCESS;
+}
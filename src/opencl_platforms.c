@@ -0,0 +1,200 @@
+//
+//  opencl_platforms.c : Part of libHAWOpenCL
+//
+//  Discovery of the platforms and their devices, done once per process;
+//  the platforms are initialized in parallel by a small pool of threads.
+//
+//  Copyright (c) 2018-2022 Rainer Keller, HS Esslingen. All rights reserved.
+//
+#include "HAWOpenCL_config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+#if defined(__APPLE__) && defined(__MACH__)
+#include <OpenCL/opencl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include "HAWOpenCL.h"
+#include "opencl_internal.h"
+
+// The maximum number of threads discovering platforms in parallel
+#define DISCOVERY_THREADS  4
+
+static bool platforms_initialized = false;
+static opencl_platform * platforms = NULL;
+static cl_uint platforms_num = 0;
+static cl_uint platforms_next = 0;     // The next platform to be discovered by a thread
+
+#if defined(HAVE_PTHREAD_H)
+static pthread_mutex_t platforms_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t platforms_cond = PTHREAD_COND_INITIALIZER;
+#  define PLATFORMS_LOCK()    pthread_mutex_lock(&platforms_mutex)
+#  define PLATFORMS_UNLOCK()  pthread_mutex_unlock(&platforms_mutex)
+#  define PLATFORMS_WAIT()    pthread_cond_wait(&platforms_cond, &platforms_mutex)
+#  define PLATFORMS_SIGNAL()  pthread_cond_broadcast(&platforms_cond)
+#else
+#  define PLATFORMS_LOCK()
+#  define PLATFORMS_UNLOCK()
+#  define PLATFORMS_WAIT()
+#  define PLATFORMS_SIGNAL()
+#endif
+
+/*
+ * Local functions
+ */
+static void opencl_platform_discover_type(opencl_platform * platform, cl_device_type type,
+        cl_uint * num, cl_device_id ** devices);
+static void opencl_platform_discover(opencl_platform * platform);
+static void * opencl_platforms_thread(void * arg);
+
+// Append the platform's devices of the type to the array devices of num entries
+static void opencl_platform_discover_type(opencl_platform * platform, cl_device_type type,
+        cl_uint * num, cl_device_id ** devices) {
+    cl_device_id * tmp;
+    cl_uint n = 0;
+    cl_int err;
+
+    err = clGetDeviceIDs(platform->platform_id, type, 0, NULL, &n);
+    // Only error out, if there's an error and it's not CL_DEVICE_NOT_FOUND
+    if (CL_SUCCESS != err && CL_DEVICE_NOT_FOUND != err)
+        FATAL_ERROR("clGetDeviceIDs", err);
+    if (CL_SUCCESS != err || 0 == n)
+        return;
+    tmp = (cl_device_id*) realloc(*devices, (*num + n) * sizeof(cl_device_id));
+    if (NULL == tmp)
+        FATAL_ERROR("realloc", ENOMEM);
+    err = clGetDeviceIDs(platform->platform_id, type, n, tmp + *num, NULL);
+    if (CL_SUCCESS != err)
+        FATAL_ERROR("clGetDeviceIDs", err);
+    *devices = tmp;
+    *num += n;
+}
+
+// Get the platform's devices and their capabilities; this initializes the vendor's driver
+static void opencl_platform_discover(opencl_platform * platform) {
+    cl_device_id * devices = NULL;
+    cl_uint num = 0;
+    cl_uint i;
+
+    // CL_DEVICE_TYPE_ALL does not include custom devices, they are appended
+    opencl_platform_discover_type(platform, CL_DEVICE_TYPE_ALL, &num, &devices);
+#if defined(CL_VERSION_1_2)
+    opencl_platform_discover_type(platform, CL_DEVICE_TYPE_CUSTOM, &num, &devices);
+#endif
+    for (i = 0; i < num; i++)
+        opencl_device_caps(devices[i]);
+
+    PLATFORMS_LOCK();
+    platform->devices = devices;
+    platform->num_devices = num;
+    platform->discovered = true;
+    PLATFORMS_SIGNAL();
+    PLATFORMS_UNLOCK();
+}
+
+static void * opencl_platforms_thread(void * arg __HAW_OPENCL_ATTR_UNUSED__) {
+    for (;;) {
+        cl_uint i;
+
+        PLATFORMS_LOCK();
+        i = platforms_next;
+        if (i < platforms_num)
+            platforms_next++;
+        PLATFORMS_UNLOCK();
+        if (i >= platforms_num)
+            break;
+        opencl_platform_discover(&platforms[i]);
+    }
+    return NULL;
+}
+
+cl_uint opencl_platforms(opencl_platform ** all) {
+    cl_platform_id * ids;
+    cl_uint num;
+    cl_uint i;
+    cl_int err;
+
+    PLATFORMS_LOCK();
+    if (platforms_initialized) {
+        *all = platforms;
+        num = platforms_num;
+        PLATFORMS_UNLOCK();
+        return num;
+    }
+
+    // Get all the Platforms first!
+    err = clGetPlatformIDs(0, NULL, &num);
+    if (CL_SUCCESS != err)
+        FATAL_ERROR("clGetPlatformIDs", err);
+    if (num == 0)
+        FATAL_ERROR("No OpenCL Platform detected.", ENODEV);
+    ids = (cl_platform_id*) malloc(num * sizeof(cl_platform_id));
+    platforms = (opencl_platform*) calloc(num, sizeof(opencl_platform));
+    if (NULL == ids || NULL == platforms)
+        FATAL_ERROR("malloc", ENOMEM);
+    err = clGetPlatformIDs(num, ids, &num);
+    if (CL_SUCCESS != err)
+        FATAL_ERROR("clGetPlatformIDs", err);
+    for (i = 0; i < num; i++) {
+        size_t len;
+        platforms[i].platform_id = ids[i];
+        err = clGetPlatformInfo(ids[i], CL_PLATFORM_NAME, sizeof(platforms[i].name) - 1,
+                platforms[i].name, &len);
+        if (CL_SUCCESS != err && CL_INVALID_VALUE != err)
+            FATAL_ERROR("clGetPlatformInfo", err);
+    }
+    free(ids);
+    platforms_num = num;
+    platforms_initialized = true;
+
+#if defined(HAVE_PTHREAD_H)
+    // The threads are detached; waiting for a platform is done on platforms_cond
+    for (i = 0; i < num && i < DISCOVERY_THREADS; i++) {
+        pthread_attr_t attr;
+        pthread_t thread;
+
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+        if (0 != pthread_create(&thread, &attr, opencl_platforms_thread, NULL))
+            FATAL_ERROR("pthread_create", errno);
+        pthread_attr_destroy(&attr);
+    }
+    *all = platforms;
+    PLATFORMS_UNLOCK();
+#else
+    *all = platforms;
+    opencl_platforms_thread(NULL);
+#endif
+    return num;
+}
+
+void opencl_platform_wait(opencl_platform * platform) {
+    PLATFORMS_LOCK();
+    while (!platform->discovered)
+        PLATFORMS_WAIT();
+    PLATFORMS_UNLOCK();
+}
+
+bool opencl_platform_may_have(opencl_platform * platform, const cl_device_type on_device_type) {
+    cl_device_type types;
+    bool discovered;
+
+    PLATFORMS_LOCK();
+    discovered = platform->discovered;
+    PLATFORMS_UNLOCK();
+    if (discovered || (on_device_type & CL_DEVICE_TYPE_DEFAULT) ||
+        !opencl_device_caps_platform_types(platform->name, &types))
+        return true;
+    return 0 != (types & on_device_type);
+}
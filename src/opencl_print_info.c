@@ -34,86 +34,31 @@ typedef enum {
     HAW_VERSION_3_0,
 } haw_opencl_version_t;
 
-static haw_opencl_version_t haw_platform_opencl_version = 0;
-static haw_opencl_version_t haw_device_opencl_version = 0;
-
 // Local functions
-static haw_opencl_version_t opencl_platform_supports_init(cl_platform_id platform) {
-    cl_int err;
-    size_t len;
-    char * platform_version;
-    err = clGetPlatformInfo(platform, CL_PLATFORM_VERSION, 0, NULL, &len);
-    if (CL_SUCCESS != err)
-        FATAL_ERROR("clGetPlatformInfo", err);
-    platform_version = (char*)malloc(len);
-    if (NULL == platform_version)
-        FATAL_ERROR("malloc", ENOMEM);
-    err = clGetPlatformInfo(platform, CL_PLATFORM_VERSION, len, platform_version, NULL);
-    if (CL_SUCCESS != err)
-        FATAL_ERROR("clGetPlatformInfo", err);
-    if (NULL != strstr(platform_version, "OpenCL 1.0"))
-        haw_platform_opencl_version = HAW_VERSION_1_0;
-    if (NULL != strstr(platform_version, "OpenCL 1.1"))
-        haw_platform_opencl_version = HAW_VERSION_1_1;
-    if (NULL != strstr(platform_version, "OpenCL 1.2"))
-        haw_platform_opencl_version = HAW_VERSION_1_2;
-
-    if (NULL != strstr(platform_version, "OpenCL 2.0"))
-        haw_platform_opencl_version = HAW_VERSION_2_0;
-    if (NULL != strstr(platform_version, "OpenCL 2.1"))
-        haw_platform_opencl_version = HAW_VERSION_2_1;
-    if (NULL != strstr(platform_version, "OpenCL 2.2"))
-        haw_platform_opencl_version = HAW_VERSION_2_2;
-
-    if (NULL != strstr(platform_version, "OpenCL 3.0"))
-        haw_platform_opencl_version = HAW_VERSION_3_0;
-
-    free (platform_version);
-
-    return haw_platform_opencl_version;
-}
+#if defined(CL_VERSION_2_1)
+// Only queries introduced with OpenCL 2.1 depend on the platform's version
+static haw_opencl_version_t opencl_version_parse(const char * version) {
+    static const struct {
+        const char * name;
+        haw_opencl_version_t version;
+    } versions[] = {
+        {"OpenCL 1.0", HAW_VERSION_1_0},
+        {"OpenCL 1.1", HAW_VERSION_1_1},
+        {"OpenCL 1.2", HAW_VERSION_1_2},
+        {"OpenCL 2.0", HAW_VERSION_2_0},
+        {"OpenCL 2.1", HAW_VERSION_2_1},
+        {"OpenCL 2.2", HAW_VERSION_2_2},
+        {"OpenCL 3.0", HAW_VERSION_3_0},
+    };
+    haw_opencl_version_t ret = 0;
+    unsigned int i;
 
-static int opencl_platform_supports_version(haw_opencl_version_t wants) {
-    return (wants > haw_platform_opencl_version) ? 0 : 1;
+    for (i = 0; i < sizeof(versions) / sizeof(versions[0]); i++)
+        if (NULL != strstr(version, versions[i].name))
+            ret = versions[i].version;
+    return ret;
 }
-
-static haw_opencl_version_t opencl_device_supports_init(cl_device_id device) {
-    cl_int err;
-    size_t len;     
-    char * device_version;
-    err = clGetDeviceInfo(device, CL_DEVICE_VERSION, 0, NULL, &len);
-    if (CL_SUCCESS != err)
-        FATAL_ERROR("clGetDeviceInfo", err);
-    device_version = (char*)malloc(len);
-    if (NULL == device_version)
-        FATAL_ERROR("malloc", ENOMEM);
-    err = clGetDeviceInfo(device, CL_DEVICE_VERSION, len, device_version, NULL);
-    if (CL_SUCCESS != err)
-        FATAL_ERROR("clGetDeviceInfo", err);
-    if (NULL != strstr(device_version, "OpenCL 1.0"))
-        haw_device_opencl_version = HAW_VERSION_1_0;
-    if (NULL != strstr(device_version, "OpenCL 1.1"))
-        haw_device_opencl_version = HAW_VERSION_1_1;
-    if (NULL != strstr(device_version, "OpenCL 1.2"))
-        haw_device_opencl_version = HAW_VERSION_1_2;
-        
-    if (NULL != strstr(device_version, "OpenCL 2.0"))
-        haw_device_opencl_version = HAW_VERSION_2_0;
-    if (NULL != strstr(device_version, "OpenCL 2.1"))
-        haw_device_opencl_version = HAW_VERSION_2_1;
-    if (NULL != strstr(device_version, "OpenCL 2.2"))
-        haw_device_opencl_version = HAW_VERSION_2_2;
-
-    if (NULL != strstr(device_version, "OpenCL 3.0"))
-        haw_device_opencl_version = HAW_VERSION_3_0;
-
-    free (device_version);
-    return haw_device_opencl_version;
-}   
-static int opencl_device_supports_version(haw_opencl_version_t wants) {
-    return (wants > haw_device_opencl_version) ? 0 : 1;
-}   
-    
+#endif
 
 static void opencl_print_device_type(cl_device_id device __HAW_OPENCL_ATTR_UNUSED__, void * val) {
     cl_device_type my_type = *((cl_device_type*)val);
@@ -422,7 +367,7 @@ typedef struct {
     void (*cl_devinfo_printf)(cl_device_id device, void * val);  // If printf-modifier is CL_PRINT_SPECIFIC, call function-ptr, otherwise NULL
 } opencl_devinfo_t;
 
-opencl_devinfo_t opencl_devinfo[] = {
+static const opencl_devinfo_t opencl_devinfo[] = {
     {OPENCL_NAME(CL_DEVICE_NAME),
         "Device name string",
         0,
@@ -870,6 +815,9 @@ int opencl_print_platform(cl_platform_id cl_platform)
     char * cl_platform_version;
     char * cl_platform_vendor;
     char * cl_platform_extensions;
+#if defined(CL_VERSION_2_1)
+    haw_opencl_version_t haw_version;
+#endif
 
     // Get Platform profile
     err = clGetPlatformInfo(cl_platform, CL_PLATFORM_PROFILE, 0, NULL, &len);
@@ -936,6 +884,9 @@ int opencl_print_platform(cl_platform_id cl_platform)
             "\tExtensions:%s\n",
             cl_platform_vendor, cl_platform_name, cl_platform_version,
             cl_platform_profile, cl_platform_extensions);
+#if defined(CL_VERSION_2_1)
+    haw_version = opencl_version_parse(cl_platform_version);
+#endif
     free(cl_platform_extensions);
     free(cl_platform_vendor);
     free(cl_platform_version);
@@ -944,7 +895,7 @@ int opencl_print_platform(cl_platform_id cl_platform)
 #if defined(CL_VERSION_2_1)
     {
         // The host timer resolution information is available with OpenCL 2.1
-        if (!opencl_platform_supports_version(HAW_VERSION_2_1)) {
+        if (haw_version < HAW_VERSION_2_1) {
             printf ("\tHost Timer Resolution: Not supported (requires OpenCL 2.1 and above)\n");
         } else {
             cl_ulong cl_platform_host_timer_resolution;
@@ -960,13 +911,13 @@ int opencl_print_platform(cl_platform_id cl_platform)
 #if defined(CL_VERSION_3_0)
     {
         // The platform numeric version is available with OpenCL 3.0
-        if (!opencl_platform_supports_version(HAW_VERSION_3_0))) {
+        if (haw_version < HAW_VERSION_3_0) {
             printf ("\tNumeric Version: Not supported (requires OpenCL 3.0 and above)\n");
         } else {
             cl_version platform_version;
             
             err = clGetPlatformInfo(cl_platform, CL_PLATFORM_NUMERIC_VERSION,
-                                    sizeof(cl_version), &cl_numeric_version, NULL);
+                                    sizeof(cl_version), &platform_version, NULL);
             if (CL_SUCCESS != err)
                 FATAL_ERROR("clGetPlatformInfo", err);
             printf ("\tNumeric Version: %d.%d.%d\n",
@@ -976,19 +927,23 @@ int opencl_print_platform(cl_platform_id cl_platform)
         }
     }
     {
-        if (!opencl_platform_supports_version(HAW_VERSION_3_0))) {
+        if (haw_version < HAW_VERSION_3_0) {
             printf ("\tExtensions with Versions: Not supported (requires OpenCL 3.0 and above)\n");
         } else {
+            size_t size;
             size_t num;
+            size_t i;
             cl_name_version * ext_version;
-            err = clGetPlatformInfo(cl_platform, CL_PLATFORM_EXTENSIONS_WITH_VERSION, 0, NULL, &num);
+            // The size is returned in bytes, not in number of entries
+            err = clGetPlatformInfo(cl_platform, CL_PLATFORM_EXTENSIONS_WITH_VERSION, 0, NULL, &size);
             if (CL_SUCCESS != err)
                 FATAL_ERROR("clGetPlatformInfo", err);
-            ext_version = (cl_name_version*)malloc(sizeof(cl_name_version) * num);
+            num = size / sizeof(cl_name_version);
+            ext_version = (cl_name_version*)malloc(size + 1);
             if (NULL == ext_version)
                 FATAL_ERROR("malloc", ENOMEM);
             err = clGetPlatformInfo(cl_platform, CL_PLATFORM_EXTENSIONS_WITH_VERSION,
-                                    num, &ext_version, NULL);
+                                    size, ext_version, NULL);
             if (CL_SUCCESS != err)
                 FATAL_ERROR("clGetPlatformInfo", err);
             printf ("\tExtensions with Versions: ");
@@ -1111,7 +1066,6 @@ int opencl_print_info(void)
     for (i = 0; i < ocl_numPlatforms; i++) {
 
         printf ("================= %d. platform =================\n", i);
-        opencl_platform_supports_init(ocl_platforms[i]);
         err = opencl_print_platform(ocl_platforms[i]);
         if (0 != err)
             FATAL_ERROR("opencl_print_info", err);
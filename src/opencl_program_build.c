@@ -0,0 +1,146 @@
+//
+//  opencl_program_build.c : Part of libHAWOpenCL
+//
+//  Build a program once and create all of its kernels, which may then
+//  be looked up by name.
+//
+//  Copyright (c) 2018-2022 Rainer Keller, HS Esslingen. All rights reserved.
+//
+#include "HAWOpenCL_config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <stdint.h>
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+
+#if defined(__APPLE__) && defined(__MACH__)
+#include <OpenCL/opencl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include "HAWOpenCL.h"
+#include "opencl_internal.h"
+
+// The hash of the kernel name, to index the kernel table
+static uint32_t opencl_program_hash(const char * name) {
+    return (uint32_t) opencl_hash_fnv1a(OPENCL_HASH_FNV1A_INIT, name, strlen(name));
+}
+
+int opencl_program_kernels_create(hawopencl_program * program) {
+    cl_uint i;
+    int err;
+
+    err = clCreateKernelsInProgram(program->program, 0, NULL, &program->num_kernels);
+    if (CL_SUCCESS != err)
+        FATAL_ERROR("clCreateKernelsInProgram", err);
+
+    program->kernels = (cl_kernel *) malloc(program->num_kernels * sizeof(cl_kernel));
+    program->kernel_names = (char **) malloc(program->num_kernels * sizeof(char *));
+    if (NULL == program->kernels || NULL == program->kernel_names)
+        FATAL_ERROR("malloc", ENOMEM);
+
+    err = clCreateKernelsInProgram(program->program, program->num_kernels, program->kernels, NULL);
+    if (CL_SUCCESS != err)
+        FATAL_ERROR("clCreateKernelsInProgram", err);
+
+    // The table has a power-of-two size of at least twice the number of kernels
+    program->table_size = 4;
+    while (program->table_size < 2 * program->num_kernels)
+        program->table_size *= 2;
+    program->table = (cl_int *) malloc(program->table_size * sizeof(cl_int));
+    if (NULL == program->table)
+        FATAL_ERROR("malloc", ENOMEM);
+    for (i = 0; i < program->table_size; i++)
+        program->table[i] = -1;
+
+    for (i = 0; i < program->num_kernels; i++) {
+        size_t len;
+        uint32_t pos;
+
+        err = clGetKernelInfo(program->kernels[i], CL_KERNEL_FUNCTION_NAME, 0, NULL, &len);
+        if (CL_SUCCESS != err)
+            FATAL_ERROR("clGetKernelInfo", err);
+        program->kernel_names[i] = (char *) malloc(len + 1);
+        if (NULL == program->kernel_names[i])
+            FATAL_ERROR("malloc", ENOMEM);
+        err = clGetKernelInfo(program->kernels[i], CL_KERNEL_FUNCTION_NAME,
+                len, program->kernel_names[i], NULL);
+        if (CL_SUCCESS != err)
+            FATAL_ERROR("clGetKernelInfo", err);
+        program->kernel_names[i][len] = '\0';
+
+        // Open addressing with linear probing
+        pos = opencl_program_hash(program->kernel_names[i]) & (program->table_size - 1);
+        while (-1 != program->table[pos])
+            pos = (pos + 1) & (program->table_size - 1);
+        program->table[pos] = (cl_int) i;
+    }
+    return CL_SUCCESS;
+}
+
+int opencl_program_build_with_options(const char * program_source,
+        hawopencl_build_options * options,
+        const cl_device_id device_id,
+        const cl_context context,
+        hawopencl_program ** program) {
+    hawopencl_program * p;
+    hawopencl_build_options default_options;
+
+    p = (hawopencl_program *) calloc(1, sizeof(hawopencl_program));
+    if (NULL == p)
+        FATAL_ERROR("calloc", ENOMEM);
+
+    if (NULL == options) {
+        opencl_build_options_init(&default_options, HAWOPENCL_BUILD_PROFILE_RELEASE);
+        options = &default_options;
+    }
+    p->program = opencl_kernel_build_program(program_source, opencl_build_options_string(options),
+            "(program)", device_id, context);
+    if (options == &default_options)
+        opencl_build_options_free(&default_options);
+    opencl_program_kernels_create(p);
+
+    *program = p;
+    return CL_SUCCESS;
+}
+
+int opencl_program_build(const char * program_source,
+        const cl_device_id device_id,
+        const cl_context context,
+        hawopencl_program ** program) {
+    return opencl_program_build_with_options(program_source, NULL, device_id, context, program);
+}
+
+cl_kernel opencl_program_kernel(const hawopencl_program * program,
+        const char * kernel_name) {
+    uint32_t pos = opencl_program_hash(kernel_name) & (program->table_size - 1);
+
+    while (-1 != program->table[pos]) {
+        const cl_int idx = program->table[pos];
+        if (0 == strcmp(program->kernel_names[idx], kernel_name))
+            return program->kernels[idx];
+        pos = (pos + 1) & (program->table_size - 1);
+    }
+    return NULL;
+}
+
+int opencl_program_release(hawopencl_program * program) {
+    cl_uint i;
+
+    for (i = 0; i < program->num_kernels; i++) {
+        OPENCL_CHECK(clReleaseKernel, (program->kernels[i]));
+        free(program->kernel_names[i]);
+    }
+    free(program->kernels);
+    free(program->kernel_names);
+    free(program->table);
+    if (NULL != program->program)
+        OPENCL_CHECK(clReleaseProgram, (program->program));
+    free(program);
+    return CL_SUCCESS;
+}
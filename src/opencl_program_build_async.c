@@ -0,0 +1,236 @@
+//
+//  opencl_program_build_async.c : Part of libHAWOpenCL
+//
+//  Build programs asynchronously on a bounded pool of worker threads,
+//  each building one program at a time by a blocking clBuildProgram().
+//
+//  Copyright (c) 2018-2022 Rainer Keller, HS Esslingen. All rights reserved.
+//
+#include "HAWOpenCL_config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <stdint.h>
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+#if defined(__APPLE__) && defined(__MACH__)
+#include <OpenCL/opencl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include "HAWOpenCL.h"
+#include "opencl_internal.h"
+
+#define BUILD_THREADS_MAX 8
+
+struct hawopencl_build_job {
+    char * source;
+    char * options;
+    cl_device_id device_id;
+    cl_context context;
+    cl_program program;
+    uint64_t key;
+    bool from_cache;
+    bool done;
+    cl_int err;
+    struct hawopencl_build_job * next;
+};
+
+#if defined(HAVE_PTHREAD_H)
+static pthread_mutex_t build_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t build_queue_cond = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t build_done_cond = PTHREAD_COND_INITIALIZER;
+static hawopencl_build_job * build_queue_head = NULL;
+static hawopencl_build_job * build_queue_tail = NULL;
+static int build_threads_num = 0;
+#endif
+
+// Mark the job as finished and wake up the waiting thread
+static void opencl_program_build_done(hawopencl_build_job * job, cl_int err) {
+#if defined(HAVE_PTHREAD_H)
+    pthread_mutex_lock(&build_mutex);
+#endif
+    job->err = err;
+    job->done = true;
+#if defined(HAVE_PTHREAD_H)
+    pthread_cond_broadcast(&build_done_cond);
+    pthread_mutex_unlock(&build_mutex);
+#endif
+}
+
+// Try the binary cache, otherwise start the build from source
+static void opencl_program_build_async_start(hawopencl_build_job * job) {
+    cl_int err;
+
+    if (opencl_kernel_cache_enabled()) {
+        job->key = opencl_kernel_cache_key(job->source, job->options, job->device_id);
+        job->program = opencl_kernel_cache_program(job->context, job->device_id, job->key, job->options);
+        if (NULL != job->program) {
+            job->from_cache = true;
+            opencl_program_build_done(job, CL_SUCCESS);
+            return;
+        }
+    }
+
+    job->program = clCreateProgramWithSource(job->context, 1, (const char **) &job->source, NULL, &err);
+    if (NULL == job->program || CL_SUCCESS != err)
+        FATAL_ERROR("clCreateProgramWithSource", err);
+
+    // Without a callback the build has finished upon return: the job is done exactly once,
+    // as a driver may both call the callback and return an error
+    err = clBuildProgram(job->program, 1, &job->device_id, job->options, NULL, NULL);
+    opencl_program_build_done(job, err);
+}
+
+#if defined(HAVE_PTHREAD_H)
+static void * opencl_program_build_worker(void * arg __HAW_OPENCL_ATTR_UNUSED__) {
+    for (;;) {
+        hawopencl_build_job * job;
+
+        pthread_mutex_lock(&build_mutex);
+        while (NULL == build_queue_head)
+            pthread_cond_wait(&build_queue_cond, &build_mutex);
+        job = build_queue_head;
+        build_queue_head = job->next;
+        if (NULL == build_queue_head)
+            build_queue_tail = NULL;
+        pthread_mutex_unlock(&build_mutex);
+
+        opencl_program_build_async_start(job);
+    }
+    return NULL;
+}
+
+// Start the worker threads; called with build_mutex held
+static void opencl_program_build_threads_start(void) {
+    const char * env = getenv("OPENCL_BUILD_THREADS");
+    int num = 0;
+    int i;
+
+    if (NULL != env)
+        num = atoi(env);
+#if defined(_SC_NPROCESSORS_ONLN)
+    if (0 >= num)
+        num = (int) sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    if (0 >= num)
+        num = 1;
+    if (num > BUILD_THREADS_MAX)
+        num = BUILD_THREADS_MAX;
+
+    for (i = 0; i < num; i++) {
+        pthread_t thread;
+        int err = pthread_create(&thread, NULL, opencl_program_build_worker, NULL);
+        if (0 != err)
+            FATAL_ERROR("pthread_create", err);
+        pthread_detach(thread);
+    }
+    build_threads_num = num;
+}
+#endif
+
+int opencl_program_build_async(const char * program_source,
+        hawopencl_build_options * options,
+        const cl_device_id device_id,
+        const cl_context context,
+        hawopencl_build_job ** job) {
+    hawopencl_build_job * j;
+    hawopencl_build_options default_options;
+
+    j = (hawopencl_build_job *) calloc(1, sizeof(hawopencl_build_job));
+    if (NULL == j)
+        FATAL_ERROR("calloc", ENOMEM);
+
+    if (NULL == options) {
+        opencl_build_options_init(&default_options, HAWOPENCL_BUILD_PROFILE_RELEASE);
+        options = &default_options;
+    }
+    j->source = strdup(program_source);
+    j->options = strdup(opencl_build_options_string(options));
+    if (NULL == j->source || NULL == j->options)
+        FATAL_ERROR("strdup", ENOMEM);
+    if (options == &default_options)
+        opencl_build_options_free(&default_options);
+
+    j->device_id = device_id;
+    j->context = context;
+    OPENCL_CHECK(clRetainContext, (context));
+
+#if defined(HAVE_PTHREAD_H)
+    pthread_mutex_lock(&build_mutex);
+    if (0 == build_threads_num)
+        opencl_program_build_threads_start();
+    if (NULL == build_queue_tail)
+        build_queue_head = j;
+    else
+        build_queue_tail->next = j;
+    build_queue_tail = j;
+    pthread_cond_signal(&build_queue_cond);
+    pthread_mutex_unlock(&build_mutex);
+#else
+    opencl_program_build_async_start(j);
+#endif
+
+    *job = j;
+    return CL_SUCCESS;
+}
+
+bool opencl_program_build_ready(hawopencl_build_job * job) {
+    bool done;
+#if defined(HAVE_PTHREAD_H)
+    pthread_mutex_lock(&build_mutex);
+    done = job->done;
+    pthread_mutex_unlock(&build_mutex);
+#else
+    done = job->done;
+#endif
+    return done;
+}
+
+int opencl_program_build_wait(hawopencl_build_job * job,
+        hawopencl_program ** program) {
+    hawopencl_program * p;
+    cl_build_status status = CL_BUILD_ERROR;
+
+#if defined(HAVE_PTHREAD_H)
+    pthread_mutex_lock(&build_mutex);
+    while (!job->done)
+        pthread_cond_wait(&build_done_cond, &build_mutex);
+    pthread_mutex_unlock(&build_mutex);
+#endif
+
+    if (CL_SUCCESS == job->err)
+        OPENCL_CHECK(clGetProgramBuildInfo, (job->program, job->device_id, CL_PROGRAM_BUILD_STATUS,
+                sizeof(status), &status, NULL));
+    if (CL_SUCCESS != job->err || CL_BUILD_SUCCESS != status) {
+        opencl_kernel_build_log_print(job->program, job->device_id, "(program)");
+        FATAL_ERROR("clBuildProgram", (CL_SUCCESS != job->err) ? job->err : CL_BUILD_PROGRAM_FAILURE);
+    }
+    if (!job->from_cache && opencl_kernel_cache_enabled())
+        opencl_kernel_cache_store(job->key, job->program, job->device_id);
+
+    p = (hawopencl_program *) calloc(1, sizeof(hawopencl_program));
+    if (NULL == p)
+        FATAL_ERROR("calloc", ENOMEM);
+    p->program = job->program;
+    opencl_program_kernels_create(p);
+
+    OPENCL_CHECK(clReleaseContext, (job->context));
+    free(job->source);
+    free(job->options);
+    free(job);
+
+    *program = p;
+    return CL_SUCCESS;
+}
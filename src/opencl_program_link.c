@@ -0,0 +1,356 @@
+//
+//  opencl_program_link.c : Part of libHAWOpenCL
+//
+//  Compile shared utility code once into library programs using
+//  clCompileProgram() and clLinkProgram(), instead of pasting the headers
+//  into every kernel source; libraries are cached in memory and on disk.
+//
+//  Copyright (c) 2018-2022 Rainer Keller, HS Esslingen. All rights reserved.
+//
+#include "HAWOpenCL_config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <stdint.h>
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+#if defined(__APPLE__) && defined(__MACH__)
+#include <OpenCL/opencl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include "HAWOpenCL.h"
+#include "opencl_internal.h"
+
+struct hawopencl_library {
+    char * header_name;             // The name kernels include the header by, e.g. "util.h"
+    cl_program header;              // The header's source, passed to clCompileProgram()
+    cl_program library;             // The compiled library, passed to clLinkProgram(); NULL while being built
+    cl_ulong key;                   // Identifies the library in the binary cache
+    cl_device_id device_id;         // The device the library was compiled for
+    cl_context context;             // The context the library was compiled in
+    unsigned int refcount;          // The number of opencl_library_build() not yet released
+    struct hawopencl_library * next; // The next library built
+};
+
+// Libraries already built, shared by all callers with the same key, device and context
+static hawopencl_library * libraries = NULL;
+
+// The options of clBuildProgram(), which clLinkProgram() accepts as well
+static const char * const linker_options[] = {
+    "-cl-denorms-are-zero",
+    "-cl-no-signed-zeros",
+    "-cl-unsafe-math-optimizations",
+    "-cl-finite-math-only",
+    "-cl-fast-relaxed-math",
+    "-cl-no-subgroup-ifp",
+};
+#define NUM_LINK_OPTIONS (sizeof(linker_options) / sizeof(linker_options[0]))
+
+#if defined(HAVE_PTHREAD_H)
+static pthread_mutex_t libraries_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t libraries_built = PTHREAD_COND_INITIALIZER; // Signalled, whenever a library has been built
+#  define LIBRARIES_LOCK()    pthread_mutex_lock(&libraries_mutex)
+#  define LIBRARIES_UNLOCK()  pthread_mutex_unlock(&libraries_mutex)
+#  define LIBRARIES_WAIT()    pthread_cond_wait(&libraries_built, &libraries_mutex)
+#  define LIBRARIES_SIGNAL()  pthread_cond_broadcast(&libraries_built)
+#else
+#  define LIBRARIES_LOCK()
+#  define LIBRARIES_UNLOCK()
+#  define LIBRARIES_WAIT()
+#  define LIBRARIES_SIGNAL()
+#endif
+
+/*
+ * Local functions
+ */
+static char * opencl_program_link_options(const char * options, const char * suffix);
+static char * opencl_program_link_options_filter(const char * options);
+static void opencl_program_compile(cl_program program, const char * options, const char * build_name,
+        cl_uint num_headers, const cl_program * headers, const char ** header_names,
+        const cl_device_id device_id);
+static cl_program opencl_program_link(cl_uint num_programs, const cl_program * programs,
+        const char * link_options, const char * build_name,
+        const cl_device_id device_id, const cl_context context);
+
+// Returns the newly allocated "options suffix", to distinguish the cache keys
+static char * opencl_program_link_options(const char * options, const char * suffix) {
+    char * str = malloc(strlen(options) + 1 + strlen(suffix) + 1);
+    if (NULL == str)
+        FATAL_ERROR("malloc", ENOMEM);
+    sprintf(str, "%s %s", options, suffix);
+    return str;
+}
+
+// Returns the newly allocated subset of the build options, which apply to linking
+static char * opencl_program_link_options_filter(const char * options) {
+    char * str = malloc(strlen(options) + 1);
+    size_t len = 0;
+
+    if (NULL == str)
+        FATAL_ERROR("malloc", ENOMEM);
+    while ('\0' != *options) {
+        const size_t option_len = strcspn(options, " ");
+        unsigned int i;
+        for (i = 0; i < NUM_LINK_OPTIONS; i++)
+            if (option_len == strlen(linker_options[i]) &&
+                0 == strncmp(options, linker_options[i], option_len)) {
+                if (0 < len)
+                    str[len++] = ' ';
+                memcpy(str + len, options, option_len);
+                len += option_len;
+                break;
+            }
+        options += option_len;
+        options += strspn(options, " ");
+    }
+    str[len] = '\0';
+    return str;
+}
+
+// Compile program into an object; prints the build log and exits on failure
+static void opencl_program_compile(cl_program program, const char * options, const char * build_name,
+        cl_uint num_headers, const cl_program * headers, const char ** header_names,
+        const cl_device_id device_id) {
+    int err;
+
+    err = clCompileProgram(program, 1, &device_id, options,
+            num_headers, (0 == num_headers) ? NULL : headers,
+            (0 == num_headers) ? NULL : header_names, NULL, NULL);
+    if (CL_SUCCESS != err) {
+        opencl_kernel_build_log_print(program, device_id, build_name);
+        FATAL_ERROR("clCompileProgram", err);
+    }
+}
+
+// Link objects and libraries; prints the build log and exits on failure
+static cl_program opencl_program_link(cl_uint num_programs, const cl_program * programs,
+        const char * link_options, const char * build_name,
+        const cl_device_id device_id, const cl_context context) {
+    cl_program program;
+    int err;
+
+    program = clLinkProgram(context, 1, &device_id, link_options,
+            num_programs, programs, NULL, NULL, &err);
+    if (NULL == program || CL_SUCCESS != err) {
+        if (NULL != program)
+            opencl_kernel_build_log_print(program, device_id, build_name);
+        FATAL_ERROR("clLinkProgram", err);
+    }
+    return program;
+}
+
+int opencl_library_build(const char * header_name,
+        const char * header_source,
+        const char * library_source,
+        hawopencl_build_options * options,
+        const cl_device_id device_id,
+        const cl_context context,
+        hawopencl_library ** library) {
+    hawopencl_library * l;
+    hawopencl_build_options default_options;
+    char * key_source;
+    char * key_options;
+    uint64_t key;
+    cl_program object;
+    cl_program library_program;
+    int err;
+
+    if (NULL == options) {
+        opencl_build_options_init(&default_options, HAWOPENCL_BUILD_PROFILE_RELEASE);
+        options = &default_options;
+    }
+
+    // The key covers the header's name and contents, which the library is compiled with
+    key_source = malloc(strlen(header_name) + 1 + strlen(header_source) + 1 + strlen(library_source) + 1);
+    if (NULL == key_source)
+        FATAL_ERROR("malloc", ENOMEM);
+    sprintf(key_source, "%s\n%s\n%s", header_name, header_source, library_source);
+    key_options = opencl_program_link_options(opencl_build_options_string(options), "-create-library");
+    key = opencl_kernel_cache_key(key_source, key_options, device_id);
+    free(key_source);
+    free(key_options);
+
+    LIBRARIES_LOCK();
+    for (l = libraries; NULL != l; l = l->next)
+        if (l->key == key && l->device_id == device_id && l->context == context)
+            break;
+    if (NULL != l) {
+        l->refcount++;
+        // Another thread is building this library, wait for it instead of building twice
+        while (NULL == l->library)
+            LIBRARIES_WAIT();
+        LIBRARIES_UNLOCK();
+        if (options == &default_options)
+            opencl_build_options_free(&default_options);
+        *library = l;
+        return CL_SUCCESS;
+    }
+
+    l = (hawopencl_library *) calloc(1, sizeof(hawopencl_library));
+    if (NULL == l)
+        FATAL_ERROR("calloc", ENOMEM);
+    l->header_name = strdup(header_name);
+    if (NULL == l->header_name)
+        FATAL_ERROR("strdup", ENOMEM);
+    l->key = key;
+    l->device_id = device_id;
+    l->context = context;
+    l->refcount = 1;
+    OPENCL_CHECK(clRetainContext, (context));
+    l->next = libraries;
+    libraries = l;
+    LIBRARIES_UNLOCK();
+
+    l->header = clCreateProgramWithSource(context, 1, &header_source, NULL, &err);
+    if (NULL == l->header || CL_SUCCESS != err)
+        FATAL_ERROR("clCreateProgramWithSource", err);
+
+    library_program = opencl_kernel_cache_binary(context, device_id, key);
+    if (NULL == library_program) {
+        object = clCreateProgramWithSource(context, 1, &library_source, NULL, &err);
+        if (NULL == object || CL_SUCCESS != err)
+            FATAL_ERROR("clCreateProgramWithSource", err);
+        opencl_program_compile(object, opencl_build_options_string(options), header_name,
+                1, &l->header, &header_name, device_id);
+        library_program = opencl_program_link(1, &object, "-create-library", header_name,
+                device_id, context);
+        OPENCL_CHECK(clReleaseProgram, (object));
+        opencl_kernel_cache_store(key, library_program, device_id);
+    }
+    if (options == &default_options)
+        opencl_build_options_free(&default_options);
+
+    LIBRARIES_LOCK();
+    l->library = library_program;
+    LIBRARIES_SIGNAL();
+    LIBRARIES_UNLOCK();
+
+    *library = l;
+    return CL_SUCCESS;
+}
+
+int opencl_library_load(const char * header_file_name,
+        const char * library_file_name,
+        hawopencl_build_options * options,
+        const cl_device_id device_id,
+        const cl_context context,
+        hawopencl_library ** library) {
+    char * header_source = opencl_kernel_load_source(header_file_name);
+    char * library_source = opencl_kernel_load_source(library_file_name);
+
+    opencl_library_build(header_file_name, header_source, library_source,
+            options, device_id, context, library);
+    free(header_source);
+    free(library_source);
+    return CL_SUCCESS;
+}
+
+int opencl_library_release(hawopencl_library * library) {
+    hawopencl_library ** l;
+
+    LIBRARIES_LOCK();
+    if (0 < --library->refcount) {
+        LIBRARIES_UNLOCK();
+        return CL_SUCCESS;
+    }
+    for (l = &libraries; NULL != *l; l = &(*l)->next)
+        if (*l == library) {
+            *l = library->next;
+            break;
+        }
+    LIBRARIES_UNLOCK();
+
+    OPENCL_CHECK(clReleaseProgram, (library->header));
+    OPENCL_CHECK(clReleaseProgram, (library->library));
+    OPENCL_CHECK(clReleaseContext, (library->context));
+    free(library->header_name);
+    free(library);
+    return CL_SUCCESS;
+}
+
+int opencl_program_build_linked(const char * program_source,
+        cl_uint num_libraries,
+        hawopencl_library * libraries[],
+        hawopencl_build_options * options,
+        const cl_device_id device_id,
+        const cl_context context,
+        hawopencl_program ** program) {
+    hawopencl_program * p;
+    hawopencl_build_options default_options;
+    const char * build_options;
+    char * key_options;
+    char * final_options;
+    const char ** header_names;
+    cl_program * programs;
+    uint64_t key = 0;
+    cl_uint i;
+    int err;
+
+    p = (hawopencl_program *) calloc(1, sizeof(hawopencl_program));
+    header_names = (const char **) malloc((num_libraries + 1) * sizeof(char *));
+    programs = (cl_program *) malloc((num_libraries + 1) * sizeof(cl_program));
+    if (NULL == p || NULL == header_names || NULL == programs)
+        FATAL_ERROR("malloc", ENOMEM);
+
+    if (NULL == options) {
+        opencl_build_options_init(&default_options, HAWOPENCL_BUILD_PROFILE_RELEASE);
+        options = &default_options;
+    }
+    build_options = opencl_build_options_string(options);
+
+    // The linked executable depends on the keys of all libraries
+    if (opencl_kernel_cache_enabled()) {
+        key_options = opencl_program_link_options(build_options, "-link");
+        for (i = 0; i < num_libraries; i++) {
+            char library_key[20];
+            char * tmp;
+            snprintf(library_key, sizeof(library_key), "%016llx", (unsigned long long) libraries[i]->key);
+            tmp = opencl_program_link_options(key_options, library_key);
+            free(key_options);
+            key_options = tmp;
+        }
+        key = opencl_kernel_cache_key(program_source, key_options, device_id);
+        free(key_options);
+        p->program = opencl_kernel_cache_program(context, device_id, key, NULL);
+    }
+
+    if (NULL == p->program) {
+        programs[0] = clCreateProgramWithSource(context, 1, &program_source, NULL, &err);
+        if (NULL == programs[0] || CL_SUCCESS != err)
+            FATAL_ERROR("clCreateProgramWithSource", err);
+
+        for (i = 0; i < num_libraries; i++) {
+            header_names[i] = libraries[i]->header_name;
+            programs[i + 1] = libraries[i]->header;
+        }
+        opencl_program_compile(programs[0], build_options, "(program)",
+                num_libraries, &programs[1], header_names, device_id);
+
+        for (i = 0; i < num_libraries; i++)
+            programs[i + 1] = libraries[i]->library;
+        final_options = opencl_program_link_options_filter(build_options);
+        p->program = opencl_program_link(num_libraries + 1, programs, final_options, "(program)",
+                device_id, context);
+        free(final_options);
+        OPENCL_CHECK(clReleaseProgram, (programs[0]));
+        if (opencl_kernel_cache_enabled())
+            opencl_kernel_cache_store(key, p->program, device_id);
+    }
+    if (options == &default_options)
+        opencl_build_options_free(&default_options);
+    free(header_names);
+    free(programs);
+
+    opencl_program_kernels_create(p);
+    *program = p;
+    return CL_SUCCESS;
+}
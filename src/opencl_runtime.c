@@ -0,0 +1,164 @@
+//
+//  opencl_runtime.c : Part of libHAWOpenCL
+//
+//  The programs built for the devices of a runtime, shared by all threads.
+//
+//  Copyright (c) 2018-2022 Rainer Keller, HS Esslingen. All rights reserved.
+//
+#include "HAWOpenCL_config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <stdint.h>
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+#if defined(__APPLE__) && defined(__MACH__)
+#include <OpenCL/opencl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include "HAWOpenCL.h"
+#include "opencl_internal.h"
+
+// A program built for one device of the runtime
+typedef struct opencl_runtime_program {
+    uint64_t key;                   // opencl_kernel_cache_key() of source, options and device
+    char * source;                  // The source, to tell programs with the same key apart
+    char * options;                 // The options string the program is built with
+    cl_uint device;                 // The index of the device within the runtime
+    cl_program program;             // NULL while being built
+    struct opencl_runtime_program * next;
+} opencl_runtime_program;
+
+struct hawopencl_runtime_state {
+    opencl_runtime_program * programs;
+#if defined(HAVE_PTHREAD_H)
+    pthread_mutex_t mutex;
+    pthread_cond_t built;           // Signalled, whenever a program has been built
+#endif
+};
+
+#if defined(HAVE_PTHREAD_H)
+#  define RUNTIME_LOCK(s)    pthread_mutex_lock(&(s)->mutex)
+#  define RUNTIME_UNLOCK(s)  pthread_mutex_unlock(&(s)->mutex)
+#  define RUNTIME_WAIT(s)    pthread_cond_wait(&(s)->built, &(s)->mutex)
+#  define RUNTIME_SIGNAL(s)  pthread_cond_broadcast(&(s)->built)
+#else
+#  define RUNTIME_LOCK(s)
+#  define RUNTIME_UNLOCK(s)
+#  define RUNTIME_WAIT(s)
+#  define RUNTIME_SIGNAL(s)
+#endif
+
+struct hawopencl_runtime_state * opencl_runtime_state_create(void) {
+    struct hawopencl_runtime_state * state;
+
+    state = calloc(1, sizeof(struct hawopencl_runtime_state));
+    if (NULL == state)
+        FATAL_ERROR("calloc", ENOMEM);
+#if defined(HAVE_PTHREAD_H)
+    pthread_mutex_init(&state->mutex, NULL);
+    pthread_cond_init(&state->built, NULL);
+#endif
+    return state;
+}
+
+void opencl_runtime_state_free(struct hawopencl_runtime_state * state) {
+    opencl_runtime_program * p;
+    opencl_runtime_program * next;
+
+    for (p = state->programs; NULL != p; p = next) {
+        next = p->next;
+        OPENCL_CHECK(clReleaseProgram, (p->program));
+        free(p->source);
+        free(p->options);
+        free(p);
+    }
+#if defined(HAVE_PTHREAD_H)
+    pthread_cond_destroy(&state->built);
+    pthread_mutex_destroy(&state->mutex);
+#endif
+    free(state);
+}
+
+int opencl_runtime_kernel(hawopencl_runtime * runtime,
+        const char * kernel_source,
+        const char * kernel_name,
+        cl_uint device,
+        hawopencl_build_options * options,
+        cl_kernel * kernel) {
+    struct hawopencl_runtime_state * state = runtime->state;
+    hawopencl_build_options default_options;
+    opencl_runtime_program * p;
+    cl_program program;
+    char * options_string;
+    uint64_t key;
+    int err;
+
+    if (device >= runtime->num_devices)
+        return CL_INVALID_DEVICE;
+
+    // The options may be shared by threads, hence they are not converted in place
+    if (NULL == options) {
+        opencl_build_options_init(&default_options, HAWOPENCL_BUILD_PROFILE_RELEASE);
+        options_string = opencl_build_options_assemble(&default_options);
+        opencl_build_options_free(&default_options);
+    } else
+        options_string = opencl_build_options_assemble(options);
+    key = opencl_kernel_cache_key(kernel_source, options_string, runtime->device_ids[device]);
+
+    RUNTIME_LOCK(state);
+    for (;;) {
+        for (p = state->programs; NULL != p; p = p->next)
+            if (p->key == key && p->device == device &&
+                0 == strcmp(p->source, kernel_source) && 0 == strcmp(p->options, options_string))
+                break;
+        // Another thread is building this program, wait for it instead of building twice
+        if (NULL != p && NULL == p->program) {
+            RUNTIME_WAIT(state);
+            continue;
+        }
+        break;
+    }
+    if (NULL == p) {
+        p = calloc(1, sizeof(opencl_runtime_program));
+        if (NULL == p)
+            FATAL_ERROR("calloc", ENOMEM);
+        p->key = key;
+        p->source = strdup(kernel_source);
+        if (NULL == p->source)
+            FATAL_ERROR("strdup", ENOMEM);
+        p->options = options_string;
+        options_string = NULL;
+        p->device = device;
+        p->next = state->programs;
+        state->programs = p;
+        RUNTIME_UNLOCK(state);
+
+        // Other programs may be built and kernels created concurrently
+        program = opencl_kernel_build_program(kernel_source, p->options, kernel_name,
+                runtime->device_ids[device], runtime->context);
+
+        RUNTIME_LOCK(state);
+        p->program = program;
+        RUNTIME_SIGNAL(state);
+    }
+    program = p->program;
+    RUNTIME_UNLOCK(state);
+    free(options_string);
+
+    *kernel = clCreateKernel(program, kernel_name, &err);
+    if (CL_INVALID_KERNEL_NAME == err)
+        return err;
+    if (NULL == *kernel || CL_SUCCESS != err)
+        FATAL_ERROR("clCreateKernel", err);
+    return CL_SUCCESS;
+}
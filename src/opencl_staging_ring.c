@@ -0,0 +1,241 @@
+//
+//  opencl_staging_ring.c : Part of libHAWOpenCL
+//
+//  Ring of slots in pinned host memory for asynchronous transfers; the
+//  slots are recycled, once the event of their last transfer completed.
+//
+//  Copyright (c) 2018-2022 Rainer Keller, HS Esslingen. All rights reserved.
+//
+#include "HAWOpenCL_config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+#ifdef HAVE_PTHREAD_H
+#include <pthread.h>
+#endif
+
+#if defined(__APPLE__) && defined(__MACH__)
+#include <OpenCL/opencl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include "HAWOpenCL.h"
+#include "opencl_internal.h"
+
+typedef struct {
+    bool acquired;                  // Acquired and not yet written or released
+    cl_event event;                 // The last transfer, NULL if none is pending
+} opencl_staging_slot;
+
+struct hawopencl_staging_ring {
+    cl_command_queue command_queue; // The queue the buffer was mapped with
+    cl_mem buffer;                  // The CL_MEM_ALLOC_HOST_PTR buffer of all slots
+    char * host;                    // The mapped buffer
+    size_t slot_size;
+    cl_uint num_slots;
+    cl_uint next;                   // The slot to acquire next
+    opencl_staging_slot * slots;
+#if defined(HAVE_PTHREAD_H)
+    pthread_mutex_t mutex;
+#endif
+};
+
+#if defined(HAVE_PTHREAD_H)
+#  define RING_LOCK(r)    pthread_mutex_lock(&(r)->mutex)
+#  define RING_UNLOCK(r)  pthread_mutex_unlock(&(r)->mutex)
+#else
+#  define RING_LOCK(r)
+#  define RING_UNLOCK(r)
+#endif
+
+/*
+ * Local functions
+ */
+static int opencl_staging_ring_transfer(hawopencl_staging_ring * ring, bool write,
+        cl_uint slot, const cl_command_queue command_queue, cl_mem buffer,
+        size_t offset, size_t size, cl_uint num_events, const cl_event * wait_list, cl_event * event);
+
+// Enqueue the transfer of an acquired slot and keep its event for recycling the slot
+static int opencl_staging_ring_transfer(hawopencl_staging_ring * ring, bool write,
+        cl_uint slot, const cl_command_queue command_queue, cl_mem buffer,
+        size_t offset, size_t size, cl_uint num_events, const cl_event * wait_list, cl_event * event) {
+    cl_event previous;
+    void * ptr;
+    cl_event e;
+    int err;
+
+    if (slot >= ring->num_slots || size > ring->slot_size)
+        return CL_INVALID_VALUE;
+    RING_LOCK(ring);
+    if (!ring->slots[slot].acquired) {
+        RING_UNLOCK(ring);
+        return CL_INVALID_VALUE;
+    }
+    previous = ring->slots[slot].event;
+    ring->slots[slot].event = NULL;
+    RING_UNLOCK(ring);
+
+    // A slot read into may be reused before being released, possibly on another queue
+    if (NULL != previous) {
+        OPENCL_CHECK(clWaitForEvents, (1, &previous));
+        OPENCL_CHECK(clReleaseEvent, (previous));
+    }
+
+    // The slot belongs to the caller until the event is stored
+    ptr = ring->host + slot * ring->slot_size;
+    if (write)
+        err = clEnqueueWriteBuffer(command_queue, buffer, CL_FALSE, offset, size, ptr,
+                num_events, wait_list, &e);
+    else
+        err = clEnqueueReadBuffer(command_queue, buffer, CL_FALSE, offset, size, ptr,
+                num_events, wait_list, &e);
+    if (CL_SUCCESS != err)
+        return err;
+    // The commands are only submitted with the next flush; the slot's next user waits for them
+    OPENCL_CHECK(clFlush, (command_queue));
+    if (NULL != event) {
+        OPENCL_CHECK(clRetainEvent, (e));
+        *event = e;
+    }
+
+    RING_LOCK(ring);
+    ring->slots[slot].event = e;
+    if (write)
+        ring->slots[slot].acquired = false;
+    RING_UNLOCK(ring);
+    return CL_SUCCESS;
+}
+
+int opencl_staging_ring_create(const cl_context context,
+        const cl_command_queue command_queue,
+        size_t slot_size,
+        cl_uint num_slots,
+        hawopencl_staging_ring ** ring) {
+    hawopencl_staging_ring * r;
+    int err;
+
+    if (0 == slot_size || 0 == num_slots)
+        return CL_INVALID_VALUE;
+    r = calloc(1, sizeof(hawopencl_staging_ring));
+    if (NULL == r)
+        FATAL_ERROR("calloc", ENOMEM);
+    r->slots = calloc(num_slots, sizeof(opencl_staging_slot));
+    if (NULL == r->slots)
+        FATAL_ERROR("calloc", ENOMEM);
+    r->slot_size = slot_size;
+    r->num_slots = num_slots;
+
+    r->buffer = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR,
+            slot_size * num_slots, NULL, &err);
+    if (NULL == r->buffer || CL_SUCCESS != err)
+        FATAL_ERROR("clCreateBuffer", err);
+    // Mapped once for the ring's lifetime; the pointer stays valid until unmapped
+    r->host = clEnqueueMapBuffer(command_queue, r->buffer, CL_TRUE, CL_MAP_READ | CL_MAP_WRITE,
+            0, slot_size * num_slots, 0, NULL, NULL, &err);
+    if (NULL == r->host || CL_SUCCESS != err)
+        FATAL_ERROR("clEnqueueMapBuffer", err);
+    OPENCL_CHECK(clRetainCommandQueue, (command_queue));
+    r->command_queue = command_queue;
+#if defined(HAVE_PTHREAD_H)
+    pthread_mutex_init(&r->mutex, NULL);
+#endif
+    *ring = r;
+    return CL_SUCCESS;
+}
+
+int opencl_staging_ring_acquire(hawopencl_staging_ring * ring,
+        cl_uint * slot,
+        void ** ptr) {
+    cl_event event;
+    cl_uint i;
+
+    RING_LOCK(ring);
+    for (i = 0; i < ring->num_slots; i++)
+        if (!ring->slots[(ring->next + i) % ring->num_slots].acquired)
+            break;
+    if (i == ring->num_slots) {
+        RING_UNLOCK(ring);
+        return CL_OUT_OF_RESOURCES;
+    }
+    i = (ring->next + i) % ring->num_slots;
+    ring->next = (i + 1) % ring->num_slots;
+    ring->slots[i].acquired = true;
+    event = ring->slots[i].event;
+    ring->slots[i].event = NULL;
+    RING_UNLOCK(ring);
+
+    // The slots are acquired in order, so this is the oldest transfer
+    if (NULL != event) {
+        OPENCL_CHECK(clWaitForEvents, (1, &event));
+        OPENCL_CHECK(clReleaseEvent, (event));
+    }
+    *slot = i;
+    *ptr = ring->host + i * ring->slot_size;
+    return CL_SUCCESS;
+}
+
+int opencl_staging_ring_write(hawopencl_staging_ring * ring,
+        cl_uint slot,
+        const cl_command_queue command_queue,
+        cl_mem buffer,
+        size_t offset,
+        size_t size,
+        cl_uint num_events,
+        const cl_event * wait_list,
+        cl_event * event) {
+    return opencl_staging_ring_transfer(ring, true, slot, command_queue, buffer,
+            offset, size, num_events, wait_list, event);
+}
+
+int opencl_staging_ring_read(hawopencl_staging_ring * ring,
+        cl_uint slot,
+        const cl_command_queue command_queue,
+        cl_mem buffer,
+        size_t offset,
+        size_t size,
+        cl_uint num_events,
+        const cl_event * wait_list,
+        cl_event * event) {
+    return opencl_staging_ring_transfer(ring, false, slot, command_queue, buffer,
+            offset, size, num_events, wait_list, event);
+}
+
+int opencl_staging_ring_release_slot(hawopencl_staging_ring * ring,
+        cl_uint slot) {
+    if (slot >= ring->num_slots)
+        return CL_INVALID_VALUE;
+    RING_LOCK(ring);
+    if (!ring->slots[slot].acquired) {
+        RING_UNLOCK(ring);
+        return CL_INVALID_VALUE;
+    }
+    ring->slots[slot].acquired = false;
+    RING_UNLOCK(ring);
+    return CL_SUCCESS;
+}
+
+int opencl_staging_ring_release(hawopencl_staging_ring * ring) {
+    cl_uint i;
+
+    for (i = 0; i < ring->num_slots; i++)
+        if (NULL != ring->slots[i].event) {
+            OPENCL_CHECK(clWaitForEvents, (1, &ring->slots[i].event));
+            OPENCL_CHECK(clReleaseEvent, (ring->slots[i].event));
+        }
+    OPENCL_CHECK(clEnqueueUnmapMemObject, (ring->command_queue, ring->buffer, ring->host, 0, NULL, NULL));
+    OPENCL_CHECK(clFinish, (ring->command_queue));
+    OPENCL_CHECK(clReleaseMemObject, (ring->buffer));
+    OPENCL_CHECK(clReleaseCommandQueue, (ring->command_queue));
+#if defined(HAVE_PTHREAD_H)
+    pthread_mutex_destroy(&ring->mutex);
+#endif
+    free(ring->slots);
+    free(ring);
+    return CL_SUCCESS;
+}
@@ -0,0 +1,169 @@
+//
+//  opencl_svm.c : Part of libHAWOpenCL
+//
+//  Regions of shared virtual memory for pointer-rich data structures,
+//  which are passed to kernels without serialization.
+//  Requires OpenCL-2.0, i.e. configuring with HAWOPENCL_CL_VERSION=200.
+//
+//  Copyright (c) 2018-2022 Rainer Keller, HS Esslingen. All rights reserved.
+//
+#include "HAWOpenCL_config.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <assert.h>
+#include <stdint.h>
+#ifdef HAVE_STDLIB_H
+#include <stdlib.h>
+#endif
+
+#if defined(__APPLE__) && defined(__MACH__)
+#include <OpenCL/opencl.h>
+#else
+#include <CL/cl.h>
+#endif
+
+#include "HAWOpenCL.h"
+#include "opencl_internal.h"
+
+#if defined(CL_VERSION_2_0) && HAWOPENCL_CL_VERSION >= 200
+#  define HAWOPENCL_HAVE_SVM 1
+#endif
+
+// The size of the largest OpenCL data type, long16, as used by clSVMAlloc() for alignment 0
+#define SVM_ALIGNMENT  128
+
+bool opencl_device_supports_svm(const cl_device_id device_id,
+        hawopencl_svm_granularity granularity) {
+#if defined(HAWOPENCL_HAVE_SVM)
+    const cl_ulong svm = opencl_device_caps(device_id)->svm_capabilities;
+
+    if (HAWOPENCL_SVM_FINE_GRAIN == granularity)
+        return 0 != (svm & CL_DEVICE_SVM_FINE_GRAIN_BUFFER);
+    return 0 != (svm & CL_DEVICE_SVM_COARSE_GRAIN_BUFFER);
+#else
+    (void) device_id; (void) granularity;
+    return false;
+#endif
+}
+
+int opencl_svm_create(const cl_device_id device_id,
+        const cl_context context,
+        cl_mem_flags flags,
+        hawopencl_svm_granularity granularity,
+        size_t size,
+        hawopencl_svm * svm) {
+#if defined(HAWOPENCL_HAVE_SVM)
+    if (!opencl_device_supports_svm(device_id, granularity))
+        return CL_INVALID_OPERATION;
+    if (HAWOPENCL_SVM_FINE_GRAIN == granularity)
+        flags |= CL_MEM_SVM_FINE_GRAIN_BUFFER;
+
+    memset(svm, 0, sizeof(hawopencl_svm));
+    // An alignment of 0 selects the largest OpenCL data type, like opencl_svm_alloc()
+    svm->ptr = clSVMAlloc(context, flags, size, 0);
+    if (NULL == svm->ptr)
+        return CL_MEM_OBJECT_ALLOCATION_FAILURE;
+    OPENCL_CHECK(clRetainContext, (context));
+    svm->context = context;
+    svm->size = size;
+    svm->granularity = granularity;
+    return CL_SUCCESS;
+#else
+    (void) device_id; (void) context; (void) flags; (void) granularity; (void) size; (void) svm;
+    return CL_INVALID_OPERATION;
+#endif
+}
+
+void * opencl_svm_alloc(hawopencl_svm * svm,
+        size_t size,
+        size_t alignment) {
+    uintptr_t start;
+
+    if (0 == alignment)
+        alignment = SVM_ALIGNMENT;
+    start = ((uintptr_t) svm->ptr + svm->used + alignment - 1) & ~((uintptr_t) alignment - 1);
+    if (start + size > (uintptr_t) svm->ptr + svm->size)
+        return NULL;
+    svm->used = start + size - (uintptr_t) svm->ptr;
+    return (void *) start;
+}
+
+int opencl_svm_map(const cl_command_queue command_queue,
+        hawopencl_svm * svm,
+        cl_map_flags flags) {
+#if defined(HAWOPENCL_HAVE_SVM)
+    if (HAWOPENCL_SVM_FINE_GRAIN == svm->granularity)
+        return CL_SUCCESS;
+    return clEnqueueSVMMap(command_queue, CL_TRUE, flags, svm->ptr, svm->size, 0, NULL, NULL);
+#else
+    (void) command_queue; (void) svm; (void) flags;
+    return CL_INVALID_OPERATION;
+#endif
+}
+
+int opencl_svm_unmap(const cl_command_queue command_queue,
+        hawopencl_svm * svm) {
+#if defined(HAWOPENCL_HAVE_SVM)
+    if (HAWOPENCL_SVM_FINE_GRAIN == svm->granularity)
+        return CL_SUCCESS;
+    return clEnqueueSVMUnmap(command_queue, svm->ptr, 0, NULL, NULL);
+#else
+    (void) command_queue; (void) svm;
+    return CL_INVALID_OPERATION;
+#endif
+}
+
+int opencl_svm_set_kernel_arg(cl_kernel kernel,
+        cl_uint index,
+        const hawopencl_svm * svm,
+        const void * ptr) {
+#if defined(HAWOPENCL_HAVE_SVM)
+    if ((const char *) ptr < (const char *) svm->ptr ||
+        (const char *) ptr >= (const char *) svm->ptr + svm->size)
+        return CL_INVALID_ARG_VALUE;
+    return clSetKernelArgSVMPointer(kernel, index, ptr);
+#else
+    (void) kernel; (void) index; (void) svm; (void) ptr;
+    return CL_INVALID_OPERATION;
+#endif
+}
+
+int opencl_svm_set_kernel_regions(cl_kernel kernel,
+        cl_uint num_regions,
+        const hawopencl_svm * const * regions) {
+#if defined(HAWOPENCL_HAVE_SVM)
+    void ** ptrs;
+    cl_uint i;
+    int err;
+
+    if (0 == num_regions)
+        return CL_INVALID_VALUE;
+    ptrs = malloc(num_regions * sizeof(void *));
+    if (NULL == ptrs)
+        FATAL_ERROR("malloc", ENOMEM);
+    for (i = 0; i < num_regions; i++)
+        ptrs[i] = regions[i]->ptr;
+    // The pointers stored in the regions are followed by the kernel, without being its arguments;
+    // the list replaces the previous one, hence it has to contain all regions at once
+    err = clSetKernelExecInfo(kernel, CL_KERNEL_EXEC_INFO_SVM_PTRS, num_regions * sizeof(void *), ptrs);
+    free(ptrs);
+    return err;
+#else
+    (void) kernel; (void) num_regions; (void) regions;
+    return CL_INVALID_OPERATION;
+#endif
+}
+
+int opencl_svm_release(hawopencl_svm * svm) {
+#if defined(HAWOPENCL_HAVE_SVM)
+    clSVMFree(svm->context, svm->ptr);
+    OPENCL_CHECK(clReleaseContext, (svm->context));
+    memset(svm, 0, sizeof(hawopencl_svm));
+    return CL_SUCCESS;
+#else
+    (void) svm;
+    return CL_INVALID_OPERATION;
+#endif
+}
@@ -0,0 +1,156 @@
+/*
+ * Round trip of the kernel archive: two programs are compiled into an
+ * archive, which is opened again and its programs built from the binaries
+ * and run. Then truncated and corrupt copies of an archive have to be
+ * rejected by opencl_archive_open(), instead of being read beyond its end.
+ */
+#include "HAWOpenCL.h"
+
+#if defined(__APPLE__) && defined(__MACH__)
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define USE_DEVICE_TYPE CL_DEVICE_TYPE_CPU
+#define ARCHIVE         "opencl_archive_test.clar"
+#define LEN             1024
+// The size of the archive's header and of one entry of its table of programs
+#define TABLES_SIZE     (32 + 32)
+
+static const char * names[] = { "scale.cl", "shift.cl" };
+static const char * sources[] = {
+    "__kernel void scale(__global float * a)\n"
+    "{\n"
+    "    a[get_global_id(0)] *= 2.0f;\n"
+    "}\n",
+    "__kernel void shift(__global float * a)\n"
+    "{\n"
+    "    a[get_global_id(0)] += SHIFT;\n"
+    "}\n"
+};
+static const char * options[] = { NULL, "-DSHIFT=3.0f" };
+
+static double get_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Write a copy of the archive, truncated to size bytes; from offset on the bytes are overwritten
+static void corrupt(const char * file_name, size_t size, size_t offset) {
+    unsigned char * data;
+    FILE * file;
+    long len;
+
+    file = fopen(ARCHIVE, "rb");
+    if (NULL == file || 0 != fseek(file, 0, SEEK_END) || 0 > (len = ftell(file)))
+        FATAL_ERROR("fopen", errno);
+    rewind(file);
+    data = malloc(len);
+    if (NULL == data)
+        FATAL_ERROR("malloc", ENOMEM);
+    if (1 != fread(data, len, 1, file))
+        FATAL_ERROR("fread", errno);
+    fclose(file);
+    if (size > (size_t) len)
+        size = len;
+    if (offset < size)
+        memset(data + offset, 'x', size - offset);
+
+    file = fopen(file_name, "wb");
+    if (NULL == file || 1 != fwrite(data, size, 1, file) || 0 != fclose(file))
+        FATAL_ERROR("fwrite", errno);
+    free(data);
+}
+
+// Run the kernel of the archived program on a and check the result
+static double run(const hawopencl_archive * archive, const char * name, const char * kernel_name,
+        cl_device_id device_id, cl_context context, cl_command_queue queue, float expected) {
+    const size_t global = LEN;
+    hawopencl_program * program;
+    float a[LEN];
+    cl_kernel kernel;
+    cl_mem mem;
+    double start;
+    cl_int err;
+    int i;
+
+    start = get_time();
+    OPENCL_CHECK(opencl_archive_program, (archive, name, device_id, context, &program));
+    start = get_time() - start;
+    kernel = opencl_program_kernel(program, kernel_name);
+    if (NULL == kernel)
+        FATAL_ERROR("opencl_program_kernel", EINVAL);
+
+    for (i = 0; i < LEN; i++)
+        a[i] = 1.0f;
+    mem = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, sizeof(a), a, &err);
+    if (NULL == mem || CL_SUCCESS != err)
+        FATAL_ERROR("clCreateBuffer", err);
+    OPENCL_CHECK(clSetKernelArg, (kernel, 0, sizeof(cl_mem), &mem));
+    OPENCL_CHECK(clEnqueueNDRangeKernel, (queue, kernel, 1, NULL, &global, NULL, 0, NULL, NULL));
+    OPENCL_CHECK(clEnqueueReadBuffer, (queue, mem, CL_TRUE, 0, sizeof(a), a, 0, NULL, NULL));
+    for (i = 0; i < LEN; i++)
+        if (a[i] != expected) {
+            printf("%s: a[%d]:%f expected:%f\n", name, i, a[i], expected);
+            FATAL_ERROR("Wrong result", EINVAL);
+        }
+    OPENCL_CHECK(clReleaseMemObject, (mem));
+    opencl_program_release(program);
+    return 1000.0 * start;
+}
+
+int main(int argc __HAW_OPENCL_ATTR_UNUSED__, char * argv[] __HAW_OPENCL_ATTR_UNUSED__) {
+    hawopencl_archive * archive;
+    hawopencl_program * program;
+    cl_device_id device_id;
+    cl_context context;
+    cl_command_queue queue;
+    double scale;
+    double shift;
+    const char * name;
+    cl_uint i;
+
+    opencl_init(USE_DEVICE_TYPE, 0, &device_id, &context, &queue);
+    printf("Using OpenCL device:%s\n", opencl_device_caps(device_id)->name);
+
+    OPENCL_CHECK(opencl_archive_write, (ARCHIVE, 2, names, sources, options, 1, &device_id));
+    OPENCL_CHECK(opencl_archive_open, (ARCHIVE, &archive));
+    for (i = 0; NULL != (name = opencl_archive_program_name(archive, i)); i++)
+        if (i >= 2 || 0 != strcmp(name, names[i]))
+            FATAL_ERROR("opencl_archive_program_name", EINVAL);
+    if (2 != i)
+        FATAL_ERROR("opencl_archive_program_name", EINVAL);
+    scale = run(archive, "scale.cl", "scale", device_id, context, queue, 2.0f);
+    shift = run(archive, "shift.cl", "shift", device_id, context, queue, 4.0f);
+    if (CL_INVALID_PROGRAM != opencl_archive_program(archive, "missing.cl", device_id, context, &program))
+        FATAL_ERROR("opencl_archive_program", EINVAL);
+    opencl_archive_close(archive);
+
+    // An archive without binaries, whose strings follow the tables
+    OPENCL_CHECK(opencl_archive_write, (ARCHIVE, 1, names, sources, options, 0, &device_id));
+    OPENCL_CHECK(opencl_archive_open, (ARCHIVE, &archive));
+    opencl_archive_close(archive);
+    corrupt(ARCHIVE ".truncated", TABLES_SIZE + 4, (size_t) -1);
+    if (CL_INVALID_BINARY != opencl_archive_open(ARCHIVE ".truncated", &archive))
+        FATAL_ERROR("opencl_archive_open of a truncated archive", EINVAL);
+    // The strings are not NUL-terminated anymore
+    corrupt(ARCHIVE ".corrupt", (size_t) -1, TABLES_SIZE);
+    if (CL_INVALID_BINARY != opencl_archive_open(ARCHIVE ".corrupt", &archive))
+        FATAL_ERROR("opencl_archive_open of a corrupt archive", EINVAL);
+    unlink(ARCHIVE ".corrupt");
+    unlink(ARCHIVE ".truncated");
+    unlink(ARCHIVE);
+
+    printf("Building from the archive: %8.3f ms (scale.cl), %8.3f ms (shift.cl)\n", scale, shift);
+    printf("Test archive finished successfully.\n");
+
+    OPENCL_CHECK(clReleaseCommandQueue, (queue));
+    OPENCL_CHECK(clReleaseContext, (context));
+    return 0;
+}
@@ -0,0 +1,151 @@
+/*
+ * Benchmark of the sub-buffer arena: FRAMES frames of ITEMS small objects
+ * of varying size are each written, scaled by a kernel and read back.
+ * Without the arena every object is a buffer of its own, created, written,
+ * read and released per frame; with the arena the objects are sub-buffers
+ * uploaded and downloaded by one transfer and freed by one reset per frame.
+ */
+#include "HAWOpenCL.h"
+
+#if defined(__APPLE__) && defined(__MACH__)
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define USE_DEVICE_TYPE CL_DEVICE_TYPE_CPU
+#define ITEMS           2000
+#define FRAMES          10
+#define MAX_LEN         256
+
+static const char * kernel_source =
+    "__kernel void scale(__global float * a)\n"
+    "{\n"
+    "    const size_t i = get_global_id(0);\n"
+    "    a[i] = 2.0f * a[i];\n"
+    "}\n";
+
+static double get_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// The number of floats of item i, varying between 1 and MAX_LEN
+static size_t item_len(int i, int f) {
+    return (size_t) ((i * 37 + f * 11) % MAX_LEN) + 1;
+}
+
+static void produce(float * a, size_t len, int i) {
+    size_t k;
+    for (k = 0; k < len; k++)
+        a[k] = (float) (i + k);
+}
+
+static void consume(const float * a, size_t len, int i) {
+    size_t k;
+    for (k = 0; k < len; k++)
+        if (a[k] != 2.0f * (float) (i + k)) {
+            printf("item:%d a[%zu]:%f expected:%f\n", i, k, a[k], 2.0f * (float) (i + k));
+            FATAL_ERROR("Wrong result", EINVAL);
+        }
+}
+
+int main(int argc __HAW_OPENCL_ATTR_UNUSED__, char * argv[] __HAW_OPENCL_ATTR_UNUSED__) {
+    static cl_mem mems[ITEMS];
+    static float * hosts[ITEMS];
+    hawopencl_arena arena;
+    cl_device_id device_id;
+    cl_context context;
+    cl_command_queue queue;
+    cl_kernel kernel;
+    size_t requested = 0;
+    size_t used = 0;
+    double separate;
+    double arenas;
+    double start;
+    float * a;
+    cl_int err;
+    int f;
+    int i;
+
+    opencl_init(USE_DEVICE_TYPE, 0, &device_id, &context, &queue);
+    printf("Using OpenCL device:%s with CL_DEVICE_MEM_BASE_ADDR_ALIGN:%u bits\n",
+            opencl_device_caps(device_id)->name, opencl_device_caps(device_id)->mem_base_addr_align);
+    opencl_kernel_build(kernel_source, "scale", device_id, context, &kernel);
+
+    // One buffer per item and frame
+    a = malloc(MAX_LEN * sizeof(float));
+    if (NULL == a)
+        FATAL_ERROR("malloc", ENOMEM);
+    start = get_time();
+    for (f = 0; f < FRAMES; f++)
+        for (i = 0; i < ITEMS; i++) {
+            const size_t len = item_len(i, f);
+            cl_mem mem;
+
+            produce(a, len, i);
+            mem = clCreateBuffer(context, CL_MEM_READ_WRITE, len * sizeof(float), NULL, &err);
+            if (NULL == mem || CL_SUCCESS != err)
+                FATAL_ERROR("clCreateBuffer", err);
+            OPENCL_CHECK(clEnqueueWriteBuffer, (queue, mem, CL_FALSE, 0, len * sizeof(float), a, 0, NULL, NULL));
+            OPENCL_CHECK(clSetKernelArg, (kernel, 0, sizeof(cl_mem), &mem));
+            OPENCL_CHECK(clEnqueueNDRangeKernel, (queue, kernel, 1, NULL, &len, NULL, 0, NULL, NULL));
+            OPENCL_CHECK(clEnqueueReadBuffer, (queue, mem, CL_TRUE, 0, len * sizeof(float), a, 0, NULL, NULL));
+            consume(a, len, i);
+            OPENCL_CHECK(clReleaseMemObject, (mem));
+        }
+    separate = 1000.0 * (get_time() - start) / FRAMES;
+    free(a);
+
+    // Sub-buffers of one arena, allocated and reset per frame
+    err = opencl_arena_create(device_id, context, CL_MEM_READ_WRITE,
+            ITEMS * (MAX_LEN * sizeof(float) + opencl_device_caps(device_id)->mem_base_addr_align / 8),
+            &arena);
+    if (CL_INVALID_OPERATION == err) {
+        printf("Test arena skipped, sub-buffers require OpenCL 1.1.\n");
+        return 0;
+    }
+    if (CL_SUCCESS != err)
+        FATAL_ERROR("opencl_arena_create", err);
+    start = get_time();
+    for (f = 0; f < FRAMES; f++) {
+        for (i = 0; i < ITEMS; i++) {
+            const size_t len = item_len(i, f);
+
+            OPENCL_CHECK(opencl_arena_alloc, (&arena, len * sizeof(float), &mems[i], (void **) &hosts[i]));
+            produce(hosts[i], len, i);
+        }
+        OPENCL_CHECK(opencl_arena_upload, (queue, &arena, CL_FALSE, NULL));
+        for (i = 0; i < ITEMS; i++) {
+            const size_t len = item_len(i, f);
+
+            OPENCL_CHECK(clSetKernelArg, (kernel, 0, sizeof(cl_mem), &mems[i]));
+            OPENCL_CHECK(clEnqueueNDRangeKernel, (queue, kernel, 1, NULL, &len, NULL, 0, NULL, NULL));
+        }
+        OPENCL_CHECK(opencl_arena_download, (queue, &arena, CL_TRUE, NULL));
+        for (i = 0; i < ITEMS; i++) {
+            const size_t len = item_len(i, f);
+
+            consume(hosts[i], len, i);
+            requested += len * sizeof(float);
+        }
+        used += arena.used;
+        OPENCL_CHECK(opencl_arena_reset, (&arena));
+    }
+    arenas = 1000.0 * (get_time() - start) / FRAMES;
+
+    printf("Buffer per item:     %8.3f ms per frame of %d items\n", separate, ITEMS);
+    printf("Arena:               %8.3f ms per frame, aligned to %zu bytes, %.1f%% padding\n", arenas,
+            arena.alignment, 100.0 * (used - requested) / used);
+    printf("Test arena finished successfully.\n");
+
+    opencl_arena_release(&arena);
+    OPENCL_CHECK(clReleaseKernel, (kernel));
+    OPENCL_CHECK(clReleaseCommandQueue, (queue));
+    OPENCL_CHECK(clReleaseContext, (context));
+    return 0;
+}
@@ -0,0 +1,145 @@
+/*
+ * Benchmark of the buffer pool: a loop of requests, each allocating a few
+ * buffers of varying size, writing the input, running a kernel and reading
+ * the result, is timed with clCreateBuffer()/clReleaseMemObject() for every
+ * request and with buffers from a pool, without and with a budget.
+ * On CPU devices such as pocl creating a buffer is a large part of a
+ * small request.
+ */
+#include "HAWOpenCL.h"
+
+#if defined(__APPLE__) && defined(__MACH__)
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define USE_DEVICE_TYPE (CL_DEVICE_TYPE_CPU | CL_DEVICE_TYPE_GPU)
+#define REQUESTS        5000
+#define BUFFERS         3               // Buffers per request
+#define MAX_LEN         (64 * 1024)     // Maximum number of ints per buffer
+#define BUDGET          (1024 * 1024)
+
+static const char * kernel_source =
+    "__kernel void scale(__global int * a, const int factor)\n"
+    "{\n"
+    "    const size_t i = get_global_id(0);\n"
+    "    a[i] *= factor;\n"
+    "}\n";
+
+static double get_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Run the requests, with buffers of the pool or, without pool, created for each request
+static double run(hawopencl_buffer_pool * pool, cl_context context,
+        cl_command_queue command_queue, cl_kernel kernel) {
+    static int a[MAX_LEN];
+    const int factor = 3;
+    double start;
+    cl_int err;
+    int r;
+    int b;
+    int i;
+
+    srand(4711);
+    start = get_time();
+    for (r = 0; r < REQUESTS; r++) {
+        cl_mem mems[BUFFERS];
+        size_t lens[BUFFERS];
+
+        for (b = 0; b < BUFFERS; b++) {
+            lens[b] = 1 + rand() % MAX_LEN;
+            if (NULL == pool) {
+                mems[b] = clCreateBuffer(context, CL_MEM_READ_WRITE, lens[b] * sizeof(int), NULL, &err);
+                if (NULL == mems[b] || CL_SUCCESS != err)
+                    FATAL_ERROR("clCreateBuffer", err);
+            } else
+                OPENCL_CHECK(opencl_buffer_pool_alloc, (pool, lens[b] * sizeof(int), &mems[b]));
+            for (i = 0; i < (int) lens[b]; i++)
+                a[i] = r + i;
+            OPENCL_CHECK(clEnqueueWriteBuffer, (command_queue, mems[b], CL_FALSE, 0, lens[b] * sizeof(int), a, 0, NULL, NULL));
+            OPENCL_CHECK(clSetKernelArg, (kernel, 0, sizeof(cl_mem), &mems[b]));
+            OPENCL_CHECK(clSetKernelArg, (kernel, 1, sizeof(int), &factor));
+            OPENCL_CHECK(clEnqueueNDRangeKernel, (command_queue, kernel, 1, NULL, &lens[b], NULL, 0, NULL, NULL));
+            // The blocking read also keeps a from being overwritten before it was written
+            OPENCL_CHECK(clEnqueueReadBuffer, (command_queue, mems[b], CL_TRUE, 0, lens[b] * sizeof(int), a, 0, NULL, NULL));
+            if (a[lens[b] - 1] != factor * (r + (int) lens[b] - 1))
+                FATAL_ERROR("Wrong result", EINVAL);
+        }
+        for (b = 0; b < BUFFERS; b++)
+            if (NULL == pool)
+                OPENCL_CHECK(clReleaseMemObject, (mems[b]));
+            else
+                OPENCL_CHECK(opencl_buffer_pool_free, (pool, mems[b]));
+    }
+    return 1e6 * (get_time() - start) / REQUESTS;
+}
+
+static void print(const char * what, double us, hawopencl_buffer_pool * pool) {
+    hawopencl_buffer_pool_stats stats;
+
+    if (NULL == pool) {
+        printf("%-24s %8.2f us/request\n", what, us);
+        return;
+    }
+    opencl_buffer_pool_stats(pool, &stats);
+    printf("%-24s %8.2f us/request hit rate:%6.2f%% trims:%lu bytes held:%llu\n", what, us,
+            100.0 * stats.hits / (stats.hits + stats.misses), stats.trims,
+            stats.bytes_in_use + stats.bytes_free);
+}
+
+int main(int argc __HAW_OPENCL_ATTR_UNUSED__, char * argv[] __HAW_OPENCL_ATTR_UNUSED__) {
+    hawopencl_buffer_pool_config config;
+    hawopencl_buffer_pool_stats stats;
+    hawopencl_buffer_pool * pool;
+    cl_device_id device_id;
+    cl_context context;
+    cl_command_queue command_queue;
+    cl_kernel kernel;
+    cl_mem mem;
+    double us;
+
+    opencl_init(USE_DEVICE_TYPE, 0, &device_id, &context, &command_queue);
+    printf("Using OpenCL device:%s\n", opencl_device_caps(device_id)->name);
+    opencl_kernel_build(kernel_source, "scale", device_id, context, &kernel);
+
+    us = run(NULL, context, command_queue, kernel);
+    print("clCreateBuffer", us, NULL);
+
+    opencl_buffer_pool_create(context, NULL, &pool);
+    us = run(pool, context, command_queue, kernel);
+    print("pool, powers of two", us, pool);
+    // A buffer not allocated from the pool is rejected
+    mem = clCreateBuffer(context, CL_MEM_READ_WRITE, 1000, NULL, NULL);
+    if (CL_INVALID_MEM_OBJECT != opencl_buffer_pool_free(pool, mem))
+        FATAL_ERROR("opencl_buffer_pool_free", EINVAL);
+    OPENCL_CHECK(clReleaseMemObject, (mem));
+    opencl_buffer_pool_trim(pool, 0);
+    opencl_buffer_pool_stats(pool, &stats);
+    if (0 != stats.bytes_free || 0 != stats.bytes_in_use)
+        FATAL_ERROR("opencl_buffer_pool_trim", EINVAL);
+    opencl_buffer_pool_release(pool);
+
+    opencl_buffer_pool_config_init(&config);
+    config.classes_per_doubling = 4;
+    config.budget = BUDGET;
+    opencl_buffer_pool_create(context, &config, &pool);
+    us = run(pool, context, command_queue, kernel);
+    print("pool, 4 classes, budget", us, pool);
+    opencl_buffer_pool_stats(pool, &stats);
+    if (stats.bytes_free > BUDGET)
+        FATAL_ERROR("Budget exceeded", EINVAL);
+    opencl_buffer_pool_release(pool);
+
+    printf("Test buffer_pool finished successfully.\n");
+    OPENCL_CHECK(clReleaseKernel, (kernel));
+    OPENCL_CHECK(clReleaseCommandQueue, (command_queue));
+    OPENCL_CHECK(clReleaseContext, (context));
+    return 0;
+}
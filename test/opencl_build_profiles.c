@@ -0,0 +1,145 @@
+/*
+ * Benchmark of the build profiles: builds a memory-bound (vector_add) and a
+ * compute-bound kernel with every profile and measures build and run time.
+ * The env.-var. OPENCL_BUILD_PROFILE would override the profile, so unset it.
+ */
+#include "HAWOpenCL.h"
+
+#if defined(__APPLE__) && defined(__MACH__)
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+#include <stdlib.h>
+#include <time.h>
+
+#define LEN (1024*1024)
+#define ITERATIONS 256
+#define REPEAT 10
+#define USE_DEVICE_TYPE (CL_DEVICE_TYPE_GPU | CL_DEVICE_TYPE_CPU)
+#define USE_DEVICE_NUM  0
+
+const char KERNEL_SOURCE[] = "\n" \
+    "__kernel void vector_add(__global float * a, \n"
+    "                         __global const float * b, \n"
+    "                         const unsigned int len)\n"
+    "{\n"
+    "    const size_t i = get_global_id(0);\n"
+    "    if (i < len) {\n"
+    "        a[i] += b[i];\n"
+    "    }\n"
+    "}\n"
+    "__kernel void compute(__global float * a, \n"
+    "                      __global const float * b, \n"
+    "                      const unsigned int len)\n"
+    "{\n"
+    "    const size_t i = get_global_id(0);\n"
+    "    if (i < len) {\n"
+    "        float x = a[i];\n"
+    "        const float y = b[i];\n"
+    "        for (int k = 0; k < ITERATIONS; k++)\n"
+    "            x = x * 0.999f + sin(x) / (1.0f + y * x * x);\n"
+    "        a[i] = x;\n"
+    "    }\n"
+    "}\n";
+
+static const hawopencl_build_profile profiles[] = {
+    HAWOPENCL_BUILD_PROFILE_DEBUG,
+    HAWOPENCL_BUILD_PROFILE_RELEASE,
+    HAWOPENCL_BUILD_PROFILE_FAST_MATH,
+    HAWOPENCL_BUILD_PROFILE_STRICT
+};
+#define NUM_PROFILES (sizeof(profiles) / sizeof(profiles[0]))
+
+static double get_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double run_kernel(cl_command_queue command_queue, cl_kernel kernel,
+        cl_mem cl_a, cl_mem cl_b, unsigned int count) {
+    size_t global = count;
+    double start;
+    int i;
+
+    OPENCL_CHECK(clSetKernelArg, (kernel, 0, sizeof(cl_mem), &cl_a));
+    OPENCL_CHECK(clSetKernelArg, (kernel, 1, sizeof(cl_mem), &cl_b));
+    OPENCL_CHECK(clSetKernelArg, (kernel, 2, sizeof(unsigned int), &count));
+    // Warm-up
+    OPENCL_CHECK(clEnqueueNDRangeKernel, (command_queue, kernel, 1, NULL, &global, NULL, 0, NULL, NULL));
+    OPENCL_CHECK(clFinish, (command_queue));
+
+    start = get_time();
+    for (i = 0; i < REPEAT; i++)
+        OPENCL_CHECK(clEnqueueNDRangeKernel, (command_queue, kernel, 1, NULL, &global, NULL, 0, NULL, NULL));
+    OPENCL_CHECK(clFinish, (command_queue));
+    return 1000.0 * (get_time() - start) / REPEAT;
+}
+
+int main(int argc __HAW_OPENCL_ATTR_UNUSED__, char * argv[] __HAW_OPENCL_ATTR_UNUSED__) {
+    cl_device_id device_id;
+    cl_context context;
+    cl_command_queue command_queue;
+    cl_mem cl_a;
+    cl_mem cl_b;
+    unsigned int count = LEN;
+    unsigned int i;
+    float * a;
+    cl_uint haw_devices_num;
+    hawopencl_device * haw_devices;
+    char iterations[16];
+
+    // Measure the compile time without the binary cache, with the profiles selected here
+    opencl_kernel_cache_config(NULL, 0);
+    unsetenv("OPENCL_BUILD_PROFILE");
+
+    opencl_get_devices(USE_DEVICE_TYPE, &haw_devices_num, &haw_devices);
+    if (0 == haw_devices_num)
+        FATAL_ERROR("No devices of device type available; please change USE_DEVICE_TYPE", EINVAL);
+    opencl_init(USE_DEVICE_TYPE, haw_devices[USE_DEVICE_NUM].device_id, &device_id, &context, &command_queue);
+    printf("Using OpenCL device:%s\n", haw_devices[USE_DEVICE_NUM].device_name);
+
+    a = (float*) malloc(sizeof(float) * count);
+    if (!a)
+        FATAL_ERROR("Failed to allocate host memory", ENOMEM);
+    for (i = 0; i < count; i++)
+        a[i] = 1.0f / (i + 1);
+    cl_a = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, sizeof(float) * count, a, NULL);
+    cl_b = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(float) * count, a, NULL);
+    if (!cl_a || !cl_b)
+        FATAL_ERROR("Failed to allocate device memory", ENOMEM);
+
+    snprintf(iterations, sizeof(iterations), "%d", ITERATIONS);
+    printf("%-10s %12s %16s %16s\n", "profile", "build [ms]", "vector_add [ms]", "compute [ms]");
+    for (i = 0; i < NUM_PROFILES; i++) {
+        hawopencl_build_options options;
+        hawopencl_program * program;
+        double start;
+        double build_time;
+
+        opencl_build_options_init(&options, profiles[i]);
+        opencl_build_options_define(&options, "ITERATIONS", iterations);
+
+        start = get_time();
+        opencl_program_build_with_options(KERNEL_SOURCE, &options, device_id, context, &program);
+        build_time = 1000.0 * (get_time() - start);
+
+        printf("%-10s %12.3f %16.3f %16.3f    (%s)\n",
+                opencl_build_profile_name(profiles[i]), build_time,
+                run_kernel(command_queue, opencl_program_kernel(program, "vector_add"), cl_a, cl_b, count),
+                run_kernel(command_queue, opencl_program_kernel(program, "compute"), cl_a, cl_b, count),
+                opencl_build_options_string(&options));
+
+        opencl_program_release(program);
+        opencl_build_options_free(&options);
+    }
+
+    OPENCL_CHECK(clReleaseMemObject, (cl_a));
+    OPENCL_CHECK(clReleaseMemObject, (cl_b));
+    OPENCL_CHECK(clReleaseCommandQueue, (command_queue));
+    OPENCL_CHECK(clReleaseContext, (context));
+    free(a);
+    opencl_free_devices(haw_devices_num, haw_devices);
+    return 0;
+}
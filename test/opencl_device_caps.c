@@ -0,0 +1,116 @@
+/*
+ * Startup benchmark of the device capability snapshot: child processes
+ * enumerate the devices with opencl_get_devices(), which queries the
+ * capabilities of every device once.
+ * The time is reported without cache, with an empty cache directory (cold)
+ * and with the file written by the previous run (warm); the capabilities
+ * read from the file must equal those queried from the driver.
+ */
+#include "HAWOpenCL.h"
+
+#if defined(__APPLE__) && defined(__MACH__)
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#define USE_DEVICE_TYPE CL_DEVICE_TYPE_ALL
+#define USE_DEVICE_NUM  0
+
+typedef struct {
+    double ms;                      // Time of opencl_get_devices()
+    cl_uint num_devices;
+    char name[256];                 // The capabilities of USE_DEVICE_NUM to compare
+    char driver_version[128];
+    cl_ulong extension_bits;
+    cl_ulong global_mem_size;
+    cl_uint preferred_vector_width_float;
+    double score;
+} result_t;
+
+static double get_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Run the enumeration in a fresh process, so that nothing is cached in memory
+static void run(const char * cache_dir, result_t * result) {
+    int fds[2];
+    pid_t pid;
+    int status;
+
+    if (0 != pipe(fds))
+        FATAL_ERROR("pipe", errno);
+    pid = fork();
+    if (-1 == pid)
+        FATAL_ERROR("fork", errno);
+    if (0 == pid) {
+        hawopencl_device * devices;
+        const hawopencl_device_caps * caps;
+        result_t r;
+        double start;
+
+        memset(&r, 0, sizeof(r));
+        setenv("OPENCL_KERNEL_CACHE_DIR", cache_dir, 1);
+        start = get_time();
+        opencl_get_devices(USE_DEVICE_TYPE, &r.num_devices, &devices);
+        r.ms = 1000.0 * (get_time() - start);
+        caps = devices[USE_DEVICE_NUM].caps;
+        strcpy(r.name, caps->name);
+        strcpy(r.driver_version, caps->driver_version);
+        r.extension_bits = caps->extension_bits;
+        r.global_mem_size = caps->global_mem_size;
+        r.preferred_vector_width_float = caps->preferred_vector_width[HAWOPENCL_VECTOR_FLOAT];
+        r.score = caps->score;
+        if (sizeof(r) != write(fds[1], &r, sizeof(r)))
+            FATAL_ERROR("write", errno);
+        opencl_free_devices(r.num_devices, devices);
+        _exit(0);
+    }
+    close(fds[1]);
+    if (sizeof(*result) != read(fds[0], result, sizeof(*result)))
+        FATAL_ERROR("read", EIO);
+    close(fds[0]);
+    if (-1 == waitpid(pid, &status, 0) || !WIFEXITED(status) || 0 != WEXITSTATUS(status))
+        FATAL_ERROR("waitpid", ECHILD);
+}
+
+int main(int argc __HAW_OPENCL_ATTR_UNUSED__, char * argv[] __HAW_OPENCL_ATTR_UNUSED__) {
+    char dir[] = "/tmp/hawopencl_device_caps.XXXXXX";
+    char path[256];
+    result_t uncached;
+    result_t cold;
+    result_t warm;
+
+    if (NULL == mkdtemp(dir))
+        FATAL_ERROR("mkdtemp", errno);
+
+    run("", &uncached);
+    run(dir, &cold);
+    run(dir, &warm);
+    printf("Enumerated %u devices, using OpenCL device:%s\n", warm.num_devices, warm.name);
+    printf("opencl_get_devices without cache: %8.3f ms\n", uncached.ms);
+    printf("opencl_get_devices cold cache:    %8.3f ms\n", cold.ms);
+    printf("opencl_get_devices warm cache:    %8.3f ms\n", warm.ms);
+
+    if (0 != strcmp(cold.name, warm.name) ||
+        0 != strcmp(cold.driver_version, warm.driver_version) ||
+        cold.extension_bits != warm.extension_bits ||
+        cold.global_mem_size != warm.global_mem_size ||
+        cold.preferred_vector_width_float != warm.preferred_vector_width_float ||
+        cold.score != warm.score ||
+        uncached.score != warm.score)
+        FATAL_ERROR("Capabilities read from the cache differ", EINVAL);
+    printf("Test device_caps finished successfully.\n");
+
+    snprintf(path, sizeof(path), "%s/devices.clcaps", dir);
+    unlink(path);
+    rmdir(dir);
+    return 0;
+}
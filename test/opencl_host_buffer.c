@@ -0,0 +1,140 @@
+/*
+ * Benchmark of zero-copy host buffers: a streaming triad a = b + s * c is
+ * run REPETITIONS times, each time with new input b and c produced on the
+ * host and the result a consumed on the host. With copies the input is
+ * written to device buffers and the result read back; with host buffers
+ * the host maps them, which on CPU devices such as pocl copies nothing.
+ */
+#include "HAWOpenCL.h"
+
+#if defined(__APPLE__) && defined(__MACH__)
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define USE_DEVICE_TYPE CL_DEVICE_TYPE_CPU
+#define LEN             (8 * 1024 * 1024)
+#define REPETITIONS     20
+
+static const char * kernel_source =
+    "__kernel void triad(__global float * a, __global const float * b,\n"
+    "                    __global const float * c, const float s)\n"
+    "{\n"
+    "    const size_t i = get_global_id(0);\n"
+    "    a[i] = b[i] + s * c[i];\n"
+    "}\n";
+
+static double get_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void produce(float * b, float * c, int r) {
+    size_t i;
+    for (i = 0; i < LEN; i++) {
+        b[i] = (float) r;
+        c[i] = 2.0f;
+    }
+}
+
+static void consume(const float * a, int r) {
+    size_t i;
+    for (i = 0; i < LEN; i++)
+        if (a[i] != (float) r + 6.0f) {
+            printf("a[%zu]:%f expected:%f\n", i, a[i], (float) r + 6.0f);
+            FATAL_ERROR("Wrong result", EINVAL);
+        }
+}
+
+int main(int argc __HAW_OPENCL_ATTR_UNUSED__, char * argv[] __HAW_OPENCL_ATTR_UNUSED__) {
+    const size_t global = LEN;
+    const float s = 3.0f;
+    hawopencl_host_buffer host[3];
+    cl_device_id device_id;
+    cl_context context;
+    cl_command_queue queue;
+    cl_kernel kernel;
+    cl_mem mems[3];
+    float * a;
+    float * b;
+    float * c;
+    double copy;
+    double zero_copy;
+    double start;
+    cl_int err;
+    int r;
+    int j;
+
+    opencl_init(USE_DEVICE_TYPE, 0, &device_id, &context, &queue);
+    printf("Using OpenCL device:%s with CL_DEVICE_MEM_BASE_ADDR_ALIGN:%u bits\n",
+            opencl_device_caps(device_id)->name, opencl_device_caps(device_id)->mem_base_addr_align);
+    opencl_kernel_build(kernel_source, "triad", device_id, context, &kernel);
+    OPENCL_CHECK(clSetKernelArg, (kernel, 3, sizeof(float), &s));
+
+    // Copy-in and copy-out of malloc()ed memory
+    a = malloc(LEN * sizeof(float));
+    b = malloc(LEN * sizeof(float));
+    c = malloc(LEN * sizeof(float));
+    if (NULL == a || NULL == b || NULL == c)
+        FATAL_ERROR("malloc", ENOMEM);
+    for (j = 0; j < 3; j++) {
+        mems[j] = clCreateBuffer(context, 0 == j ? CL_MEM_WRITE_ONLY : CL_MEM_READ_ONLY,
+                LEN * sizeof(float), NULL, &err);
+        if (NULL == mems[j] || CL_SUCCESS != err)
+            FATAL_ERROR("clCreateBuffer", err);
+        OPENCL_CHECK(clSetKernelArg, (kernel, j, sizeof(cl_mem), &mems[j]));
+    }
+    start = get_time();
+    for (r = 0; r < REPETITIONS; r++) {
+        produce(b, c, r);
+        OPENCL_CHECK(clEnqueueWriteBuffer, (queue, mems[1], CL_FALSE, 0, LEN * sizeof(float), b, 0, NULL, NULL));
+        OPENCL_CHECK(clEnqueueWriteBuffer, (queue, mems[2], CL_FALSE, 0, LEN * sizeof(float), c, 0, NULL, NULL));
+        OPENCL_CHECK(clEnqueueNDRangeKernel, (queue, kernel, 1, NULL, &global, NULL, 0, NULL, NULL));
+        OPENCL_CHECK(clEnqueueReadBuffer, (queue, mems[0], CL_TRUE, 0, LEN * sizeof(float), a, 0, NULL, NULL));
+        consume(a, r);
+    }
+    copy = 1000.0 * (get_time() - start) / REPETITIONS;
+    for (j = 0; j < 3; j++)
+        OPENCL_CHECK(clReleaseMemObject, (mems[j]));
+    free(c);
+    free(b);
+    free(a);
+
+    // The kernel works on the host memory in place
+    for (j = 0; j < 3; j++) {
+        opencl_host_buffer_create(device_id, context, 0 == j ? CL_MEM_WRITE_ONLY : CL_MEM_READ_ONLY,
+                LEN * sizeof(float), &host[j]);
+        OPENCL_CHECK(clSetKernelArg, (kernel, j, sizeof(cl_mem), &host[j].buffer));
+    }
+    start = get_time();
+    for (r = 0; r < REPETITIONS; r++) {
+        b = opencl_host_buffer_map(queue, &host[1], CL_MAP_WRITE);
+        c = opencl_host_buffer_map(queue, &host[2], CL_MAP_WRITE);
+        produce(b, c, r);
+        OPENCL_CHECK(opencl_host_buffer_unmap, (queue, &host[1], b));
+        OPENCL_CHECK(opencl_host_buffer_unmap, (queue, &host[2], c));
+        OPENCL_CHECK(clEnqueueNDRangeKernel, (queue, kernel, 1, NULL, &global, NULL, 0, NULL, NULL));
+        a = opencl_host_buffer_map(queue, &host[0], CL_MAP_READ);
+        consume(a, r);
+        OPENCL_CHECK(opencl_host_buffer_unmap, (queue, &host[0], a));
+    }
+    OPENCL_CHECK(clFinish, (queue));
+    zero_copy = 1000.0 * (get_time() - start) / REPETITIONS;
+
+    printf("Copy-in/copy-out:    %8.3f ms per repetition\n", copy);
+    printf("Host buffers:        %8.3f ms per repetition, aligned to %zu bytes, %s\n", zero_copy,
+            host[0].alignment, host[0].zero_copy && host[1].zero_copy ? "zero-copy" : "mapping copies");
+    printf("Test host_buffer finished successfully.\n");
+
+    for (j = 0; j < 3; j++)
+        opencl_host_buffer_release(&host[j]);
+    OPENCL_CHECK(clReleaseKernel, (kernel));
+    OPENCL_CHECK(clReleaseCommandQueue, (queue));
+    OPENCL_CHECK(clReleaseContext, (context));
+    return 0;
+}
@@ -0,0 +1,125 @@
+/*
+ * Test of opencl_init_multi(): a vector is split into chunks, which are
+ * processed in a round robin over all queues of all devices of the runtime.
+ * The time is compared to processing all chunks on the first queue only.
+ */
+#include "HAWOpenCL.h"
+
+#if defined(__APPLE__) && defined(__MACH__)
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define USE_DEVICE_TYPE   (CL_DEVICE_TYPE_GPU | CL_DEVICE_TYPE_CPU)
+#define QUEUES_PER_DEVICE 2
+#define CHUNKS            64
+#define CHUNK_LEN         (1024 * 1024)
+#define ITERATIONS        64
+
+static const char * kernel_source =
+    "__kernel void iterate(__global float * a, const unsigned int iterations)\n"
+    "{\n"
+    "    const size_t i = get_global_id(0);\n"
+    "    float x = a[i];\n"
+    "    for (unsigned int j = 0; j < iterations; j++)\n"
+    "        x = x * 0.5f + 1.0f;\n"
+    "    a[i] = x;\n"
+    "}\n";
+
+static double get_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Process all chunks on the first num_queues queues of the runtime and check the result
+static double run(const hawopencl_runtime * runtime, cl_kernel * kernels, cl_uint num_queues, float * a) {
+    const cl_uint iterations = ITERATIONS;
+    const size_t global = CHUNK_LEN;
+    cl_mem mems[CHUNKS];
+    double start;
+    float expected = 0.0f;
+    cl_int err;
+    int c;
+    int i;
+
+    for (i = 0; i < ITERATIONS; i++)
+        expected = expected * 0.5f + 1.0f;
+    memset(a, 0, CHUNKS * CHUNK_LEN * sizeof(float));
+
+    start = get_time();
+    for (c = 0; c < CHUNKS; c++) {
+        // Chunks are distributed over the devices first, then over their queues
+        const cl_uint n = c % num_queues;
+        const cl_uint device = n % runtime->num_devices;
+        const cl_command_queue queue = opencl_runtime_queue(runtime, device, n / runtime->num_devices);
+
+        mems[c] = clCreateBuffer(runtime->context, CL_MEM_READ_WRITE, CHUNK_LEN * sizeof(float), NULL, &err);
+        if (NULL == mems[c] || CL_SUCCESS != err)
+            FATAL_ERROR("clCreateBuffer", err);
+        OPENCL_CHECK(clEnqueueWriteBuffer, (queue, mems[c], CL_FALSE, 0, CHUNK_LEN * sizeof(float),
+                    &a[c * CHUNK_LEN], 0, NULL, NULL));
+        OPENCL_CHECK(clSetKernelArg, (kernels[device], 0, sizeof(cl_mem), &mems[c]));
+        OPENCL_CHECK(clSetKernelArg, (kernels[device], 1, sizeof(cl_uint), &iterations));
+        OPENCL_CHECK(clEnqueueNDRangeKernel, (queue, kernels[device], 1, NULL, &global, NULL, 0, NULL, NULL));
+        OPENCL_CHECK(clEnqueueReadBuffer, (queue, mems[c], CL_FALSE, 0, CHUNK_LEN * sizeof(float),
+                    &a[c * CHUNK_LEN], 0, NULL, NULL));
+        OPENCL_CHECK(clFlush, (queue));
+    }
+    for (i = 0; i < (int) (runtime->num_devices * runtime->queues_per_device); i++)
+        OPENCL_CHECK(clFinish, (runtime->command_queues[i]));
+    start = get_time() - start;
+
+    for (c = 0; c < CHUNKS; c++)
+        OPENCL_CHECK(clReleaseMemObject, (mems[c]));
+    for (i = 0; i < CHUNKS * CHUNK_LEN; i++)
+        if (a[i] != expected) {
+            printf("a[%d]:%f expected:%f\n", i, a[i], expected);
+            FATAL_ERROR("Wrong result", EINVAL);
+        }
+    return start;
+}
+
+int main(int argc __HAW_OPENCL_ATTR_UNUSED__, char * argv[] __HAW_OPENCL_ATTR_UNUSED__) {
+    hawopencl_runtime * runtime;
+    cl_kernel * kernels;
+    float * a;
+    double t_single;
+    double t_all;
+    cl_uint d;
+
+    if (CL_INVALID_VALUE != opencl_init_multi(USE_DEVICE_TYPE, 1, NULL, 0, NULL, &runtime))
+        FATAL_ERROR("opencl_init_multi", EINVAL);
+    opencl_init_multi(USE_DEVICE_TYPE, 0, NULL, QUEUES_PER_DEVICE, NULL, &runtime);
+    if (NULL != opencl_runtime_queue(runtime, runtime->num_devices, 0) ||
+        NULL != opencl_runtime_queue(runtime, 0, QUEUES_PER_DEVICE))
+        FATAL_ERROR("opencl_runtime_queue", EINVAL);
+
+    kernels = malloc(runtime->num_devices * sizeof(cl_kernel));
+    a = malloc(CHUNKS * CHUNK_LEN * sizeof(float));
+    if (NULL == kernels || NULL == a)
+        FATAL_ERROR("malloc", ENOMEM);
+    for (d = 0; d < runtime->num_devices; d++) {
+        printf("Using OpenCL device:%s with %d queues\n",
+                opencl_device_caps(runtime->device_ids[d])->name, QUEUES_PER_DEVICE);
+        opencl_kernel_build(kernel_source, "iterate", runtime->device_ids[d], runtime->context, &kernels[d]);
+    }
+
+    t_single = run(runtime, kernels, 1, a);
+    t_all = run(runtime, kernels, runtime->num_devices * QUEUES_PER_DEVICE, a);
+    printf("%d chunks on one queue:   %8.3f ms\n", CHUNKS, 1000.0 * t_single);
+    printf("%d chunks on %u queues: %8.3f ms (speedup %.2f)\n", CHUNKS,
+            runtime->num_devices * QUEUES_PER_DEVICE, 1000.0 * t_all, t_single / t_all);
+    printf("Test init_multi finished successfully.\n");
+
+    for (d = 0; d < runtime->num_devices; d++)
+        OPENCL_CHECK(clReleaseKernel, (kernels[d]));
+    opencl_runtime_release(runtime);
+    free(kernels);
+    free(a);
+    return 0;
+}
@@ -0,0 +1,151 @@
+/*
+ * Benchmark of opencl_init_partitioned(): a memory-bound triad
+ * a[i] = b[i] + s * c[i] runs on the whole CPU device, and split into chunks
+ * on the sub-devices of one NUMA node each, using host memory placed on
+ * the sub-device's node. If the device does not support partitioning
+ * by NUMA node (e.g. on a single socket), it is split equally in two.
+ */
+#include "HAWOpenCL.h"
+
+#if defined(__APPLE__) && defined(__MACH__)
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define USE_DEVICE_TYPE CL_DEVICE_TYPE_CPU
+#define USE_DEVICE_NUM  0
+#define LEN             (32 * 1024 * 1024)
+#define REPETITIONS     10
+
+static const char * kernel_source =
+    "__kernel void triad(__global float * a, __global const float * b,\n"
+    "                    __global const float * c, const float s)\n"
+    "{\n"
+    "    const size_t i = get_global_id(0);\n"
+    "    a[i] = b[i] + s * c[i];\n"
+    "}\n";
+
+static double get_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Run the triad on all devices of the runtime, each on its share of LEN; returns GB/s
+static double run(const hawopencl_runtime * runtime) {
+    const size_t share = LEN / runtime->num_devices;
+    const float s = 3.0f;
+    float ** host = malloc(3 * runtime->num_devices * sizeof(float *));
+    cl_mem * mems = malloc(3 * runtime->num_devices * sizeof(cl_mem));
+    cl_kernel * kernels = malloc(runtime->num_devices * sizeof(cl_kernel));
+    double start;
+    cl_uint d;
+    cl_int err;
+    int r;
+    int j;
+    size_t i;
+
+    if (NULL == host || NULL == mems || NULL == kernels)
+        FATAL_ERROR("malloc", ENOMEM);
+    for (d = 0; d < runtime->num_devices; d++) {
+        opencl_kernel_build(kernel_source, "triad", runtime->device_ids[d], runtime->context, &kernels[d]);
+        for (j = 0; j < 3; j++) {
+            host[3 * d + j] = opencl_runtime_host_alloc(runtime, d, share * sizeof(float));
+            if (NULL == host[3 * d + j])
+                FATAL_ERROR("opencl_runtime_host_alloc", ENOMEM);
+            mems[3 * d + j] = clCreateBuffer(runtime->context, CL_MEM_READ_WRITE | CL_MEM_USE_HOST_PTR,
+                    share * sizeof(float), host[3 * d + j], &err);
+            if (NULL == mems[3 * d + j] || CL_SUCCESS != err)
+                FATAL_ERROR("clCreateBuffer", err);
+        }
+        for (i = 0; i < share; i++) {
+            host[3 * d + 1][i] = 1.0f;
+            host[3 * d + 2][i] = 2.0f;
+        }
+        for (j = 0; j < 3; j++)
+            OPENCL_CHECK(clSetKernelArg, (kernels[d], j, sizeof(cl_mem), &mems[3 * d + j]));
+        OPENCL_CHECK(clSetKernelArg, (kernels[d], 3, sizeof(float), &s));
+        // Warm up
+        OPENCL_CHECK(clEnqueueNDRangeKernel, (runtime->command_queues[d], kernels[d], 1, NULL, &share, NULL, 0, NULL, NULL));
+        OPENCL_CHECK(clFinish, (runtime->command_queues[d]));
+    }
+
+    start = get_time();
+    for (r = 0; r < REPETITIONS; r++) {
+        for (d = 0; d < runtime->num_devices; d++) {
+            OPENCL_CHECK(clEnqueueNDRangeKernel, (runtime->command_queues[d], kernels[d], 1, NULL, &share, NULL, 0, NULL, NULL));
+            OPENCL_CHECK(clFlush, (runtime->command_queues[d]));
+        }
+        for (d = 0; d < runtime->num_devices; d++)
+            OPENCL_CHECK(clFinish, (runtime->command_queues[d]));
+    }
+    start = get_time() - start;
+
+    for (d = 0; d < runtime->num_devices; d++) {
+        float * a = clEnqueueMapBuffer(runtime->command_queues[d], mems[3 * d], CL_TRUE, CL_MAP_READ,
+                0, share * sizeof(float), 0, NULL, NULL, &err);
+        if (NULL == a || CL_SUCCESS != err)
+            FATAL_ERROR("clEnqueueMapBuffer", err);
+        for (i = 0; i < share; i++)
+            if (a[i] != 7.0f)
+                FATAL_ERROR("Wrong result", EINVAL);
+        OPENCL_CHECK(clEnqueueUnmapMemObject, (runtime->command_queues[d], mems[3 * d], a, 0, NULL, NULL));
+        OPENCL_CHECK(clFinish, (runtime->command_queues[d]));
+        for (j = 0; j < 3; j++) {
+            OPENCL_CHECK(clReleaseMemObject, (mems[3 * d + j]));
+            opencl_runtime_host_free(host[3 * d + j], share * sizeof(float));
+        }
+        OPENCL_CHECK(clReleaseKernel, (kernels[d]));
+    }
+    free(kernels);
+    free(mems);
+    free(host);
+    return 3.0 * sizeof(float) * share * runtime->num_devices * REPETITIONS / start / 1e9;
+}
+
+int main(int argc __HAW_OPENCL_ATTR_UNUSED__, char * argv[] __HAW_OPENCL_ATTR_UNUSED__) {
+    cl_uint haw_devices_num;
+    hawopencl_device * haw_devices;
+    hawopencl_runtime * runtime;
+    cl_device_id device_id;
+    double whole;
+    double partitioned;
+    cl_uint d;
+    int err;
+
+    opencl_get_devices(USE_DEVICE_TYPE, &haw_devices_num, &haw_devices);
+    if (0 == haw_devices_num)
+        FATAL_ERROR("No devices of device type available; please change USE_DEVICE_TYPE", EINVAL);
+    device_id = haw_devices[USE_DEVICE_NUM].device_id;
+    printf("Using OpenCL device:%s with %u compute units\n",
+            haw_devices[USE_DEVICE_NUM].device_name, haw_devices[USE_DEVICE_NUM].caps->max_compute_units);
+
+    opencl_init_multi(USE_DEVICE_TYPE, 1, &device_id, 1, NULL, &runtime);
+    whole = run(runtime);
+    opencl_runtime_release(runtime);
+
+    err = opencl_init_partitioned(device_id, HAWOPENCL_PARTITION_NUMA, 0, NULL, NULL, &runtime);
+    if (CL_SUCCESS != err) {
+        printf("Partitioning by NUMA node failed (%d), partitioning equally\n", err);
+        err = opencl_init_partitioned(device_id, HAWOPENCL_PARTITION_EQUALLY,
+                haw_devices[USE_DEVICE_NUM].caps->max_compute_units / 2, NULL, NULL, &runtime);
+        if (CL_SUCCESS != err)
+            FATAL_ERROR("opencl_init_partitioned", err);
+    }
+    for (d = 0; d < runtime->num_devices; d++)
+        printf("Sub-device %u: %u compute units on NUMA node %d\n", d,
+                opencl_device_caps(runtime->device_ids[d])->max_compute_units, runtime->numa_nodes[d]);
+    partitioned = run(runtime);
+    opencl_runtime_release(runtime);
+
+    printf("Triad on the whole device:  %8.2f GB/s\n", whole);
+    printf("Triad on %u sub-devices:     %8.2f GB/s\n", d, partitioned);
+    printf("Test init_partitioned finished successfully.\n");
+
+    opencl_free_devices(haw_devices_num, haw_devices);
+    return 0;
+}
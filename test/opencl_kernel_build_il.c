@@ -0,0 +1,113 @@
+/*
+ * Small test to show the usage of opencl_kernel_build_il():
+ * the kernel vector_add.cl is compiled to SPIR-V at build time using
+ * hawopencl_add_spirv(); the build from IL is compared to the build from
+ * source. Falls back to the source, if the library was not configured with
+ * HAWOPENCL_CL_VERSION=210 (or higher) or the device does not support SPIR-V.
+ */
+#include "HAWOpenCL.h"
+
+#if defined(__APPLE__) && defined(__MACH__)
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+#include <stdlib.h>
+#include <time.h>
+
+#define LEN (1024*1024)
+#define USE_DEVICE_TYPE (CL_DEVICE_TYPE_GPU | CL_DEVICE_TYPE_CPU)
+#define USE_DEVICE_NUM  0
+
+static double get_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc __HAW_OPENCL_ATTR_UNUSED__, char * argv[] __HAW_OPENCL_ATTR_UNUSED__) {
+    cl_device_id device_id;
+    cl_context context;
+    cl_command_queue command_queue;
+    cl_kernel kernel;
+    cl_mem cl_a;
+    cl_mem cl_b;
+    unsigned int count = LEN;
+    unsigned int i;
+    int * a;
+    int * b;
+    size_t global;
+    cl_uint haw_devices_num;
+    hawopencl_device * haw_devices;
+    char * source;
+    double start;
+
+    // The .spv file is written to the build directory, the .cl is found in the source directory
+    setenv("OPENCL_KERNEL_PATH", SPIRV_DIR, 0);
+    // Measure the compile time without the binary cache
+    opencl_kernel_cache_config(NULL, 0);
+
+    opencl_get_devices(USE_DEVICE_TYPE, &haw_devices_num, &haw_devices);
+    if (0 == haw_devices_num)
+        FATAL_ERROR("No devices of device type available; please change USE_DEVICE_TYPE", EINVAL);
+    opencl_init(USE_DEVICE_TYPE, haw_devices[USE_DEVICE_NUM].device_id, &device_id, &context, &command_queue);
+    printf("Using OpenCL device:%s\n", haw_devices[USE_DEVICE_NUM].device_name);
+
+    source = opencl_kernel_load_source("test/vector_add.cl");
+    start = get_time();
+    opencl_kernel_build(source, "vector_add", device_id, context, &kernel);
+    printf("Build of vector_add from source took %.3f ms\n", 1000.0 * (get_time() - start));
+    free(source);
+
+    if (opencl_device_supports_il(device_id)) {
+        size_t length;
+        void * il = opencl_kernel_load_il("vector_add.spv", &length);
+
+        OPENCL_CHECK(clReleaseKernel, (kernel));
+        start = get_time();
+        OPENCL_CHECK(opencl_kernel_build_il, (il, length, "vector_add", NULL, device_id, context, &kernel));
+        printf("Build of vector_add from SPIR-V took %.3f ms\n", 1000.0 * (get_time() - start));
+        free(il);
+    } else {
+        printf("SPIR-V is not supported; using the kernel built from source\n");
+    }
+
+    a = (int*) malloc(sizeof(int) * count);
+    b = (int*) malloc(sizeof(int) * count);
+    if (!a || !b)
+        FATAL_ERROR("Failed to allocate host memory", ENOMEM);
+    for (i = 0; i < count; i++) {
+        a[i] = i;
+        b[i] = 1;
+    }
+    cl_a = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, sizeof(cl_int) * count, a, NULL);
+    cl_b = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(cl_int) * count, b, NULL);
+    if (!cl_a || !cl_b)
+        FATAL_ERROR("Failed to allocate device memory", ENOMEM);
+
+    OPENCL_CHECK(clSetKernelArg, (kernel, 0, sizeof(cl_mem), &cl_a));
+    OPENCL_CHECK(clSetKernelArg, (kernel, 1, sizeof(cl_mem), &cl_b));
+    OPENCL_CHECK(clSetKernelArg, (kernel, 2, sizeof(unsigned int), &count));
+    global = count;
+    OPENCL_CHECK(clEnqueueNDRangeKernel, (command_queue, kernel, 1, NULL, &global, NULL, 0, NULL, NULL));
+    OPENCL_CHECK(clEnqueueReadBuffer, (command_queue, cl_a, CL_TRUE, 0, sizeof(int) * count, a, 0, NULL, NULL));
+
+    for (i = 0; i < count; i++) {
+        if (a[i] != (int) i + 1)
+            break;
+    }
+    if (i != count) {
+        FATAL_ERROR("Check error at position", i);
+    }
+    printf("Test kernel_build_il finished successfully.\n");
+
+    OPENCL_CHECK(clReleaseMemObject, (cl_a));
+    OPENCL_CHECK(clReleaseMemObject, (cl_b));
+    OPENCL_CHECK(clReleaseKernel, (kernel));
+    OPENCL_CHECK(clReleaseCommandQueue, (command_queue));
+    OPENCL_CHECK(clReleaseContext, (context));
+    free(a);
+    free(b);
+    opencl_free_devices(haw_devices_num, haw_devices);
+    return 0;
+}
@@ -0,0 +1,89 @@
+/*
+ * Benchmark of the program binary cache used by opencl_kernel_build().
+ * The first build misses the cache and compiles from source, the
+ * following builds are served from the binary stored on disk.
+ *
+ * Pass a cache directory as argument to keep it across runs, e.g. to
+ * measure the startup time of a second process:
+ *     ./opencl_kernel_cache /tmp/hawopencl_cache
+ */
+#include "HAWOpenCL.h"
+
+#if defined(__APPLE__) && defined(__MACH__)
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define USE_DEVICE_TYPE (CL_DEVICE_TYPE_GPU | CL_DEVICE_TYPE_CPU)
+#define USE_DEVICE_NUM  0
+#define NUM_BUILDS      5
+
+const char KERNEL_SOURCE[] = "\n" \
+    "__kernel void vector_add(__global int * a, \n"
+    "                         __global const int * b, \n"
+    "                         const unsigned int len)\n"
+    "{\n"
+    "    const size_t i = get_global_id(0);\n"
+    "    if (i < len) {\n"
+    "        a[i] += b[i];\n"
+    "    }\n"
+    "}\n";
+
+static double get_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc, char * argv[]) {
+    cl_device_id device_id;
+    cl_context context;
+    cl_command_queue command_queue;
+    cl_kernel kernel;
+    cl_uint haw_devices_num;
+    hawopencl_device * haw_devices;
+    hawopencl_kernel_cache_stats stats;
+    char cache_dir[] = "/tmp/hawopencl_cache_XXXXXX";
+    int i;
+
+    if (argc > 1) {
+        opencl_kernel_cache_config(argv[1], 64 * 1024 * 1024);
+    } else {
+        if (NULL == mkdtemp(cache_dir))
+            FATAL_ERROR("mkdtemp", errno);
+        opencl_kernel_cache_config(cache_dir, 64 * 1024 * 1024);
+    }
+
+    opencl_get_devices(USE_DEVICE_TYPE, &haw_devices_num, &haw_devices);
+    if (0 == haw_devices_num)
+        FATAL_ERROR("No devices of device type available; please change USE_DEVICE_TYPE", EINVAL);
+    opencl_init(USE_DEVICE_TYPE, haw_devices[USE_DEVICE_NUM].device_id, &device_id, &context, &command_queue);
+    printf("Using OpenCL device:%s\n", haw_devices[USE_DEVICE_NUM].device_name);
+
+    for (i = 0; i < NUM_BUILDS; i++) {
+        double start = get_time();
+        opencl_kernel_build(KERNEL_SOURCE, "vector_add", device_id, context, &kernel);
+        printf("%d. build of vector_add took %.3f ms\n", i + 1, 1000.0 * (get_time() - start));
+        OPENCL_CHECK(clReleaseKernel, (kernel));
+    }
+
+    opencl_kernel_cache_stats(&stats);
+    printf("Kernel cache: hits:%lu misses:%lu stores:%lu evictions:%lu invalid:%lu bytes:%llu\n",
+            stats.hits, stats.misses, stats.stores, stats.evictions, stats.invalid, stats.bytes);
+
+    if (argc <= 1) {
+        char cmd[64];
+        snprintf(cmd, sizeof(cmd), "rm -rf %s", cache_dir);
+        if (0 != system(cmd))
+            fprintf(stderr, "WARNING: Could not remove %s\n", cache_dir);
+    }
+
+    OPENCL_CHECK(clReleaseCommandQueue, (command_queue));
+    OPENCL_CHECK(clReleaseContext, (context));
+    opencl_free_devices(haw_devices_num, haw_devices);
+    return 0;
+}
@@ -0,0 +1,140 @@
+/*
+ * Offline ahead-of-time compiler of OpenCL kernels:
+ * the .cl files are loaded with opencl_kernel_load() (expanding any
+ * #include "..."), compiled for every device found and written into one
+ * archive, which applications open with opencl_archive_open().
+ *
+ * Usage: opencl_kernel_compile [-o archive] [-p profile] [-D NAME[=VALUE]]... [-t all|cpu|gpu] file.cl...
+ *        opencl_kernel_compile -l archive
+ */
+#include "HAWOpenCL.h"
+
+#if defined(__APPLE__) && defined(__MACH__)
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define DEFAULT_ARCHIVE "kernels.clar"
+
+static void usage(const char * prog) {
+    fprintf(stderr, "Usage: %s [-o archive] [-p profile] [-D NAME[=VALUE]]... [-t all|cpu|gpu] file.cl...\n"
+                    "       %s -l archive\n"
+                    "  -o archive   The archive to write (default: " DEFAULT_ARCHIVE ")\n"
+                    "  -p profile   The build profile: debug, release (default), fast-math or strict\n"
+                    "  -D NAME=VAL  Define the macro for all files\n"
+                    "  -t type      The type of devices to compile for (default: all)\n"
+                    "  -l archive   List the programs of an archive\n"
+                    "The .cl files and their includes are searched in OPENCL_KERNEL_PATH.\n",
+                    prog, prog);
+    exit(EINVAL);
+}
+
+static int list(const char * archive_file_name) {
+    hawopencl_archive * archive;
+    const char * name;
+    cl_uint i;
+    int err;
+
+    err = opencl_archive_open(archive_file_name, &archive);
+    if (CL_SUCCESS != err) {
+        fprintf(stderr, "ERROR: Cannot open archive %s\n", archive_file_name);
+        return err;
+    }
+    for (i = 0; NULL != (name = opencl_archive_program_name(archive, i)); i++)
+        printf("%s\n", name);
+    opencl_archive_close(archive);
+    return 0;
+}
+
+int main(int argc, char * argv[]) {
+    const char * archive_file_name = DEFAULT_ARCHIVE;
+    cl_device_type device_type = CL_DEVICE_TYPE_ALL;
+    hawopencl_build_options options;
+    hawopencl_build_profile profile = HAWOPENCL_BUILD_PROFILE_RELEASE;
+    hawopencl_device * haw_devices;
+    cl_uint haw_devices_num;
+    cl_device_id * devices;
+    const char ** names;
+    const char ** sources;
+    const char ** build_options;
+    int num_programs;
+    int opt;
+    int i;
+
+    opencl_build_options_init(&options, profile);
+    while (-1 != (opt = getopt(argc, argv, "o:p:D:t:l:h"))) {
+        switch (opt) {
+            case 'o':
+                archive_file_name = optarg;
+                break;
+            case 'p':
+                if (CL_SUCCESS != opencl_build_profile_parse(optarg, &profile))
+                    usage(argv[0]);
+                options.profile = profile;
+                break;
+            case 'D': {
+                char * value = strchr(optarg, '=');
+                if (NULL != value)
+                    *value++ = '\0';
+                opencl_build_options_define(&options, optarg, value);
+                break;
+            }
+            case 't':
+                if (0 == strcmp(optarg, "all"))
+                    device_type = CL_DEVICE_TYPE_ALL;
+                else if (0 == strcmp(optarg, "cpu"))
+                    device_type = CL_DEVICE_TYPE_CPU;
+                else if (0 == strcmp(optarg, "gpu"))
+                    device_type = CL_DEVICE_TYPE_GPU;
+                else
+                    usage(argv[0]);
+                break;
+            case 'l':
+                return list(optarg);
+            default:
+                usage(argv[0]);
+        }
+    }
+    num_programs = argc - optind;
+    if (0 >= num_programs)
+        usage(argv[0]);
+
+    opencl_get_devices(device_type, &haw_devices_num, &haw_devices);
+    if (0 == haw_devices_num)
+        FATAL_ERROR("No devices of device type available", ENODEV);
+    devices = (cl_device_id *) malloc(haw_devices_num * sizeof(cl_device_id));
+    names = (const char **) malloc(num_programs * sizeof(char *));
+    sources = (const char **) malloc(num_programs * sizeof(char *));
+    build_options = (const char **) malloc(num_programs * sizeof(char *));
+    if (!devices || !names || !sources || !build_options)
+        FATAL_ERROR("malloc", ENOMEM);
+    for (i = 0; i < (int) haw_devices_num; i++) {
+        printf("Compiling for OpenCL device:%s\n", haw_devices[i].device_name);
+        devices[i] = haw_devices[i].device_id;
+    }
+
+    // All files share the same options
+    opencl_build_options_string(&options);
+    for (i = 0; i < num_programs; i++) {
+        names[i] = argv[optind + i];
+        sources[i] = opencl_kernel_load(names[i]);
+        build_options[i] = options.options;
+    }
+    opencl_archive_write(archive_file_name, num_programs, names, sources, build_options,
+            haw_devices_num, devices);
+    printf("Wrote %d programs for %u devices to %s\n", num_programs, haw_devices_num, archive_file_name);
+
+    for (i = 0; i < num_programs; i++)
+        free((char *) sources[i]);
+    opencl_build_options_free(&options);
+    free(names);
+    free(sources);
+    free(build_options);
+    free(devices);
+    opencl_free_devices(haw_devices_num, haw_devices);
+    return 0;
+}
@@ -0,0 +1,130 @@
+/*
+ * Test of the include expansion of opencl_kernel_load():
+ * a tree of NUM_HEADERS headers is generated into a temporary directory,
+ * every header includes the common one and the next two headers, using
+ * include guards, #pragma once or none (in the leaves).
+ * Every header must show up exactly once; the first load reads the headers,
+ * later loads are served from the header cache and the path index.
+ * A file created after indexing must be found as well.
+ */
+#include "HAWOpenCL.h"
+
+#if defined(__APPLE__) && defined(__MACH__)
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define NUM_HEADERS 40
+#define NUM_LOADS   10
+
+static double get_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void write_file(const char * dir, const char * name, const char * contents) {
+    char path[256];
+    FILE * file;
+
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    file = fopen(path, "w");
+    if (NULL == file)
+        FATAL_ERROR("fopen", errno);
+    fputs(contents, file);
+    fclose(file);
+}
+
+static void remove_file(const char * dir, const char * name) {
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    unlink(path);
+}
+
+static void write_headers(const char * dir) {
+    char name[32];
+    char contents[512];
+    int i;
+
+    write_file(dir, "common.h", "#ifndef COMMON_H\n#define COMMON_H\n#define SCALE 2.0f\n#endif\n");
+    for (i = 0; i < NUM_HEADERS; i++) {
+        int len = 0;
+        snprintf(name, sizeof(name), "header_%d.h", i);
+        if (i % 2)
+            len += snprintf(contents + len, sizeof(contents) - len, "#pragma once\n");
+        else
+            len += snprintf(contents + len, sizeof(contents) - len, "#ifndef HEADER_%d_H\n#define HEADER_%d_H\n", i, i);
+        len += snprintf(contents + len, sizeof(contents) - len, "#include \"common.h\"\n");
+        if (2*i+1 < NUM_HEADERS)
+            len += snprintf(contents + len, sizeof(contents) - len, "#include \"header_%d.h\"\n", 2*i+1);
+        if (2*i+2 < NUM_HEADERS)
+            len += snprintf(contents + len, sizeof(contents) - len, "#include \"header_%d.h\"\n", 2*i+2);
+        len += snprintf(contents + len, sizeof(contents) - len, "float f_%d(float x) { return SCALE * x; }\n", i);
+        if (0 == i % 2)
+            len += snprintf(contents + len, sizeof(contents) - len, "#endif\n");
+        write_file(dir, name, contents);
+    }
+    // Include the tree twice
+    write_file(dir, "include.cl", "#include \"header_0.h\"\n"
+                                  "#include \"header_1.h\"\n"
+                                  "__kernel void f(__global float * a) { a[0] = f_0(a[0]); }\n");
+}
+
+int main(int argc __HAW_OPENCL_ATTR_UNUSED__, char * argv[] __HAW_OPENCL_ATTR_UNUSED__) {
+    char dir[] = "/tmp/hawopencl_kernel_include.XXXXXX";
+    char name[32];
+    char * source;
+    double start;
+    int i;
+
+    if (NULL == mkdtemp(dir))
+        FATAL_ERROR("mkdtemp", errno);
+    write_headers(dir);
+    setenv("OPENCL_KERNEL_PATH", dir, 1);
+
+    start = get_time();
+    source = opencl_kernel_load("include.cl");
+    printf("First load took %.3f ms\n", 1000.0 * (get_time() - start));
+
+    for (i = 0; i < NUM_HEADERS; i++) {
+        char function[32];
+        char * pos;
+        snprintf(function, sizeof(function), "float f_%d(", i);
+        pos = strstr(source, function);
+        if (NULL == pos || NULL != strstr(pos + 1, function)) {
+            printf("%s\n", source);
+            FATAL_ERROR("Header not included exactly once", i);
+        }
+    }
+    if (NULL != strstr(source, "#pragma once"))
+        FATAL_ERROR("#pragma once not removed", EINVAL);
+    free(source);
+
+    start = get_time();
+    for (i = 0; i < NUM_LOADS; i++)
+        free(opencl_kernel_load("include.cl"));
+    printf("Cached loads took %.3f ms each\n", 1000.0 * (get_time() - start) / NUM_LOADS);
+
+    // The directory is indexed already, the failing lookup has to rescan it
+    write_file(dir, "late.cl", "#include \"header_3.h\"\n");
+    source = opencl_kernel_load("late.cl");
+    if (NULL == strstr(source, "float f_3("))
+        FATAL_ERROR("File created after indexing not found", ENOENT);
+    free(source);
+    printf("Test kernel_include finished successfully.\n");
+
+    remove_file(dir, "include.cl");
+    remove_file(dir, "late.cl");
+    remove_file(dir, "common.h");
+    for (i = 0; i < NUM_HEADERS; i++) {
+        snprintf(name, sizeof(name), "header_%d.h", i);
+        remove_file(dir, name);
+    }
+    rmdir(dir);
+    return 0;
+}
@@ -0,0 +1,156 @@
+/*
+ * Benchmark of opencl_kernel_map() against opencl_kernel_load():
+ * a large kernel with a constant table of -s MB (default 8) and an include
+ * is generated into a temporary directory; both loaders are timed and
+ * the growth of the peak RSS is reported. Mapping is measured first,
+ * since the peak RSS only grows.
+ * With -b, both sources are built as well, without the binary cache.
+ */
+#include "HAWOpenCL.h"
+
+#if defined(__APPLE__) && defined(__MACH__)
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#define USE_DEVICE_TYPE (CL_DEVICE_TYPE_GPU | CL_DEVICE_TYPE_CPU)
+#define USE_DEVICE_NUM  0
+
+static double get_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// The peak resident set size in KiB
+static long get_max_rss(void) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;
+}
+
+static void write_kernel(const char * dir, size_t size_mb) {
+    char path[256];
+    FILE * file;
+    size_t num_entries;
+    size_t i;
+
+    snprintf(path, sizeof(path), "%s/scale.h", dir);
+    file = fopen(path, "w");
+    if (NULL == file)
+        FATAL_ERROR("fopen", errno);
+    fprintf(file, "float scale(float x) { return 2.0f * x; }\n");
+    fclose(file);
+
+    // Every entry takes 16 characters
+    num_entries = size_mb * 1024 * 1024 / 16;
+    snprintf(path, sizeof(path), "%s/table.cl", dir);
+    file = fopen(path, "w");
+    if (NULL == file)
+        FATAL_ERROR("fopen", errno);
+    fprintf(file, "#include \"scale.h\"\n"
+                  "__constant float table[%zu] = {\n", num_entries);
+    for (i = 0; i < num_entries; i++)
+        fprintf(file, "%13.6ff,%s", (float) i, (i % 4 == 3) ? "\n" : " ");
+    fprintf(file, "};\n"
+                  "__kernel void lookup(__global float * a, const unsigned int len)\n"
+                  "{\n"
+                  "    const size_t i = get_global_id(0);\n"
+                  "    if (i < len)\n"
+                  "        a[i] = scale(table[i %% %zu]);\n"
+                  "}\n", num_entries);
+    fclose(file);
+}
+
+int main(int argc, char * argv[]) {
+    char dir[] = "/tmp/hawopencl_kernel_map.XXXXXX";
+    char path[256];
+    size_t size_mb = 8;
+    bool build = false;
+    hawopencl_source source;
+    char * buffer;
+    long rss;
+    double start;
+    double map_time;
+    double load_time;
+    int opt;
+
+    while (-1 != (opt = getopt(argc, argv, "s:b"))) {
+        switch (opt) {
+            case 's':
+                size_mb = strtoul(optarg, NULL, 0);
+                break;
+            case 'b':
+                build = true;
+                break;
+            default:
+                fprintf(stderr, "Usage: %s [-s size_in_MB] [-b]\n", argv[0]);
+                exit(EINVAL);
+        }
+    }
+
+    if (NULL == mkdtemp(dir))
+        FATAL_ERROR("mkdtemp", errno);
+    write_kernel(dir, size_mb);
+    setenv("OPENCL_KERNEL_PATH", dir, 1);
+
+    rss = get_max_rss();
+    start = get_time();
+    opencl_kernel_map("table.cl", &source);
+    map_time = get_time() - start;
+    printf("opencl_kernel_map:  %8.3f ms, peak RSS +%ld KiB, %u segments\n",
+           1000.0 * map_time, get_max_rss() - rss, source.count);
+
+    rss = get_max_rss();
+    start = get_time();
+    buffer = opencl_kernel_load("table.cl");
+    load_time = get_time() - start;
+    printf("opencl_kernel_load: %8.3f ms, peak RSS +%ld KiB\n",
+           1000.0 * load_time, get_max_rss() - rss);
+
+    if (build) {
+        cl_device_id device_id;
+        cl_context context;
+        cl_command_queue command_queue;
+        cl_kernel kernel;
+        cl_uint haw_devices_num;
+        hawopencl_device * haw_devices;
+
+        opencl_kernel_cache_config(NULL, 0);
+        opencl_get_devices(USE_DEVICE_TYPE, &haw_devices_num, &haw_devices);
+        if (0 == haw_devices_num)
+            FATAL_ERROR("No devices of device type available; please change USE_DEVICE_TYPE", EINVAL);
+        opencl_init(USE_DEVICE_TYPE, haw_devices[USE_DEVICE_NUM].device_id, &device_id, &context, &command_queue);
+        printf("Using OpenCL device:%s\n", haw_devices[USE_DEVICE_NUM].device_name);
+
+        start = get_time();
+        opencl_kernel_build_sources(source.count, source.strings, source.lengths, "lookup",
+                NULL, device_id, context, &kernel);
+        printf("Build of mapped segments took %.3f ms\n", 1000.0 * (get_time() - start));
+        OPENCL_CHECK(clReleaseKernel, (kernel));
+
+        start = get_time();
+        opencl_kernel_build(buffer, "lookup", device_id, context, &kernel);
+        printf("Build of loaded buffer took   %.3f ms\n", 1000.0 * (get_time() - start));
+        OPENCL_CHECK(clReleaseKernel, (kernel));
+
+        OPENCL_CHECK(clReleaseCommandQueue, (command_queue));
+        OPENCL_CHECK(clReleaseContext, (context));
+        opencl_free_devices(haw_devices_num, haw_devices);
+    }
+
+    opencl_kernel_unmap(&source);
+    free(buffer);
+    snprintf(path, sizeof(path), "%s/table.cl", dir);
+    unlink(path);
+    snprintf(path, sizeof(path), "%s/scale.h", dir);
+    unlink(path);
+    rmdir(dir);
+    return 0;
+}
@@ -0,0 +1,153 @@
+/*
+ * Benchmark of kernel variants built by opencl_kernel_variant():
+ * a kernel summing TILE elements per work-item, with TILE passed at runtime
+ * as argument, compared to TILE as compile-time constant; and one
+ * type-generic source instantiated for float and int.
+ */
+#include "HAWOpenCL.h"
+
+#if defined(__APPLE__) && defined(__MACH__)
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define LEN (4*1024*1024)
+#define USE_DEVICE_TYPE (CL_DEVICE_TYPE_GPU | CL_DEVICE_TYPE_CPU)
+#define USE_DEVICE_NUM  0
+#define TILE            16
+#define NUM_LOOKUPS     100000
+
+// TILE is either a compile-time constant, or passed as argument tile
+const char KERNEL_SOURCE[] = "\n" \
+    "#ifndef T\n"
+    "#define T float\n"
+    "#endif\n"
+    "__kernel void tile_sum(__global T * a, __global const T * b, const unsigned int tile)\n"
+    "{\n"
+    "#ifdef TILE\n"
+    "    const unsigned int n = TILE;\n"
+    "#else\n"
+    "    const unsigned int n = tile;\n"
+    "#endif\n"
+    "    const size_t i = get_global_id(0);\n"
+    "    T sum = 0;\n"
+    "    for (unsigned int j = 0; j < n; j++)\n"
+    "        sum += b[i * n + j];\n"
+    "    a[i] = sum;\n"
+    "}\n";
+
+static double get_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double run(cl_command_queue command_queue, cl_kernel kernel, cl_mem cl_a, cl_mem cl_b) {
+    const unsigned int tile = TILE;
+    const size_t global = LEN / TILE;
+    double start;
+
+    OPENCL_CHECK(clSetKernelArg, (kernel, 0, sizeof(cl_mem), &cl_a));
+    OPENCL_CHECK(clSetKernelArg, (kernel, 1, sizeof(cl_mem), &cl_b));
+    OPENCL_CHECK(clSetKernelArg, (kernel, 2, sizeof(unsigned int), &tile));
+    // Warm up, then measure
+    OPENCL_CHECK(clEnqueueNDRangeKernel, (command_queue, kernel, 1, NULL, &global, NULL, 0, NULL, NULL));
+    OPENCL_CHECK(clFinish, (command_queue));
+    start = get_time();
+    OPENCL_CHECK(clEnqueueNDRangeKernel, (command_queue, kernel, 1, NULL, &global, NULL, 0, NULL, NULL));
+    OPENCL_CHECK(clFinish, (command_queue));
+    return get_time() - start;
+}
+
+int main(int argc __HAW_OPENCL_ATTR_UNUSED__, char * argv[] __HAW_OPENCL_ATTR_UNUSED__) {
+    cl_device_id device_id;
+    cl_context context;
+    cl_command_queue command_queue;
+    cl_uint haw_devices_num;
+    hawopencl_device * haw_devices;
+    hawopencl_variant_cache * cache;
+    const hawopencl_define tile_defines[] = {{"T", "int"}, {"TILE", "16"}};
+    const hawopencl_define tile_defines_reordered[] = {{"TILE", "16"}, {"T", "int"}};
+    cl_kernel kernel;
+    cl_kernel kernel_tile;
+    cl_mem cl_a;
+    cl_mem cl_b;
+    int * a;
+    int * b;
+    float * f;
+    double start;
+    double time_arg;
+    double time_tile;
+    unsigned int i;
+
+    opencl_get_devices(USE_DEVICE_TYPE, &haw_devices_num, &haw_devices);
+    if (0 == haw_devices_num)
+        FATAL_ERROR("No devices of device type available; please change USE_DEVICE_TYPE", EINVAL);
+    opencl_init(USE_DEVICE_TYPE, haw_devices[USE_DEVICE_NUM].device_id, &device_id, &context, &command_queue);
+    printf("Using OpenCL device:%s\n", haw_devices[USE_DEVICE_NUM].device_name);
+
+    a = (int *) malloc(sizeof(int) * (LEN / TILE));
+    b = (int *) malloc(sizeof(int) * LEN);
+    f = (float *) malloc(sizeof(float) * (LEN / TILE));
+    if (!a || !b || !f)
+        FATAL_ERROR("Failed to allocate host memory", ENOMEM);
+    for (i = 0; i < LEN; i++)
+        b[i] = 1;
+    cl_a = clCreateBuffer(context, CL_MEM_WRITE_ONLY, sizeof(int) * (LEN / TILE), NULL, NULL);
+    cl_b = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(int) * LEN, b, NULL);
+    if (!cl_a || !cl_b)
+        FATAL_ERROR("Failed to allocate device memory", ENOMEM);
+
+    opencl_variant_cache_create(KERNEL_SOURCE, NULL, device_id, context, &cache);
+
+    // The runtime argument and the compile-time constant variant
+    opencl_kernel_variant_typed(cache, "int", "tile_sum", &kernel);
+    opencl_kernel_variant(cache, 2, tile_defines, "tile_sum", &kernel_tile);
+    time_arg = run(command_queue, kernel, cl_a, cl_b);
+    time_tile = run(command_queue, kernel_tile, cl_a, cl_b);
+    printf("tile_sum with TILE as argument took %.3f ms, as constant %.3f ms (speedup %.2f)\n",
+            1000.0 * time_arg, 1000.0 * time_tile, time_arg / time_tile);
+    OPENCL_CHECK(clEnqueueReadBuffer, (command_queue, cl_a, CL_TRUE, 0, sizeof(int) * (LEN / TILE), a, 0, NULL, NULL));
+    for (i = 0; i < LEN / TILE; i++)
+        if (TILE != a[i])
+            FATAL_ERROR("Check error at position", i);
+
+    // Repeated requests are served from the table, in any order of definitions
+    start = get_time();
+    for (i = 0; i < NUM_LOOKUPS; i++) {
+        cl_kernel k;
+        opencl_kernel_variant(cache, 2, tile_defines_reordered, "tile_sum", &k);
+        if (k != kernel_tile)
+            FATAL_ERROR("Variant was not found in cache", EINVAL);
+    }
+    printf("%d lookups of a cached variant took %.3f ms\n", NUM_LOOKUPS, 1000.0 * (get_time() - start));
+
+    // The same source instantiated for float
+    for (i = 0; i < LEN; i++)
+        ((float *) b)[i] = 0.5f;
+    OPENCL_CHECK(clEnqueueWriteBuffer, (command_queue, cl_b, CL_TRUE, 0, sizeof(float) * LEN, b, 0, NULL, NULL));
+    opencl_kernel_variant_typed(cache, "float", "tile_sum", &kernel);
+    run(command_queue, kernel, cl_a, cl_b);
+    OPENCL_CHECK(clEnqueueReadBuffer, (command_queue, cl_a, CL_TRUE, 0, sizeof(float) * (LEN / TILE), f, 0, NULL, NULL));
+    for (i = 0; i < LEN / TILE; i++)
+        if (0.5f * TILE != f[i])
+            FATAL_ERROR("Check error at position", i);
+    if (3 != opencl_variant_cache_size(cache))
+        FATAL_ERROR("Unexpected number of variants", EINVAL);
+    printf("Test kernel_variant finished successfully.\n");
+
+    opencl_variant_cache_release(cache);
+    OPENCL_CHECK(clReleaseMemObject, (cl_a));
+    OPENCL_CHECK(clReleaseMemObject, (cl_b));
+    OPENCL_CHECK(clReleaseCommandQueue, (command_queue));
+    OPENCL_CHECK(clReleaseContext, (context));
+    free(a);
+    free(b);
+    free(f);
+    opencl_free_devices(haw_devices_num, haw_devices);
+    return 0;
+}
@@ -0,0 +1,142 @@
+/*
+ * Test of opencl_kernel_watch(): a kernel scaling by a factor defined in an
+ * included header is generated into a temporary directory and run; then
+ * the header is rewritten with another factor, as an editor would.
+ * The kernel must be reloaded within a few seconds and compute the new
+ * result; the time from the write to the reload is reported.
+ */
+#include "HAWOpenCL.h"
+
+#if defined(__APPLE__) && defined(__MACH__)
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define USE_DEVICE_TYPE (CL_DEVICE_TYPE_GPU | CL_DEVICE_TYPE_CPU)
+#define USE_DEVICE_NUM  0
+#define LEN             1024
+#define TIMEOUT         10.0
+
+static double get_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void write_file(const char * dir, const char * name, const char * contents) {
+    char path[256];
+    char tmp[256];
+    FILE * file;
+
+    // Write to a temporary file and rename it, like most editors do
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    snprintf(tmp, sizeof(tmp), "%s/.%s.tmp", dir, name);
+    file = fopen(tmp, "w");
+    if (NULL == file)
+        FATAL_ERROR("fopen", errno);
+    fputs(contents, file);
+    fclose(file);
+    if (0 != rename(tmp, path))
+        FATAL_ERROR("rename", errno);
+}
+
+static void remove_file(const char * dir, const char * name) {
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    unlink(path);
+}
+
+// Run the kernel of the watch and check a[i] == factor * i
+static bool run(hawopencl_watch * watch, cl_command_queue command_queue, cl_mem mem, float factor) {
+    const size_t global = LEN;
+    const cl_uint len = LEN;
+    float a[LEN];
+    cl_kernel kernel;
+    bool reloaded;
+    int i;
+
+    opencl_watch_kernel(watch, "scale", &kernel, &reloaded);
+    OPENCL_CHECK(clSetKernelArg, (kernel, 0, sizeof(cl_mem), &mem));
+    OPENCL_CHECK(clSetKernelArg, (kernel, 1, sizeof(cl_uint), &len));
+    OPENCL_CHECK(clEnqueueNDRangeKernel, (command_queue, kernel, 1, NULL, &global, NULL, 0, NULL, NULL));
+    OPENCL_CHECK(clEnqueueReadBuffer, (command_queue, mem, CL_TRUE, 0, sizeof(a), a, 0, NULL, NULL));
+    for (i = 0; i < LEN; i++)
+        if (a[i] != factor * i) {
+            printf("a[%d]:%f expected:%f\n", i, a[i], factor * i);
+            FATAL_ERROR("Wrong result", EINVAL);
+        }
+    return reloaded;
+}
+
+int main(int argc __HAW_OPENCL_ATTR_UNUSED__, char * argv[] __HAW_OPENCL_ATTR_UNUSED__) {
+    char dir[] = "/tmp/hawopencl_kernel_watch.XXXXXX";
+    cl_device_id device_id;
+    cl_context context;
+    cl_command_queue command_queue;
+    cl_uint haw_devices_num;
+    hawopencl_device * haw_devices;
+    hawopencl_watch * watch;
+    cl_mem mem;
+    cl_kernel kernel;
+    bool reloaded = false;
+    double start;
+    cl_int err;
+
+    if (NULL == mkdtemp(dir))
+        FATAL_ERROR("mkdtemp", errno);
+    write_file(dir, "factor.h", "#define FACTOR 2.0f\n");
+    write_file(dir, "watch.cl", "#include \"factor.h\"\n"
+                                "__kernel void scale(__global float * a, const unsigned int len)\n"
+                                "{\n"
+                                "    const size_t i = get_global_id(0);\n"
+                                "    if (i < len)\n"
+                                "        a[i] = FACTOR * i;\n"
+                                "}\n");
+    setenv("OPENCL_KERNEL_PATH", dir, 1);
+    opencl_kernel_cache_config(NULL, 0);
+
+    opencl_get_devices(USE_DEVICE_TYPE, &haw_devices_num, &haw_devices);
+    if (0 == haw_devices_num)
+        FATAL_ERROR("No devices of device type available; please change USE_DEVICE_TYPE", EINVAL);
+    opencl_init(USE_DEVICE_TYPE, haw_devices[USE_DEVICE_NUM].device_id, &device_id, &context, &command_queue);
+    printf("Using OpenCL device:%s\n", haw_devices[USE_DEVICE_NUM].device_name);
+
+    mem = clCreateBuffer(context, CL_MEM_WRITE_ONLY, LEN * sizeof(float), NULL, &err);
+    if (NULL == mem || CL_SUCCESS != err)
+        FATAL_ERROR("clCreateBuffer", err);
+
+    opencl_kernel_watch("watch.cl", NULL, device_id, context, &watch);
+    if (CL_INVALID_KERNEL_NAME != opencl_watch_kernel(watch, "no_such_kernel", &kernel, NULL))
+        FATAL_ERROR("opencl_watch_kernel", EINVAL);
+    run(watch, command_queue, mem, 2.0f);
+
+    start = get_time();
+    write_file(dir, "factor.h", "#define FACTOR 3.0f\n");
+    while (!reloaded && get_time() - start < TIMEOUT) {
+        opencl_watch_kernel(watch, "scale", &kernel, &reloaded);
+        if (!reloaded)
+            usleep(1000);
+    }
+    if (!reloaded)
+        FATAL_ERROR("Kernel not reloaded after the header changed", ETIMEDOUT);
+    printf("Reload after the change took %.3f ms\n", 1000.0 * (get_time() - start));
+    // The rebuilt kernel is current now, no further reload
+    if (run(watch, command_queue, mem, 3.0f))
+        FATAL_ERROR("Kernel reloaded twice", EINVAL);
+    printf("Test kernel_watch finished successfully.\n");
+
+    opencl_watch_release(watch);
+    OPENCL_CHECK(clReleaseMemObject, (mem));
+    OPENCL_CHECK(clReleaseCommandQueue, (command_queue));
+    OPENCL_CHECK(clReleaseContext, (context));
+    opencl_free_devices(haw_devices_num, haw_devices);
+    remove_file(dir, "watch.cl");
+    remove_file(dir, "factor.h");
+    rmdir(dir);
+    return 0;
+}
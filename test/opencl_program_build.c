@@ -0,0 +1,137 @@
+/*
+ * Small test to show the usage of opencl_program_build():
+ * the program is compiled once and all kernels are looked up by name,
+ * compared to building the program once per kernel with opencl_kernel_build().
+ */
+#include "HAWOpenCL.h"
+
+#if defined(__APPLE__) && defined(__MACH__)
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+#include <stdlib.h>
+#include <time.h>
+
+#define LEN (1024*1024)
+#define USE_DEVICE_TYPE (CL_DEVICE_TYPE_GPU | CL_DEVICE_TYPE_CPU)
+#define USE_DEVICE_NUM  0
+
+const char KERNEL_SOURCE[] = "\n" \
+    "__kernel void vector_add(__global int * a, __global const int * b, const unsigned int len)\n"
+    "{\n"
+    "    const size_t i = get_global_id(0);\n"
+    "    if (i < len) a[i] += b[i];\n"
+    "}\n"
+    "__kernel void vector_sub(__global int * a, __global const int * b, const unsigned int len)\n"
+    "{\n"
+    "    const size_t i = get_global_id(0);\n"
+    "    if (i < len) a[i] -= b[i];\n"
+    "}\n"
+    "__kernel void vector_scale(__global int * a, __global const int * b, const unsigned int len)\n"
+    "{\n"
+    "    const size_t i = get_global_id(0);\n"
+    "    if (i < len) a[i] *= b[i];\n"
+    "}\n";
+
+const char * KERNEL_NAMES[] = {"vector_add", "vector_sub", "vector_scale"};
+#define NUM_KERNELS (sizeof(KERNEL_NAMES) / sizeof(KERNEL_NAMES[0]))
+
+static double get_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc __HAW_OPENCL_ATTR_UNUSED__, char * argv[] __HAW_OPENCL_ATTR_UNUSED__) {
+    cl_device_id device_id;
+    cl_context context;
+    cl_command_queue command_queue;
+    cl_kernel kernels[NUM_KERNELS];
+    cl_mem cl_a;
+    cl_mem cl_b;
+    unsigned int count = LEN;
+    unsigned int i;
+    int * a;
+    int * b;
+    size_t global;
+    cl_uint haw_devices_num;
+    hawopencl_device * haw_devices;
+    hawopencl_program * program;
+    double start;
+
+    // Measure the compile time without the binary cache
+    opencl_kernel_cache_config(NULL, 0);
+
+    opencl_get_devices(USE_DEVICE_TYPE, &haw_devices_num, &haw_devices);
+    if (0 == haw_devices_num)
+        FATAL_ERROR("No devices of device type available; please change USE_DEVICE_TYPE", EINVAL);
+    opencl_init(USE_DEVICE_TYPE, haw_devices[USE_DEVICE_NUM].device_id, &device_id, &context, &command_queue);
+
+    start = get_time();
+    for (i = 0; i < NUM_KERNELS; i++)
+        opencl_kernel_build(KERNEL_SOURCE, KERNEL_NAMES[i], device_id, context, &kernels[i]);
+    printf("opencl_kernel_build() of %d kernels took %.3f ms\n",
+            (int) NUM_KERNELS, 1000.0 * (get_time() - start));
+    for (i = 0; i < NUM_KERNELS; i++)
+        OPENCL_CHECK(clReleaseKernel, (kernels[i]));
+
+    start = get_time();
+    opencl_program_build(KERNEL_SOURCE, device_id, context, &program);
+    printf("opencl_program_build() of %u kernels took %.3f ms\n",
+            program->num_kernels, 1000.0 * (get_time() - start));
+    if (NUM_KERNELS != program->num_kernels)
+        FATAL_ERROR("Unexpected number of kernels in program", EINVAL);
+    if (NULL != opencl_program_kernel(program, "no_such_kernel"))
+        FATAL_ERROR("Found non-existing kernel", EINVAL);
+
+    a = (int*) malloc(sizeof(int) * count);
+    b = (int*) malloc(sizeof(int) * count);
+    if (!a || !b)
+        FATAL_ERROR("Failed to allocate host memory", ENOMEM);
+    for (i = 0; i < count; i++) {
+        a[i] = 1;
+        b[i] = 2;
+    }
+    cl_a = clCreateBuffer(context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, sizeof(cl_int) * count, a, NULL);
+    cl_b = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(cl_int) * count, b, NULL);
+    if (!cl_a || !cl_b)
+        FATAL_ERROR("Failed to allocate device memory", ENOMEM);
+
+    // a = ((1 + 2) * 2) - 2 = 4
+    global = count;
+    for (i = 0; i < NUM_KERNELS; i++) {
+        cl_kernel kernel = opencl_program_kernel(program, KERNEL_NAMES[i]);
+        if (NULL == kernel)
+            FATAL_ERROR("opencl_program_kernel", EINVAL);
+        OPENCL_CHECK(clSetKernelArg, (kernel, 0, sizeof(cl_mem), &cl_a));
+        OPENCL_CHECK(clSetKernelArg, (kernel, 1, sizeof(cl_mem), &cl_b));
+        OPENCL_CHECK(clSetKernelArg, (kernel, 2, sizeof(unsigned int), &count));
+    }
+    OPENCL_CHECK(clEnqueueNDRangeKernel, (command_queue, opencl_program_kernel(program, "vector_add"),
+            1, NULL, &global, NULL, 0, NULL, NULL));
+    OPENCL_CHECK(clEnqueueNDRangeKernel, (command_queue, opencl_program_kernel(program, "vector_scale"),
+            1, NULL, &global, NULL, 0, NULL, NULL));
+    OPENCL_CHECK(clEnqueueNDRangeKernel, (command_queue, opencl_program_kernel(program, "vector_sub"),
+            1, NULL, &global, NULL, 0, NULL, NULL));
+    OPENCL_CHECK(clEnqueueReadBuffer, (command_queue, cl_a, CL_TRUE, 0, sizeof(int) * count, a, 0, NULL, NULL));
+
+    for (i = 0; i < count; i++) {
+        if (a[i] != 4)
+            break;
+    }
+    if (i != count) {
+        FATAL_ERROR("Check error at position", i);
+    }
+    printf("Test program_build finished successfully.\n");
+
+    OPENCL_CHECK(clReleaseMemObject, (cl_a));
+    OPENCL_CHECK(clReleaseMemObject, (cl_b));
+    opencl_program_release(program);
+    OPENCL_CHECK(clReleaseCommandQueue, (command_queue));
+    OPENCL_CHECK(clReleaseContext, (context));
+    free(a);
+    free(b);
+    opencl_free_devices(haw_devices_num, haw_devices);
+    return 0;
+}
@@ -0,0 +1,106 @@
+/*
+ * Benchmark of opencl_program_build_async(): several programs are built
+ * one after the other using opencl_program_build(), then concurrently.
+ * The concurrent build should take roughly as long as the longest build.
+ *
+ * The number of worker threads may be set in OPENCL_BUILD_THREADS.
+ */
+#include "HAWOpenCL.h"
+
+#if defined(__APPLE__) && defined(__MACH__)
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define USE_DEVICE_TYPE (CL_DEVICE_TYPE_GPU | CL_DEVICE_TYPE_CPU)
+#define USE_DEVICE_NUM  0
+#define NUM_PROGRAMS    8
+
+// Every program gets a different SCALE, so that the driver cannot reuse a build
+const char KERNEL_SOURCE[] = "\n" \
+    "__kernel void vector_scale(__global float * a, __global const float * b, const unsigned int len)\n"
+    "{\n"
+    "    const size_t i = get_global_id(0);\n"
+    "    if (i < len) {\n"
+    "        float x = b[i];\n"
+    "        for (int j = 0; j < 16; j++)\n"
+    "            x = x * SCALE + sin(x) * cos(x);\n"
+    "        a[i] = x;\n"
+    "    }\n"
+    "}\n";
+
+static double get_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void init_options(hawopencl_build_options * options, int i) {
+    char value[32];
+    snprintf(value, sizeof(value), "%d.0f", i + 1);
+    opencl_build_options_init(options, HAWOPENCL_BUILD_PROFILE_RELEASE);
+    opencl_build_options_define(options, "SCALE", value);
+}
+
+int main(int argc __HAW_OPENCL_ATTR_UNUSED__, char * argv[] __HAW_OPENCL_ATTR_UNUSED__) {
+    cl_device_id device_id;
+    cl_context context;
+    cl_command_queue command_queue;
+    cl_uint haw_devices_num;
+    hawopencl_device * haw_devices;
+    hawopencl_build_options options[NUM_PROGRAMS];
+    hawopencl_build_job * jobs[NUM_PROGRAMS];
+    hawopencl_program * programs[NUM_PROGRAMS];
+    double start;
+    double serial;
+    double async;
+    int i;
+
+    // Measure the compile time without the binary cache
+    opencl_kernel_cache_config(NULL, 0);
+
+    opencl_get_devices(USE_DEVICE_TYPE, &haw_devices_num, &haw_devices);
+    if (0 == haw_devices_num)
+        FATAL_ERROR("No devices of device type available; please change USE_DEVICE_TYPE", EINVAL);
+    opencl_init(USE_DEVICE_TYPE, haw_devices[USE_DEVICE_NUM].device_id, &device_id, &context, &command_queue);
+    printf("Using OpenCL device:%s\n", haw_devices[USE_DEVICE_NUM].device_name);
+
+    start = get_time();
+    for (i = 0; i < NUM_PROGRAMS; i++) {
+        init_options(&options[i], i);
+        opencl_program_build_with_options(KERNEL_SOURCE, &options[i], device_id, context, &programs[i]);
+        opencl_build_options_free(&options[i]);
+        opencl_program_release(programs[i]);
+    }
+    serial = get_time() - start;
+    printf("opencl_program_build() of %d programs took %.3f ms\n", NUM_PROGRAMS, 1000.0 * serial);
+
+    // Use distinct values, so that the second round is not served by any driver cache either
+    start = get_time();
+    for (i = 0; i < NUM_PROGRAMS; i++) {
+        init_options(&options[i], NUM_PROGRAMS + i);
+        opencl_program_build_async(KERNEL_SOURCE, &options[i], device_id, context, &jobs[i]);
+        opencl_build_options_free(&options[i]);
+    }
+    for (i = 0; i < NUM_PROGRAMS; i++) {
+        opencl_program_build_wait(jobs[i], &programs[i]);
+        if (NULL == opencl_program_kernel(programs[i], "vector_scale"))
+            FATAL_ERROR("opencl_program_kernel", EINVAL);
+    }
+    async = get_time() - start;
+    printf("opencl_program_build_async() of %d programs took %.3f ms (speedup %.2f)\n",
+            NUM_PROGRAMS, 1000.0 * async, serial / async);
+
+    for (i = 0; i < NUM_PROGRAMS; i++)
+        opencl_program_release(programs[i]);
+    printf("Test program_build_async finished successfully.\n");
+
+    OPENCL_CHECK(clReleaseCommandQueue, (command_queue));
+    OPENCL_CHECK(clReleaseContext, (context));
+    opencl_free_devices(haw_devices_num, haw_devices);
+    return 0;
+}
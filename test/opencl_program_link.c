@@ -0,0 +1,165 @@
+/*
+ * Benchmark of opencl_library_build() and opencl_program_build_linked():
+ * a suite of programs sharing a large utility module is built once with the
+ * module pasted into every source, like opencl_kernel_load() does for
+ * #include "...", and once with the module compiled into a library once
+ * and linked into every program.
+ */
+#include "HAWOpenCL.h"
+
+#if defined(__APPLE__) && defined(__MACH__)
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#define USE_DEVICE_TYPE (CL_DEVICE_TYPE_GPU | CL_DEVICE_TYPE_CPU)
+#define USE_DEVICE_NUM  0
+#define NUM_PROGRAMS    8
+#define NUM_FUNCTIONS   64
+#define LEN             1024
+
+const char FUNCTION_DECL[] = "float util_%d(float x);\n";
+const char FUNCTION_IMPL[] = "\n" \
+    "float util_%d(float x)\n"
+    "{\n"
+    "    for (int j = 0; j < %d; j++)\n"
+    "        x = x * 0.5f + sin(x) * cos(x);\n"
+    "    return x;\n"
+    "}\n";
+const char KERNEL_SOURCE[] = "\n" \
+    "__kernel void kernel_%d(__global float * a, __global const float * b, const unsigned int len)\n"
+    "{\n"
+    "    const size_t i = get_global_id(0);\n"
+    "    if (i < len) a[i] = util_%d(b[i]);\n"
+    "}\n";
+
+static double get_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Append the formatted string to the buffer of size 64kB
+static void append(char * buffer, const char * format, int arg1, int arg2) {
+    const size_t len = strlen(buffer);
+    snprintf(buffer + len, 65536 - len, format, arg1, arg2);
+}
+
+int main(int argc __HAW_OPENCL_ATTR_UNUSED__, char * argv[] __HAW_OPENCL_ATTR_UNUSED__) {
+    cl_device_id device_id;
+    cl_context context;
+    cl_command_queue command_queue;
+    cl_uint haw_devices_num;
+    hawopencl_device * haw_devices;
+    hawopencl_library * library;
+    hawopencl_program * program;
+    char * header = calloc(65536, 1);
+    char * library_source = calloc(65536, 1);
+    char * source = calloc(65536, 1);
+    char * linked_source = calloc(65536, 1);
+    char kernel_name[32];
+    cl_mem cl_a;
+    cl_mem cl_b;
+    float a[LEN];
+    float b[LEN];
+    float expected[LEN];
+    unsigned int len = LEN;
+    size_t global = LEN;
+    double start;
+    double pasted;
+    double linked;
+    int i;
+
+    if (NULL == header || NULL == library_source || NULL == source || NULL == linked_source)
+        FATAL_ERROR("calloc", ENOMEM);
+    for (i = 0; i < NUM_FUNCTIONS; i++) {
+        append(header, FUNCTION_DECL, i, 0);
+        append(library_source, FUNCTION_IMPL, i, i + 1);
+    }
+
+    // Measure the compile time without the binary cache
+    opencl_kernel_cache_config(NULL, 0);
+
+    opencl_get_devices(USE_DEVICE_TYPE, &haw_devices_num, &haw_devices);
+    if (0 == haw_devices_num)
+        FATAL_ERROR("No devices of device type available; please change USE_DEVICE_TYPE", EINVAL);
+    opencl_init(USE_DEVICE_TYPE, haw_devices[USE_DEVICE_NUM].device_id, &device_id, &context, &command_queue);
+    printf("Using OpenCL device:%s\n", haw_devices[USE_DEVICE_NUM].device_name);
+
+    for (i = 0; i < LEN; i++)
+        b[i] = (float) i / LEN;
+    cl_a = clCreateBuffer(context, CL_MEM_WRITE_ONLY, sizeof(a), NULL, NULL);
+    cl_b = clCreateBuffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(b), b, NULL);
+    if (!cl_a || !cl_b)
+        FATAL_ERROR("Failed to allocate device memory", ENOMEM);
+
+    start = get_time();
+    for (i = 0; i < NUM_PROGRAMS; i++) {
+        strcpy(source, library_source);
+        append(source, KERNEL_SOURCE, i, i);
+        opencl_program_build(source, device_id, context, &program);
+        opencl_program_release(program);
+    }
+    pasted = get_time() - start;
+    printf("Building %d programs with pasted utility module took %.3f ms\n", NUM_PROGRAMS, 1000.0 * pasted);
+
+    start = get_time();
+    opencl_library_build("util.h", header, library_source, NULL, device_id, context, &library);
+    for (i = 0; i < NUM_PROGRAMS; i++) {
+        cl_kernel kernel;
+
+        strcpy(linked_source, "#include \"util.h\"\n");
+        append(linked_source, KERNEL_SOURCE, i, i);
+        opencl_program_build_linked(linked_source, 1, &library, NULL, device_id, context, &program);
+
+        // Compare the last program's result with the pasted build
+        if (NUM_PROGRAMS - 1 == i) {
+            hawopencl_program * reference;
+            int j;
+
+            linked = get_time() - start;
+            opencl_program_build(source, device_id, context, &reference);
+            snprintf(kernel_name, sizeof(kernel_name), "kernel_%d", i);
+            kernel = opencl_program_kernel(reference, kernel_name);
+            OPENCL_CHECK(clSetKernelArg, (kernel, 0, sizeof(cl_mem), &cl_a));
+            OPENCL_CHECK(clSetKernelArg, (kernel, 1, sizeof(cl_mem), &cl_b));
+            OPENCL_CHECK(clSetKernelArg, (kernel, 2, sizeof(unsigned int), &len));
+            OPENCL_CHECK(clEnqueueNDRangeKernel, (command_queue, kernel, 1, NULL, &global, NULL, 0, NULL, NULL));
+            OPENCL_CHECK(clEnqueueReadBuffer, (command_queue, cl_a, CL_TRUE, 0, sizeof(expected), expected, 0, NULL, NULL));
+            opencl_program_release(reference);
+
+            kernel = opencl_program_kernel(program, kernel_name);
+            if (NULL == kernel)
+                FATAL_ERROR("opencl_program_kernel", EINVAL);
+            OPENCL_CHECK(clSetKernelArg, (kernel, 0, sizeof(cl_mem), &cl_a));
+            OPENCL_CHECK(clSetKernelArg, (kernel, 1, sizeof(cl_mem), &cl_b));
+            OPENCL_CHECK(clSetKernelArg, (kernel, 2, sizeof(unsigned int), &len));
+            OPENCL_CHECK(clEnqueueNDRangeKernel, (command_queue, kernel, 1, NULL, &global, NULL, 0, NULL, NULL));
+            OPENCL_CHECK(clEnqueueReadBuffer, (command_queue, cl_a, CL_TRUE, 0, sizeof(a), a, 0, NULL, NULL));
+            for (j = 0; j < LEN; j++)
+                if (fabsf(a[j] - expected[j]) > 1e-5f)
+                    FATAL_ERROR("Check error at position", j);
+        }
+        opencl_program_release(program);
+    }
+    printf("Building %d programs linked with the utility library took %.3f ms (speedup %.2f)\n",
+            NUM_PROGRAMS, 1000.0 * linked, pasted / linked);
+    opencl_library_release(library);
+    printf("Test program_link finished successfully.\n");
+
+    OPENCL_CHECK(clReleaseMemObject, (cl_a));
+    OPENCL_CHECK(clReleaseMemObject, (cl_b));
+    OPENCL_CHECK(clReleaseCommandQueue, (command_queue));
+    OPENCL_CHECK(clReleaseContext, (context));
+    free(header);
+    free(library_source);
+    free(source);
+    free(linked_source);
+    opencl_free_devices(haw_devices_num, haw_devices);
+    return 0;
+}
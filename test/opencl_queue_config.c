@@ -0,0 +1,109 @@
+/*
+ * Benchmark of the command queue properties: many small kernels are
+ * launched on queues with profiling on and off, in-order and out-of-order,
+ * and the launch throughput is reported. The effect is most visible on
+ * CPU devices such as pocl, where a kernel's runtime is close to its
+ * launch overhead.
+ */
+#include "HAWOpenCL.h"
+
+#if defined(__APPLE__) && defined(__MACH__)
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define USE_DEVICE_TYPE (CL_DEVICE_TYPE_CPU | CL_DEVICE_TYPE_GPU)
+#define USE_DEVICE_NUM  0
+#define LEN             256
+#define LAUNCHES        20000
+
+static const char * kernel_source =
+    "__kernel void small(__global int * a)\n"
+    "{\n"
+    "    const size_t i = get_global_id(0);\n"
+    "    a[i] = 2 * (int) i;\n"
+    "}\n";
+
+static double get_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(int argc __HAW_OPENCL_ATTR_UNUSED__, char * argv[] __HAW_OPENCL_ATTR_UNUSED__) {
+    static const struct {
+        const char * name;
+        cl_command_queue_properties properties;
+    } configs[] = {
+        {"in-order,     profiling", CL_QUEUE_PROFILING_ENABLE},
+        {"in-order,     no profiling", 0},
+        {"out-of-order, profiling", CL_QUEUE_PROFILING_ENABLE | CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE},
+        {"out-of-order, no profiling", CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE},
+    };
+    cl_uint haw_devices_num;
+    hawopencl_device * haw_devices;
+    unsigned int c;
+
+    opencl_get_devices(USE_DEVICE_TYPE, &haw_devices_num, &haw_devices);
+    if (0 == haw_devices_num)
+        FATAL_ERROR("No devices of device type available; please change USE_DEVICE_TYPE", EINVAL);
+    printf("Using OpenCL device:%s\n", haw_devices[USE_DEVICE_NUM].device_name);
+
+    for (c = 0; c < sizeof(configs) / sizeof(configs[0]); c++) {
+        hawopencl_queue_config config;
+        cl_device_id device_id;
+        cl_context context;
+        cl_command_queue command_queue;
+        cl_command_queue_properties properties;
+        cl_kernel kernel;
+        cl_mem mem;
+        const size_t global = LEN;
+        int a[LEN];
+        double start;
+        cl_int err;
+        int i;
+
+        opencl_queue_config_init(&config);
+        config.properties = configs[c].properties;
+        opencl_init_with_queue_config(USE_DEVICE_TYPE, haw_devices[USE_DEVICE_NUM].device_id, &config,
+                &device_id, &context, &command_queue);
+        OPENCL_CHECK(clGetCommandQueueInfo, (command_queue, CL_QUEUE_PROPERTIES, sizeof(properties), &properties, NULL));
+        if ((properties & CL_QUEUE_PROFILING_ENABLE) != (configs[c].properties & CL_QUEUE_PROFILING_ENABLE))
+            FATAL_ERROR("Wrong queue properties", EINVAL);
+        opencl_kernel_build(kernel_source, "small", device_id, context, &kernel);
+        mem = clCreateBuffer(context, CL_MEM_WRITE_ONLY, sizeof(a), NULL, &err);
+        if (NULL == mem || CL_SUCCESS != err)
+            FATAL_ERROR("clCreateBuffer", err);
+        OPENCL_CHECK(clSetKernelArg, (kernel, 0, sizeof(cl_mem), &mem));
+        // Warm up
+        OPENCL_CHECK(clEnqueueNDRangeKernel, (command_queue, kernel, 1, NULL, &global, NULL, 0, NULL, NULL));
+        OPENCL_CHECK(clFinish, (command_queue));
+
+        start = get_time();
+        for (i = 0; i < LAUNCHES; i++)
+            OPENCL_CHECK(clEnqueueNDRangeKernel, (command_queue, kernel, 1, NULL, &global, NULL, 0, NULL, NULL));
+        OPENCL_CHECK(clFinish, (command_queue));
+        start = get_time() - start;
+
+        OPENCL_CHECK(clEnqueueReadBuffer, (command_queue, mem, CL_TRUE, 0, sizeof(a), a, 0, NULL, NULL));
+        for (i = 0; i < LEN; i++)
+            if (a[i] != 2 * i)
+                FATAL_ERROR("Wrong result", EINVAL);
+        printf("%-28s%s: %10.0f launches/s (%.3f us per launch)\n", configs[c].name,
+                (configs[c].properties & ~properties & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE) ? " (unsupported)" : "",
+                LAUNCHES / start, 1e6 * start / LAUNCHES);
+
+        OPENCL_CHECK(clReleaseMemObject, (mem));
+        OPENCL_CHECK(clReleaseKernel, (kernel));
+        OPENCL_CHECK(clReleaseCommandQueue, (command_queue));
+        OPENCL_CHECK(clReleaseContext, (context));
+    }
+    printf("Test queue_config finished successfully.\n");
+
+    opencl_free_devices(haw_devices_num, haw_devices);
+    return 0;
+}
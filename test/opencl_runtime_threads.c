@@ -0,0 +1,123 @@
+/*
+ * Test of a runtime shared by several worker threads: every thread gets
+ * its kernels by opencl_runtime_kernel() -- one program shared by all
+ * threads, and one built with a thread-specific define -- and launches
+ * them on its own command queue, without any locking of its own.
+ */
+#include "HAWOpenCL.h"
+
+#if defined(__APPLE__) && defined(__MACH__)
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#define USE_DEVICE_TYPE (CL_DEVICE_TYPE_GPU | CL_DEVICE_TYPE_CPU)
+#define THREADS         8
+#define LEN             4096
+#define LAUNCHES        100
+
+static const char * kernel_source =
+    "#ifndef OFFSET\n"
+    "#define OFFSET 0\n"
+    "#endif\n"
+    "__kernel void fill(__global int * a, const int factor)\n"
+    "{\n"
+    "    const size_t i = get_global_id(0);\n"
+    "    a[i] = factor * (int) i + OFFSET;\n"
+    "}\n";
+
+typedef struct {
+    hawopencl_runtime * runtime;
+    int thread;
+} worker_t;
+
+static double get_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Launch the kernel LAUNCHES times on the queue of this thread and check the result
+static void launch(cl_command_queue queue, cl_kernel kernel, cl_mem mem, int factor, int offset) {
+    const size_t global = LEN;
+    int a[LEN];
+    int i;
+
+    OPENCL_CHECK(clSetKernelArg, (kernel, 0, sizeof(cl_mem), &mem));
+    OPENCL_CHECK(clSetKernelArg, (kernel, 1, sizeof(int), &factor));
+    for (i = 0; i < LAUNCHES; i++)
+        OPENCL_CHECK(clEnqueueNDRangeKernel, (queue, kernel, 1, NULL, &global, NULL, 0, NULL, NULL));
+    OPENCL_CHECK(clEnqueueReadBuffer, (queue, mem, CL_TRUE, 0, sizeof(a), a, 0, NULL, NULL));
+    for (i = 0; i < LEN; i++)
+        if (a[i] != factor * i + offset) {
+            printf("a[%d]:%d expected:%d\n", i, a[i], factor * i + offset);
+            FATAL_ERROR("Wrong result", EINVAL);
+        }
+}
+
+static void * worker(void * arg) {
+    worker_t * w = (worker_t *) arg;
+    const cl_command_queue queue = opencl_runtime_queue(w->runtime, 0, w->thread);
+    hawopencl_build_options options;
+    char value[16];
+    cl_kernel shared;
+    cl_kernel own;
+    cl_mem mem;
+    cl_int err;
+
+    mem = clCreateBuffer(w->runtime->context, CL_MEM_WRITE_ONLY, LEN * sizeof(int), NULL, &err);
+    if (NULL == mem || CL_SUCCESS != err)
+        FATAL_ERROR("clCreateBuffer", err);
+
+    opencl_runtime_kernel(w->runtime, kernel_source, "fill", 0, NULL, &shared);
+    launch(queue, shared, mem, w->thread, 0);
+
+    opencl_build_options_init(&options, HAWOPENCL_BUILD_PROFILE_RELEASE);
+    snprintf(value, sizeof(value), "%d", 1000 * w->thread);
+    opencl_build_options_define(&options, "OFFSET", value);
+    opencl_runtime_kernel(w->runtime, kernel_source, "fill", 0, &options, &own);
+    opencl_build_options_free(&options);
+    launch(queue, own, mem, 2, 1000 * w->thread);
+
+    OPENCL_CHECK(clReleaseKernel, (own));
+    OPENCL_CHECK(clReleaseKernel, (shared));
+    OPENCL_CHECK(clReleaseMemObject, (mem));
+    return NULL;
+}
+
+int main(int argc __HAW_OPENCL_ATTR_UNUSED__, char * argv[] __HAW_OPENCL_ATTR_UNUSED__) {
+    hawopencl_runtime * runtime;
+    pthread_t threads[THREADS];
+    worker_t workers[THREADS];
+    cl_kernel kernel;
+    double start;
+    int i;
+
+    // Every thread builds its own program, so measure the builds, not the cache
+    opencl_kernel_cache_config(NULL, 0);
+    opencl_init_multi(USE_DEVICE_TYPE, 1, NULL, THREADS, NULL, &runtime);
+    printf("Using OpenCL device:%s\n", opencl_device_caps(runtime->device_ids[0])->name);
+    if (CL_INVALID_DEVICE != opencl_runtime_kernel(runtime, kernel_source, "fill", 1, NULL, &kernel) ||
+        CL_INVALID_KERNEL_NAME != opencl_runtime_kernel(runtime, kernel_source, "no_such_kernel", 0, NULL, &kernel))
+        FATAL_ERROR("opencl_runtime_kernel", EINVAL);
+
+    start = get_time();
+    for (i = 0; i < THREADS; i++) {
+        workers[i].runtime = runtime;
+        workers[i].thread = i;
+        if (0 != pthread_create(&threads[i], NULL, worker, &workers[i]))
+            FATAL_ERROR("pthread_create", errno);
+    }
+    for (i = 0; i < THREADS; i++)
+        pthread_join(threads[i], NULL);
+    printf("%d threads built and launched their kernels in %.3f ms\n", THREADS, 1000.0 * (get_time() - start));
+    printf("Test runtime_threads finished successfully.\n");
+
+    opencl_runtime_release(runtime);
+    return 0;
+}
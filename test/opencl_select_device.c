@@ -0,0 +1,58 @@
+/*
+ * List the devices of all platforms with their score, and the device
+ * selected by each policy; the name and vendor patterns may be passed
+ * as arguments, e.g. opencl_select_device "RTX|Radeon" "NVIDIA|AMD".
+ */
+#include "HAWOpenCL.h"
+
+#if defined(__APPLE__) && defined(__MACH__)
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+#include <stdlib.h>
+
+#define USE_DEVICE_TYPE CL_DEVICE_TYPE_ALL
+
+static void print_selected(const char * policy_name, cl_uint num_devices, const hawopencl_device * devices,
+        hawopencl_select_policy policy, const char * pattern) {
+    cl_uint index;
+    int err = opencl_select_device(num_devices, devices, policy, pattern, &index);
+    if (CL_SUCCESS == err)
+        printf("%-8s %-12s -> [%u] %s\n", policy_name, (NULL != pattern) ? pattern : "",
+               index, devices[index].device_name);
+    else if (CL_DEVICE_NOT_FOUND == err)
+        printf("%-8s %-12s -> no matching device\n", policy_name, (NULL != pattern) ? pattern : "");
+    else
+        FATAL_ERROR("opencl_select_device", err);
+}
+
+int main(int argc, char * argv[]) {
+    const char * name_pattern = (argc > 1) ? argv[1] : ".";
+    const char * vendor_pattern = (argc > 2) ? argv[2] : ".";
+    cl_uint haw_devices_num;
+    hawopencl_device * haw_devices;
+    cl_uint i;
+
+    opencl_get_devices(USE_DEVICE_TYPE, &haw_devices_num, &haw_devices);
+    for (i = 0; i < haw_devices_num; i++) {
+        const hawopencl_device_caps * caps = haw_devices[i].caps;
+        printf("[%u] %s (%s): %u CUs @ %u MHz, %lu MiB, %s local memory, score %.0f\n",
+               i, haw_devices[i].device_name, caps->vendor,
+               caps->max_compute_units, caps->max_clock_frequency,
+               (unsigned long) (caps->global_mem_size >> 20),
+               (CL_LOCAL == caps->local_mem_type) ? "dedicated" : "global",
+               caps->score);
+    }
+
+    print_selected("fastest", haw_devices_num, haw_devices, HAWOPENCL_SELECT_FASTEST, NULL);
+    print_selected("memory", haw_devices_num, haw_devices, HAWOPENCL_SELECT_MEMORY, NULL);
+    print_selected("name", haw_devices_num, haw_devices, HAWOPENCL_SELECT_NAME, name_pattern);
+    print_selected("vendor", haw_devices_num, haw_devices, HAWOPENCL_SELECT_VENDOR, vendor_pattern);
+    if (CL_INVALID_VALUE != opencl_select_device(haw_devices_num, haw_devices, HAWOPENCL_SELECT_NAME, "(", &i))
+        FATAL_ERROR("Invalid pattern accepted", EINVAL);
+    printf("Test select_device finished successfully.\n");
+
+    opencl_free_devices(haw_devices_num, haw_devices);
+    return 0;
+}
@@ -0,0 +1,180 @@
+/*
+ * Benchmark of the staging ring: CHUNKS chunks are uploaded into one buffer
+ * while as many are downloaded from another, first by blocking transfers
+ * from malloc()ed memory, then by non-blocking transfers through the slots
+ * of the ring, with the uploads and downloads on two queues overlapping.
+ */
+#include "HAWOpenCL.h"
+
+#if defined(__APPLE__) && defined(__MACH__)
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define USE_DEVICE_TYPE (CL_DEVICE_TYPE_GPU | CL_DEVICE_TYPE_CPU)
+#define CHUNK           (1024 * 1024)   // Bytes per transfer
+#define CHUNKS          256
+#define SLOTS           8
+#define LEN             (CHUNK / sizeof(int))
+
+static double get_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void fill(int * a, int chunk) {
+    size_t i;
+    for (i = 0; i < LEN; i++)
+        a[i] = chunk + (int) i;
+}
+
+static void check(const int * a, int chunk) {
+    size_t i;
+    for (i = 0; i < LEN; i++)
+        if (a[i] != chunk + (int) i) {
+            printf("chunk:%d a[%zu]:%d expected:%d\n", chunk, i, a[i], chunk + (int) i);
+            FATAL_ERROR("Wrong result", EINVAL);
+        }
+}
+
+// Blocking transfers from and to malloc()ed memory; returns GB/s in both directions
+static double run_blocking(cl_command_queue queue, cl_mem up, cl_mem down) {
+    int * a = malloc(CHUNK);
+    double start;
+    int c;
+
+    if (NULL == a)
+        FATAL_ERROR("malloc", ENOMEM);
+    start = get_time();
+    for (c = 0; c < CHUNKS; c++) {
+        fill(a, c);
+        OPENCL_CHECK(clEnqueueWriteBuffer, (queue, up, CL_TRUE, (size_t) c * CHUNK, CHUNK, a, 0, NULL, NULL));
+        OPENCL_CHECK(clEnqueueReadBuffer, (queue, down, CL_TRUE, (size_t) c * CHUNK, CHUNK, a, 0, NULL, NULL));
+        check(a, -c);
+    }
+    start = get_time() - start;
+    free(a);
+    return 2.0 * CHUNKS * CHUNK / start / 1e9;
+}
+
+// Uploads on one queue and downloads on the other through the ring; returns GB/s in both directions
+static double run_ring(hawopencl_staging_ring * ring, cl_command_queue up_queue,
+        cl_command_queue down_queue, cl_mem up, cl_mem down) {
+    cl_uint pending_slots[SLOTS / 2];
+    cl_event pending_events[SLOTS / 2];
+    int * pending_ptrs[SLOTS / 2];
+    int num_pending = 0;
+    double start;
+    cl_uint slot;
+    void * ptr;
+    int c;
+    int p;
+
+    start = get_time();
+    for (c = 0; c < CHUNKS; c++) {
+        OPENCL_CHECK(opencl_staging_ring_acquire, (ring, &slot, &ptr));
+        fill((int *) ptr, c);
+        OPENCL_CHECK(opencl_staging_ring_write, (ring, slot, up_queue, up, (size_t) c * CHUNK, CHUNK, 0, NULL, NULL));
+
+        // Keep half of the slots for downloads in flight; consume the oldest one
+        if (SLOTS / 2 == num_pending) {
+            OPENCL_CHECK(clWaitForEvents, (1, &pending_events[0]));
+            check(pending_ptrs[0], -(c - SLOTS / 2));
+            OPENCL_CHECK(clReleaseEvent, (pending_events[0]));
+            OPENCL_CHECK(opencl_staging_ring_release_slot, (ring, pending_slots[0]));
+            num_pending--;
+            memmove(pending_slots, pending_slots + 1, num_pending * sizeof(cl_uint));
+            memmove(pending_events, pending_events + 1, num_pending * sizeof(cl_event));
+            memmove(pending_ptrs, pending_ptrs + 1, num_pending * sizeof(int *));
+        }
+        OPENCL_CHECK(opencl_staging_ring_acquire, (ring, &slot, &ptr));
+        OPENCL_CHECK(opencl_staging_ring_read, (ring, slot, down_queue, down, (size_t) c * CHUNK, CHUNK,
+                0, NULL, &pending_events[num_pending]));
+        pending_slots[num_pending] = slot;
+        pending_ptrs[num_pending] = (int *) ptr;
+        num_pending++;
+    }
+    for (p = 0; p < num_pending; p++) {
+        OPENCL_CHECK(clWaitForEvents, (1, &pending_events[p]));
+        check(pending_ptrs[p], -(CHUNKS - num_pending + p));
+        OPENCL_CHECK(clReleaseEvent, (pending_events[p]));
+        OPENCL_CHECK(opencl_staging_ring_release_slot, (ring, pending_slots[p]));
+    }
+    OPENCL_CHECK(clFinish, (up_queue));
+    start = get_time() - start;
+    return 2.0 * CHUNKS * CHUNK / start / 1e9;
+}
+
+// Check the uploaded chunks and reset them for the next run
+static void verify(cl_command_queue queue, cl_mem up) {
+    int * a = malloc(CHUNK);
+    int c;
+
+    if (NULL == a)
+        FATAL_ERROR("malloc", ENOMEM);
+    for (c = 0; c < CHUNKS; c++) {
+        OPENCL_CHECK(clEnqueueReadBuffer, (queue, up, CL_TRUE, (size_t) c * CHUNK, CHUNK, a, 0, NULL, NULL));
+        check(a, c);
+        memset(a, 0, CHUNK);
+        OPENCL_CHECK(clEnqueueWriteBuffer, (queue, up, CL_TRUE, (size_t) c * CHUNK, CHUNK, a, 0, NULL, NULL));
+    }
+    free(a);
+}
+
+int main(int argc __HAW_OPENCL_ATTR_UNUSED__, char * argv[] __HAW_OPENCL_ATTR_UNUSED__) {
+    hawopencl_staging_ring * ring;
+    cl_device_id device_id;
+    cl_context context;
+    cl_command_queue up_queue;
+    cl_command_queue down_queue;
+    cl_mem up;
+    cl_mem down;
+    double blocking;
+    double staged;
+    int * a;
+    int c;
+    cl_int err;
+
+    opencl_init(USE_DEVICE_TYPE, 0, &device_id, &context, &up_queue);
+    printf("Using OpenCL device:%s\n", opencl_device_caps(device_id)->name);
+    opencl_command_queue_create(device_id, context, NULL, &down_queue);
+
+    up = clCreateBuffer(context, CL_MEM_READ_WRITE, (size_t) CHUNKS * CHUNK, NULL, &err);
+    if (NULL == up || CL_SUCCESS != err)
+        FATAL_ERROR("clCreateBuffer", err);
+    down = clCreateBuffer(context, CL_MEM_READ_WRITE, (size_t) CHUNKS * CHUNK, NULL, &err);
+    if (NULL == down || CL_SUCCESS != err)
+        FATAL_ERROR("clCreateBuffer", err);
+    a = malloc(CHUNK);
+    if (NULL == a)
+        FATAL_ERROR("malloc", ENOMEM);
+    for (c = 0; c < CHUNKS; c++) {
+        fill(a, -c);
+        OPENCL_CHECK(clEnqueueWriteBuffer, (up_queue, down, CL_TRUE, (size_t) c * CHUNK, CHUNK, a, 0, NULL, NULL));
+    }
+    free(a);
+
+    blocking = run_blocking(up_queue, up, down);
+    verify(up_queue, up);
+
+    opencl_staging_ring_create(context, up_queue, CHUNK, SLOTS, &ring);
+    staged = run_ring(ring, up_queue, down_queue, up, down);
+    verify(up_queue, up);
+    opencl_staging_ring_release(ring);
+
+    printf("Blocking transfers from malloc():  %8.2f GB/s\n", blocking);
+    printf("Staging ring, %d slots, 2 queues:   %8.2f GB/s\n", SLOTS, staged);
+    printf("Test staging_ring finished successfully.\n");
+
+    OPENCL_CHECK(clReleaseMemObject, (down));
+    OPENCL_CHECK(clReleaseMemObject, (up));
+    OPENCL_CHECK(clReleaseCommandQueue, (down_queue));
+    OPENCL_CHECK(clReleaseCommandQueue, (up_queue));
+    OPENCL_CHECK(clReleaseContext, (context));
+    return 0;
+}
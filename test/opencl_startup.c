@@ -0,0 +1,158 @@
+/*
+ * Startup benchmark: child processes time from main() until the result of
+ * the first kernel is available, split into the phases of device discovery,
+ * initialization of context and queue, build and the first run.
+ * The platforms are discovered in parallel; in the cold run (empty cache
+ * directory) all platforms are waited for, in the warm run the device
+ * capabilities of the previous run allow to skip platforms without any
+ * device of USE_DEVICE_TYPE, e.g. a slow GPU driver for a CPU-only program.
+ */
+#include "HAWOpenCL.h"
+
+#if defined(__APPLE__) && defined(__MACH__)
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/wait.h>
+
+#define USE_DEVICE_TYPE CL_DEVICE_TYPE_CPU
+#define LEN             1024
+
+static const char * kernel_source =
+    "__kernel void square(__global int * a)\n"
+    "{\n"
+    "    const size_t i = get_global_id(0);\n"
+    "    a[i] = (int) (i * i);\n"
+    "}\n";
+
+typedef struct {
+    double discover_ms;             // opencl_get_devices()
+    double init_ms;                 // opencl_init() with the selected device
+    double build_ms;                // opencl_kernel_build()
+    double run_ms;                  // Until the result has been read
+    char name[256];
+} result_t;
+
+static double get_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Everything a program does until its first kernel's result is ready
+static void first_kernel(double start, result_t * r) {
+    const size_t global = LEN;
+    cl_uint num_devices;
+    hawopencl_device * devices;
+    cl_device_id device_id;
+    cl_context context;
+    cl_command_queue queue;
+    cl_kernel kernel;
+    cl_mem mem;
+    cl_int err;
+    int a[LEN];
+    double t;
+    int i;
+
+    opencl_get_devices(USE_DEVICE_TYPE, &num_devices, &devices);
+    strncpy(r->name, devices[0].device_name, sizeof(r->name) - 1);
+    t = get_time();
+    r->discover_ms = 1000.0 * (t - start);
+
+    opencl_init(USE_DEVICE_TYPE, devices[0].device_id, &device_id, &context, &queue);
+    opencl_free_devices(num_devices, devices);
+    r->init_ms = 1000.0 * (get_time() - t);
+    t = get_time();
+
+    opencl_kernel_build(kernel_source, "square", device_id, context, &kernel);
+    r->build_ms = 1000.0 * (get_time() - t);
+    t = get_time();
+
+    mem = clCreateBuffer(context, CL_MEM_WRITE_ONLY, sizeof(a), NULL, &err);
+    if (NULL == mem || CL_SUCCESS != err)
+        FATAL_ERROR("clCreateBuffer", err);
+    OPENCL_CHECK(clSetKernelArg, (kernel, 0, sizeof(cl_mem), &mem));
+    OPENCL_CHECK(clEnqueueNDRangeKernel, (queue, kernel, 1, NULL, &global, NULL, 0, NULL, NULL));
+    OPENCL_CHECK(clEnqueueReadBuffer, (queue, mem, CL_TRUE, 0, sizeof(a), a, 0, NULL, NULL));
+    r->run_ms = 1000.0 * (get_time() - t);
+    for (i = 0; i < LEN; i++)
+        if (a[i] != i * i)
+            FATAL_ERROR("Wrong result", EINVAL);
+
+    OPENCL_CHECK(clReleaseMemObject, (mem));
+    OPENCL_CHECK(clReleaseKernel, (kernel));
+    OPENCL_CHECK(clReleaseCommandQueue, (queue));
+    OPENCL_CHECK(clReleaseContext, (context));
+}
+
+// Start a fresh process, as the platforms are discovered only once per process
+static void run(const char * cache_dir, result_t * result) {
+    int fds[2];
+    pid_t pid;
+    int status;
+
+    if (0 != pipe(fds))
+        FATAL_ERROR("pipe", errno);
+    pid = fork();
+    if (-1 == pid)
+        FATAL_ERROR("fork", errno);
+    if (0 == pid) {
+        result_t r;
+
+        memset(&r, 0, sizeof(r));
+        setenv("OPENCL_KERNEL_CACHE_DIR", cache_dir, 1);
+        first_kernel(get_time(), &r);
+        if (sizeof(r) != write(fds[1], &r, sizeof(r)))
+            FATAL_ERROR("write", errno);
+        _exit(0);
+    }
+    close(fds[1]);
+    if (sizeof(*result) != read(fds[0], result, sizeof(*result)))
+        FATAL_ERROR("read", EIO);
+    close(fds[0]);
+    if (-1 == waitpid(pid, &status, 0) || !WIFEXITED(status) || 0 != WEXITSTATUS(status))
+        FATAL_ERROR("waitpid", ECHILD);
+}
+
+static void print(const char * what, const result_t * r) {
+    printf("%s: discover:%8.3f ms init:%8.3f ms build:%8.3f ms run:%8.3f ms total:%8.3f ms\n",
+            what, r->discover_ms, r->init_ms, r->build_ms, r->run_ms,
+            r->discover_ms + r->init_ms + r->build_ms + r->run_ms);
+}
+
+int main(int argc __HAW_OPENCL_ATTR_UNUSED__, char * argv[] __HAW_OPENCL_ATTR_UNUSED__) {
+    char dir[] = "/tmp/hawopencl_startup.XXXXXX";
+    char path[512];
+    struct dirent * entry;
+    DIR * d;
+    result_t cold;
+    result_t warm;
+
+    if (NULL == mkdtemp(dir))
+        FATAL_ERROR("mkdtemp", errno);
+
+    run(dir, &cold);
+    run(dir, &warm);
+    printf("Using OpenCL device:%s\n", warm.name);
+    print("cold", &cold);
+    print("warm", &warm);
+    printf("Test startup finished successfully.\n");
+
+    // Remove the device capabilities and kernels cached by the runs
+    d = opendir(dir);
+    while (NULL != d && NULL != (entry = readdir(d)))
+        if ('.' != entry->d_name[0]) {
+            snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+            unlink(path);
+        }
+    if (NULL != d)
+        closedir(d);
+    rmdir(dir);
+    return 0;
+}
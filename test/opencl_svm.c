@@ -0,0 +1,235 @@
+/*
+ * Pointer-chasing benchmark of shared virtual memory: LISTS linked lists of
+ * LENGTH nodes each, scattered randomly in memory, are summed by a kernel,
+ * one work-item per list.
+ * With flattening the lists built on the host by malloc() are serialized
+ * into an array of nodes linked by indices and copied to a buffer for every
+ * run; with SVM the lists are built in an SVM region and the kernel follows
+ * the pointers as they are. Requires HAWOPENCL_CL_VERSION of at least 200
+ * and a device supporting SVM, e.g. pocl.
+ */
+#include "HAWOpenCL.h"
+
+#if defined(__APPLE__) && defined(__MACH__)
+#include <OpenCL/cl.h>
+#else
+#include <CL/cl.h>
+#endif
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define USE_DEVICE_TYPE (CL_DEVICE_TYPE_CPU | CL_DEVICE_TYPE_GPU)
+#define LISTS           1024
+#define LENGTH          1024
+#define REPETITIONS     10
+
+typedef struct node {
+    struct node * next;
+    cl_int value;
+    cl_int index;               // Assigned by flattening
+} node_t;
+
+typedef struct {
+    cl_int next;                // The index of the next node, -1 at the end
+    cl_int value;
+} flat_node_t;
+
+static const char * flat_source =
+    "typedef struct { int next; int value; } flat_node_t;\n"
+    "__kernel void chase(__global const flat_node_t * nodes, __global const int * heads,\n"
+    "                    __global long * sums)\n"
+    "{\n"
+    "    const size_t k = get_global_id(0);\n"
+    "    long sum = 0;\n"
+    "    for (int n = heads[k]; n >= 0; n = nodes[n].next)\n"
+    "        sum += nodes[n].value;\n"
+    "    sums[k] = sum;\n"
+    "}\n";
+
+static const char * svm_source =
+    "typedef struct node { __global struct node * next; int value; int index; } node_t;\n"
+    "__kernel void chase(__global node_t * __global const * heads, __global long * sums)\n"
+    "{\n"
+    "    const size_t k = get_global_id(0);\n"
+    "    long sum = 0;\n"
+    "    for (__global node_t * n = heads[k]; NULL != n; n = n->next)\n"
+    "        sum += n->value;\n"
+    "    sums[k] = sum;\n"
+    "}\n";
+
+static double get_time(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+// Link the nodes into lists in a random order, so that following a pointer misses the cache
+static void build(node_t * nodes, node_t ** heads) {
+    int * order = malloc(LISTS * LENGTH * sizeof(int));
+    int i;
+
+    if (NULL == order)
+        FATAL_ERROR("malloc", ENOMEM);
+    for (i = 0; i < LISTS * LENGTH; i++)
+        order[i] = i;
+    srand(4711);
+    for (i = LISTS * LENGTH - 1; i > 0; i--) {
+        const int j = rand() % (i + 1);
+        const int tmp = order[i];
+        order[i] = order[j];
+        order[j] = tmp;
+    }
+    for (i = 0; i < LISTS * LENGTH; i++) {
+        node_t * n = &nodes[order[i]];
+        n->value = i % LENGTH;
+        n->next = (LENGTH - 1 == i % LENGTH) ? NULL : &nodes[order[i + 1]];
+        if (0 == i % LENGTH)
+            heads[i / LENGTH] = n;
+    }
+    free(order);
+}
+
+static void check(const cl_long * sums) {
+    int k;
+    for (k = 0; k < LISTS; k++)
+        if (sums[k] != (cl_long) LENGTH * (LENGTH - 1) / 2)
+            FATAL_ERROR("Wrong result", EINVAL);
+}
+
+// Serialize the lists into flat nodes linked by indices, copy and sum them; returns ms per run
+static double run_flat(cl_device_id device_id, cl_context context, cl_command_queue queue) {
+    const size_t global = LISTS;
+    node_t * nodes = malloc(LISTS * LENGTH * sizeof(node_t));
+    node_t ** heads = malloc(LISTS * sizeof(node_t *));
+    flat_node_t * flat = malloc(LISTS * LENGTH * sizeof(flat_node_t));
+    cl_int flat_heads[LISTS];
+    cl_long sums[LISTS];
+    cl_mem mems[3];
+    cl_kernel kernel;
+    double start;
+    cl_int err;
+    int r;
+    int k;
+
+    if (NULL == nodes || NULL == heads || NULL == flat)
+        FATAL_ERROR("malloc", ENOMEM);
+    build(nodes, heads);
+    opencl_kernel_build(flat_source, "chase", device_id, context, &kernel);
+    mems[0] = clCreateBuffer(context, CL_MEM_READ_ONLY, LISTS * LENGTH * sizeof(flat_node_t), NULL, &err);
+    mems[1] = clCreateBuffer(context, CL_MEM_READ_ONLY, sizeof(flat_heads), NULL, &err);
+    mems[2] = clCreateBuffer(context, CL_MEM_WRITE_ONLY, sizeof(sums), NULL, &err);
+    for (k = 0; k < 3; k++) {
+        if (NULL == mems[k])
+            FATAL_ERROR("clCreateBuffer", err);
+        OPENCL_CHECK(clSetKernelArg, (kernel, k, sizeof(cl_mem), &mems[k]));
+    }
+
+    start = get_time();
+    for (r = 0; r < REPETITIONS; r++) {
+        int count = 0;
+        // Number the nodes in list order, then translate the pointers into indices
+        for (k = 0; k < LISTS; k++) {
+            node_t * n;
+            for (n = heads[k]; NULL != n; n = n->next)
+                n->index = count++;
+        }
+        for (k = 0; k < LISTS; k++) {
+            node_t * n;
+            flat_heads[k] = heads[k]->index;
+            for (n = heads[k]; NULL != n; n = n->next) {
+                flat[n->index].next = (NULL == n->next) ? -1 : n->next->index;
+                flat[n->index].value = n->value;
+            }
+        }
+        OPENCL_CHECK(clEnqueueWriteBuffer, (queue, mems[0], CL_FALSE, 0, LISTS * LENGTH * sizeof(flat_node_t), flat, 0, NULL, NULL));
+        OPENCL_CHECK(clEnqueueWriteBuffer, (queue, mems[1], CL_FALSE, 0, sizeof(flat_heads), flat_heads, 0, NULL, NULL));
+        OPENCL_CHECK(clEnqueueNDRangeKernel, (queue, kernel, 1, NULL, &global, NULL, 0, NULL, NULL));
+        OPENCL_CHECK(clEnqueueReadBuffer, (queue, mems[2], CL_TRUE, 0, sizeof(sums), sums, 0, NULL, NULL));
+        check(sums);
+    }
+    start = get_time() - start;
+
+    for (k = 0; k < 3; k++)
+        OPENCL_CHECK(clReleaseMemObject, (mems[k]));
+    OPENCL_CHECK(clReleaseKernel, (kernel));
+    free(flat);
+    free(heads);
+    free(nodes);
+    return 1000.0 * start / REPETITIONS;
+}
+
+// Sum the lists built in the SVM region; returns ms per run
+static double run_svm(cl_device_id device_id, cl_context context, cl_command_queue queue,
+        hawopencl_svm_granularity granularity) {
+    const size_t global = LISTS;
+    hawopencl_build_options options;
+    hawopencl_svm svm;
+    const hawopencl_svm * regions[1] = { &svm };
+    node_t * nodes;
+    node_t ** heads;
+    cl_long sums[LISTS];
+    cl_kernel kernel;
+    cl_mem mem;
+    double start;
+    cl_int err;
+    int r;
+
+    OPENCL_CHECK(opencl_svm_create, (device_id, context, CL_MEM_READ_WRITE, granularity,
+            LISTS * LENGTH * sizeof(node_t) + LISTS * sizeof(node_t *) + 256, &svm));
+    OPENCL_CHECK(opencl_svm_map, (queue, &svm, CL_MAP_WRITE));
+    nodes = opencl_svm_alloc(&svm, LISTS * LENGTH * sizeof(node_t), 0);
+    heads = opencl_svm_alloc(&svm, LISTS * sizeof(node_t *), 0);
+    if (NULL == nodes || NULL == heads)
+        FATAL_ERROR("opencl_svm_alloc", ENOMEM);
+    build(nodes, heads);
+    OPENCL_CHECK(opencl_svm_unmap, (queue, &svm));
+
+    opencl_build_options_init(&options, HAWOPENCL_BUILD_PROFILE_RELEASE);
+    opencl_build_options_add(&options, "-cl-std=CL2.0");
+    opencl_kernel_build_with_options(svm_source, "chase", &options, device_id, context, &kernel);
+    opencl_build_options_free(&options);
+    mem = clCreateBuffer(context, CL_MEM_WRITE_ONLY, sizeof(sums), NULL, &err);
+    if (NULL == mem || CL_SUCCESS != err)
+        FATAL_ERROR("clCreateBuffer", err);
+    OPENCL_CHECK(opencl_svm_set_kernel_arg, (kernel, 0, &svm, heads));
+    OPENCL_CHECK(opencl_svm_set_kernel_regions, (kernel, 1, regions));
+    OPENCL_CHECK(clSetKernelArg, (kernel, 1, sizeof(cl_mem), &mem));
+
+    start = get_time();
+    for (r = 0; r < REPETITIONS; r++) {
+        OPENCL_CHECK(clEnqueueNDRangeKernel, (queue, kernel, 1, NULL, &global, NULL, 0, NULL, NULL));
+        OPENCL_CHECK(clEnqueueReadBuffer, (queue, mem, CL_TRUE, 0, sizeof(sums), sums, 0, NULL, NULL));
+        check(sums);
+    }
+    start = get_time() - start;
+
+    OPENCL_CHECK(clReleaseMemObject, (mem));
+    OPENCL_CHECK(clReleaseKernel, (kernel));
+    opencl_svm_release(&svm);
+    return 1000.0 * start / REPETITIONS;
+}
+
+int main(int argc __HAW_OPENCL_ATTR_UNUSED__, char * argv[] __HAW_OPENCL_ATTR_UNUSED__) {
+    cl_device_id device_id;
+    cl_context context;
+    cl_command_queue queue;
+
+    opencl_init(USE_DEVICE_TYPE, 0, &device_id, &context, &queue);
+    printf("Using OpenCL device:%s\n", opencl_device_caps(device_id)->name);
+
+    printf("Flattening and copy:   %8.3f ms per run\n", run_flat(device_id, context, queue));
+    if (opencl_device_supports_svm(device_id, HAWOPENCL_SVM_COARSE_GRAIN))
+        printf("Coarse-grained SVM:    %8.3f ms per run\n",
+                run_svm(device_id, context, queue, HAWOPENCL_SVM_COARSE_GRAIN));
+    else
+        printf("SVM is not supported; configure with HAWOPENCL_CL_VERSION=200\n");
+    if (opencl_device_supports_svm(device_id, HAWOPENCL_SVM_FINE_GRAIN))
+        printf("Fine-grained SVM:      %8.3f ms per run\n",
+                run_svm(device_id, context, queue, HAWOPENCL_SVM_FINE_GRAIN));
+    printf("Test svm finished successfully.\n");
+
+    OPENCL_CHECK(clReleaseCommandQueue, (queue));
+    OPENCL_CHECK(clReleaseContext, (context));
+    return 0;
+}
@@ -1,8 +1,7 @@
 /*
  * Small test to show the usage of the HAWOpenCL API.
- * This test has KERNEL_SOURCE defined inline -- not very good to code...
- * 
- * 
+ * The kernel vector_add.cl is compiled into the executable using
+ * hawopencl_embed_kernels(), so no OPENCL_KERNEL_PATH is required.
  */
 #include "HAWOpenCL.h"
 
@@ -17,19 +16,6 @@
 #define USE_DEVICE_TYPE (CL_DEVICE_TYPE_GPU | CL_DEVICE_TYPE_CPU)
 #define USE_DEVICE_NUM  0
 
-// Keep it as string here, otherwise automatic tests might fail due to NOT
-// setting the env-var OPENCL_KERNEL_PATH correctly.
-const char KERNEL_SOURCE[] = "\n" \
-    "__kernel void vector_add(__global int * a, \n"
-    "                         __global const int * b, \n"
-    "                         const unsigned int len)\n"
-    "{\n"
-    "    const size_t i = get_global_id(0);\n"
-    "    if (i < len) {\n"
-    "        a[i] += b[i];\n"
-    "    }\n"
-    "}\n";
-
 int main(int argc __HAW_OPENCL_ATTR_UNUSED__, char * argv[] __HAW_OPENCL_ATTR_UNUSED__) {
     cl_device_id device_id;
     cl_context context;
@@ -45,6 +31,7 @@ int main(int argc __HAW_OPENCL_ATTR_UNUSED__, char * argv[] __HAW_OPENCL_ATTR_UN
     cl_uint haw_devices_num;
     hawopencl_device * haw_devices;
     hawopencl_kernel kernel_info;
+    char * source;
     
     opencl_get_devices(USE_DEVICE_TYPE, &haw_devices_num, &haw_devices);
     if (0 == haw_devices_num)
@@ -57,7 +44,9 @@ int main(int argc __HAW_OPENCL_ATTR_UNUSED__, char * argv[] __HAW_OPENCL_ATTR_UN
     // opencl_init(USE_DEVICE_TYPE, 0, &device_id, &context, &command_queue);
     opencl_init(USE_DEVICE_TYPE, haw_devices[USE_DEVICE_NUM].device_id, &device_id, &context, &command_queue);
     // opencl_print_device(device_id);
-    opencl_kernel_build(KERNEL_SOURCE, "vector_add", device_id, context, &kernel);
+    source = opencl_kernel_load("vector_add.cl");
+    opencl_kernel_build(source, "vector_add", device_id, context, &kernel);
+    free(source);
     
     a = (int*) malloc(sizeof(int) * count);
     b = (int*) malloc(sizeof(int) * count);
@@ -0,0 +1,12 @@
+/*
+ * Kernel used by the tests, e.g. compiled offline into SPIR-V.
+ */
+__kernel void vector_add(__global int * a,
+                         __global const int * b,
+                         const unsigned int len)
+{
+    const size_t i = get_global_id(0);
+    if (i < len) {
+        a[i] += b[i];
+    }
+}